@@ -68,13 +68,35 @@ SOURCES += \
     src/fronius_inverter.cpp \
     src/power_info.cpp \
     src/inverter_gateway.cpp \
+    src/inventory_detector.cpp \
     src/local_ip_address_generator.cpp \
+    src/scan_window.cpp \
     src/settings.cpp \
+    src/tcp_port_scanner.cpp \
     src/dbus_fronius.cpp \
     src/inverter_settings.cpp \
     src/fronius_device_info.cpp \
     src/inverter_mediator.cpp \
     src/modbus_tcp_client/modbus_tcp_client.cpp \
+    src/modbus_tcp_client/modbus_tcp_connection.cpp \
+    src/modbus_tcp_client/modbus_tcp_frame.cpp \
+    src/modbus_tcp_client/modbus_statistics.cpp \
+    src/modbus_tcp_client/rtt_estimator.cpp \
+    src/modbus_tcp_client/modbus_register_image.cpp \
+    src/modbus_tcp_client/modbus_tcp_server.cpp \
+    src/modbus_tcp_client/modbus_tcp_proxy.cpp \
+    src/modbus_tcp_client/crc16.cpp \
+    src/modbus_tcp_client/modbus_rtu_frame_parser.cpp \
+    src/modbus_tcp_client/modbus_rtu_bus.cpp \
+    src/modbus_tcp_client/modbus_rtu_serial_bus.cpp \
+    src/modbus_tcp_client/modbus_rtu_tcp_bus.cpp \
+    src/modbus_tcp_client/modbus_rtu_client.cpp \
+    src/modbus_tcp_client/modbus_rtu_over_tcp_client.cpp \
+    ext/velib/src/plt/serial.c \
+    ext/velib/src/plt/posix_serial.c \
+    ext/velib/src/plt/posix_ctx.c \
+    ext/velib/src/types/ve_variant.c \
+    src/modbus_statistics_info.cpp \
     src/ve_qitem_consumer.cpp \
     src/ve_qitem_init_monitor.cpp \
     src/ve_service.cpp \
@@ -84,9 +106,16 @@ SOURCES += \
     src/fronius_udp_detector.cpp \
     src/modbus_tcp_client/modbus_reply.cpp \
     src/modbus_tcp_client/modbus_client.cpp \
+    src/modbus_tcp_client/modbus_frame_buffer.cpp \
+    src/modbus_tcp_client/timer_wheel.cpp \
     src/sunspec_tools.cpp \
+    src/sunspec_models.cpp \
+    src/sunspec_inverter_decoder.cpp \
+    src/sunspec_read_plan.cpp \
     src/gateway_interface.cpp \
     src/sunspec_updater.cpp \
+    src/poll_scheduler.cpp \
+    src/power_limit_coalescer.cpp \
     src/solar_api_updater.cpp \
     src/data_processor.cpp \
     src/solaredge_updater.cpp \
@@ -100,8 +129,11 @@ HEADERS += \
     src/fronius_inverter.h \
     src/power_info.h \
     src/inverter_gateway.h \
+    src/inventory_detector.h \
     src/local_ip_address_generator.h \
+    src/scan_window.h \
     src/settings.h \
+    src/tcp_port_scanner.h \
     src/dbus_fronius.h \
     src/inverter_settings.h \
     src/defines.h \
@@ -109,6 +141,22 @@ HEADERS += \
     src/inverter_mediator.h \
     src/velib/velib_config_app.h \
     src/modbus_tcp_client/modbus_tcp_client.h \
+    src/modbus_tcp_client/modbus_tcp_connection.h \
+    src/modbus_tcp_client/modbus_tcp_frame.h \
+    src/modbus_tcp_client/modbus_statistics.h \
+    src/modbus_tcp_client/rtt_estimator.h \
+    src/modbus_tcp_client/modbus_register_image.h \
+    src/modbus_tcp_client/modbus_tcp_server.h \
+    src/modbus_tcp_client/modbus_tcp_proxy.h \
+    src/modbus_tcp_client/modbus_request_queue.h \
+    src/modbus_tcp_client/crc16.h \
+    src/modbus_tcp_client/modbus_rtu_frame_parser.h \
+    src/modbus_tcp_client/modbus_rtu_bus.h \
+    src/modbus_tcp_client/modbus_rtu_serial_bus.h \
+    src/modbus_tcp_client/modbus_rtu_tcp_bus.h \
+    src/modbus_tcp_client/modbus_rtu_client.h \
+    src/modbus_tcp_client/modbus_rtu_over_tcp_client.h \
+    src/modbus_statistics_info.h \
     src/ve_qitem_consumer.h \
     src/ve_qitem_init_monitor.h \
     src/ve_service.h \
@@ -118,9 +166,16 @@ HEADERS += \
     src/fronius_udp_detector.h \
     src/modbus_tcp_client/modbus_reply.h \
     src/modbus_tcp_client/modbus_client.h \
+    src/modbus_tcp_client/modbus_frame_buffer.h \
+    src/modbus_tcp_client/timer_wheel.h \
     src/sunspec_tools.h \
+    src/sunspec_models.h \
+    src/sunspec_inverter_decoder.h \
+    src/sunspec_read_plan.h \
     src/gateway_interface.h \
     src/sunspec_updater.h \
+    src/poll_scheduler.h \
+    src/power_limit_coalescer.h \
     src/solar_api_updater.h \
     src/data_processor.h \
     src/solaredge_updater.h \
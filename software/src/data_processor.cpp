@@ -11,6 +11,10 @@ DataProcessor::DataProcessor(Inverter *inverter, InverterSettings *settings, QOb
 	mSettings(settings),
 	mPreviousTotalEnergy(-1)
 {
+	// Until the power of the phases is known, assume it is evenly distributed.
+	int phaseCount = qBound(1, inverter->deviceInfo().phaseCount, 3);
+	for (int i=0; i<3; ++i)
+		mPhaseShares[i] = i < phaseCount ? 1.0 / phaseCount : 0;
 }
 
 void DataProcessor::process(const CommonInverterData &data)
@@ -66,6 +70,10 @@ void DataProcessor::process(const ThreePhasesInverterData &data)
 	if (totalVi > 0) {
 		powerCorrection = mInverter->meanPowerInfo()->power() / totalVi;
 		energyCorrection = energyDelta / totalVi;
+		// Used by processPower, which may be called when the total power is 0.
+		mPhaseShares[0] = vi1 / totalVi;
+		mPhaseShares[1] = vi2 / totalVi;
+		mPhaseShares[2] = deviceInfo.phaseCount > 2 ? vi3 / totalVi : 0;
 	}
 
 	PowerInfo *l1 = mInverter->l1PowerInfo();
@@ -91,6 +99,23 @@ void DataProcessor::process(const ThreePhasesInverterData &data)
 	mPreviousTotalEnergy = totalEnergy;
 }
 
+void DataProcessor::processPower(double power)
+{
+	BasicPowerInfo *pi = mInverter->meanPowerInfo();
+	pi->setPower(power);
+	InverterPhase phase = getPhase();
+	if (phase != MultiPhase) {
+		mInverter->getPowerInfo(phase)->setPower(power);
+		return;
+	}
+	// The shares do not depend on the previous total, so this also works if that was 0 or
+	// invalid. An invalid power invalidates the power of the phases as well.
+	mInverter->l1PowerInfo()->setPower(power * mPhaseShares[0]);
+	mInverter->l2PowerInfo()->setPower(power * mPhaseShares[1]);
+	if (mInverter->deviceInfo().phaseCount > 2)
+		mInverter->l3PowerInfo()->setPower(power * mPhaseShares[2]);
+}
+
 void DataProcessor::updateEnergySettings()
 {
 	updateEnergySettings(PhaseL1);
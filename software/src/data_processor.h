@@ -29,6 +29,13 @@ public:
 
 	void process(const ThreePhasesInverterData &data);
 
+	/*!
+	 * Updates the total power only, as read by a fast poll. The power is distributed over the
+	 * phases as in the last full update in which the inverter produced power, or evenly if there
+	 * has not been one yet.
+	 */
+	void processPower(double power);
+
 	void updateEnergySettings();
 
 private:
@@ -44,6 +51,8 @@ private:
 	Inverter *mInverter;
 	InverterSettings *mSettings;
 	double mPreviousTotalEnergy;
+	// Fraction of the total power per phase, from the last full update with power.
+	double mPhaseShares[3];
 };
 
 #endif // FRONIUSDATAPROCESSOR_H
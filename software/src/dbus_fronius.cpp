@@ -2,18 +2,29 @@
 #include "defines.h"
 #include "inverter_gateway.h"
 #include "inverter_mediator.h"
+#include "inventory_detector.h"
+#include "modbus_tcp_proxy.h"
+#include "modbus_tcp_server.h"
 #include "settings.h"
 #include "solar_api_detector.h"
 #include "sunspec_detector.h"
+#include "sunspec_updater.h"
 #include "ve_qitem_init_monitor.h"
 #include "logging.h"
 
+// Devices found in earlier runs (see `InventoryDetector`). /data is kept across reboots and
+// firmware updates.
+static const char *InventoryFileName = "/data/var/lib/dbus-fronius/inventory.conf";
+
 DBusFronius::DBusFronius(QObject *parent) :
 	VeService(VeQItems::getRoot()->itemGetOrCreate("pub/com.victronenergy.fronius"), parent),
 	mSettings(new Settings(VeQItems::getRoot()->itemGetOrCreate("sub/com.victronenergy.settings/Settings/Fronius", false), this)),
 	mAutoDetect(createItem("AutoDetect")),
 	mScanProgress(createItem("ScanProgress")),
-	mGateway(new InverterGateway(mSettings, this))
+	mScanWindow(createItem("ScanWindow")),
+	mScanRate(createItem("ScanRate")),
+	mGateway(new InverterGateway(mSettings, this)),
+	mModbusServer(0)
 {
 	connect(mGateway, SIGNAL(inverterFound(DeviceInfo)), this, SLOT(onInverterFound(DeviceInfo)));
 	connect(mGateway, SIGNAL(autoDetectChanged()), this, SLOT(onAutoDetectChanged()));
@@ -42,9 +53,17 @@ void DBusFronius::onSettingsInitialized()
 {
 	mGateway->addDetector(new SolarApiDetector(mSettings, this));
 	mGateway->addDetector(new SunspecDetector(126, this));
+	mGateway->addSerialDetector(new SunspecDetector(mSettings, this));
+	mGateway->setInventory(new InventoryDetector(InventoryFileName, this));
 	mGateway->initializeSettings();
 	onScanProgressChanged();
 	onAutoDetectChanged();
+	connect(mSettings, SIGNAL(modbusServerPortChanged()), this, SLOT(onModbusServerPortChanged()));
+	connect(mSettings, SIGNAL(modbusServerProxyChanged()),
+			this, SLOT(onModbusServerProxyChanged()));
+	connect(mSettings, SIGNAL(modbusProxyCacheTimeChanged()),
+			this, SLOT(onModbusProxyCacheTimeChanged()));
+	onModbusServerProxyChanged();
 	startDetection();
 }
 
@@ -74,6 +93,48 @@ void DBusFronius::onInverterFound(const DeviceInfo &deviceInfo)
 void DBusFronius::onScanProgressChanged()
 {
 	produceDouble(mScanProgress, mGateway->scanProgress(), 0, "%");
+	produceValue(mScanWindow, mGateway->scanWindow());
+	produceDouble(mScanRate, mGateway->scanRate(), 1, "/s");
+}
+
+void DBusFronius::onModbusServerPortChanged()
+{
+	int port = mSettings->modbusServerPort();
+	if (port <= 0 || port > 0xFFFF) {
+		if (mModbusServer->isListening())
+			qInfo() << "Modbus TCP server stopped";
+		mModbusServer->close();
+		return;
+	}
+	QHostAddress address = mSettings->modbusServerAddress();
+	if (address.isNull()) {
+		qWarning() << "Invalid Modbus TCP server address, listening on localhost only";
+		address = QHostAddress::LocalHost;
+	}
+	if (mModbusServer->listen(static_cast<quint16>(port), address))
+		qInfo() << "Modbus TCP server listening on" << address.toString() << "port" << port;
+	else
+		qWarning() << "Could not start Modbus TCP server on port" << port;
+}
+
+void DBusFronius::onModbusServerProxyChanged()
+{
+	delete mModbusServer;
+	if (mSettings->modbusServerProxy()) {
+		ModbusTcpProxy *proxy = new ModbusTcpProxy(SunspecUpdater::findProxyTarget, this);
+		proxy->setCacheTime(mSettings->modbusProxyCacheTime());
+		mModbusServer = proxy;
+	} else {
+		mModbusServer = new ModbusTcpServer(&SunspecUpdater::registerImage(), this);
+	}
+	onModbusServerPortChanged();
+}
+
+void DBusFronius::onModbusProxyCacheTimeChanged()
+{
+	ModbusTcpProxy *proxy = qobject_cast<ModbusTcpProxy *>(mModbusServer);
+	if (proxy != 0)
+		proxy->setCacheTime(mSettings->modbusProxyCacheTime());
 }
 
 void DBusFronius::onAutoDetectChanged()
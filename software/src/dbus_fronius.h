@@ -6,6 +6,7 @@
 
 class InverterGateway;
 class InverterMediator;
+class ModbusTcpServer;
 class Settings;
 class VeQItem;
 
@@ -36,12 +37,21 @@ private slots:
 
 	void onAutoDetectChanged();
 
+	void onModbusServerPortChanged();
+
+	void onModbusServerProxyChanged();
+
+	void onModbusProxyCacheTimeChanged();
+
 private:
 	QList<InverterMediator *> mMediators;
 	Settings *mSettings;
 	VeQItem *mAutoDetect;
 	VeQItem *mScanProgress;
+	VeQItem *mScanWindow;
+	VeQItem *mScanRate;
 	InverterGateway *mGateway;
+	ModbusTcpServer *mModbusServer;
 };
 
 #endif // DBUS_TEST2_H
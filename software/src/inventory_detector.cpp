@@ -0,0 +1,278 @@
+#include <QSettings>
+#include <qnumeric.h>
+#include "inventory_detector.h"
+#include "modbus_tcp_client.h"
+#include "modbus_reply.h"
+#include "sunspec_tools.h"
+#include "sunspec_updater.h"
+#include "logging.h"
+
+// The firmware version (Vr) and serial number (SN) of the common model, which always starts at
+// 40002. Both are read at once to validate a cached device.
+static const quint16 ValidationRegister = 40044;
+static const int ValidationCount = 24;
+// Timeout of the validation read. If the device does not reply in time, we fall back to the
+// complete detection, which allows for slower devices.
+static const int ValidationTimeout = 2000;
+
+static bool isSameValue(double a, double b)
+{
+	return a == b || (qIsNaN(a) && qIsNaN(b));
+}
+
+static bool isSameDevice(const DeviceInfo &a, const DeviceInfo &b)
+{
+	return a.hostName == b.hostName &&
+		a.uniqueId == b.uniqueId &&
+		a.productName == b.productName &&
+		a.dataManagerVersion == b.dataManagerVersion &&
+		a.firmwareVersion == b.firmwareVersion &&
+		a.serialNumber == b.serialNumber &&
+		a.networkId == b.networkId &&
+		a.port == b.port &&
+		a.deviceType == b.deviceType &&
+		a.phaseCount == b.phaseCount &&
+		a.productId == b.productId &&
+		a.retrievalMode == b.retrievalMode &&
+		a.inverterModelOffset == b.inverterModelOffset &&
+		a.immediateControlOffset == b.immediateControlOffset &&
+		isSameValue(a.powerLimitScale, b.powerLimitScale) &&
+		isSameValue(a.maxPower, b.maxPower) &&
+		isSameValue(a.storageCapacity, b.storageCapacity);
+}
+
+InventoryDetector::InventoryDetector(const QString &fileName, QObject *parent):
+	AbstractDetector(parent),
+	mFileName(fileName)
+{
+	load();
+}
+
+DetectorReply *InventoryDetector::start(const QString &hostName, int timeout)
+{
+	QList<DeviceInfo> devices;
+	foreach (const DeviceInfo &di, mDevices) {
+		if (di.hostName == hostName)
+			devices.append(di);
+	}
+	if (devices.isEmpty())
+		return 0;
+
+	// If the connection is shared with an updater, `connected` is emitted from the event loop,
+	// so there is always time to connect to the reply.
+	ModbusTcpClient *client = new ModbusTcpClient(this);
+	client->setTimeout(qMin(ValidationTimeout, timeout));
+	client->setPriority(ModbusClient::DetectionPriority);
+	connect(client, SIGNAL(connected()), this, SLOT(onConnected()));
+	connect(client, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+	Reply *reply = new Reply(this);
+	reply->host = hostName;
+	reply->client = client;
+	reply->devices = devices;
+	mClientToReply[client] = reply;
+	client->connectToServer(hostName);
+	return reply;
+}
+
+QStringList InventoryDetector::hostNames() const
+{
+	QStringList hosts;
+	foreach (const DeviceInfo &di, mDevices) {
+		if (!hosts.contains(di.hostName))
+			hosts.append(di.hostName);
+	}
+	return hosts;
+}
+
+void InventoryDetector::store(const DeviceInfo &deviceInfo)
+{
+	// Validation needs the serial number from the common model.
+	if (deviceInfo.retrievalMode == ProtocolFroniusSolarApi || deviceInfo.serialNumber.isEmpty())
+		return;
+	QString k = key(deviceInfo.hostName, deviceInfo.networkId);
+	QHash<QString, DeviceInfo>::const_iterator it = mDevices.constFind(k);
+	if (it != mDevices.constEnd() && isSameDevice(it.value(), deviceInfo))
+		return;
+	// The device may have moved to another address.
+	QHash<QString, DeviceInfo>::iterator old = mDevices.begin();
+	while (old != mDevices.end()) {
+		if (old.value().uniqueId == deviceInfo.uniqueId)
+			old = mDevices.erase(old);
+		else
+			++old;
+	}
+	mDevices[k] = deviceInfo;
+	save();
+}
+
+void InventoryDetector::onConnected()
+{
+	ModbusClient *client = static_cast<ModbusClient *>(sender());
+	Reply *r = mClientToReply.value(client);
+	if (r == 0 || r->pending > 0)
+		return;
+	foreach (const DeviceInfo &di, r->devices) {
+		// We are talking to this one already, so there is no need to check it.
+		if (SunspecUpdater::hasConnectionTo(di.hostName, di.networkId))
+			continue;
+		ModbusReply *reply = client->readHoldingRegisters(di.networkId, ValidationRegister,
+														  ValidationCount);
+		mModbusReplyToReply[reply] = r;
+		mModbusReplyToDevice[reply] = di;
+		connect(reply, SIGNAL(finished()), this, SLOT(onFinished()));
+		++r->pending;
+	}
+	if (r->pending == 0)
+		setDone(r);
+}
+
+void InventoryDetector::onDisconnected()
+{
+	ModbusClient *client = static_cast<ModbusClient *>(sender());
+	Reply *r = mClientToReply.value(client);
+	if (r == 0)
+		return;
+	// The host may be down. Keep the entries, the other detectors will have a go anyway.
+	r->confirmed = false;
+	setDone(r);
+}
+
+void InventoryDetector::onFinished()
+{
+	ModbusReply *reply = static_cast<ModbusReply *>(sender());
+	reply->deleteLater();
+	Reply *r = mModbusReplyToReply.take(reply);
+	DeviceInfo di = mModbusReplyToDevice.take(reply);
+	if (r == 0 || !mClientToReply.contains(r->client))
+		return;
+
+	if (reply->error() == ModbusReply::Timeout || reply->error() == ModbusReply::TcpError) {
+		r->confirmed = false;
+	} else if (!validate(di, reply)) {
+		qInfo() << "Cached device changed @" << di.hostName << ':' << di.networkId;
+		r->confirmed = false;
+		removeHost(r->host);
+	}
+	if (--r->pending == 0)
+		setDone(r);
+}
+
+bool InventoryDetector::validate(const DeviceInfo &deviceInfo, ModbusReply *reply)
+{
+	QVector<quint16> values = reply->registers();
+	if (reply->error() != ModbusReply::NoException || values.size() != ValidationCount)
+		return false;
+	return getString(values, 0, 8) == deviceInfo.firmwareVersion &&
+		getString(values, 8, 16) == deviceInfo.serialNumber;
+}
+
+void InventoryDetector::setDone(Reply *r)
+{
+	if (!mClientToReply.contains(r->client))
+		return;
+	if (r->confirmed) {
+		foreach (const DeviceInfo &di, r->devices) {
+			qDebug() << "Confirmed cached device @" << di.hostName << ':' << di.networkId;
+			r->setResult(di);
+		}
+	}
+	r->setFinished();
+	disconnect(r->client);
+	mClientToReply.remove(r->client);
+	r->client->deleteLater();
+}
+
+void InventoryDetector::removeHost(const QString &hostName)
+{
+	bool changed = false;
+	QHash<QString, DeviceInfo>::iterator it = mDevices.begin();
+	while (it != mDevices.end()) {
+		if (it.value().hostName == hostName) {
+			it = mDevices.erase(it);
+			changed = true;
+		} else {
+			++it;
+		}
+	}
+	if (changed)
+		save();
+}
+
+void InventoryDetector::load()
+{
+	QSettings settings(mFileName, QSettings::IniFormat);
+	int count = settings.beginReadArray("Devices");
+	for (int i=0; i<count; ++i) {
+		settings.setArrayIndex(i);
+		DeviceInfo di;
+		di.hostName = settings.value("HostName").toString();
+		di.uniqueId = settings.value("UniqueId").toString();
+		di.productName = settings.value("ProductName").toString();
+		di.dataManagerVersion = settings.value("DataManagerVersion").toString();
+		di.firmwareVersion = settings.value("FirmwareVersion").toString();
+		di.serialNumber = settings.value("SerialNumber").toString();
+		di.networkId = settings.value("NetworkId").toInt();
+		di.port = settings.value("Port").toInt();
+		di.deviceType = settings.value("DeviceType").toInt();
+		di.phaseCount = settings.value("PhaseCount").toInt();
+		di.productId = settings.value("ProductId").toInt();
+		di.retrievalMode = static_cast<ProtocolType>(settings.value("RetrievalMode").toInt());
+		di.inverterModelOffset = settings.value("InverterModelOffset").toUInt();
+		di.immediateControlOffset = settings.value("ImmediateControlOffset").toUInt();
+		di.powerLimitScale = settings.value("PowerLimitScale").toDouble();
+		di.maxPower = settings.value("MaxPower").toDouble();
+		di.storageCapacity = settings.value("StorageCapacity").toDouble();
+		if (di.hostName.isEmpty() || di.serialNumber.isEmpty() || di.phaseCount < 1 ||
+			di.retrievalMode == ProtocolFroniusSolarApi)
+			continue;
+		mDevices[key(di.hostName, di.networkId)] = di;
+	}
+	settings.endArray();
+	if (!mDevices.isEmpty())
+		qInfo() << "Loaded" << mDevices.size() << "devices from" << mFileName;
+}
+
+void InventoryDetector::save() const
+{
+	QSettings settings(mFileName, QSettings::IniFormat);
+	settings.remove("Devices");
+	settings.beginWriteArray("Devices", mDevices.size());
+	int i = 0;
+	foreach (const DeviceInfo &di, mDevices) {
+		settings.setArrayIndex(i++);
+		settings.setValue("HostName", di.hostName);
+		settings.setValue("UniqueId", di.uniqueId);
+		settings.setValue("ProductName", di.productName);
+		settings.setValue("DataManagerVersion", di.dataManagerVersion);
+		settings.setValue("FirmwareVersion", di.firmwareVersion);
+		settings.setValue("SerialNumber", di.serialNumber);
+		settings.setValue("NetworkId", di.networkId);
+		settings.setValue("Port", di.port);
+		settings.setValue("DeviceType", di.deviceType);
+		settings.setValue("PhaseCount", di.phaseCount);
+		settings.setValue("ProductId", di.productId);
+		settings.setValue("RetrievalMode", static_cast<int>(di.retrievalMode));
+		settings.setValue("InverterModelOffset", di.inverterModelOffset);
+		settings.setValue("ImmediateControlOffset", di.immediateControlOffset);
+		settings.setValue("PowerLimitScale", di.powerLimitScale);
+		settings.setValue("MaxPower", di.maxPower);
+		settings.setValue("StorageCapacity", di.storageCapacity);
+	}
+	settings.endArray();
+	settings.sync();
+	if (settings.status() != QSettings::NoError)
+		qWarning() << "Could not write device inventory to" << mFileName;
+}
+
+QString InventoryDetector::key(const QString &hostName, int networkId)
+{
+	return QString("%1:%2").arg(hostName).arg(networkId);
+}
+
+InventoryDetector::Reply::Reply(QObject *parent):
+	DetectorReply(parent),
+	client(0),
+	pending(0),
+	confirmed(true)
+{
+}
@@ -0,0 +1,102 @@
+#ifndef INVENTORY_DETECTOR_H
+#define INVENTORY_DETECTOR_H
+
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include "abstract_detector.h"
+#include "defines.h"
+
+class ModbusClient;
+class ModbusReply;
+
+/*!
+ * Detects SunSpec inverters using the results of earlier detections (the inventory), which are
+ * kept in a file on local storage.
+ *
+ * Each device found on a Modbus TCP host is stored by `InverterGateway`, keyed by host name and
+ * unit ID. A cached device is confirmed with a single read of the firmware version and serial
+ * number from the common model, which saves a complete walk of the SunSpec model map, and the
+ * Solar API requests before it. Units we are talking to already are confirmed without a read.
+ *
+ * The `deviceFound` signal is only emitted once all cached devices on a host have been confirmed.
+ * If one of them does not match, the entries of the host are dropped, and no device is reported,
+ * so the other detectors will redo the complete detection for the host.
+ */
+class InventoryDetector : public AbstractDetector
+{
+	Q_OBJECT
+public:
+	/// Loads the inventory from `fileName`.
+	InventoryDetector(const QString &fileName, QObject *parent = 0);
+
+	/// Returns 0 if there are no cached devices on `hostName`.
+	DetectorReply *start(const QString &hostName, int timeout) override;
+
+	/// Host names of all cached devices.
+	QStringList hostNames() const;
+
+	/// Adds or updates the entry of a device. Devices which cannot be validated are ignored.
+	void store(const DeviceInfo &deviceInfo);
+
+private slots:
+	void onConnected();
+
+	void onDisconnected();
+
+	void onFinished();
+
+private:
+	class Reply : public DetectorReply
+	{
+	public:
+		Reply(QObject *parent = 0);
+
+		QString hostName() const override
+		{
+			return host;
+		}
+
+		void setResult(const DeviceInfo &di)
+		{
+			emit deviceFound(di);
+		}
+
+		void setFinished()
+		{
+			emit finished();
+		}
+
+		QString host;
+		ModbusClient *client;
+		/// Cached devices on the host, which are reported if all of them have been confirmed.
+		QList<DeviceInfo> devices;
+		/// Number of validation reads we are still waiting for.
+		int pending;
+		/// False if one of the devices could not be confirmed.
+		bool confirmed;
+	};
+
+	/// Checks the result of a validation read. Returns false if the device does not match.
+	static bool validate(const DeviceInfo &deviceInfo, ModbusReply *reply);
+
+	/// Done with the host. Reports the devices if they are all confirmed.
+	void setDone(Reply *reply);
+
+	/// Removes all entries of a host from the inventory.
+	void removeHost(const QString &hostName);
+
+	void load();
+
+	void save() const;
+
+	static QString key(const QString &hostName, int networkId);
+
+	QString mFileName;
+	QHash<QString, DeviceInfo> mDevices;
+	QHash<ModbusClient *, Reply *> mClientToReply;
+	QHash<ModbusReply *, Reply *> mModbusReplyToReply;
+	QHash<ModbusReply *, DeviceInfo> mModbusReplyToDevice;
+};
+
+#endif // INVENTORY_DETECTOR_H
@@ -123,6 +123,11 @@ int Inverter::networkId() const
 	return mDeviceInfo.networkId;
 }
 
+int Inverter::deviceInstance() const
+{
+	return mDeviceInstance->getValue().toInt();
+}
+
 void Inverter::setHostName(const QString &h)
 {
 	if (mDeviceInfo.hostName== h)
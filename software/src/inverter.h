@@ -44,6 +44,8 @@ public:
 
 	int networkId() const;
 
+	int deviceInstance() const;
+
 	void setHostName(const QString &h);
 
 	int port() const;
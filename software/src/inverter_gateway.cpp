@@ -3,17 +3,31 @@
 #include "abstract_detector.h"
 #include "settings.h"
 #include "fronius_udp_detector.h"
+#include "inventory_detector.h"
+#include "modbus_tcp_client.h"
+#include "tcp_port_scanner.h"
 #include "compat.h"
 #include "logging.h"
 
-static const int MaxSimultaneousRequests = 64;
+// Timeout passed to the detectors.
+static const int DetectionTimeout = 15000;
+// A detector which takes this long (ms) has run into the timeout. There is some margin, because
+// coarse timers may fire a bit early.
+static const int TimedOutDetection = DetectionTimeout - 1000;
+// Time (ms) allowed for a connect during the port sweep. Hosts on the LAN accept or refuse a
+// connection within milliseconds.
+static const int SweepTimeout = 1000;
 
 InverterGateway::InverterGateway(Settings *settings, QObject *parent) :
 	QObject(parent),
 	mSettings(settings),
+	mScanCount(0),
 	mTimer(new QTimer(this)),
 	mUdpDetector(new FroniusUdpDetector(this)),
+	mPortScanner(new TcpPortScanner(this)),
+	mInventory(0),
 	mAutoDetect(false),
+	mScanPending(false),
 	mTriedFull(false),
 	mScanType(None)
 {
@@ -22,12 +36,23 @@ InverterGateway::InverterGateway(Settings *settings, QObject *parent) :
 	mTimer->setInterval(60000);
 	connect(mTimer, SIGNAL(timeout()), this, SLOT(onTimer()));
 	connect(mUdpDetector, SIGNAL(finished()), this, SLOT(continueScan()));
+	connect(mPortScanner, SIGNAL(finished()), this, SLOT(onSweepDone()));
 }
 
 void InverterGateway::addDetector(AbstractDetector *detector) {
 	mDetectors.append(detector);
 }
 
+void InverterGateway::addSerialDetector(AbstractDetector *detector)
+{
+	mSerialDetectors.append(detector);
+}
+
+void InverterGateway::setInventory(InventoryDetector *inventory)
+{
+	mInventory = inventory;
+}
+
 bool InverterGateway::autoDetect() const
 {
 	return mAutoDetect;
@@ -43,13 +68,29 @@ void InverterGateway::setAutoDetect(bool b)
 
 int InverterGateway::scanProgress() const
 {
+	// The address generator is not used during the sweep.
+	if (mAutoDetect && mPortScanner->isRunning())
+		return 0;
 	return mAutoDetect ? mAddressGenerator.progress(mActiveHosts.count()) : 100;
 }
 
+int InverterGateway::scanWindow() const
+{
+	return mScanWindow.size();
+}
+
+double InverterGateway::scanRate() const
+{
+	if (!mScanTime.isValid() || mScanTime.elapsed() <= 0)
+		return 0;
+	return 1000.0 * mScanCount / mScanTime.elapsed();
+}
+
 void InverterGateway::initializeSettings()
 {
 	connect(mSettings, SIGNAL(portNumberChanged()), this, SLOT(onPortNumberChanged()));
 	connect(mSettings, SIGNAL(ipAddressesChanged()), this, SLOT(onIpAddressesChanged()));
+	connect(mSettings, SIGNAL(rtuPortsChanged()), this, SLOT(onIpAddressesChanged()));
 }
 
 void InverterGateway::startDetection()
@@ -73,10 +114,17 @@ void InverterGateway::scan(enum ScanType scanType)
 	mDevicesFound.clear();
 	setAutoDetect(mScanType == Full);
 
+	// Confirm the devices we know about without waiting for the UDP scan. A full scan redoes the
+	// complete detection, so it also picks up devices added to a host.
+	if (scanType != Full)
+		scanInventory();
+
 	// Do a UDP scan if a full scan was requested, or on the periodic priority
 	// scan (but only if autoScan permitted).
 	mUdpDetector->reset();
+	mPortScanner->abort();
 	if ((scanType == Full) || ((scanType == TryPriority) && mSettings->autoScan())) {
+		mScanPending = true;
 		mUdpDetector->start();
 	} else {
 		continueScan();
@@ -85,6 +133,8 @@ void InverterGateway::scan(enum ScanType scanType)
 
 void InverterGateway::continueScan()
 {
+	mScanPending = false;
+
 	// Start with any addresses found by the fast UDP scan.
 	QList<QHostAddress> addresses = mUdpDetector->devicesFound();
 
@@ -95,6 +145,9 @@ void InverterGateway::continueScan()
 		}
 	}
 
+	// RTU buses are configured explicitly, so they are scanned every time.
+	scanSerialPorts();
+
 	// If priority scan and no known PV-inverters, then we're done
 	if (mScanType == Priority && addresses.isEmpty())
 		return;
@@ -103,17 +156,110 @@ void InverterGateway::continueScan()
 	mAddressGenerator.setPriorityAddresses(addresses);
 	mAddressGenerator.setPriorityOnly(mScanType != Full);
 	mAddressGenerator.reset();
+	mScanTime.start();
+	mScanCount = 0;
+
+	if (mScanType == Full) {
+		QList<QHostAddress> range;
+		while (mAddressGenerator.hasNext())
+			range.append(mAddressGenerator.next());
+		QList<quint16> ports;
+		ports << static_cast<quint16>(mSettings->portNumber())
+			  << static_cast<quint16>(ModbusTcpClient::DefaultTcpPort);
+		qDebug() << "Starting port sweep of" << range.size() << "addresses";
+		mScanPending = true;
+		mPortScanner->start(range, ports, SweepTimeout);
+		updateScanProgress();
+		return;
+	}
+
+	scanNextHosts();
+	// All hosts may have been confirmed from the inventory already.
+	if (mActiveHosts.size() == 0)
+		setScanDone();
+}
+
+void InverterGateway::onSweepDone()
+{
+	mScanPending = false;
+	QList<QHostAddress> hosts = mPortScanner->hostsFound();
+	qDebug() << "Port sweep done," << hosts.size() << "hosts found";
+	// The addresses without open ports have been scanned as well.
+	mScanCount += mPortScanner->addresses().size() - hosts.size();
+	mAddressGenerator.setPriorityAddresses(hosts);
+	mAddressGenerator.setPriorityOnly(true);
+	mAddressGenerator.reset();
+	updateScanProgress();
 
-	while (mActiveHosts.size() < MaxSimultaneousRequests && mAddressGenerator.hasNext()) {
-		QString host = mAddressGenerator.next().toString();
+	scanNextHosts();
+	if (mActiveHosts.size() == 0)
+		setScanDone();
+}
+
+void InverterGateway::scanNextHosts()
+{
+	while (mActiveHosts.size() < mScanWindow.size() && scanNextHost())
+		;
+}
+
+bool InverterGateway::scanNextHost()
+{
+	while (mAddressGenerator.hasNext()) {
+		QHostAddress address = mAddressGenerator.next();
+		QString host = address.toString();
+		// Hosts from the inventory may have been scanned (or found) already.
+		if (mDevicesFound.contains(address) || isScanning(host))
+			continue;
 		qDebug() << "Starting scan for" << host;
-		scanHost(host);
+		scanHost(host, detectors());
+		return true;
+	}
+	return false;
+}
+
+void InverterGateway::scanInventory()
+{
+	if (mInventory == 0)
+		return;
+	foreach (const QString &host, mInventory->hostNames()) {
+		if (isScanning(host))
+			continue;
+		qDebug() << "Starting scan for known host" << host;
+		scanHost(host, detectors());
+	}
+}
+
+bool InverterGateway::isScanning(const QString &hostName) const
+{
+	foreach (HostScan *host, mActiveHosts) {
+		if (host->hostName() == hostName)
+			return true;
+	}
+	return false;
+}
+
+QList<AbstractDetector *> InverterGateway::detectors() const
+{
+	if (mInventory == 0 || mScanType == Full)
+		return mDetectors;
+	return QList<AbstractDetector *>() << mInventory << mDetectors;
+}
+
+void InverterGateway::scanSerialPorts()
+{
+	if (mSerialDetectors.isEmpty())
+		return;
+	foreach (const QString &port, mSettings->rtuPorts()) {
+		if (isScanning(port))
+			continue;
+		qDebug() << "Starting scan for RTU bus" << port;
+		scanHost(port, mSerialDetectors);
 	}
 }
 
-void InverterGateway::scanHost(QString hostName)
+void InverterGateway::scanHost(QString hostName, const QList<AbstractDetector *> &detectors)
 {
-	HostScan *host = new HostScan(mDetectors, hostName);
+	HostScan *host = new HostScan(detectors, hostName);
 	mActiveHosts.append(host);
 	connect(host, SIGNAL(finished()), this, SLOT(onDetectionDone()));
 	connect(host, SIGNAL(deviceFound(const DeviceInfo &)),
@@ -124,7 +270,14 @@ void InverterGateway::scanHost(QString hostName)
 void InverterGateway::onInverterFound(const DeviceInfo &deviceInfo)
 {
 	QHostAddress addr(deviceInfo.hostName);
+	if (addr.isNull()) {
+		// Found on an RTU bus, which is always scanned.
+		emit inverterFound(deviceInfo);
+		return;
+	}
 	mDevicesFound.insert(addr);
+	if (mInventory != 0)
+		mInventory->store(deviceInfo);
 
 	// If the found address is already in the list of manually configured
 	// addresses, do not append it to the list of discovered addresses.
@@ -144,42 +297,56 @@ void InverterGateway::onDetectionDone()
 	qDebug() << "Done scanning" << host->hostName();
 	mActiveHosts.removeOne(host);
 	host->deleteLater();
+	// RTU buses are slow by nature, and do not compete for the network.
+	if (!QHostAddress(host->hostName()).isNull()) {
+		mScanWindow.addResult(host->timedOut());
+		++mScanCount;
+	}
 	updateScanProgress();
 
-	if (mScanType > None && mAddressGenerator.hasNext()) {
-		// Scan the next available host
-		scanHost(mAddressGenerator.next().toString());
-	} else if(mActiveHosts.size() == 0) {
-		// Scan is complete
-		enum ScanType scanType = mScanType;
-		mScanType = None;
-
-		// Did we get what we came for? For full and priority scans, this is it.
-		// For TryPriority scans, we switch to a full scan if we're a few
-		// piggies short, and if autoScan is enabled.
-		if ((scanType == TryPriority) && mSettings->autoScan()) {
-			QSet<QHostAddress> addresses = listToSet<QHostAddress>(mSettings->knownIpAddresses());
-
-			// Do a full scan if not all devices were found and we haven't
-			// tried a full scan yet. That means we'll fall back to a full
-			// scan only once. After that a manual scan will be required
-			// to find PV-inverters that changed IP address.
-			if ((addresses - mDevicesFound).size() && !mTriedFull) {
-				qInfo() << "Not all devices found, starting full IP scan";
-				mScanType = Full;
-				mTriedFull = true;
-				setAutoDetect(true);
-				continueScan();
-				return;
-			}
-		}
+	// Hosts from the inventory, and RTU buses, are scanned while the UDP scan or the port sweep
+	// is running. The IP scan will carry on once that is done.
+	if (mScanPending)
+		return;
+
+	// Scan the next available hosts
+	if (mScanType > None)
+		scanNextHosts();
 
-		setAutoDetect(false);
-		// Restart the timer to ensure at least 60 seconds space before
-		// we scan again.
-		mTimer->start();
-		qDebug() << "Auto IP scan completed. Detection finished";
+	if (mActiveHosts.size() == 0)
+		setScanDone();
+}
+
+void InverterGateway::setScanDone()
+{
+	enum ScanType scanType = mScanType;
+	mScanType = None;
+
+	// Did we get what we came for? For full and priority scans, this is it.
+	// For TryPriority scans, we switch to a full scan if we're a few
+	// piggies short, and if autoScan is enabled.
+	if ((scanType == TryPriority) && mSettings->autoScan()) {
+		QSet<QHostAddress> addresses = listToSet<QHostAddress>(mSettings->knownIpAddresses());
+
+		// Do a full scan if not all devices were found and we haven't
+		// tried a full scan yet. That means we'll fall back to a full
+		// scan only once. After that a manual scan will be required
+		// to find PV-inverters that changed IP address.
+		if ((addresses - mDevicesFound).size() && !mTriedFull) {
+			qInfo() << "Not all devices found, starting full IP scan";
+			mScanType = Full;
+			mTriedFull = true;
+			setAutoDetect(true);
+			continueScan();
+			return;
+		}
 	}
+
+	setAutoDetect(false);
+	// Restart the timer to ensure at least 60 seconds space before
+	// we scan again.
+	mTimer->start();
+	qDebug() << "Auto IP scan completed. Detection finished";
 }
 
 void InverterGateway::onPortNumberChanged()
@@ -212,15 +379,18 @@ void InverterGateway::updateScanProgress()
 HostScan::HostScan(QList<AbstractDetector *> detectors, QString hostname, QObject *parent) :
 	QObject(parent),
 	mDetectors(detectors),
-	mHostname(hostname)
+	mHostname(hostname),
+	mTimedOut(false),
+	mDeviceFound(false)
 {
 }
 
 void HostScan::scan()
 {
 	while (mDetectors.size()) {
-		DetectorReply *reply = mDetectors.takeFirst()->start(mHostname, 15000);
+		DetectorReply *reply = mDetectors.takeFirst()->start(mHostname, DetectionTimeout);
 		if (reply != 0) {
+			mDetectorTime.start();
 			connect(reply, SIGNAL(deviceFound(const DeviceInfo &)),
 				this, SLOT(onDeviceFound(const DeviceInfo &)));
 			connect(reply, SIGNAL(finished()), this, SLOT(continueScan()));
@@ -234,11 +404,14 @@ void HostScan::scan()
 void HostScan::continueScan() {
 	DetectorReply *reply = static_cast<DetectorReply *>(sender());
 	reply->deleteLater();
+	if (mDetectorTime.elapsed() >= TimedOutDetection)
+		mTimedOut = true;
 	scan(); // Try next detector
 }
 
 void HostScan::onDeviceFound(const DeviceInfo &deviceInfo)
 {
 	mDetectors.clear(); // Found an inverter on this host, we're done.
+	mDeviceFound = true;
 	emit deviceFound(deviceInfo);
 }
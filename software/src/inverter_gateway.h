@@ -1,15 +1,19 @@
 #ifndef INVERTER_GATEWAY_H
 #define INVERTER_GATEWAY_H
 
+#include <QElapsedTimer>
 #include <QHostAddress>
 #include <QPointer>
 #include <QStringList>
 #include "defines.h"
 #include "local_ip_address_generator.h"
+#include "scan_window.h"
 
 class AbstractDetector;
 class FroniusUdpDetector;
+class InventoryDetector;
 class QTimer;
+class TcpPortScanner;
 class Settings;
 class HostScan;
 /*!
@@ -21,6 +25,18 @@ class HostScan;
  * - Scanning all IP addresses within the local network (limited is the netmark is too wide). This
  *   scan is performed on startup and can be requested manually by calling `startDetection`.
  *
+ * Modbus RTU buses (the rtuPorts setting: serial ports and serial to ethernet gateways) are
+ * scanned with each scan, using the detectors added with `addSerialDetector`.
+ *
+ * A full scan starts with a quick sweep of the whole address range (see `TcpPortScanner`), and
+ * only the hosts with an open Solar API or Modbus TCP port are passed to the detectors.
+ *
+ * The number of hosts scanned at the same time is adapted to the network (see `ScanWindow`).
+ *
+ * If an inventory is set (see `setInventory`), the devices found are stored in it. All scans
+ * except full scans start with the hosts in the inventory, right away, and try to confirm the
+ * cached devices before running the other detectors.
+ *
  * The diagram below shows in which order devices are scanned.
  * @dotfile ipaddress_scanning.dot
  */
@@ -32,10 +48,22 @@ public:
 
 	void addDetector(AbstractDetector *detector);
 
+	/// Adds a detector for devices on the RTU buses from the rtuPorts setting.
+	void addSerialDetector(AbstractDetector *detector);
+
+	/// Sets the detector which keeps the devices found.
+	void setInventory(InventoryDetector *inventory);
+
 	bool autoDetect() const;
 
 	int scanProgress() const;
 
+	/// The number of hosts which may be scanned at the same time.
+	int scanWindow() const;
+
+	/// Number of IP addresses scanned per second in the current (or last) scan.
+	double scanRate() const;
+
 	void initializeSettings();
 
 	virtual void startDetection();
@@ -64,6 +92,8 @@ private slots:
 
 	void continueScan();
 
+	void onSweepDone();
+
 private:
 	enum ScanType
 	{
@@ -75,18 +105,51 @@ private:
 
 	void updateScanProgress();
 
-	void scanHost(QString hostName);
+	/// Called when all hosts have been scanned.
+	void setScanDone();
+
+	void scanHost(QString hostName, const QList<AbstractDetector *> &detectors);
+
+	/*!
+	 * Starts scanning the next address from the generator, skipping hosts which have been scanned
+	 * already. Returns false if there are no addresses left.
+	 */
+	bool scanNextHost();
+
+	/// Starts scanning the hosts from the inventory.
+	void scanInventory();
+
+	bool isScanning(const QString &hostName) const;
+
+	/// The detectors used for IP addresses in the current scan.
+	QList<AbstractDetector *> detectors() const;
+
+	/// Scans the RTU buses, except those which are still being scanned.
+	void scanSerialPorts();
 
 	void scan(enum ScanType scanType);
 
+	/// Starts scanning addresses from the generator, as long as the scan window allows.
+	void scanNextHosts();
+
 	QPointer<Settings> mSettings;
 	QSet<QHostAddress> mDevicesFound;
 	QList<HostScan *> mActiveHosts;
 	LocalIpAddressGenerator mAddressGenerator;
+	ScanWindow mScanWindow;
+	// Start of the IP scan, and the number of addresses scanned since.
+	QElapsedTimer mScanTime;
+	int mScanCount;
 	QList<AbstractDetector *> mDetectors;
+	QList<AbstractDetector *> mSerialDetectors;
 	QTimer *mTimer;
 	FroniusUdpDetector *mUdpDetector;
+	TcpPortScanner *mPortScanner;
+	InventoryDetector *mInventory;
 	bool mAutoDetect;
+	// True while waiting for the UDP detector or the port sweep, before the IP scan proper is
+	// started.
+	bool mScanPending;
 	bool mTriedFull;
 	enum ScanType mScanType;
 };
@@ -98,6 +161,8 @@ public:
 	HostScan(QList<AbstractDetector *> detectors, QString hostname, QObject *parent = 0);
 	QString hostName() { return mHostname; }
 	void scan();
+	/// True if no device was found, and a detector ran into the timeout.
+	bool timedOut() const { return mTimedOut && !mDeviceFound; }
 
 signals:
 	void deviceFound(const DeviceInfo &deviceInfo);
@@ -110,6 +175,9 @@ private slots:
 private:
 	QList<AbstractDetector *> mDetectors;
 	QString mHostname;
+	QElapsedTimer mDetectorTime;
+	bool mTimedOut;
+	bool mDeviceFound;
 };
 
 #endif // INVERTER_GATEWAY_H
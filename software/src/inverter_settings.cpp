@@ -1,3 +1,4 @@
+#include <qnumeric.h>
 #include <veutil/qt/ve_qitem.hpp>
 #include "defines.h"
 #include "inverter_settings.h"
@@ -14,7 +15,14 @@ InverterSettings::InverterSettings(VeQItem *root, QObject *parent) :
 	mL1Energy(connectItem("L1Energy", 0.0, 0.0, 1e6, SIGNAL(l1EnergyChanged()), true)),
 	mL2Energy(connectItem("L2Energy", 0.0, 0.0, 1e6, SIGNAL(l2EnergyChanged()), true)),
 	mL3Energy(connectItem("L3Energy", 0.0, 0.0, 1e6, SIGNAL(l3EnergyChanged()), true)),
-	mSerialNumber(connectItem("SerialNumber", "", 0, false))
+	mSerialNumber(connectItem("SerialNumber", "", 0, false)),
+	mCombinedPowerLimitWrite(connectItem("CombinedPowerLimitWrite", 0, 0)),
+	mModbusMinTimeout(connectItem("ModbusTimeoutMin", 250, SIGNAL(modbusTimeoutChanged()))),
+	mModbusMaxTimeout(connectItem("ModbusTimeoutMax", 5000, SIGNAL(modbusTimeoutChanged()))),
+	mPollIntervalMin(connectItem("PollIntervalMin", 1000, SIGNAL(pollIntervalChanged()))),
+	mPollIntervalMax(connectItem("PollIntervalMax", 30000, SIGNAL(pollIntervalChanged()))),
+	mPowerLimitDeadband(connectItem("PowerLimitDeadband", 0.0, 0.0, 1e6, 0)),
+	mFastPollInterval(connectItem("FastPollInterval", 250, 0))
 {
 }
 
@@ -122,3 +130,39 @@ void InverterSettings::setSerialNumber(const QString &s)
 {
 	mSerialNumber->setValue(s);
 }
+
+bool InverterSettings::combinedPowerLimitWrite() const
+{
+	return mCombinedPowerLimitWrite->getValue().toBool();
+}
+
+int InverterSettings::modbusMinTimeout() const
+{
+	return qMax(1, mModbusMinTimeout->getValue().toInt());
+}
+
+int InverterSettings::modbusMaxTimeout() const
+{
+	return qMax(modbusMinTimeout(), mModbusMaxTimeout->getValue().toInt());
+}
+
+int InverterSettings::pollIntervalMin() const
+{
+	return qMax(1, mPollIntervalMin->getValue().toInt());
+}
+
+int InverterSettings::pollIntervalMax() const
+{
+	return qMax(pollIntervalMin(), mPollIntervalMax->getValue().toInt());
+}
+
+double InverterSettings::powerLimitDeadband() const
+{
+	double deadband = getDouble(mPowerLimitDeadband);
+	return qIsFinite(deadband) ? qMax(0.0, deadband) : 0.0;
+}
+
+int InverterSettings::fastPollInterval() const
+{
+	return qMax(0, mFastPollInterval->getValue().toInt());
+}
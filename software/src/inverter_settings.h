@@ -42,6 +42,41 @@ public:
 
 	void setSerialNumber(const QString &s);
 
+	/*!
+	 * If true, a new power limit is written together with the read back of the inverter model,
+	 * using a single Read/Write Multiple Registers (function 23) request. Not all devices support
+	 * this, so it is disabled by default.
+	 */
+	bool combinedPowerLimitWrite() const;
+
+	/*!
+	 * Limits (in ms) of the Modbus request timeout. Within these limits, the timeout is derived
+	 * from the round trip times measured on the inverter.
+	 */
+	int modbusMinTimeout() const;
+
+	int modbusMaxTimeout() const;
+
+	/*!
+	 * Limits (in ms) of the interval between two polls of the inverter. The minimum is used when
+	 * the power changes fast or a power limit is active, the maximum when the inverter is sleeping.
+	 */
+	int pollIntervalMin() const;
+
+	int pollIntervalMax() const;
+
+	/*!
+	 * Power (W) by which a requested power limit must differ from the limit written last, before
+	 * it is written to the inverter. 0 means every change is written.
+	 */
+	double powerLimitDeadband() const;
+
+	/*!
+	 * Interval (in ms) at which the AC power is read while a power limit is active, in addition
+	 * to the regular polls. 0 disables the fast poll.
+	 */
+	int fastPollInterval() const;
+
 signals:
 	void phaseChanged();
 
@@ -57,6 +92,10 @@ signals:
 
 	void l3EnergyChanged();
 
+	void modbusTimeoutChanged();
+
+	void pollIntervalChanged();
+
 private:
 	VeQItem *mPhase;
 	VeQItem *mPhaseCount;
@@ -67,6 +106,13 @@ private:
 	VeQItem *mL2Energy;
 	VeQItem *mL3Energy;
 	VeQItem *mSerialNumber;
+	VeQItem *mCombinedPowerLimitWrite;
+	VeQItem *mModbusMinTimeout;
+	VeQItem *mModbusMaxTimeout;
+	VeQItem *mPollIntervalMin;
+	VeQItem *mPollIntervalMax;
+	VeQItem *mPowerLimitDeadband;
+	VeQItem *mFastPollInterval;
 };
 
 #endif // INVERTERSETTINGS_H
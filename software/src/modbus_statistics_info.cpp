@@ -0,0 +1,90 @@
+#include <qnumeric.h>
+#include <QMetaEnum>
+#include <QTimer>
+#include "modbus_statistics_info.h"
+
+// Interval (ms) between updates of the D-Bus items
+static const int UpdateInterval = 10000;
+
+ModbusStatisticsInfo::ModbusStatisticsInfo(VeQItem *root, const ModbusStatistics *statistics,
+										   QObject *parent):
+	VeService(root, parent),
+	mStatistics(statistics),
+	mReplyCount(createItem("Requests")),
+	mBytesSent(createItem("BytesSent")),
+	mBytesReceived(createItem("BytesReceived")),
+	mReconnects(createItem("Reconnects")),
+	mQueueDepth(createItem("QueueDepth")),
+	mMaxQueueDepth(createItem("MaxQueueDepth")),
+	mOtherErrorCount(createItem("Errors/Other")),
+	mQueueTime(createHistogramItems("QueueTime")),
+	mRoundTripTime(createHistogramItems("RoundTripTime")),
+	mTotalTime(createHistogramItems("TotalTime"))
+{
+	Q_ASSERT(statistics != 0);
+	const QMetaObject &mo = ModbusReply::staticMetaObject;
+	QMetaEnum metaEnum = mo.enumerator(mo.indexOfEnumerator("ExceptionCode"));
+	for (int i = 0; i < metaEnum.keyCount(); ++i) {
+		int code = metaEnum.value(i);
+		if (code == ModbusReply::NoException)
+			continue;
+		mErrorCodes.append(code);
+		mErrorCounts.append(createItem(QString("Errors/%1").arg(metaEnum.key(i))));
+	}
+	QTimer *timer = new QTimer(this);
+	timer->setInterval(UpdateInterval);
+	connect(timer, SIGNAL(timeout()), this, SLOT(update()));
+	timer->start();
+	update();
+}
+
+void ModbusStatisticsInfo::update()
+{
+	produceValue(mReplyCount, mStatistics->replyCount());
+	produceValue(mBytesSent, mStatistics->bytesSent());
+	produceValue(mBytesReceived, mStatistics->bytesReceived());
+	produceValue(mReconnects, mStatistics->reconnects());
+	produceValue(mQueueDepth, mStatistics->queueDepth());
+	produceValue(mMaxQueueDepth, mStatistics->maxQueueDepth());
+	quint32 other = mStatistics->replyCount() -
+		mStatistics->replyCount(ModbusReply::NoException);
+	for (int i = 0; i < mErrorCodes.size(); ++i) {
+		quint32 count = mStatistics->replyCount(
+			static_cast<ModbusReply::ExceptionCode>(mErrorCodes[i]));
+		produceValue(mErrorCounts[i], count);
+		other -= count;
+	}
+	produceValue(mOtherErrorCount, other);
+	produceHistogram(mQueueTime, mStatistics->queueTime());
+	produceHistogram(mRoundTripTime, mStatistics->roundTripTime());
+	produceHistogram(mTotalTime, mStatistics->totalTime());
+}
+
+ModbusStatisticsInfo::HistogramItems ModbusStatisticsInfo::createHistogramItems(
+	const QString &path)
+{
+	HistogramItems items;
+	items.count = createItem(path + "/Count");
+	items.average = createItem(path + "/Average");
+	items.max = createItem(path + "/Max");
+	// Bucket names are based on their upper bound, eg. Buckets/Below8ms. The last bucket has no
+	// upper bound.
+	const int last = ModbusStatistics::Histogram::BucketCount - 1;
+	for (int i = 0; i < last; ++i) {
+		items.buckets.append(createItem(QString("%1/Buckets/Below%2ms").
+			arg(path).arg(ModbusStatistics::Histogram::upperBound(i))));
+	}
+	items.buckets.append(createItem(QString("%1/Buckets/Above%2ms").
+		arg(path).arg(ModbusStatistics::Histogram::upperBound(last - 1))));
+	return items;
+}
+
+void ModbusStatisticsInfo::produceHistogram(const HistogramItems &items,
+											const ModbusStatistics::Histogram &histogram)
+{
+	produceValue(items.count, histogram.count());
+	produceDouble(items.average, histogram.average(), 1, "ms");
+	produceDouble(items.max, histogram.max() < 0 ? qQNaN() : histogram.max(), 0, "ms");
+	for (int i = 0; i < items.buckets.size(); ++i)
+		produceValue(items.buckets[i], histogram.bucket(i));
+}
@@ -0,0 +1,58 @@
+#ifndef MODBUS_STATISTICS_INFO_H
+#define MODBUS_STATISTICS_INFO_H
+
+#include <QVector>
+#include "modbus_statistics.h"
+#include "ve_service.h"
+
+/*!
+ * Publishes the statistics of a Modbus client on the D-Bus, in a subtree of the inverter service
+ * (usually /Debug/Modbus).
+ *
+ * The items are refreshed periodically rather than after every request, so publishing does not
+ * add to the cost of collecting the statistics.
+ */
+class ModbusStatisticsInfo : public VeService
+{
+	Q_OBJECT
+public:
+	/*!
+	 * @param statistics The statistics to publish. Must remain valid for the lifetime of this
+	 * object.
+	 */
+	ModbusStatisticsInfo(VeQItem *root, const ModbusStatistics *statistics, QObject *parent = 0);
+
+public slots:
+	void update();
+
+private:
+	struct HistogramItems
+	{
+		VeQItem *count;
+		VeQItem *average;
+		VeQItem *max;
+		QVector<VeQItem *> buckets;
+	};
+
+	HistogramItems createHistogramItems(const QString &path);
+
+	void produceHistogram(const HistogramItems &items,
+						  const ModbusStatistics::Histogram &histogram);
+
+	const ModbusStatistics *mStatistics;
+	VeQItem *mReplyCount;
+	VeQItem *mBytesSent;
+	VeQItem *mBytesReceived;
+	VeQItem *mReconnects;
+	VeQItem *mQueueDepth;
+	VeQItem *mMaxQueueDepth;
+	// One item per exception code (except NoException), and one for codes we do not know.
+	QVector<VeQItem *> mErrorCounts;
+	QVector<int> mErrorCodes;
+	VeQItem *mOtherErrorCount;
+	HistogramItems mQueueTime;
+	HistogramItems mRoundTripTime;
+	HistogramItems mTotalTime;
+};
+
+#endif // MODBUS_STATISTICS_INFO_H
@@ -1,7 +1,79 @@
 #include "modbus_client.h"
+#include "rtt_estimator.h"
 
 ModbusClient::ModbusClient(QObject *parent):
-	QObject(parent)
+	QObject(parent),
+	mPriority(PollPriority),
+	mTimeout(1000),
+	mMinTimeout(0),
+	mMaxTimeout(0)
 {
+}
+
+void ModbusClient::readHoldingRegisters(quint8 unitId, quint16 startReg, quint16 count,
+										const ModbusReply::Handler &handler)
+{
+	readHoldingRegisters(unitId, startReg, count)->setHandler(handler);
+}
 
+void ModbusClient::readInputRegisters(quint8 unitId, quint16 startReg, quint16 count,
+									  const ModbusReply::Handler &handler)
+{
+	readInputRegisters(unitId, startReg, count)->setHandler(handler);
+}
+
+void ModbusClient::writeSingleHoldingRegister(quint8 unitId, quint16 reg, quint16 value,
+											  const ModbusReply::Handler &handler)
+{
+	writeSingleHoldingRegister(unitId, reg, value)->setHandler(handler);
+}
+
+void ModbusClient::writeMultipleHoldingRegisters(quint8 unitId, quint16 startReg,
+												 const QVector<quint16> &values,
+												 const ModbusReply::Handler &handler)
+{
+	writeMultipleHoldingRegisters(unitId, startReg, values)->setHandler(handler);
+}
+
+void ModbusClient::readWriteMultipleRegisters(quint8 unitId, quint16 readStartReg,
+											  quint16 readCount, quint16 writeStartReg,
+											  const QVector<quint16> &values,
+											  const ModbusReply::Handler &handler)
+{
+	readWriteMultipleRegisters(unitId, readStartReg, readCount, writeStartReg, values)->
+		setHandler(handler);
+}
+
+void ModbusClient::send(const PreparedRequest &request, const ModbusReply::Handler &handler)
+{
+	send(request)->setHandler(handler);
+}
+
+int ModbusClient::timeout() const
+{
+	if (mMaxTimeout <= 0)
+		return mTimeout;
+	const RttEstimator *estimator = rttEstimator();
+	if (estimator == 0)
+		return mMaxTimeout;
+	return estimator->timeout(mMinTimeout, mMaxTimeout);
+}
+
+void ModbusClient::setTimeout(int t)
+{
+	mTimeout = t;
+	mMinTimeout = 0;
+	mMaxTimeout = 0;
+}
+
+void ModbusClient::setAdaptiveTimeout(int minTimeout, int maxTimeout)
+{
+	Q_ASSERT(minTimeout > 0 && minTimeout <= maxTimeout);
+	mMinTimeout = qMax(1, minTimeout);
+	mMaxTimeout = qMax(mMinTimeout, maxTimeout);
+}
+
+void ModbusClient::setPriority(Priority priority)
+{
+	mPriority = priority;
 }
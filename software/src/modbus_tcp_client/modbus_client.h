@@ -1,16 +1,73 @@
 #ifndef MODBUS_CLIENT_H
 #define MODBUS_CLIENT_H
 
+#include <QByteArray>
 #include <QObject>
+#include "modbus_reply.h"
+#include "modbus_statistics.h"
 
-class ModbusReply;
+class RttEstimator;
 
+/*!
+ * Base class for Modbus clients.
+ *
+ * Requests waiting to be sent are ordered by priority (see `setPriority`), so a power limit
+ * update does not have to wait for a queue of polls.
+ *
+ * The transport (Modbus TCP, or Modbus RTU on a serial bus) is implemented by the subclasses.
+ * Code talking to a device should only need this interface, so the same device support works
+ * over both transports.
+ */
 class ModbusClient : public QObject
 {
 	Q_OBJECT
 public:
+	/// Maximum number of registers in a single read request, from the Modbus specification.
+	static const int MaxReadCount = 125;
+
+	/// Order in which queued requests are sent, highest priority first.
+	enum Priority
+	{
+		ControlPriority,
+		PollPriority,
+		DetectionPriority,
+		BackgroundPriority
+	};
+
+	static const int PriorityCount = BackgroundPriority + 1;
+
+	/*!
+	 * A request which has been encoded in advance, for requests which are sent repeatedly (like
+	 * polling). Sending it only costs a reference count. A prepared request may only be sent by
+	 * the client that created it. Copying is cheap.
+	 */
+	class PreparedRequest
+	{
+	public:
+		PreparedRequest():
+			mRegisterCount(0)
+		{}
+
+		bool isValid() const
+		{
+			return !mFrame.isEmpty();
+		}
+
+	private:
+		friend class ModbusClient;
+
+		QByteArray mFrame;
+		int mRegisterCount;
+	};
+
 	explicit ModbusClient(QObject *parent = 0);
 
+	/*!
+	 * Returns true if requests can be sent. Requests created while this is false are queued
+	 * until the connection has been (re)established.
+	 */
+	virtual bool isConnected() const = 0;
+
 	virtual ModbusReply *readHoldingRegisters(quint8 unitId, quint16 startReg, quint16 count) = 0;
 
 	virtual ModbusReply *readInputRegisters(quint8 unitId, quint16 startReg, quint16 count) = 0;
@@ -20,9 +77,133 @@ public:
 	virtual ModbusReply *writeMultipleHoldingRegisters(quint8 unitId, quint16 startReg,
 													   const QVector<quint16> &values) = 0;
 
-	virtual int timeout() const = 0;
+	/*!
+	 * Writes `values` starting at `writeStartReg`, and then reads `readCount` registers starting
+	 * at `readStartReg`, in a single transaction (function code 23). Devices which do not support
+	 * this reply with `IllegalFunction`.
+	 */
+	virtual ModbusReply *readWriteMultipleRegisters(quint8 unitId, quint16 readStartReg,
+													quint16 readCount, quint16 writeStartReg,
+													const QVector<quint16> &values) = 0;
+
+	/*!
+	 * Callback versions of the functions above. The handler is called when the request has
+	 * finished, after which the reply is cleaned up by the client. Because no signal connection
+	 * is needed, and the client may reuse the reply object, this is the cheapest way to send
+	 * requests.
+	 */
+	void readHoldingRegisters(quint8 unitId, quint16 startReg, quint16 count,
+							  const ModbusReply::Handler &handler);
+
+	void readInputRegisters(quint8 unitId, quint16 startReg, quint16 count,
+							const ModbusReply::Handler &handler);
+
+	void writeSingleHoldingRegister(quint8 unitId, quint16 reg, quint16 value,
+									const ModbusReply::Handler &handler);
+
+	void writeMultipleHoldingRegisters(quint8 unitId, quint16 startReg,
+									   const QVector<quint16> &values,
+									   const ModbusReply::Handler &handler);
+
+	void readWriteMultipleRegisters(quint8 unitId, quint16 readStartReg, quint16 readCount,
+									quint16 writeStartReg, const QVector<quint16> &values,
+									const ModbusReply::Handler &handler);
+
+	/// Encodes a read request for later use with `send`.
+	virtual PreparedRequest prepareReadHoldingRegisters(quint8 unitId, quint16 startReg,
+														quint16 count) const = 0;
+
+	virtual ModbusReply *send(const PreparedRequest &request) = 0;
+
+	void send(const PreparedRequest &request, const ModbusReply::Handler &handler);
+
+	Priority priority() const
+	{
+		return mPriority;
+	}
+
+	/*!
+	 * Sets the priority of the reads sent by this client (`PollPriority` by default). Writes are
+	 * sent with `ControlPriority`, except for background clients: all their requests are
+	 * handled after those of other clients sharing the connection or bus.
+	 */
+	void setPriority(Priority priority);
+
+	/// Returns the priority of a request sent by this client.
+	Priority requestPriority(bool write) const
+	{
+		return write && mPriority != BackgroundPriority ? ControlPriority : mPriority;
+	}
+
+	/*!
+	 * Returns the timeout (in ms) for the next request. With an adaptive timeout, this depends on
+	 * the round trip times measured so far.
+	 */
+	int timeout() const;
+
+	/// Sets a fixed timeout, and disables the adaptive timeout.
+	void setTimeout(int t);
+
+	/*!
+	 * Derives the timeout of each request from the round trip times measured on the host or bus
+	 * (see `RttEstimator`), limited to [minTimeout, maxTimeout]. As long as nothing is known
+	 * about the host, `maxTimeout` is used.
+	 */
+	void setAdaptiveTimeout(int minTimeout, int maxTimeout);
+
+	bool hasAdaptiveTimeout() const
+	{
+		return mMaxTimeout > 0;
+	}
+
+	/// Returns the statistics of the requests sent by this client.
+	const ModbusStatistics &statistics() const
+	{
+		return mStatistics;
+	}
+
+signals:
+	void connected();
+
+	void disconnected();
+
+protected:
+	/*!
+	 * Returns the round trip time estimator used for the adaptive timeout, or 0 if it is not
+	 * available (yet).
+	 */
+	virtual const RttEstimator *rttEstimator() const
+	{
+		return 0;
+	}
+
+	static PreparedRequest createPreparedRequest(const QByteArray &frame, int registerCount)
+	{
+		PreparedRequest request;
+		request.mFrame = frame;
+		request.mRegisterCount = registerCount;
+		return request;
+	}
+
+	static const QByteArray &frame(const PreparedRequest &request)
+	{
+		return request.mFrame;
+	}
+
+	static int registerCount(const PreparedRequest &request)
+	{
+		return request.mRegisterCount;
+	}
+
+	// Updated by the connection or bus that handles the requests.
+	ModbusStatistics mStatistics;
 
-	virtual void setTimeout(int t) = 0;
+private:
+	Priority mPriority;
+	int mTimeout;
+	// Limits of the adaptive timeout. Zero if the timeout is fixed.
+	int mMinTimeout;
+	int mMaxTimeout;
 };
 
 #endif // MODBUS_CLIENT_H
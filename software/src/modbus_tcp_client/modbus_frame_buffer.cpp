@@ -0,0 +1,95 @@
+#include <QIODevice>
+#include <string.h>
+#include "modbus_frame_buffer.h"
+
+static int roundUpToPowerOfTwo(int n)
+{
+	int r = 16;
+	while (r < n)
+		r <<= 1;
+	return r;
+}
+
+ModbusFrameBuffer::ModbusFrameBuffer(int capacity):
+	mData(roundUpToPowerOfTwo(capacity), 0),
+	mMask(static_cast<quint32>(mData.size() - 1)),
+	mReadPos(0),
+	mWritePos(0)
+{
+}
+
+void ModbusFrameBuffer::append(const char *data, int size)
+{
+	reserve(this->size() + size);
+	char *buffer = mData.data();
+	quint32 start = mWritePos & mMask;
+	int first = qMin(size, mData.size() - static_cast<int>(start));
+	memcpy(buffer + start, data, static_cast<size_t>(first));
+	memcpy(buffer, data + first, static_cast<size_t>(size - first));
+	mWritePos += static_cast<quint32>(size);
+}
+
+int ModbusFrameBuffer::readFrom(QIODevice *device)
+{
+	int available = static_cast<int>(device->bytesAvailable());
+	if (available <= 0)
+		return 0;
+	reserve(size() + available);
+	char *buffer = mData.data();
+	int total = 0;
+	// At most 2 reads are needed: one up to the end of the buffer, and one at the start.
+	for (int i = 0; i < 2 && total < available; ++i) {
+		quint32 start = mWritePos & mMask;
+		int chunk = qMin(available - total, mData.size() - static_cast<int>(start));
+		qint64 n = device->read(buffer + start, chunk);
+		if (n <= 0)
+			break;
+		mWritePos += static_cast<quint32>(n);
+		total += static_cast<int>(n);
+	}
+	return total;
+}
+
+void ModbusFrameBuffer::peekRegisters(int offset, quint16 *registers, int count) const
+{
+	Q_ASSERT(offset + 2 * count <= size());
+	const quint8 *buffer = reinterpret_cast<const quint8 *>(mData.constData());
+	quint32 pos = mReadPos + static_cast<quint32>(offset);
+	// Fast path if the registers do not wrap around the end of the buffer.
+	if (static_cast<int>(pos & mMask) + 2 * count <= mData.size()) {
+		const quint8 *src = buffer + (pos & mMask);
+		for (int i = 0; i < count; ++i, src += 2)
+			registers[i] = static_cast<quint16>((src[0] << 8) | src[1]);
+		return;
+	}
+	for (int i = 0; i < count; ++i, pos += 2) {
+		registers[i] = static_cast<quint16>(
+			(buffer[pos & mMask] << 8) | buffer[(pos + 1) & mMask]);
+	}
+}
+
+void ModbusFrameBuffer::skip(int count)
+{
+	Q_ASSERT(count <= size());
+	mReadPos += static_cast<quint32>(qMin(count, size()));
+}
+
+void ModbusFrameBuffer::clear()
+{
+	mReadPos = mWritePos;
+}
+
+void ModbusFrameBuffer::reserve(int size)
+{
+	if (size <= mData.size())
+		return;
+	// Move the data to the start of the new (bigger) buffer.
+	QByteArray data(roundUpToPowerOfTwo(size), 0);
+	int count = this->size();
+	for (int i = 0; i < count; ++i)
+		data[i] = static_cast<char>(peek(i));
+	mData = data;
+	mMask = static_cast<quint32>(mData.size() - 1);
+	mReadPos = 0;
+	mWritePos = static_cast<quint32>(count);
+}
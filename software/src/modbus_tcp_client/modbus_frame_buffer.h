@@ -0,0 +1,78 @@
+#ifndef MODBUS_FRAME_BUFFER_H
+#define MODBUS_FRAME_BUFFER_H
+
+#include <QByteArray>
+
+class QIODevice;
+
+/*!
+ * Receive buffer for Modbus frames.
+ *
+ * This is a ring buffer with a read cursor. Incoming data is appended at the end, and frames are
+ * decoded in place from the read cursor. When a frame has been handled, the cursor is moved past
+ * it using `skip`. Unlike `QByteArray::remove`, this does not move the remaining data, so the
+ * cost of handling a burst of frames is linear in the number of bytes received.
+ *
+ * The buffer grows when it is too small to hold all data received, but never shrinks. Because the
+ * size of a Modbus frame is limited, it will quickly reach a stable size.
+ */
+class ModbusFrameBuffer
+{
+public:
+	explicit ModbusFrameBuffer(int capacity = 512);
+
+	/// Returns the number of bytes available for reading.
+	int size() const
+	{
+		return static_cast<int>(mWritePos - mReadPos);
+	}
+
+	int capacity() const
+	{
+		return mData.size();
+	}
+
+	void append(const char *data, int size);
+
+	/*!
+	 * Reads all data available on `device` directly into the buffer.
+	 * @return The number of bytes read.
+	 */
+	int readFrom(QIODevice *device);
+
+	/// Returns the byte at `offset` from the read cursor.
+	quint8 peek(int offset) const
+	{
+		Q_ASSERT(offset < size());
+		return static_cast<quint8>(mData.constData()[(mReadPos + offset) & mMask]);
+	}
+
+	/// Returns the big endian 16 bit value at `offset` from the read cursor.
+	quint16 peekUInt16(int offset) const
+	{
+		return static_cast<quint16>((peek(offset) << 8) | peek(offset + 1));
+	}
+
+	/*!
+	 * Decodes `count` big endian registers, starting at `offset` from the read cursor, into
+	 * `registers`. The destination must have room for `count` values.
+	 */
+	void peekRegisters(int offset, quint16 *registers, int count) const;
+
+	/// Moves the read cursor `count` bytes forward.
+	void skip(int count);
+
+	void clear();
+
+private:
+	void reserve(int size);
+
+	QByteArray mData;
+	quint32 mMask;
+	// Positions increase monotonically and wrap around at 2^32. Because the capacity is a power of
+	// two, the position within mData can be computed by masking.
+	quint32 mReadPos;
+	quint32 mWritePos;
+};
+
+#endif // MODBUS_FRAME_BUFFER_H
@@ -0,0 +1,49 @@
+#include "modbus_register_image.h"
+
+void ModbusRegisterImage::update(quint8 unitId, quint16 startReg, const QVector<quint16> &values)
+{
+	Unit &unit = mUnits[unitId];
+	int count = qMin(values.size(), 0x10000 - startReg);
+	const quint16 *src = values.constData();
+	for (int reg = startReg; count > 0;) {
+		Page &page = unit[static_cast<quint16>(reg >> PageBits)];
+		int offset = reg & PageMask;
+		int n = qMin(count, PageSize - offset);
+		for (int i = 0; i < n; ++i)
+			page.values[offset + i] = src[i];
+		page.valid |= validMask(offset, n);
+		reg += n;
+		src += n;
+		count -= n;
+	}
+}
+
+bool ModbusRegisterImage::read(quint8 unitId, quint16 startReg, int count, quint16 *values) const
+{
+	QHash<quint8, Unit>::const_iterator u = mUnits.find(unitId);
+	if (u == mUnits.end() || count <= 0 || startReg + count > 0x10000)
+		return false;
+	const Unit &unit = u.value();
+	for (int reg = startReg; count > 0;) {
+		Unit::const_iterator p = unit.find(static_cast<quint16>(reg >> PageBits));
+		if (p == unit.end())
+			return false;
+		const Page &page = p.value();
+		int offset = reg & PageMask;
+		int n = qMin(count, PageSize - offset);
+		quint64 mask = validMask(offset, n);
+		if ((page.valid & mask) != mask)
+			return false;
+		for (int i = 0; i < n; ++i)
+			values[i] = page.values[offset + i];
+		reg += n;
+		values += n;
+		count -= n;
+	}
+	return true;
+}
+
+void ModbusRegisterImage::removeUnit(quint8 unitId)
+{
+	mUnits.remove(unitId);
+}
@@ -0,0 +1,69 @@
+#ifndef MODBUS_REGISTER_IMAGE_H
+#define MODBUS_REGISTER_IMAGE_H
+
+#include <QHash>
+#include <QVector>
+
+/*!
+ * In-memory copy of the holding registers of a number of Modbus devices (units).
+ *
+ * Register values are stored as they are read from a device, and can be served to other Modbus
+ * clients later on (see `ModbusTcpServer`). Only registers which have been stored are available:
+ * the image keeps track of which registers are valid.
+ *
+ * Registers are stored in pages of 64, so the image of a device which is read in a few blocks
+ * (like the SunSpec models) takes little memory, and updating it does not allocate once the pages
+ * exist.
+ */
+class ModbusRegisterImage
+{
+public:
+	/// Stores `values` as the contents of the registers starting at `startReg`.
+	void update(quint8 unitId, quint16 startReg, const QVector<quint16> &values);
+
+	/*!
+	 * Copies `count` registers, starting at `startReg`, to `values`.
+	 * @return False if one or more of the registers are not available. The contents of `values`
+	 * are undefined in that case.
+	 */
+	bool read(quint8 unitId, quint16 startReg, int count, quint16 *values) const;
+
+	bool hasUnit(quint8 unitId) const
+	{
+		return mUnits.contains(unitId);
+	}
+
+	/// Removes all registers of the given unit, eg. when the device is no longer available.
+	void removeUnit(quint8 unitId);
+
+private:
+	static const int PageBits = 6;
+	static const int PageSize = 1 << PageBits;
+	static const int PageMask = PageSize - 1;
+
+	struct Page
+	{
+		Page():
+			valid(0)
+		{}
+
+		// Bit n is set if values[n] is valid.
+		quint64 valid;
+		quint16 values[PageSize];
+	};
+
+	/// Returns a mask with bits `offset` up to `offset + count - 1` set.
+	static quint64 validMask(int offset, int count)
+	{
+		if (count == PageSize)
+			return ~Q_UINT64_C(0);
+		return ((Q_UINT64_C(1) << count) - 1) << offset;
+	}
+
+	// Pages by page number (register address / PageSize).
+	typedef QHash<quint16, Page> Unit;
+
+	QHash<quint8, Unit> mUnits;
+};
+
+#endif // MODBUS_REGISTER_IMAGE_H
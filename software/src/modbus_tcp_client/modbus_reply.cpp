@@ -33,6 +33,12 @@ QString ModbusReply::toString() const
 	return s;
 }
 
+void ModbusReply::setHandler(const Handler &handler)
+{
+	Q_ASSERT(!isFinished());
+	mHandler = handler;
+}
+
 void ModbusReply::setResult(const QVector<quint16> &registers)
 {
 	if (isFinished())
@@ -42,7 +48,7 @@ void ModbusReply::setResult(const QVector<quint16> &registers)
 	mError = NoException;
 	onFinished();
 	Q_ASSERT(isFinished());
-	emit finished();
+	notify();
 }
 
 void ModbusReply::setResult(ModbusReply::ExceptionCode error)
@@ -52,5 +58,31 @@ void ModbusReply::setResult(ModbusReply::ExceptionCode error)
 	mError = error;
 	onFinished();
 	Q_ASSERT(isFinished());
+	notify();
+}
+
+void ModbusReply::onHandled()
+{
+	deleteLater();
+}
+
+void ModbusReply::reset()
+{
+	// Keep the capacity of the register vector
+	mRegisters.resize(0);
+	mHandler = Handler();
+	mError = NoException;
+	disconnect();
+}
+
+void ModbusReply::notify()
+{
 	emit finished();
+	if (!mHandler)
+		return;
+	// The handler may not be called again when the reply is reused.
+	Handler handler = mHandler;
+	mHandler = Handler();
+	handler(this);
+	onHandled();
 }
@@ -5,6 +5,7 @@
 #include <QVector>
 #include <QDebug>
 #include <QTextStream>
+#include <functional>
 
 class ModbusReply : public QObject
 {
@@ -31,6 +32,12 @@ public:
 
 	Q_ENUMS(ExceptionCode)
 
+	/*!
+	 * Function called when the reply has finished. The reply is owned by the client: it must not
+	 * be deleted or used after the handler has returned.
+	 */
+	typedef std::function<void (ModbusReply *)> Handler;
+
 	QVector<quint16> registers() const
 	{
 		return mRegisters;
@@ -45,6 +52,13 @@ public:
 
 	virtual QString toString() const;
 
+	/*!
+	 * Sets a function which will be called after the `finished` signal has been emitted. This is
+	 * a cheaper alternative to connecting the signal. When the handler returns, the reply is
+	 * cleaned up (see `onHandled`).
+	 */
+	void setHandler(const Handler &handler);
+
 signals:
 	void finished();
 
@@ -53,12 +67,33 @@ protected:
 
 	virtual void onFinished() = 0;
 
+	/*!
+	 * Called after the handler set with `setHandler` has returned. The default implementation
+	 * deletes the reply, clients may override this to reuse it.
+	 */
+	virtual void onHandled();
+
+	/// Clears the result and the handler, so the reply can be used for a new request.
+	void reset();
+
 	void setResult(const QVector<quint16> &registers);
 
 	void setResult(ExceptionCode error);
 
+	/*!
+	 * Gives direct access to the register values, so a client can decode the reply in place
+	 * (and reserve space in advance). Call `setResult(NoException)` when done.
+	 */
+	QVector<quint16> &registerBuffer()
+	{
+		return mRegisters;
+	}
+
 private:
+	void notify();
+
 	QVector<quint16> mRegisters;
+	Handler mHandler;
 	ExceptionCode mError;
 };
 
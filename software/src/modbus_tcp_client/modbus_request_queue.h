@@ -0,0 +1,142 @@
+#ifndef MODBUS_REQUEST_QUEUE_H
+#define MODBUS_REQUEST_QUEUE_H
+
+#include <QList>
+#include "modbus_client.h"
+
+/*!
+ * Queue of requests waiting to be sent, ordered by priority (see `ModbusClient::Priority`), and
+ * in order of arrival within a priority.
+ *
+ * To prevent starvation, a priority level is served anyway once its oldest request has been
+ * overtaken `MaxOvertaken` times by requests with a higher priority. So a steady stream of
+ * control writes slows down polling, but does not stop it, while a control write never waits
+ * for more than one request of each lower level.
+ *
+ * The queue keeps track of its largest size (high-water mark), which is a useful gauge of the
+ * load on the device.
+ */
+template<typename T>
+class ModbusRequestQueue
+{
+public:
+	static const int MaxOvertaken = 8;
+
+	ModbusRequestQueue():
+		mSize(0),
+		mMaxSize(0)
+	{
+		for (int p = 0; p < ModbusClient::PriorityCount; ++p)
+			mOvertaken[p] = 0;
+	}
+
+	bool isEmpty() const
+	{
+		return mSize == 0;
+	}
+
+	int size() const
+	{
+		return mSize;
+	}
+
+	int size(ModbusClient::Priority priority) const
+	{
+		return mQueues[priority].size();
+	}
+
+	/// Returns the largest size of the queue since creation or the last call to `resetMaxSize`.
+	int maxSize() const
+	{
+		return mMaxSize;
+	}
+
+	void resetMaxSize()
+	{
+		mMaxSize = mSize;
+	}
+
+	void enqueue(const T &item, ModbusClient::Priority priority)
+	{
+		mQueues[priority].append(item);
+		++mSize;
+		mMaxSize = qMax(mMaxSize, mSize);
+	}
+
+	/// Removes and returns the request which should be sent next. The queue must not be empty.
+	T dequeue()
+	{
+		return mQueues[takeLevel()].takeFirst();
+	}
+
+	/*!
+	 * Like `dequeue`, but within the priority level that is up next, the oldest request for which
+	 * `preferred` returns true is taken. If there is no such request, the oldest one is taken.
+	 */
+	template<typename Predicate>
+	T dequeue(Predicate preferred)
+	{
+		QList<T> &queue = mQueues[takeLevel()];
+		for (int i = 0; i < queue.size(); ++i) {
+			if (preferred(queue.at(i)))
+				return queue.takeAt(i);
+		}
+		return queue.takeFirst();
+	}
+
+	/// Removes `item` (eg. when the request is cancelled). Returns false if it was not queued.
+	bool removeOne(const T &item)
+	{
+		for (int p = 0; p < ModbusClient::PriorityCount; ++p) {
+			if (mQueues[p].removeOne(item)) {
+				--mSize;
+				if (mQueues[p].isEmpty())
+					mOvertaken[p] = 0;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void clear()
+	{
+		for (int p = 0; p < ModbusClient::PriorityCount; ++p) {
+			mQueues[p].clear();
+			mOvertaken[p] = 0;
+		}
+		mSize = 0;
+	}
+
+private:
+	/// Selects the priority level of the next request, and removes one request from the count.
+	int takeLevel()
+	{
+		Q_ASSERT(mSize > 0);
+		int next = -1;
+		for (int p = 0; p < ModbusClient::PriorityCount; ++p) {
+			if (mQueues[p].isEmpty())
+				continue;
+			if (next == -1) {
+				next = p;
+			} else if (mOvertaken[p] >= MaxOvertaken) {
+				next = p;
+				break;
+			}
+		}
+		for (int p = next + 1; p < ModbusClient::PriorityCount; ++p) {
+			if (!mQueues[p].isEmpty())
+				++mOvertaken[p];
+		}
+		mOvertaken[next] = 0;
+		--mSize;
+		return next;
+	}
+
+	QList<T> mQueues[ModbusClient::PriorityCount];
+	// Number of requests sent before the oldest request of each level, since it was queued.
+	int mOvertaken[ModbusClient::PriorityCount];
+	int mSize;
+	int mMaxSize;
+};
+
+#endif // MODBUS_REQUEST_QUEUE_H
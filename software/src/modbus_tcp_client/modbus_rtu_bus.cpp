@@ -0,0 +1,322 @@
+#include <QTimer>
+#include <string.h>
+#include <unistd.h>
+#include "crc16.h"
+#include "modbus_rtu_bus.h"
+#include "modbus_rtu_client.h"
+#include "modbus_tcp_frame.h"
+
+QHash<QString, ModbusRtuBus *> ModbusRtuBus::mBuses;
+
+ModbusRtuBus::ModbusRtuBus(const QString &name):
+	QObject(),
+	mTimer(new QTimer(this)),
+	mActiveReply(0),
+	mRttEstimator(RttEstimator::forHost(name)),
+	mFrameGap(0),
+	mOpen(false),
+	mSendScheduled(false),
+	mSkipCount(0),
+	mName(name)
+{
+	memset(mTimeouts, 0, sizeof(mTimeouts));
+	mClock.start();
+	mLastActivity.start();
+	mTimer->setSingleShot(true);
+	connect(mTimer, SIGNAL(timeout()), this, SLOT(onTimeout()));
+	Q_ASSERT(!mBuses.contains(name));
+	mBuses.insert(name, this);
+}
+
+ModbusRtuBus *ModbusRtuBus::find(const QString &name)
+{
+	return mBuses.value(name);
+}
+
+void ModbusRtuBus::addClient(ModbusRtuClient *client)
+{
+	Q_ASSERT(!mClients.contains(client));
+	mClients.append(client);
+}
+
+void ModbusRtuBus::release(ModbusRtuClient *client)
+{
+	mClients.removeOne(client);
+	foreach (Reply *reply, mPendingReplies) {
+		if (reply->client == client)
+			delete reply;
+	}
+	if (!mClients.isEmpty())
+		return;
+	mBuses.remove(mName);
+	// We may be called from one of our own signals.
+	deleteLater();
+}
+
+void ModbusRtuBus::setOpen(bool open)
+{
+	if (open) {
+		if (mOpen)
+			return;
+		mOpen = true;
+		mLastActivity.restart();
+		// Requests created while the bus was being opened have been waiting in the queue.
+		scheduleSendNext();
+		emit opened();
+	} else {
+		mOpen = false;
+		failPendingReplies(ModbusReply::TcpError);
+		emit closed();
+	}
+}
+
+ModbusReply *ModbusRtuBus::send(ModbusRtuClient *client, int timeout, const QByteArray &frame,
+								int registerCount)
+{
+	Q_ASSERT(frame.size() >= 4);
+	Reply *reply = new Reply(this, client, frame);
+	reply->timeout = timeout;
+	reply->queuedAt = mClock.elapsed();
+	// Allocate storage for the result now, so the reply can be decoded in place.
+	reply->registerBuffer().reserve(registerCount);
+	mPendingReplies.append(reply);
+	bool write = false;
+	switch (reply->function()) {
+	case ModbusTcpFrame::WriteSingleRegister:
+	case ModbusTcpFrame::WriteMultipleRegisters:
+	case ModbusTcpFrame::ReadWriteMultipleRegisters:
+		write = true;
+		break;
+	}
+	mQueue.enqueue(reply, client->requestPriority(write));
+	client->mStatistics.addQueued();
+	if (mOpen)
+		sendNext();
+	else if (!isOpening())
+		scheduleSendNext(); // Fails the request, after the caller has set up the reply.
+	return reply;
+}
+
+void ModbusRtuBus::onTimeout()
+{
+	Reply *reply = takeActiveReply();
+	if (reply != 0) {
+		quint8 &timeouts = mTimeouts[reply->unitId()];
+		if (timeouts < UnresponsiveTimeouts)
+			mRttEstimator->backOff();
+		if (timeouts < 0xFF)
+			++timeouts;
+		addReply(reply, ModbusReply::Timeout);
+		reply->setResult(ModbusReply::Timeout);
+	}
+	sendNext();
+}
+
+bool ModbusRtuBus::processFrame(const ModbusRtuFrameParser::Frame &frame)
+{
+	if (frame.unitId != mActiveReply->unitId())
+		return false;
+	if ((frame.function & 0x7F) != mActiveReply->function())
+		return false;
+	Reply *reply = takeActiveReply();
+	mTimeouts[reply->unitId()] = 0;
+	mRttEstimator->addSample(mClock.elapsed() - reply->sentAt);
+	reply->client->mStatistics.addBytesReceived(frame.dataSize + 4);
+	ModbusReply::ExceptionCode error = ModbusReply::NoException;
+	if ((frame.function & 0x80) != 0) {
+		error = static_cast<ModbusReply::ExceptionCode>(frame.data[0]);
+	} else {
+		switch (frame.function) {
+		case ModbusTcpFrame::ReadHoldingRegisters:
+		case ModbusTcpFrame::ReadInputRegisters:
+		case ModbusTcpFrame::ReadWriteMultipleRegisters:
+		{
+			// The frame length follows from the byte count (see ModbusRtuFrameParser).
+			int count = (frame.dataSize - 1) / 2;
+			QVector<quint16> &registers = reply->registerBuffer();
+			registers.resize(count);
+			const quint8 *p = frame.data + 1;
+			for (int i = 0; i < count; ++i, p += 2)
+				registers[i] = toUInt16(p[0], p[1]);
+			break;
+		}
+		case ModbusTcpFrame::WriteSingleRegister:
+		{
+			QVector<quint16> &registers = reply->registerBuffer();
+			registers.resize(1);
+			registers[0] = toUInt16(frame.data[2], frame.data[3]);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	addReply(reply, error);
+	reply->setResult(error);
+	return true;
+}
+
+ModbusRtuBus::Reply *ModbusRtuBus::takeActiveReply()
+{
+	Reply *reply = mActiveReply;
+	mActiveReply = 0;
+	mTimer->stop();
+	if (reply != 0)
+		detach(reply);
+	return reply;
+}
+
+void ModbusRtuBus::onReadyRead()
+{
+	// A partial frame followed by silence will never be completed, and must not be mistaken for
+	// the start of the next frame.
+	if (mFrameGap > 0 && mParser.size() > 0 &&
+		mLastActivity.nsecsElapsed() / 1000 > mFrameGap + FrameGapMargin)
+		mParser.clear();
+	bool first = true;
+	for (;;) {
+		int room = 0;
+		char *buf = mParser.writeBuffer(&room);
+		qint64 len = readData(buf, room);
+		if (len < 0)
+			return;
+		if (first && len == 0) {
+			emit serialEvent("Ready for reading but read 0 bytes. Device removed?");
+			return;
+		}
+		mParser.commit(static_cast<int>(len));
+		if (len < room)
+			break;
+		first = false;
+	}
+	mLastActivity.restart();
+	if (mActiveReply == 0) {
+		// We received data when we were not expecting any (eg. the response to a request that
+		// has been cancelled). Ignore the data.
+		mParser.clear();
+		return;
+	}
+	ModbusRtuFrameParser::Frame frame;
+	while (mActiveReply != 0 && mParser.nextFrame(&frame)) {
+		if (processFrame(frame))
+			sendNext();
+	}
+}
+
+void ModbusRtuBus::sendNext()
+{
+	mSendScheduled = false;
+	if (!mOpen) {
+		// Nothing will be sent until the bus has been opened.
+		if (!isOpening())
+			failPendingReplies(ModbusReply::TcpError);
+		return;
+	}
+	if (mTimer->isActive() || mQueue.isEmpty())
+		return;
+	// Serve responsive devices first, but do not let the others wait forever.
+	bool skipped = false;
+	Reply *reply = mQueue.dequeue([this, &skipped](Reply *r) {
+		if (mSkipCount >= ModbusRequestQueue<Reply *>::MaxOvertaken || isResponsive(r->unitId()))
+			return true;
+		skipped = true;
+		return false;
+	});
+	if (!isResponsive(reply->unitId()))
+		mSkipCount = 0;
+	else if (skipped)
+		++mSkipCount;
+	reply->client->mStatistics.removeQueued();
+	// Keep the bus silent for the inter-frame delay. The time since the last response (which
+	// usually includes handling it) counts as well, so often there is no need to wait at all.
+	qint64 silence = mLastActivity.nsecsElapsed() / 1000;
+	if (silence < mFrameGap)
+		usleep(static_cast<useconds_t>(mFrameGap - silence));
+	mParser.clear();
+	writeData(reply->frame.constData(), reply->frame.size());
+	reply->client->mStatistics.addBytesSent(reply->frame.size());
+	mLastActivity.restart();
+	reply->sent = true;
+	reply->sentAt = mClock.elapsed();
+	mActiveReply = reply;
+	mTimer->start(reply->timeout);
+}
+
+void ModbusRtuBus::scheduleSendNext()
+{
+	if (mSendScheduled)
+		return;
+	mSendScheduled = true;
+	QTimer::singleShot(0, this, SLOT(sendNext()));
+}
+
+void ModbusRtuBus::failPendingReplies(ModbusReply::ExceptionCode error)
+{
+	Reply *active = takeActiveReply();
+	if (active != 0) {
+		addReply(active, error);
+		active->setResult(error);
+	}
+	while (!mQueue.isEmpty()) {
+		Reply *reply = mQueue.dequeue();
+		detach(reply);
+		reply->client->mStatistics.removeQueued();
+		addReply(reply, error);
+		reply->setResult(error);
+	}
+}
+
+void ModbusRtuBus::addReply(Reply *reply, ModbusReply::ExceptionCode error)
+{
+	qint64 now = mClock.elapsed();
+	qint64 queueTime = (reply->sent ? reply->sentAt : now) - reply->queuedAt;
+	reply->client->mStatistics.addReply(queueTime, reply->sent ? now - reply->sentAt : -1, error);
+}
+
+void ModbusRtuBus::detach(Reply *reply)
+{
+	reply->bus = 0;
+	mPendingReplies.removeOne(reply);
+}
+
+void ModbusRtuBus::removeReply(Reply *reply)
+{
+	detach(reply);
+	if (reply == mActiveReply) {
+		// Leave the timer running: the bus remains busy until the device has had the time to
+		// respond.
+		mActiveReply = 0;
+	} else if (mQueue.removeOne(reply)) {
+		reply->client->mStatistics.removeQueued();
+	}
+}
+
+ModbusRtuBus::Reply::Reply(ModbusRtuBus *bus, ModbusRtuClient *client, const QByteArray &frame):
+	ModbusReply(bus),
+	bus(bus),
+	client(client),
+	frame(frame),
+	timeout(0),
+	sent(false),
+	queuedAt(0),
+	sentAt(0),
+	mFinished(false)
+{
+}
+
+ModbusRtuBus::Reply::~Reply()
+{
+	if (bus != 0)
+		bus->removeReply(this); // Deleted by the user before the request was finished.
+}
+
+bool ModbusRtuBus::Reply::isFinished() const
+{
+	return mFinished;
+}
+
+void ModbusRtuBus::Reply::onFinished()
+{
+	Q_ASSERT(!mFinished);
+	mFinished = true;
+}
@@ -0,0 +1,256 @@
+#ifndef MODBUS_RTU_BUS_H
+#define MODBUS_RTU_BUS_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include "modbus_reply.h"
+#include "modbus_request_queue.h"
+#include "modbus_rtu_frame_parser.h"
+#include "rtt_estimator.h"
+
+class ModbusRtuClient;
+class QTimer;
+
+/*!
+ * A Modbus RTU bus, shared by all `ModbusRtuClient` objects using it.
+ *
+ * An RS485 bus is usually multi-drop: several devices, each with its own slave address, are
+ * connected to a single serial port. The port can be opened only once, so all clients for the
+ * port use a single bus object, which is created when the first client is created, and destroyed
+ * when the last one is gone. The same holds for a serial to ethernet gateway, which passes RTU
+ * frames between a TCP connection and its RS485 port. This class handles the requests, the
+ * transport (serial port or TCP connection) is implemented in subclasses.
+ *
+ * The bus is half-duplex: a request may only be sent when the response to the previous one has
+ * been received, or has timed out. Requests are queued, ordered by priority (see
+ * `ModbusRequestQueue`), and sent back to back, so the bus is never idle while there is work to
+ * do. The inter-frame delay (t3.5) is only waited for if the time spent handling the previous
+ * response was shorter.
+ *
+ * An absent or crashed device costs a full timeout for each request, during which the bus cannot
+ * be used for anything else. Therefore, a device which has not responded to the last
+ * `UnresponsiveTimeouts` requests is served after the responsive devices with the same priority.
+ * As soon as it responds again, it is treated like the others.
+ *
+ * The bus records the latency, result and size of each request in the statistics of the client
+ * that sent it. Round trip times are fed to the `RttEstimator` of the bus, which clients may use
+ * to set their timeouts. Timeouts of unresponsive devices are not, as they say nothing about the
+ * bus.
+ */
+class ModbusRtuBus : public QObject
+{
+	Q_OBJECT
+public:
+	/// Number of consecutive timeouts after which a device is considered unresponsive.
+	static const int UnresponsiveTimeouts = 2;
+
+	/*!
+	 * Unregisters `client`. Its pending requests are cancelled (the replies are deleted). The
+	 * bus is closed when the last client has been released.
+	 */
+	void release(ModbusRtuClient *client);
+
+	/// The serial port, or the address of the gateway.
+	QString name() const
+	{
+		return mName;
+	}
+
+	/// Returns true if requests can be sent.
+	bool isOpen() const
+	{
+		return mOpen;
+	}
+
+	/*!
+	 * Returns true while the bus is being opened (eg. a TCP connection is being set up). Requests
+	 * are queued until it is open. Requests sent while the bus is neither open nor opening fail
+	 * immediately.
+	 */
+	virtual bool isOpening() const
+	{
+		return false;
+	}
+
+	const RttEstimator *rttEstimator() const
+	{
+		return mRttEstimator;
+	}
+
+	/// Returns the number of requests waiting for the bus.
+	int queueDepth() const
+	{
+		return mQueue.size();
+	}
+
+	/// Returns the largest number of requests that have been waiting for the bus at once.
+	int maxQueueDepth() const
+	{
+		return mQueue.maxSize();
+	}
+
+	/*!
+	 * Queues a request frame, including slave address and CRC. The frame is not modified, so it
+	 * may be sent repeatedly.
+	 * @param timeout Time (in ms) allowed for the response, once the request has been sent.
+	 * @param registerCount Number of registers expected in the response.
+	 */
+	ModbusReply *send(ModbusRtuClient *client, int timeout, const QByteArray &frame,
+					  int registerCount);
+
+signals:
+	void opened();
+
+	void closed();
+
+	void serialEvent(const char *message);
+
+protected:
+	ModbusRtuBus(const QString &name);
+
+	/// Returns the bus with the given name, or 0 if it does not exist.
+	static ModbusRtuBus *find(const QString &name);
+
+	/// Registers `client` as one of the users of the bus.
+	void addClient(ModbusRtuClient *client);
+
+	/*!
+	 * Reads at most `maxSize` bytes of received data.
+	 * @return The number of bytes read, or -1 on error.
+	 */
+	virtual qint64 readData(char *data, int maxSize) = 0;
+
+	virtual void writeData(const char *data, int size) = 0;
+
+	/*!
+	 * To be called by the subclass when the bus has been opened or closed, or when opening it
+	 * failed. Closing the bus fails all pending requests.
+	 */
+	void setOpen(bool open);
+
+	/*!
+	 * Sets the inter-frame delay (t3.5) in us. A value of 0 disables the delay and the detection
+	 * of incomplete frames, which is what we want if the frames are not sent on the line by us.
+	 */
+	void setFrameGap(int frameGap)
+	{
+		mFrameGap = frameGap;
+	}
+
+protected slots:
+	/// To be called by the subclass when data has been received.
+	void onReadyRead();
+
+private slots:
+	void onTimeout();
+
+	void sendNext();
+
+private:
+	// Additional silence (in us) allowed within a frame before the data received so far is
+	// discarded. Serial port drivers (USB adapters in particular) deliver data in chunks, so the
+	// gaps we see are much larger than those on the line.
+	static const int FrameGapMargin = 20000;
+
+	class Reply : public ModbusReply {
+	public:
+		Reply(ModbusRtuBus *bus, ModbusRtuClient *client, const QByteArray &frame);
+
+		~Reply();
+
+		using ModbusReply::setResult;
+		using ModbusReply::registerBuffer;
+
+		bool isFinished() const override;
+
+		quint8 unitId() const
+		{
+			return static_cast<quint8>(frame[0]);
+		}
+
+		quint8 function() const
+		{
+			return static_cast<quint8>(frame[1]);
+		}
+
+		/// The bus handling the request. Reset when the request has finished or was cancelled.
+		ModbusRtuBus *bus;
+		/// The client that sent the request.
+		ModbusRtuClient *client;
+		QByteArray frame;
+		/// Time allowed for the response, in ms.
+		int timeout;
+		/// True if the frame has been written to the bus.
+		bool sent;
+		/// Time (see `ModbusRtuBus::mClock`) the request was created.
+		qint64 queuedAt;
+		/// Time the frame was written to the port, only valid if `sent` is true.
+		qint64 sentAt;
+
+	private:
+		void onFinished() override;
+
+		bool mFinished;
+	};
+
+	bool isResponsive(quint8 unitId) const
+	{
+		return mTimeouts[unitId] < UnresponsiveTimeouts;
+	}
+
+	/*!
+	 * Handles a response frame. Returns false if the frame is not the response to the active
+	 * request.
+	 */
+	bool processFrame(const ModbusRtuFrameParser::Frame &frame);
+
+	/// Takes the active request off the bus, so the next request may be sent.
+	Reply *takeActiveReply();
+
+	/// Records the result of `reply` in the statistics of its client.
+	void addReply(Reply *reply, ModbusReply::ExceptionCode error);
+
+	/// Removes `reply` from the pending requests, because it has finished.
+	void detach(Reply *reply);
+
+	/// Cancels `reply`, which has been deleted before it finished.
+	void removeReply(Reply *reply);
+
+	void scheduleSendNext();
+
+	/// Fails the active request and all queued requests.
+	void failPendingReplies(ModbusReply::ExceptionCode error);
+
+	// All buses, by name.
+	static QHash<QString, ModbusRtuBus *> mBuses;
+
+	QList<ModbusRtuClient *> mClients;
+	// All unfinished requests: the queued ones and the active one.
+	QList<Reply *> mPendingReplies;
+	// Runs while a request is on the bus, including cancelled requests, whose response may still
+	// come in.
+	QTimer *mTimer;
+	ModbusRequestQueue<Reply *> mQueue;
+	// The request waiting for a response, 0 if there is none.
+	Reply *mActiveReply;
+	ModbusRtuFrameParser mParser;
+	RttEstimator *mRttEstimator;
+	// Time since the last data was sent or received.
+	QElapsedTimer mLastActivity;
+	// Time base for the request statistics
+	QElapsedTimer mClock;
+	// Number of consecutive timeouts, by slave address.
+	quint8 mTimeouts[256];
+	// Inter-frame delay (t3.5) in us.
+	int mFrameGap;
+	bool mOpen;
+	bool mSendScheduled;
+	// Number of requests sent since a request of an unresponsive device was passed over.
+	int mSkipCount;
+	QString mName;
+};
+
+#endif // MODBUS_RTU_BUS_H
@@ -4,16 +4,11 @@
 #include <QByteArray>
 #include <QList>
 #include <QMetaType>
-#include <QMutex>
 #include <QObject>
-extern "C" {
-	#include <velib/platform/serial.h>
-}
-#include "crc16.h"
 #include "modbus_client.h"
 #include "modbus_reply.h"
 
-class QTimer;
+class ModbusRtuBus;
 
 Q_DECLARE_METATYPE(QList<quint16>)
 
@@ -21,120 +16,121 @@ Q_DECLARE_METATYPE(QList<quint16>)
  * Partial implementation of the Modbus RTU protocol.
  *
  * Supported functions: `ReadHoldingRegisters`, `ReadInputRegisters`,
- * and `WriteSingleRegister`.
+ * `WriteSingleRegister`, `WriteMultipleRegisters` and `ReadWriteMultipleRegisters`.
+ *
+ * The client does not own the serial port: all clients using the same port share a single
+ * `ModbusRtuBus`, so several devices (with different slave addresses) on the same RS485 bus can
+ * each have their own client. Each client has its own timeout and priority, and its pending
+ * requests are cancelled when it is destroyed.
  *
  * Communication is implemented asynchronously. It is allowed to add multiple
- * request at once. They will be queued and sent to the device whenever it is
- * ready (ie. all previous requests have been handled).
+ * request at once. They will be queued and sent to the device whenever the bus is
+ * ready (ie. all previous requests have been handled). Queued requests are sent
+ * in order of priority (see `ModbusClient::setPriority`).
+ *
+ * Devices on a serial bus are identified by a serial address, which is used in place of the host
+ * name of a Modbus TCP device (see `isSerialAddress`). Devices behind a serial to ethernet gateway
+ * are reached using `ModbusRtuOverTcpClient`.
  */
 class ModbusRtuClient : public ModbusClient
 {
 	Q_OBJECT
 public:
+	static const int DefaultBaudrate = 9600;
+
 	ModbusRtuClient(const QString &portName, int baudrate, QObject *parent = 0);
 
 	~ModbusRtuClient();
 
-	virtual ModbusReply *readHoldingRegisters(quint8 unitId, quint16 startReg, quint16 count);
+	/*!
+	 * Returns true if `address` is a serial address: the path of a serial port, optionally
+	 * followed by a colon and the baud rate. For example: "/dev/ttyUSB0" or "/dev/ttyUSB0:19200".
+	 */
+	static bool isSerialAddress(const QString &address);
+
+	/*!
+	 * Splits a serial address (see `isSerialAddress`) into port name and baud rate. If the baud
+	 * rate is omitted, `DefaultBaudrate` is used.
+	 * @return False if `address` is not a valid serial address.
+	 */
+	static bool parseSerialAddress(const QString &address, QString *portName, int *baudrate);
+
+	/*!
+	 * Returns true if `address` is a serial address, or the address of a serial to ethernet
+	 * gateway (see `ModbusRtuOverTcpClient::isRtuOverTcpAddress`).
+	 */
+	static bool isRtuAddress(const QString &address);
+
+	/*!
+	 * Creates a client for the bus with the given address.
+	 * @param address A serial address, or the address of a gateway. Use `isRtuAddress` to check
+	 * the address first.
+	 */
+	static ModbusRtuClient *create(const QString &address, QObject *parent = 0);
+
+	/// The serial port, or the address of the gateway.
+	QString portName() const;
+
+	/// Returns true if the serial port has been opened, or the gateway is connected.
+	bool isConnected() const override;
+
+	using ModbusClient::readHoldingRegisters;
+	using ModbusClient::readInputRegisters;
+	using ModbusClient::writeSingleHoldingRegister;
+	using ModbusClient::writeMultipleHoldingRegisters;
+	using ModbusClient::readWriteMultipleRegisters;
+	using ModbusClient::send;
 
-	virtual ModbusReply *readInputRegisters(quint8 unitId, quint16 startReg, quint16 count);
+	ModbusReply *readHoldingRegisters(quint8 unitId, quint16 startReg, quint16 count) override;
 
-	virtual ModbusReply *writeSingleHoldingRegister(quint8 unitId, quint16 reg, quint16 value);
+	ModbusReply *readInputRegisters(quint8 unitId, quint16 startReg, quint16 count) override;
 
-	virtual ModbusReply *writeMultipleHoldingRegisters(quint8 unitId, quint16 startReg,
-													   const QVector<quint16> &values);
+	ModbusReply *writeSingleHoldingRegister(quint8 unitId, quint16 reg, quint16 value) override;
 
-	virtual int timeout() const;
+	ModbusReply *writeMultipleHoldingRegisters(quint8 unitId, quint16 startReg,
+											   const QVector<quint16> &values) override;
 
-	virtual void setTimeout(int t);
+	ModbusReply *readWriteMultipleRegisters(quint8 unitId, quint16 readStartReg,
+											quint16 readCount, quint16 writeStartReg,
+											const QVector<quint16> &values) override;
+
+	/// The request is encoded including the CRC, so sending it costs no computation at all.
+	PreparedRequest prepareReadHoldingRegisters(quint8 unitId, quint16 startReg,
+												quint16 count) const override;
+
+	ModbusReply *send(const PreparedRequest &request) override;
+
+	/// Returns the number of requests waiting for the bus (from all clients using it).
+	int queueDepth() const;
+
+	/// Returns the largest number of requests that have been waiting for the bus at once.
+	int maxQueueDepth() const;
 
 signals:
 	void serialEvent(const char *message);
 
-private slots:
-	void onTimeout();
+protected:
+	/// Creates a client without a bus, the subclass must call `setBus`.
+	explicit ModbusRtuClient(QObject *parent);
 
-	bool processPacket();
+	void setBus(ModbusRtuBus *bus);
 
-	void onReadyRead();
+	/// The estimator of the bus, shared by all devices on the bus.
+	const RttEstimator *rttEstimator() const override;
 
-	void onError();
+private slots:
+	void onBusReady();
 
 private:
-	enum FunctionCode
-	{
-		ReadCoils						= 1,
-		ReadDiscreteInputs				= 2,
-		ReadHoldingRegisters			= 3,
-		ReadInputRegisters				= 4,
-		WriteSingleCoil					= 5,
-		WriteSingleRegister				= 6,
-		WriteMultipleCoils				= 15,
-		WriteMultipleRegisters			= 16,
-		ReadFileRecord					= 20,
-		WriteFileRecord					= 21,
-		MaskWriteRegister				= 22,
-		ReadWriteMultipleRegisters		= 23,
-		ReadFIFOQueue					= 24,
-		EncapsulatedInterfaceTransport	= 43,
-	};
-
-	class Reply : public ModbusReply {
-	public:
-		Reply(QObject *parent = 0);
-
-		using ModbusReply::setResult;
-
-		virtual bool isFinished() const;
-
-		QVector<quint16> values;
-		FunctionCode function;
-		quint8 slaveAddress;
-		quint16 reg;
-		quint16 count;
-		bool finished;
-
-	private:
-		virtual void onFinished();
-	};
-
-	void handleByteRead(quint8 b);
-
-	void resetStateEngine(bool toIdle);
-
-	void processPending();
-
-	ModbusReply *readRegisters(FunctionCode function, quint8 slaveAddress, quint16 startReg, quint16 count);
-
-	void send(Reply *reply);
-
-	enum ReadState {
-		Idle,
-		Address,
-		Function,
-		ByteCount,
-		StartAddressMsb,
-		StartAddressLsb,
-		Data,
-		CrcMsb,
-		CrcLsb
-	};
-
-	VeSerialPort *mSerialPort;
-	QTimer *mTimer;
-	QList<Reply *> mPendingCommands;
-	Reply *mActiveReply;
-
-	// State engine
-	ReadState mState;
-	FunctionCode mFunction;
-	quint8 mCount;
-	quint16 mUnitId;
-	quint16 mStartAddress;
-	quint16 mCrc;
-	Crc16 mCrcBuilder;
-	bool mAddToCrc;
-	QByteArray mData;
+	// The statistics are collected by the bus.
+	friend class ModbusRtuBus;
+
+	/// Creates an RTU frame (including CRC) from a Modbus TCP frame created by `ModbusTcpFrame`.
+	static QByteArray toRtuFrame(const QByteArray &tcpFrame);
+
+	ModbusReply *sendFrame(const QByteArray &tcpFrame, int registerCount);
+
+	ModbusRtuBus *mBus;
 };
 
 #endif // MODBUS_RTU_H
@@ -0,0 +1,99 @@
+#include <string.h>
+#include "crc16.h"
+#include "modbus_rtu_frame_parser.h"
+
+ModbusRtuFrameParser::ModbusRtuFrameParser():
+	mStart(0),
+	mEnd(0),
+	mCrcErrorCount(0)
+{
+}
+
+char *ModbusRtuFrameParser::writeBuffer(int *room)
+{
+	if (static_cast<int>(sizeof(mData)) - mEnd < MaxFrameSize) {
+		// A frame is never longer than MaxFrameSize, so older data cannot be part of a frame.
+		if (size() > MaxFrameSize)
+			mStart = mEnd - MaxFrameSize;
+		memmove(mData, mData + mStart, static_cast<size_t>(size()));
+		mEnd -= mStart;
+		mStart = 0;
+	}
+	*room = static_cast<int>(sizeof(mData)) - mEnd;
+	return reinterpret_cast<char *>(mData + mEnd);
+}
+
+void ModbusRtuFrameParser::commit(int count)
+{
+	Q_ASSERT(count >= 0 && mEnd + count <= static_cast<int>(sizeof(mData)));
+	mEnd += count;
+}
+
+void ModbusRtuFrameParser::append(const char *data, int size)
+{
+	while (size > 0) {
+		int room = 0;
+		char *dst = writeBuffer(&room);
+		int n = qMin(size, room);
+		memcpy(dst, data, static_cast<size_t>(n));
+		commit(n);
+		data += n;
+		size -= n;
+	}
+}
+
+bool ModbusRtuFrameParser::nextFrame(Frame *frame)
+{
+	for (;;) {
+		int length = frameLength();
+		if (length == 0)
+			return false;
+		if (length < 0) {
+			// Not a response we know of, so we are not at the start of a frame.
+			++mStart;
+			continue;
+		}
+		const quint8 *p = mData + mStart;
+		quint16 crc = Crc16::getValue(reinterpret_cast<const char *>(p), length - 2);
+		if (crc != toUInt16(p[length - 2], p[length - 1])) {
+			++mCrcErrorCount;
+			++mStart;
+			continue;
+		}
+		frame->unitId = p[0];
+		frame->function = p[1];
+		frame->data = p + 2;
+		frame->dataSize = length - 4;
+		mStart += length;
+		if (mStart == mEnd)
+			clear();
+		return true;
+	}
+}
+
+int ModbusRtuFrameParser::frameLength() const
+{
+	// Address, function code and the first data byte (exception code or byte count) are needed.
+	if (size() < 3)
+		return 0;
+	const quint8 *p = mData + mStart;
+	int length = 0;
+	if ((p[1] & 0x80) != 0) {
+		length = 5;
+	} else {
+		switch (p[1]) {
+		case 3:		// Read holding registers
+		case 4:		// Read input registers
+		case 23:	// Read/write multiple registers
+			length = 5 + p[2];
+			break;
+		case 6:		// Write single register
+		case 16:	// Write multiple registers
+			length = 8;
+			break;
+		default:
+			return -1;
+		}
+	}
+	return size() < length ? 0 : length;
+}
@@ -0,0 +1,92 @@
+#ifndef MODBUS_RTU_FRAME_PARSER_H
+#define MODBUS_RTU_FRAME_PARSER_H
+
+#include <QtGlobal>
+
+/*!
+ * Finds Modbus RTU response frames in a stream of bytes received from a serial port.
+ *
+ * Modbus RTU has no frame delimiters, except for the silence between frames. Instead of
+ * following the frame byte by byte, the parser waits until the function code (and byte count,
+ * if present) has been received, which tells the length of the frame. Once the complete frame
+ * is available, its CRC is checked in one go. If the check fails, the parser assumes it has lost
+ * track of the frame boundaries, and looks for a frame at the next byte.
+ *
+ * The silence between frames (t3.5) is handled by the caller, which should call `clear` when
+ * the line has been silent for a while, so a partial frame (eg. from a device that was
+ * interrupted) does not corrupt the next one.
+ *
+ * Data is received directly into the parser (see `writeBuffer` and `commit`), and frames are
+ * decoded in place, so no allocations or copies are needed.
+ */
+class ModbusRtuFrameParser
+{
+public:
+	/// Maximum size of a Modbus RTU frame, from the Modbus specification.
+	static const int MaxFrameSize = 256;
+
+	struct Frame
+	{
+		quint8 unitId;
+		/// Function code, with bit 7 set for exception responses.
+		quint8 function;
+		/// The data between function code and CRC.
+		const quint8 *data;
+		int dataSize;
+	};
+
+	ModbusRtuFrameParser();
+
+	/// Number of bytes received but not parsed yet.
+	int size() const
+	{
+		return mEnd - mStart;
+	}
+
+	/*!
+	 * Returns the position where new data should be stored, and the number of bytes that can be
+	 * stored there (at least `MaxFrameSize`). Call `commit` afterwards.
+	 */
+	char *writeBuffer(int *room);
+
+	/// Adds `count` bytes, which have been stored in the buffer returned by `writeBuffer`.
+	void commit(int count);
+
+	/// Copies `size` bytes into the buffer.
+	void append(const char *data, int size);
+
+	/*!
+	 * Looks for the next complete frame with a valid CRC. The frame data remains valid until the
+	 * next call to any of the functions that modify the parser.
+	 * @return False if more data is needed.
+	 */
+	bool nextFrame(Frame *frame);
+
+	/// Discards all unparsed data.
+	void clear()
+	{
+		mStart = 0;
+		mEnd = 0;
+	}
+
+	/// Number of times a frame was dropped because of a CRC mismatch.
+	quint32 crcErrorCount() const
+	{
+		return mCrcErrorCount;
+	}
+
+private:
+	/*!
+	 * Returns the length of the frame at the read position, including address and CRC, if it
+	 * can be computed from the bytes received so far. Returns 0 if more data is needed, and -1
+	 * if the function code is not supported.
+	 */
+	int frameLength() const;
+
+	quint8 mData[2 * MaxFrameSize];
+	int mStart;
+	int mEnd;
+	quint32 mCrcErrorCount;
+};
+
+#endif // MODBUS_RTU_FRAME_PARSER_H
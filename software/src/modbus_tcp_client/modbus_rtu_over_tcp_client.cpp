@@ -0,0 +1,48 @@
+#include <string.h>
+#include "modbus_rtu_over_tcp_client.h"
+#include "modbus_rtu_tcp_bus.h"
+
+static const char *const AddressPrefix = "rtu+tcp://";
+
+ModbusRtuOverTcpClient::ModbusRtuOverTcpClient(const QString &hostName, quint16 tcpPort,
+											   QObject *parent):
+	ModbusRtuClient(parent),
+	mHostName(hostName),
+	mTcpPort(tcpPort)
+{
+	setBus(ModbusRtuTcpBus::acquire(rtuOverTcpAddress(hostName, tcpPort), hostName, tcpPort,
+									this));
+}
+
+bool ModbusRtuOverTcpClient::isRtuOverTcpAddress(const QString &address)
+{
+	QString hostName;
+	quint16 tcpPort = 0;
+	return parseRtuOverTcpAddress(address, &hostName, &tcpPort);
+}
+
+bool ModbusRtuOverTcpClient::parseRtuOverTcpAddress(const QString &address, QString *hostName,
+													quint16 *tcpPort)
+{
+	if (!address.startsWith(AddressPrefix))
+		return false;
+	QString hostAndPort = address.mid(static_cast<int>(strlen(AddressPrefix)));
+	int colon = hostAndPort.lastIndexOf(':');
+	if (colon == -1) {
+		*hostName = hostAndPort;
+		*tcpPort = DefaultTcpPort;
+		return !hostName->isEmpty();
+	}
+	bool ok = false;
+	int port = hostAndPort.mid(colon + 1).toInt(&ok);
+	if (!ok || port <= 0 || port > 0xFFFF)
+		return false;
+	*hostName = hostAndPort.left(colon);
+	*tcpPort = static_cast<quint16>(port);
+	return !hostName->isEmpty();
+}
+
+QString ModbusRtuOverTcpClient::rtuOverTcpAddress(const QString &hostName, quint16 tcpPort)
+{
+	return QString("%1%2:%3").arg(AddressPrefix).arg(hostName).arg(tcpPort);
+}
@@ -0,0 +1,60 @@
+#ifndef MODBUS_RTU_OVER_TCP_CLIENT_H
+#define MODBUS_RTU_OVER_TCP_CLIENT_H
+
+#include "modbus_rtu_client.h"
+
+/*!
+ * Modbus RTU client for devices behind a serial to ethernet gateway, which passes RTU frames
+ * (including the CRC) between a TCP connection and its serial port. This is not the same as
+ * Modbus TCP, which uses the MBAP header instead of the CRC, and is handled by `ModbusTcpClient`.
+ *
+ * Framing, queueing and statistics are the same as with `ModbusRtuClient`. All clients using the
+ * same gateway share a single connection (see `ModbusRtuTcpBus`), and requests are sent one at a
+ * time.
+ *
+ * Devices behind a gateway are identified by an RTU over TCP address, which is used in place of
+ * the host name of a Modbus TCP device (see `isRtuOverTcpAddress`).
+ */
+class ModbusRtuOverTcpClient : public ModbusRtuClient
+{
+	Q_OBJECT
+public:
+	static const quint16 DefaultTcpPort = 502;
+
+	ModbusRtuOverTcpClient(const QString &hostName, quint16 tcpPort = DefaultTcpPort,
+						   QObject *parent = 0);
+
+	/*!
+	 * Returns true if `address` is an RTU over TCP address: "rtu+tcp://" followed by the host
+	 * name, optionally followed by a colon and the TCP port. For example:
+	 * "rtu+tcp://192.168.1.20:4001".
+	 */
+	static bool isRtuOverTcpAddress(const QString &address);
+
+	/*!
+	 * Splits an RTU over TCP address (see `isRtuOverTcpAddress`) into host name and TCP port. If
+	 * the port is omitted, `DefaultTcpPort` is used.
+	 * @return False if `address` is not a valid address.
+	 */
+	static bool parseRtuOverTcpAddress(const QString &address, QString *hostName,
+									   quint16 *tcpPort);
+
+	/// Returns the RTU over TCP address of the given gateway.
+	static QString rtuOverTcpAddress(const QString &hostName, quint16 tcpPort);
+
+	QString hostName() const
+	{
+		return mHostName;
+	}
+
+	quint16 tcpPort() const
+	{
+		return mTcpPort;
+	}
+
+private:
+	QString mHostName;
+	quint16 mTcpPort;
+};
+
+#endif // MODBUS_RTU_OVER_TCP_CLIENT_H
@@ -0,0 +1,73 @@
+#include <QSocketNotifier>
+#include <unistd.h>
+#include "modbus_rtu_serial_bus.h"
+
+ModbusRtuSerialBus::ModbusRtuSerialBus(const QString &portName, int baudrate):
+	ModbusRtuBus(portName),
+	mSerialPort(veSerialAllocate(portName.toLatin1().data())),
+	mBaudrate(baudrate)
+{
+	veSerialSetBaud(mSerialPort, static_cast<un32>(baudrate));
+	veSerialSetKind(mSerialPort, 0); // Requires external event pump
+	if (!veSerialOpen(mSerialPort, 0)) {
+		qWarning() << "Could not open serial port" << portName;
+		return;
+	}
+
+	QSocketNotifier *readNotifier =
+		new QSocketNotifier(mSerialPort->fh, QSocketNotifier::Read, this);
+	connect(readNotifier, SIGNAL(activated(int)), this, SLOT(onReadyRead()));
+
+	QSocketNotifier *errorNotifier =
+		new QSocketNotifier(mSerialPort->fh, QSocketNotifier::Exception, this);
+	connect(errorNotifier, SIGNAL(activated(int)), this, SLOT(onError()));
+
+	// Modbus requires a pause between frames of 3.5 times the interval needed to send a
+	// character. We use 4 characters here, just in case...
+	// We also assume 10 bits per caracter (8 data bits, 1 stop bit and 1 parity bit). Keep in
+	// mind that overestimating the character time does not hurt (a lot), but underestimating
+	// does.
+	setFrameGap(static_cast<int>((4 * 10 * 1000 * 1000) / mSerialPort->baudrate));
+	setOpen(true);
+}
+
+ModbusRtuSerialBus::~ModbusRtuSerialBus()
+{
+	if (isOpen())
+		veSerialClose(mSerialPort);
+	VeSerialPortFree(mSerialPort);
+}
+
+ModbusRtuBus *ModbusRtuSerialBus::acquire(const QString &portName, int baudrate,
+										  ModbusRtuClient *client)
+{
+	ModbusRtuSerialBus *bus = static_cast<ModbusRtuSerialBus *>(find(portName));
+	if (bus == 0) {
+		bus = new ModbusRtuSerialBus(portName, baudrate);
+	} else if (bus->baudrate() != baudrate) {
+		qWarning() << "Serial port" << portName << "is in use with baud rate" << bus->baudrate();
+	}
+	bus->addClient(client);
+	return bus;
+}
+
+qint64 ModbusRtuSerialBus::readData(char *data, int maxSize)
+{
+	ssize_t len = read(mSerialPort->fh, data, static_cast<size_t>(maxSize));
+	if (len < 0)
+		emit serialEvent("serial read failure");
+	return len;
+}
+
+void ModbusRtuSerialBus::writeData(const char *data, int size)
+{
+	// The data is shared with the prepared request it was created from, so we need a const
+	// pointer to avoid a copy.
+	veSerialPutBuf(mSerialPort, reinterpret_cast<un8 *>(const_cast<char *>(data)),
+				   static_cast<un32>(size));
+}
+
+void ModbusRtuSerialBus::onError()
+{
+	emit serialEvent("Serial error");
+}
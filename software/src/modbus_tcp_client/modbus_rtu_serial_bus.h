@@ -0,0 +1,44 @@
+#ifndef MODBUS_RTU_SERIAL_BUS_H
+#define MODBUS_RTU_SERIAL_BUS_H
+
+extern "C" {
+	#include <velib/platform/serial.h>
+}
+#include "modbus_rtu_bus.h"
+
+/*!
+ * A Modbus RTU bus on a serial (RS485) port.
+ */
+class ModbusRtuSerialBus : public ModbusRtuBus
+{
+	Q_OBJECT
+public:
+	/*!
+	 * Returns the bus on the given serial port, and registers `client` as one of its users.
+	 * Opens the port if it has not been opened yet. The baud rate of the first client is used.
+	 */
+	static ModbusRtuBus *acquire(const QString &portName, int baudrate, ModbusRtuClient *client);
+
+	int baudrate() const
+	{
+		return mBaudrate;
+	}
+
+protected:
+	qint64 readData(char *data, int maxSize) override;
+
+	void writeData(const char *data, int size) override;
+
+private slots:
+	void onError();
+
+private:
+	ModbusRtuSerialBus(const QString &portName, int baudrate);
+
+	~ModbusRtuSerialBus();
+
+	VeSerialPort *mSerialPort;
+	int mBaudrate;
+};
+
+#endif // MODBUS_RTU_SERIAL_BUS_H
@@ -0,0 +1,84 @@
+#include <QTcpSocket>
+#include <QTimer>
+#include "modbus_rtu_tcp_bus.h"
+
+ModbusRtuTcpBus::ModbusRtuTcpBus(const QString &name, const QString &hostName, quint16 tcpPort):
+	ModbusRtuBus(name),
+	mSocket(new QTcpSocket(this)),
+	mConnectTimer(new QTimer(this)),
+	mReconnectTimer(new QTimer(this)),
+	mReconnectAttempts(0),
+	mHostName(hostName),
+	mTcpPort(tcpPort)
+{
+	connect(mSocket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+	connect(mSocket, SIGNAL(connected()), this, SLOT(onConnected()));
+	connect(mSocket, SIGNAL(disconnected()), this, SLOT(onClosed()));
+	#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+	connect(mSocket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onClosed()));
+	#else
+	connect(mSocket, SIGNAL(errorOccurred(QAbstractSocket::SocketError)), this, SLOT(onClosed()));
+	#endif
+	mConnectTimer->setSingleShot(true);
+	mConnectTimer->setInterval(ConnectTimeout);
+	connect(mConnectTimer, SIGNAL(timeout()), this, SLOT(onClosed()));
+	mReconnectTimer->setSingleShot(true);
+	connect(mReconnectTimer, SIGNAL(timeout()), this, SLOT(connectToServer()));
+	connectToServer();
+}
+
+ModbusRtuBus *ModbusRtuTcpBus::acquire(const QString &name, const QString &hostName,
+									   quint16 tcpPort, ModbusRtuClient *client)
+{
+	ModbusRtuTcpBus *bus = static_cast<ModbusRtuTcpBus *>(find(name));
+	if (bus == 0)
+		bus = new ModbusRtuTcpBus(name, hostName, tcpPort);
+	bus->addClient(client);
+	return bus;
+}
+
+bool ModbusRtuTcpBus::isOpening() const
+{
+	return mConnectTimer->isActive();
+}
+
+qint64 ModbusRtuTcpBus::readData(char *data, int maxSize)
+{
+	return mSocket->read(data, maxSize);
+}
+
+void ModbusRtuTcpBus::writeData(const char *data, int size)
+{
+	mSocket->write(data, size);
+}
+
+void ModbusRtuTcpBus::connectToServer()
+{
+	mConnectTimer->start();
+	mSocket->connectToHost(mHostName, mTcpPort);
+}
+
+void ModbusRtuTcpBus::onConnected()
+{
+	mConnectTimer->stop();
+	mReconnectAttempts = 0;
+	mSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+	mSocket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+	setOpen(true);
+}
+
+void ModbusRtuTcpBus::onClosed()
+{
+	// A lost connection is usually reported twice: by an error and by the disconnected signal.
+	if (mReconnectTimer->isActive())
+		return;
+	mConnectTimer->stop();
+	int delay = qMin(MaxReconnectDelay, MinReconnectDelay << qMin(mReconnectAttempts, 16));
+	++mReconnectAttempts;
+	mReconnectTimer->start(delay);
+	// Leave the socket in a clean state for the next attempt. Signals emitted by the socket here
+	// are ignored, because the reconnect timer is running.
+	if (mSocket->state() != QTcpSocket::UnconnectedState)
+		mSocket->abort();
+	setOpen(false);
+}
@@ -0,0 +1,64 @@
+#ifndef MODBUS_RTU_TCP_BUS_H
+#define MODBUS_RTU_TCP_BUS_H
+
+#include <QAbstractSocket>
+#include "modbus_rtu_bus.h"
+
+class QTcpSocket;
+
+/*!
+ * A Modbus RTU bus behind a serial to ethernet gateway, which passes RTU frames (including the
+ * CRC) between a TCP connection and its serial port.
+ *
+ * Unlike a Modbus TCP gateway, such a gateway does not know about requests and responses, so the
+ * requests must be sent one at a time, just like on the serial port itself. The gateway will
+ * usually accept a single connection only, which is shared by all clients.
+ *
+ * A lost connection is re-established automatically, with an exponential back off between the
+ * attempts. Requests sent while there is no connection fail immediately.
+ */
+class ModbusRtuTcpBus : public ModbusRtuBus
+{
+	Q_OBJECT
+public:
+	/*!
+	 * Returns the bus behind the gateway, and registers `client` as one of its users. Connects to
+	 * the gateway if there is no connection yet.
+	 * @param name The address of the gateway, used to share the bus.
+	 */
+	static ModbusRtuBus *acquire(const QString &name, const QString &hostName, quint16 tcpPort,
+								 ModbusRtuClient *client);
+
+	bool isOpening() const override;
+
+protected:
+	qint64 readData(char *data, int maxSize) override;
+
+	void writeData(const char *data, int size) override;
+
+private slots:
+	void connectToServer();
+
+	void onConnected();
+
+	void onClosed();
+
+private:
+	// Time allowed for setting up the connection (ms).
+	static const int ConnectTimeout = 5000;
+	// Range of the delay (ms) between reconnect attempts
+	static const int MinReconnectDelay = 500;
+	static const int MaxReconnectDelay = 30000;
+
+	ModbusRtuTcpBus(const QString &name, const QString &hostName, quint16 tcpPort);
+
+	QTcpSocket *mSocket;
+	QTimer *mConnectTimer;
+	QTimer *mReconnectTimer;
+	// Number of reconnect attempts since the connection was lost. Determines the back off.
+	int mReconnectAttempts;
+	QString mHostName;
+	quint16 mTcpPort;
+};
+
+#endif // MODBUS_RTU_TCP_BUS_H
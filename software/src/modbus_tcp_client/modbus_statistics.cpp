@@ -0,0 +1,66 @@
+#include <qnumeric.h>
+#include <string.h>
+#include "modbus_statistics.h"
+
+ModbusStatistics::Histogram::Histogram()
+{
+	clear();
+}
+
+void ModbusStatistics::Histogram::add(qint64 ms)
+{
+	if (ms < 0)
+		ms = 0;
+	// The bucket index is the number of significant bits of the duration.
+	int index = 0;
+	for (quint64 v = static_cast<quint64>(ms); v != 0 && index < BucketCount - 1; v >>= 1)
+		++index;
+	++mBuckets[index];
+	++mCount;
+	mSum += static_cast<quint64>(ms);
+	mMax = qMax(mMax, ms);
+}
+
+double ModbusStatistics::Histogram::average() const
+{
+	if (mCount == 0)
+		return qQNaN();
+	return static_cast<double>(mSum) / mCount;
+}
+
+void ModbusStatistics::Histogram::clear()
+{
+	memset(mBuckets, 0, sizeof(mBuckets));
+	mCount = 0;
+	mSum = 0;
+	mMax = -1;
+}
+
+ModbusStatistics::ModbusStatistics():
+	mQueueDepth(0)
+{
+	clear();
+}
+
+void ModbusStatistics::addReply(qint64 queueTime, qint64 roundTripTime,
+								ModbusReply::ExceptionCode error)
+{
+	mQueueTime.add(queueTime);
+	// A negative round trip time means the request never left the queue.
+	if (roundTripTime >= 0)
+		mRoundTripTime.add(roundTripTime);
+	mTotalTime.add(queueTime + qMax(roundTripTime, Q_INT64_C(0)));
+	++mReplyCounts[static_cast<quint8>(error)];
+}
+
+void ModbusStatistics::clear()
+{
+	mQueueTime.clear();
+	mRoundTripTime.clear();
+	mTotalTime.clear();
+	memset(mReplyCounts, 0, sizeof(mReplyCounts));
+	mBytesSent = 0;
+	mBytesReceived = 0;
+	mReconnects = 0;
+	mMaxQueueDepth = mQueueDepth;
+}
@@ -0,0 +1,181 @@
+#ifndef MODBUS_STATISTICS_H
+#define MODBUS_STATISTICS_H
+
+#include <QtGlobal>
+#include "modbus_reply.h"
+
+/*!
+ * Request statistics of a Modbus client: latency histograms, the number of replies per exception
+ * code, and traffic counters.
+ *
+ * All storage is allocated up front, so recording a sample is just a few integer operations. This
+ * allows the statistics to be collected all the time, not just while debugging.
+ */
+class ModbusStatistics
+{
+public:
+	/*!
+	 * Histogram of durations (in ms) with logarithmic buckets. Bucket 0 holds durations below
+	 * 1 ms, bucket n (n > 0) holds durations from 2^(n-1) up to (but not including) 2^n ms. The
+	 * last bucket also holds all larger values.
+	 */
+	class Histogram
+	{
+	public:
+		static const int BucketCount = 16;
+
+		Histogram();
+
+		void add(qint64 ms);
+
+		/// Returns the number of samples in bucket `index`.
+		quint32 bucket(int index) const
+		{
+			Q_ASSERT(index >= 0 && index < BucketCount);
+			return mBuckets[index];
+		}
+
+		/// Returns the (exclusive) upper bound of bucket `index` in ms.
+		static qint64 upperBound(int index)
+		{
+			return Q_INT64_C(1) << index;
+		}
+
+		/// Returns the total number of samples.
+		quint32 count() const
+		{
+			return mCount;
+		}
+
+		/// Returns the average duration in ms, or NaN if there are no samples.
+		double average() const;
+
+		/// Returns the longest duration seen in ms, or -1 if there are no samples.
+		qint64 max() const
+		{
+			return mMax;
+		}
+
+		void clear();
+
+	private:
+		quint32 mBuckets[BucketCount];
+		quint32 mCount;
+		quint64 mSum;
+		qint64 mMax;
+	};
+
+	ModbusStatistics();
+
+	/*!
+	 * Records a finished request.
+	 * @param queueTime Time between creating the request and writing it to the server.
+	 * @param roundTripTime Time between writing the request and receiving the reply. Should be
+	 * negative if the request has never been sent (eg. when the connection was lost).
+	 * @param error The result of the request.
+	 */
+	void addReply(qint64 queueTime, qint64 roundTripTime, ModbusReply::ExceptionCode error);
+
+	void addBytesSent(int count)
+	{
+		mBytesSent += static_cast<quint64>(count);
+	}
+
+	void addBytesReceived(int count)
+	{
+		mBytesReceived += static_cast<quint64>(count);
+	}
+
+	void addReconnect()
+	{
+		++mReconnects;
+	}
+
+	/// Records that a request has been added to the send queue.
+	void addQueued()
+	{
+		++mQueueDepth;
+		mMaxQueueDepth = qMax(mMaxQueueDepth, mQueueDepth);
+	}
+
+	/// Records that a request has left the send queue, because it was sent or cancelled.
+	void removeQueued()
+	{
+		Q_ASSERT(mQueueDepth > 0);
+		--mQueueDepth;
+	}
+
+	/// Time spent waiting for room in the in-flight window, or for the connection.
+	const Histogram &queueTime() const
+	{
+		return mQueueTime;
+	}
+
+	/// Time spent waiting for the server, for requests that have been sent.
+	const Histogram &roundTripTime() const
+	{
+		return mRoundTripTime;
+	}
+
+	/// Time between creating the request and its completion.
+	const Histogram &totalTime() const
+	{
+		return mTotalTime;
+	}
+
+	/// Returns the number of finished requests.
+	quint32 replyCount() const
+	{
+		return mTotalTime.count();
+	}
+
+	/// Returns the number of requests that finished with the given result.
+	quint32 replyCount(ModbusReply::ExceptionCode error) const
+	{
+		return mReplyCounts[static_cast<quint8>(error)];
+	}
+
+	quint64 bytesSent() const
+	{
+		return mBytesSent;
+	}
+
+	quint64 bytesReceived() const
+	{
+		return mBytesReceived;
+	}
+
+	quint32 reconnects() const
+	{
+		return mReconnects;
+	}
+
+	/// Returns the number of requests waiting to be sent.
+	int queueDepth() const
+	{
+		return mQueueDepth;
+	}
+
+	/// Returns the largest queue depth seen (since the last call to `clear`).
+	int maxQueueDepth() const
+	{
+		return mMaxQueueDepth;
+	}
+
+	/// Resets all counters. The queue depth is not a counter, and is kept.
+	void clear();
+
+private:
+	Histogram mQueueTime;
+	Histogram mRoundTripTime;
+	Histogram mTotalTime;
+	// Indexed by exception code. The Modbus exception codes, as well as our own, fit in 8 bits.
+	quint32 mReplyCounts[256];
+	quint64 mBytesSent;
+	quint64 mBytesReceived;
+	quint32 mReconnects;
+	int mQueueDepth;
+	int mMaxQueueDepth;
+};
+
+#endif // MODBUS_STATISTICS_H
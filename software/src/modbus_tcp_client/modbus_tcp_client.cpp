@@ -1,282 +1,150 @@
-#include <QHostAddress>
-#include <QTcpSocket>
 #include <QTimer>
-#include "crc16.h"
 #include "modbus_tcp_client.h"
+#include "modbus_tcp_connection.h"
+#include "modbus_tcp_frame.h"
 #include "modbus_reply.h"
 
 ModbusTcpClient::ModbusTcpClient(QObject *parent):
 	ModbusClient(parent),
-	mSocket(new QTcpSocket(this)),
-	mTimeout(1000),
-	mConnectTimerId(0),
-	mTransactionId(0)
+	mConnection(0),
+	mConnectTimeout(0),
+	mAutoReconnect(false),
+	mMaxInFlight(DefaultMaxInFlight),
+	mTcpPort(DefaultTcpPort)
 {
-	mSocket->socketOption(QAbstractSocket::LowDelayOption);
-	connect(mSocket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
-	connect(mSocket, SIGNAL(connected()), this, SLOT(onConnected()));
-	connect(mSocket, SIGNAL(disconnected()), this, SIGNAL(disconnected()));
-	#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-	connect(mSocket, SIGNAL(error(QAbstractSocket::SocketError)),
-			this, SLOT(onSocketErrorReceived(QAbstractSocket::SocketError)));
-	#else
-	connect(mSocket, SIGNAL(errorOccurred(QAbstractSocket::SocketError)),
-			this, SLOT(onSocketErrorReceived(QAbstractSocket::SocketError)));
-	#endif
+}
+
+ModbusTcpClient::~ModbusTcpClient()
+{
+	if (mConnection != 0)
+		mConnection->release(this);
 }
 
 void ModbusTcpClient::connectToServer(const QString &hostName, quint16 tcpPort)
 {
+	if (mConnection != 0 && (mHostName != hostName || mTcpPort != tcpPort)) {
+		mConnection->disconnect(this);
+		mConnection->release(this);
+		mConnection = 0;
+	}
 	mHostName = hostName;
 	mTcpPort = tcpPort;
-	mConnectTimerId = startTimer(mTimeout);
-	mSocket->connectToHost(hostName, tcpPort);
+	if (mConnection == 0) {
+		mConnection = ModbusTcpConnection::acquire(hostName, tcpPort, this);
+		connect(mConnection, SIGNAL(connected()), this, SIGNAL(connected()));
+		connect(mConnection, SIGNAL(disconnected()), this, SIGNAL(disconnected()));
+	}
+	if (mConnection->isConnected()) {
+		// Give the caller a chance to handle the connected signal, just like with a new
+		// connection.
+		QTimer::singleShot(0, this, SLOT(onSharedConnectionReady()));
+		return;
+	}
+	mConnection->connectToServer(connectTimeout());
 }
 
 bool ModbusTcpClient::isConnected() const
 {
-	return mSocket->state() == QTcpSocket::ConnectedState;
+	return mConnection != 0 && mConnection->isConnected();
 }
 
 ModbusReply *ModbusTcpClient::readInputRegisters(quint8 unitId, quint16 startReg, quint16 count)
 {
-	return readRegisters(ReadInputRegisters, unitId, startReg, count);
+	Q_ASSERT(mConnection != 0);
+	return mConnection->readInputRegisters(this, timeout(), unitId, startReg, count);
 }
 
 ModbusReply *ModbusTcpClient::readHoldingRegisters(quint8 unitId, quint16 startReg, quint16 count)
 {
-	return readRegisters(ReadHoldingRegisters, unitId, startReg, count);
+	Q_ASSERT(mConnection != 0);
+	return mConnection->readHoldingRegisters(this, timeout(), unitId, startReg, count);
 }
 
 ModbusReply *ModbusTcpClient::writeSingleHoldingRegister(quint8 unitId, quint16 reg, quint16 value)
 {
-	QByteArray frame = createFrame(WriteSingleRegister, unitId, 4);
-	frame.append(static_cast<char>(msb(reg)));
-	frame.append(static_cast<char>(lsb(reg)));
-	frame.append(static_cast<char>(msb(value)));
-	frame.append(static_cast<char>(lsb(value)));
-	return sendFrame(frame);
+	Q_ASSERT(mConnection != 0);
+	return mConnection->writeSingleHoldingRegister(this, timeout(), unitId, reg, value);
 }
 
 ModbusReply *ModbusTcpClient::writeMultipleHoldingRegisters(quint8 unitId, quint16 startReg,
 															const QVector<quint16> &values)
 {
-	QByteArray frame = createFrame(WriteMultipleRegisters, unitId, 5 + 2 * values.size());
-	frame.append(static_cast<char>(msb(startReg)));
-	frame.append(static_cast<char>(lsb(startReg)));
-	frame.append(static_cast<char>(msb(values.size())));
-	frame.append(static_cast<char>(lsb(values.size())));
-	frame.append(static_cast<char>(values.size() * 2));
-	foreach (quint16 value, values) {
-		frame.append(static_cast<char>(msb(value)));
-		frame.append(static_cast<char>(lsb(value)));
-	}
-	return sendFrame(frame);
-}
-
-QString ModbusTcpClient::hostName() const
-{
-	return mHostName;
-}
-
-quint16 ModbusTcpClient::portName() const
-{
-	return mTcpPort;
-}
-
-int ModbusTcpClient::timeout() const
-{
-	return mTimeout;
-}
-
-void ModbusTcpClient::setTimeout(int t)
-{
-	mTimeout = t;
-}
-
-void ModbusTcpClient::timerEvent(QTimerEvent *event)
-{
-	Q_UNUSED(event)
-	Q_ASSERT(mConnectTimerId > 0);
-	if (mConnectTimerId == 0)
-		return;
-	killTimer(mConnectTimerId);
-	mConnectTimerId = 0;
-	mSocket->disconnectFromHost();
-	emit disconnected();
-}
-
-void ModbusTcpClient::onConnected()
-{
-	if (mConnectTimerId > 0) {
-		killTimer(mConnectTimerId);
-		mConnectTimerId = 0;
-	}
-	emit connected();
-}
-
-void ModbusTcpClient::onReadyRead()
-{
-	mBuffer.append(mSocket->read(mSocket->bytesAvailable()));
-	for (;;) {
-		if (mBuffer.size() < 6)
-			return;
-		int length = toUInt16(mBuffer, 4) + 6;
-		if (mBuffer.size() < length)
-			return;
-		quint16 transactionId = toUInt16(mBuffer, 0);
-		Q_ASSERT(toUInt16(mBuffer, 2) == 0);
-		// quint8 unitId = static_cast<quint8>(mBuffer[6]);
-		quint8 functionCode = static_cast<quint8>(mBuffer[7]);
-		if ((functionCode & 0x80) == 0) {
-			switch (functionCode) {
-			case ReadHoldingRegisters:
-			case ReadInputRegisters:
-				if (mBuffer.size() > 8) {
-					quint8 payloadSize = static_cast<quint8>(mBuffer[8]);
-					int i0 = 9;
-					int i1 = i0 + payloadSize;
-					if (i1 == length) {
-						QVector<quint16> values;
-						for (; i0 < i1; i0 += 2)
-							values.append(toUInt16(mBuffer, i0));
-						setFinished(transactionId, values);
-						break;
-					}
-				}
-				setFinished(transactionId, ModbusReply::ParseError);
-				break;
-			case WriteSingleRegister:
-				if (mBuffer.size() > 11) {
-					// quint16 startReg = toUInt16(mBuffer, 8);
-					quint16 value = toUInt16(mBuffer, 10);
-					QVector<quint16> values;
-					values.append(value);
-					setFinished(transactionId, values);
-					break;
-				}
-				setFinished(transactionId, ModbusReply::ParseError);
-				break;
-			case WriteMultipleRegisters:
-				if (mBuffer.size() == 12) {
-					// quint16 startReg = toUInt16(mBuffer, 8);
-					// quint16 regCount = toUInt16(mBuffer, 10);
-					setFinished(transactionId, QVector<quint16>());
-					break;
-				}
-				setFinished(transactionId, ModbusReply::ParseError);
-				break;
-			}
-		} else {
-			if (mBuffer.size() > 8) {
-				quint8 error = static_cast<quint8>(mBuffer[8]);
-				setFinished(transactionId, error);
-			} else {
-				setFinished(transactionId, ModbusReply::ParseError);
-			}
-		}
-		mBuffer.remove(0, length);
-	}
+	Q_ASSERT(mConnection != 0);
+	return mConnection->writeMultipleHoldingRegisters(this, timeout(), unitId, startReg, values);
 }
 
-void ModbusTcpClient::onReplyDestroyed()
+ModbusReply *ModbusTcpClient::readWriteMultipleRegisters(quint8 unitId, quint16 readStartReg,
+														 quint16 readCount, quint16 writeStartReg,
+														 const QVector<quint16> &values)
 {
-	Reply *reply = static_cast<Reply *>(sender());
-	mPendingReplies.remove(reply->transactionId());
+	Q_ASSERT(mConnection != 0);
+	return mConnection->readWriteMultipleRegisters(this, timeout(), unitId, readStartReg, readCount,
+												   writeStartReg, values);
 }
 
-void ModbusTcpClient::onSocketErrorReceived(QAbstractSocket::SocketError error)
+ModbusClient::PreparedRequest ModbusTcpClient::prepareReadHoldingRegisters(
+	quint8 unitId, quint16 startReg, quint16 count) const
 {
-	Q_UNUSED(error)
-	foreach (Reply *reply, mPendingReplies)
-		reply->setResult(ModbusReply::TcpError);
-	mPendingReplies.clear();
-	emit disconnected();
+	return createPreparedRequest(
+		ModbusTcpFrame::readRegisters(ModbusTcpFrame::ReadHoldingRegisters, unitId, startReg,
+									  count),
+		count);
 }
 
-ModbusReply *ModbusTcpClient::sendFrame(const QByteArray &frame)
+ModbusReply *ModbusTcpClient::send(const PreparedRequest &request)
 {
-	Reply *reply = new Reply(mTransactionId, mTimeout, this);
-	mPendingReplies[mTransactionId] = reply;
-	mSocket->write(frame);
-	connect(reply, SIGNAL(destroyed()), this, SLOT(onReplyDestroyed()));
-	return reply;
+	Q_ASSERT(mConnection != 0);
+	Q_ASSERT(request.isValid());
+	return mConnection->send(this, timeout(), frame(request), registerCount(request));
 }
 
-ModbusTcpClient::Reply *ModbusTcpClient::popReply(quint16 transactionId)
+QString ModbusTcpClient::hostName() const
 {
-	QHash<quint16, Reply *>::Iterator it = mPendingReplies.find(transactionId);
-	if (it == mPendingReplies.end())
-		return 0;
-	Reply *reply = it.value();
-	mPendingReplies.erase(it);
-	disconnect(reply);
-	return reply;
+	return mHostName;
 }
 
-ModbusReply *ModbusTcpClient::readRegisters(FunctionCode function, quint8 unitId, quint16 startReg,
-											quint16 count)
+quint16 ModbusTcpClient::portName() const
 {
-	QByteArray frame = createFrame(function, unitId, 4);
-	frame.append(static_cast<char>(msb(startReg)));
-	frame.append(static_cast<char>(lsb(startReg)));
-	frame.append(static_cast<char>(msb(count)));
-	frame.append(static_cast<char>(lsb(count)));
-	return sendFrame(frame);
+	return mTcpPort;
 }
 
-QByteArray ModbusTcpClient::createFrame(ModbusTcpClient::FunctionCode function, quint8 unitId,
-										quint8 count)
+const RttEstimator *ModbusTcpClient::rttEstimator() const
 {
-	++mTransactionId;
-	QByteArray frame;
-	frame.append(static_cast<char>(msb(mTransactionId)));
-	frame.append(static_cast<char>(lsb(mTransactionId)));
-	frame.append(static_cast<char>(0));
-	frame.append(static_cast<char>(0));
-	frame.append(static_cast<char>(0));
-	frame.append(static_cast<char>(count + 2));
-	frame.append(static_cast<char>(unitId));
-	frame.append(static_cast<char>(function));
-	return frame;
+	return mConnection == 0 ? 0 : mConnection->rttEstimator();
 }
 
-void ModbusTcpClient::setFinished(quint16 transactionId, const QVector<quint16> &values)
+int ModbusTcpClient::connectTimeout() const
 {
-	Reply *reply = popReply(transactionId);
-	if (reply != 0)
-		reply->setResult(values);
+	return mConnectTimeout > 0 ? mConnectTimeout : timeout();
 }
 
-void ModbusTcpClient::setFinished(quint16 transactionId, int error)
+void ModbusTcpClient::setConnectTimeout(int t)
 {
-	Reply *reply = popReply(transactionId);
-	if (reply != 0)
-		reply->setResult(static_cast<ModbusReply::ExceptionCode>(error));
+	mConnectTimeout = qMax(0, t);
 }
 
-ModbusTcpClient::Reply::Reply(quint16 transactionId, int timeout, QObject *parent):
-	ModbusReply(parent),
-	mTimerId(startTimer(timeout)),
-	mTransactionId(transactionId)
+void ModbusTcpClient::setAutoReconnect(bool r)
 {
+	mAutoReconnect = r;
+	if (mConnection != 0)
+		mConnection->updateAutoReconnect();
 }
 
-bool ModbusTcpClient::Reply::isFinished() const
+int ModbusTcpClient::maxInFlight() const
 {
-	return mTimerId == 0;
+	return mMaxInFlight;
 }
 
-void ModbusTcpClient::Reply::onFinished()
+void ModbusTcpClient::setMaxInFlight(int n)
 {
-	Q_ASSERT(mTimerId > 0);
-	killTimer(mTimerId);
-	mTimerId = 0;
+	Q_ASSERT(n > 0);
+	mMaxInFlight = qMax(1, n);
+	if (mConnection != 0)
+		mConnection->updateMaxInFlight();
 }
 
-void ModbusTcpClient::Reply::timerEvent(QTimerEvent *event)
+void ModbusTcpClient::onSharedConnectionReady()
 {
-	Q_UNUSED(event)
-	Q_ASSERT(mTimerId > 0);
-	setResult(Timeout);
+	if (isConnected())
+		emit connected();
 }
@@ -1,24 +1,56 @@
 #ifndef MODBUSTCPCLIENT_H
 #define MODBUSTCPCLIENT_H
 
-#include <QAbstractSocket>
 #include <QObject>
 #include "modbus_client.h"
 #include "modbus_reply.h"
 
-class QTimer;
-
+class ModbusTcpConnection;
+
+/*!
+ * Modbus TCP client.
+ *
+ * The client does not own a socket: all clients connected to the same host and port share a
+ * single `ModbusTcpConnection`. Each client has its own timeout, and its pending requests are
+ * cancelled when it is destroyed.
+ *
+ * Requests are queued until the connection has been established, or until there is room in the
+ * in-flight window. The queue is shared by all clients of the connection, and ordered by the
+ * priority of the requests (see `ModbusClient::setPriority`). Replies are matched to requests
+ * using the transaction ID from the MBAP header, so the server is allowed to handle pipelined
+ * requests out of order.
+ *
+ * The traffic counters in the statistics only include the frames of this client, while
+ * reconnects are counted for the shared connection.
+ */
 class ModbusTcpClient: public ModbusClient
 {
 	Q_OBJECT
 public:
 	static const quint16 DefaultTcpPort = 502;
 
+	/// Number of outstanding requests allowed by default. A value of 1 disables pipelining, which
+	/// is the safe choice for servers that are not known to support it.
+	static const int DefaultMaxInFlight = 1;
+
 	ModbusTcpClient(QObject *parent = 0);
 
+	~ModbusTcpClient();
+
+	/*!
+	 * Connects to the server. If another client is connected to the same server already, the
+	 * connection is shared, and `connected` will be emitted when control returns to the event
+	 * loop.
+	 */
 	void connectToServer(const QString &hostName, quint16 tcpPort = DefaultTcpPort);
 
-	bool isConnected() const;
+	bool isConnected() const override;
+
+	using ModbusClient::readHoldingRegisters;
+	using ModbusClient::readInputRegisters;
+	using ModbusClient::writeSingleHoldingRegister;
+	using ModbusClient::writeMultipleHoldingRegisters;
+	using ModbusClient::readWriteMultipleRegisters;
 
 	ModbusReply *readHoldingRegisters(quint8 unitId, quint16 startReg, quint16 count) override;
 
@@ -29,93 +61,71 @@ public:
 	ModbusReply *writeMultipleHoldingRegisters(quint8 unitId, quint16 startReg,
 													   const QVector<quint16> &values) override;
 
-	QString hostName() const;
-
-	quint16 portName() const;
-
-	int timeout() const override;
-
-	void setTimeout(int t) override;
+	using ModbusClient::send;
 
-signals:
-	void connected();
+	PreparedRequest prepareReadHoldingRegisters(quint8 unitId, quint16 startReg,
+												quint16 count) const override;
 
-	void disconnected();
+	ModbusReply *send(const PreparedRequest &request) override;
 
-protected:
-	virtual void timerEvent(QTimerEvent *event) override;
+	ModbusReply *readWriteMultipleRegisters(quint8 unitId, quint16 readStartReg,
+											quint16 readCount, quint16 writeStartReg,
+											const QVector<quint16> &values) override;
 
-private slots:
-	void onConnected();
+	QString hostName() const;
 
-	void onReadyRead();
+	quint16 portName() const;
 
-	void onReplyDestroyed();
+	/*!
+	 * Returns the time (in ms) allowed for setting up the connection. Unless set explicitly, this
+	 * is the request timeout.
+	 */
+	int connectTimeout() const;
 
-	void onSocketErrorReceived(QAbstractSocket::SocketError error);
+	/// Sets the connect timeout. A value of 0 means the request timeout is used.
+	void setConnectTimeout(int t);
 
-private:
-	enum FunctionCode
+	bool autoReconnect() const
 	{
-		ReadCoils						= 1,
-		ReadDiscreteInputs				= 2,
-		ReadHoldingRegisters			= 3,
-		ReadInputRegisters				= 4,
-		WriteSingleCoil					= 5,
-		WriteSingleRegister				= 6,
-		WriteMultipleCoils				= 15,
-		WriteMultipleRegisters			= 16,
-		ReadFileRecord					= 20,
-		WriteFileRecord					= 21,
-		MaskWriteRegister				= 22,
-		ReadWriteMultipleRegisters		= 23,
-		ReadFIFOQueue					= 24,
-		EncapsulatedInterfaceTransport	= 43,
-	};
+		return mAutoReconnect;
+	}
+
+	/*!
+	 * If enabled, the connection is re-established automatically when it is lost, or when
+	 * connecting fails. Attempts are made with an increasing delay, and `disconnected` is emitted
+	 * after each failed attempt. If the connection is shared, it is enough for one of its clients
+	 * to enable this.
+	 */
+	void setAutoReconnect(bool r);
+
+	int maxInFlight() const;
+
+	/*!
+	 * Sets the maximum number of requests that may be sent to the server before the reply to the
+	 * first one has been received. According to the Modbus TCP specification, servers should be
+	 * able to handle this, but a lot of (embedded) implementations will only handle a limited
+	 * number of pipelined requests.
+	 * If the connection is shared, the largest value set by any of its clients is used.
+	 */
+	void setMaxInFlight(int n);
 
-	class Reply : public ModbusReply {
-	public:
-		Reply(quint16 transactionId, int timeout, QObject *parent = 0);
-
-		quint16 transactionId() const
-		{
-			return mTransactionId;
-		}
-
-		using ModbusReply::setResult;
-
-		bool isFinished() const override;
-
-		void timerEvent(QTimerEvent *event) override;
-
-	private:
-		void onFinished() override;
-
-		int mTimerId;
-		quint16 mTransactionId;
-	};
-
-	ModbusReply *readRegisters(FunctionCode function, quint8 unitId, quint16 startReg,
-							   quint16 count);
-
-	ModbusReply *sendFrame(const QByteArray &payload);
-
-	Reply *popReply(quint16 transactionId);
-
-	QByteArray createFrame(FunctionCode function, quint8 unitId, quint8 count);
+protected:
+	/// The estimator of the host, shared by all connections to it.
+	const RttEstimator *rttEstimator() const override;
 
-	void setFinished(quint16 transactionId, const QVector<quint16> &values);
+private slots:
+	void onSharedConnectionReady();
 
-	void setFinished(quint16 transactionId, int error);
+private:
+	// The statistics are collected by the connection.
+	friend class ModbusTcpConnection;
 
-	QHash<quint16, Reply *> mPendingReplies;
-	QAbstractSocket *mSocket;
-	int mTimeout;
-	int mConnectTimerId;
-	QByteArray mBuffer;
+	ModbusTcpConnection *mConnection;
+	int mConnectTimeout;
+	bool mAutoReconnect;
+	int mMaxInFlight;
 	QString mHostName;
 	quint16 mTcpPort;
-	quint16 mTransactionId;
 };
 
 #endif // MODBUSTCPCLIENT_H
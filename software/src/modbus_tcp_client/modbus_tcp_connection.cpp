@@ -0,0 +1,598 @@
+#include <QDebug>
+#include <QHostInfo>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QTimerEvent>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#endif
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "modbus_tcp_client.h"
+#include "modbus_tcp_connection.h"
+#include "modbus_tcp_frame.h"
+
+QHash<QString, ModbusTcpConnection *> ModbusTcpConnection::mConnections;
+QHash<QString, QHostAddress> ModbusTcpConnection::mResolvedAddresses;
+
+static int randomInt(int bound)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+	return QRandomGenerator::global()->bounded(bound);
+#else
+	return qrand() % bound;
+#endif
+}
+
+ModbusTcpConnection::ModbusTcpConnection(const QString &hostName, quint16 tcpPort):
+	QObject(),
+	mTimerWheel(new TimerWheel(this)),
+	mRttEstimator(RttEstimator::forHost(hostName)),
+	mSocket(new QTcpSocket(this)),
+	mMaxInFlight(ModbusTcpClient::DefaultMaxInFlight),
+	mInFlight(0),
+	mFlushScheduled(false),
+	mConnectTimerId(0),
+	mReconnectTimerId(0),
+	mReconnectAttempts(0),
+	mAutoReconnect(false),
+	mLookupId(-1),
+	mWasConnected(false),
+	mHostName(hostName),
+	mTcpPort(tcpPort),
+	mTransactionId(0)
+{
+	mClock.start();
+	connect(mSocket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+	connect(mSocket, SIGNAL(connected()), this, SLOT(onConnected()));
+	connect(mSocket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+	#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+	connect(mSocket, SIGNAL(error(QAbstractSocket::SocketError)),
+			this, SLOT(onSocketErrorReceived(QAbstractSocket::SocketError)));
+	#else
+	connect(mSocket, SIGNAL(errorOccurred(QAbstractSocket::SocketError)),
+			this, SLOT(onSocketErrorReceived(QAbstractSocket::SocketError)));
+	#endif
+}
+
+ModbusTcpConnection::~ModbusTcpConnection()
+{
+	if (mLookupId != -1)
+		QHostInfo::abortHostLookup(mLookupId);
+	// The replies are our children, and will be deleted after this destructor has finished. Make
+	// sure they do not call back into this (partially destroyed) object.
+	foreach (Reply *reply, mPendingReplies)
+		reply->connection = 0;
+	foreach (Reply *reply, mReplyPool)
+		reply->connection = 0;
+}
+
+ModbusTcpConnection *ModbusTcpConnection::acquire(const QString &hostName, quint16 tcpPort,
+												  ModbusTcpClient *client)
+{
+	QString k = key(hostName, tcpPort);
+	ModbusTcpConnection *connection = mConnections.value(k);
+	if (connection == 0) {
+		connection = new ModbusTcpConnection(hostName, tcpPort);
+		mConnections.insert(k, connection);
+	}
+	Q_ASSERT(!connection->mClients.contains(client));
+	connection->mClients.append(client);
+	connection->updateMaxInFlight();
+	connection->updateAutoReconnect();
+	return connection;
+}
+
+void ModbusTcpConnection::release(ModbusTcpClient *client)
+{
+	mClients.removeOne(client);
+	foreach (Reply *reply, mPendingReplies) {
+		if (reply->client == client) {
+			removeReply(reply);
+			delete reply;
+		}
+	}
+	if (!mClients.isEmpty()) {
+		updateMaxInFlight();
+		updateAutoReconnect();
+		return;
+	}
+	mConnections.remove(key(mHostName, mTcpPort));
+	// We may be called from one of our own signals.
+	deleteLater();
+}
+
+bool ModbusTcpConnection::isConnected() const
+{
+	return mSocket->state() == QTcpSocket::ConnectedState;
+}
+
+void ModbusTcpConnection::connectToServer(int timeout)
+{
+	if (mSocket->state() != QTcpSocket::UnconnectedState || mLookupId != -1)
+		return;
+	if (mReconnectTimerId != 0) {
+		killTimer(mReconnectTimerId);
+		mReconnectTimerId = 0;
+	}
+	if (mConnectTimerId != 0)
+		killTimer(mConnectTimerId);
+	mConnectTimerId = startTimer(timeout);
+	// The host name is usually an IP address, which does not have to be resolved.
+	QHostAddress address;
+	if (!address.setAddress(mHostName))
+		address = mResolvedAddresses.value(mHostName);
+	if (!address.isNull()) {
+		mSocket->connectToHost(address, mTcpPort);
+		return;
+	}
+	mLookupId = QHostInfo::lookupHost(mHostName, this, SLOT(onHostLookedUp(QHostInfo)));
+}
+
+void ModbusTcpConnection::updateAutoReconnect()
+{
+	bool autoReconnect = false;
+	foreach (ModbusTcpClient *client, mClients)
+		autoReconnect = autoReconnect || client->autoReconnect();
+	mAutoReconnect = autoReconnect;
+	if (!mAutoReconnect && mReconnectTimerId != 0) {
+		killTimer(mReconnectTimerId);
+		mReconnectTimerId = 0;
+	}
+}
+
+void ModbusTcpConnection::updateMaxInFlight()
+{
+	int n = 1;
+	foreach (ModbusTcpClient *client, mClients)
+		n = qMax(n, client->maxInFlight());
+	mMaxInFlight = n;
+	scheduleFlush();
+}
+
+ModbusReply *ModbusTcpConnection::readHoldingRegisters(ModbusTcpClient *client, int timeout,
+													   quint8 unitId, quint16 startReg,
+													   quint16 count)
+{
+	QByteArray frame = ModbusTcpFrame::readRegisters(ModbusTcpFrame::ReadHoldingRegisters, unitId,
+													 startReg, count);
+	return send(client, timeout, frame, count);
+}
+
+ModbusReply *ModbusTcpConnection::readInputRegisters(ModbusTcpClient *client, int timeout,
+													 quint8 unitId, quint16 startReg,
+													 quint16 count)
+{
+	QByteArray frame = ModbusTcpFrame::readRegisters(ModbusTcpFrame::ReadInputRegisters, unitId,
+													 startReg, count);
+	return send(client, timeout, frame, count);
+}
+
+ModbusReply *ModbusTcpConnection::writeSingleHoldingRegister(ModbusTcpClient *client, int timeout,
+															 quint8 unitId, quint16 reg,
+															 quint16 value)
+{
+	return send(client, timeout, ModbusTcpFrame::writeSingleRegister(unitId, reg, value), 1);
+}
+
+ModbusReply *ModbusTcpConnection::writeMultipleHoldingRegisters(ModbusTcpClient *client,
+																int timeout, quint8 unitId,
+																quint16 startReg,
+																const QVector<quint16> &values)
+{
+	QByteArray frame = ModbusTcpFrame::writeMultipleRegisters(unitId, startReg, values);
+	return send(client, timeout, frame, 0);
+}
+
+ModbusReply *ModbusTcpConnection::readWriteMultipleRegisters(ModbusTcpClient *client,
+															 int timeout, quint8 unitId,
+															 quint16 readStartReg,
+															 quint16 readCount,
+															 quint16 writeStartReg,
+															 const QVector<quint16> &values)
+{
+	QByteArray frame = ModbusTcpFrame::readWriteMultipleRegisters(unitId, readStartReg, readCount,
+																  writeStartReg, values);
+	return send(client, timeout, frame, readCount);
+}
+
+ModbusReply *ModbusTcpConnection::send(ModbusTcpClient *client, int timeout,
+									   const QByteArray &frame, int registerCount)
+{
+	Q_ASSERT(frame.size() >= ModbusTcpFrame::HeaderSize);
+	++mTransactionId;
+	Reply *reply = mReplyPool.isEmpty() ? new Reply(this) : mReplyPool.takeLast();
+	reply->start(client, mTransactionId, frame);
+	reply->queuedAt = mClock.elapsed();
+	// Allocate storage for the result now, so the reply can be decoded in place.
+	reply->registerBuffer().reserve(registerCount);
+	mTimerWheel->schedule(reply, timeout);
+	mPendingReplies[mTransactionId] = reply;
+	enqueue(reply);
+	scheduleFlush();
+	return reply;
+}
+
+void ModbusTcpConnection::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == mReconnectTimerId) {
+		killTimer(mReconnectTimerId);
+		mReconnectTimerId = 0;
+		// Leave the socket in a clean state, in case it has not completely shut down after losing
+		// the previous connection.
+		if (mSocket->state() != QTcpSocket::UnconnectedState)
+			mSocket->abort();
+		connectToServer(connectTimeout());
+		return;
+	}
+	Q_ASSERT(event->timerId() == mConnectTimerId);
+	if (mConnectTimerId == 0)
+		return;
+	killTimer(mConnectTimerId);
+	mConnectTimerId = 0;
+	if (mLookupId != -1) {
+		QHostInfo::abortHostLookup(mLookupId);
+		mLookupId = -1;
+	}
+	// The host may have been given a new address.
+	mResolvedAddresses.remove(mHostName);
+	mSocket->disconnectFromHost();
+	scheduleReconnect();
+	emit disconnected();
+}
+
+void ModbusTcpConnection::onConnected()
+{
+	if (mConnectTimerId > 0) {
+		killTimer(mConnectTimerId);
+		mConnectTimerId = 0;
+	}
+	mReconnectAttempts = 0;
+	// Leftovers of a frame from the previous connection must not be taken for the start of the new
+	// stream.
+	mBuffer.clear();
+	setKeepAliveOptions();
+	if (mWasConnected) {
+		foreach (ModbusTcpClient *client, mClients)
+			client->mStatistics.addReconnect();
+	}
+	mWasConnected = true;
+	// Requests created while we were not connected have been waiting in the queue.
+	scheduleFlush();
+	emit connected();
+}
+
+void ModbusTcpConnection::onDisconnected()
+{
+	mBuffer.clear();
+	scheduleReconnect();
+	emit disconnected();
+}
+
+void ModbusTcpConnection::onHostLookedUp(const QHostInfo &info)
+{
+	if (info.lookupId() != mLookupId)
+		return;
+	mLookupId = -1;
+	if (info.error() != QHostInfo::NoError || info.addresses().isEmpty()) {
+		onSocketErrorReceived(QAbstractSocket::HostNotFoundError);
+		return;
+	}
+	QHostAddress address = info.addresses().first();
+	foreach (const QHostAddress &a, info.addresses()) {
+		if (a.protocol() == QAbstractSocket::IPv4Protocol) {
+			address = a;
+			break;
+		}
+	}
+	mResolvedAddresses.insert(mHostName, address);
+	mSocket->connectToHost(address, mTcpPort);
+}
+
+void ModbusTcpConnection::onReadyRead()
+{
+	mBuffer.readFrom(mSocket);
+	for (;;) {
+		// MBAP header: transaction ID, protocol ID, length (including unit ID).
+		if (mBuffer.size() < 6)
+			return;
+		int length = mBuffer.peekUInt16(4);
+		if (mBuffer.peekUInt16(2) != 0 || length < 2 || length > MaxFrameLength) {
+			// Not Modbus TCP, or we lost track of the frame boundaries. Handle it like a lost
+			// connection: the pending requests fail, and we reconnect to get back in sync.
+			qWarning() << "Invalid Modbus TCP frame received from" << mHostName;
+			onSocketErrorReceived(QAbstractSocket::UnknownSocketError);
+			mSocket->abort();
+			return;
+		}
+		length += 6;
+		if (mBuffer.size() < length)
+			return;
+		quint16 transactionId = mBuffer.peekUInt16(0);
+		Reply *reply = popReply(transactionId);
+		if (reply != 0) {
+			mRttEstimator->addSample(mClock.elapsed() - reply->sentAt);
+			reply->client->mStatistics.addBytesReceived(length);
+			decodeReply(reply, length);
+		}
+		mBuffer.skip(length);
+	}
+}
+
+void ModbusTcpConnection::onSocketErrorReceived(QAbstractSocket::SocketError error)
+{
+	Q_UNUSED(error)
+	if (mConnectTimerId != 0) {
+		// Connecting failed
+		killTimer(mConnectTimerId);
+		mConnectTimerId = 0;
+		mResolvedAddresses.remove(mHostName);
+	}
+	// The connection may have dropped in the middle of a frame.
+	mBuffer.clear();
+	QHash<quint16, Reply *> replies = mPendingReplies;
+	mPendingReplies.clear();
+	mQueue.clear();
+	mInFlight = 0;
+	foreach (Reply *reply, replies) {
+		if (!reply->sent)
+			reply->client->mStatistics.removeQueued();
+		reply->connection = 0;
+		reply->setResult(ModbusReply::TcpError);
+	}
+	scheduleReconnect();
+	emit disconnected();
+}
+
+void ModbusTcpConnection::flush()
+{
+	mFlushScheduled = false;
+	if (!isConnected())
+		return;
+	// Write all frames that fit in the window in a single call, so they will usually end up in a
+	// single TCP segment.
+	QByteArray frames;
+	frames.reserve(mMaxInFlight * 16);
+	qint64 now = mClock.elapsed();
+	while (mInFlight < mMaxInFlight && !mQueue.isEmpty()) {
+		Reply *reply = mQueue.dequeue();
+		reply->client->mStatistics.removeQueued();
+		// The frame may be shared with other requests (see ModbusClient::PreparedRequest), so
+		// the transaction ID is filled in here, rather than in the frame itself.
+		int offset = frames.size();
+		frames.append(reply->frame);
+		ModbusTcpFrame::setTransactionId(frames.data() + offset, reply->transactionId());
+		reply->client->mStatistics.addBytesSent(reply->frame.size());
+		reply->frame.clear();
+		reply->sent = true;
+		reply->sentAt = now;
+		++mInFlight;
+	}
+	if (!frames.isEmpty())
+		mSocket->write(frames);
+}
+
+void ModbusTcpConnection::scheduleFlush()
+{
+	if (mFlushScheduled || mQueue.isEmpty())
+		return;
+	mFlushScheduled = true;
+	QTimer::singleShot(0, this, SLOT(flush()));
+}
+
+void ModbusTcpConnection::enqueue(Reply *reply)
+{
+	bool write = false;
+	switch (static_cast<quint8>(reply->frame[7])) {
+	case ModbusTcpFrame::WriteSingleRegister:
+	case ModbusTcpFrame::WriteMultipleRegisters:
+	case ModbusTcpFrame::ReadWriteMultipleRegisters:
+		write = true;
+		break;
+	}
+	mQueue.enqueue(reply, reply->client->requestPriority(write));
+	reply->client->mStatistics.addQueued();
+}
+
+ModbusTcpConnection::Reply *ModbusTcpConnection::popReply(quint16 transactionId)
+{
+	Reply *reply = mPendingReplies.value(transactionId);
+	// A late reply to a request that has timed out may arrive after the transaction ID has been
+	// reused for a request that is still in the queue.
+	if (reply == 0 || !reply->sent)
+		return 0;
+	removeReply(reply);
+	return reply;
+}
+
+void ModbusTcpConnection::removeReply(Reply *reply)
+{
+	Q_ASSERT(reply->connection == this);
+	mPendingReplies.remove(reply->transactionId());
+	reply->connection = 0;
+	if (reply->sent) {
+		// Free a slot in the in-flight window
+		--mInFlight;
+		scheduleFlush();
+	} else if (mQueue.removeOne(reply)) {
+		reply->client->mStatistics.removeQueued();
+	}
+}
+
+void ModbusTcpConnection::recycleReply(Reply *reply)
+{
+	if (mReplyPool.size() >= MaxPoolSize) {
+		reply->deleteLater();
+		return;
+	}
+	reply->reset();
+	reply->connection = this;
+	reply->client = 0;
+	reply->pooled = true;
+	mReplyPool.append(reply);
+}
+
+void ModbusTcpConnection::decodeReply(Reply *reply, int length)
+{
+	// The frame starts at the read cursor of mBuffer. Byte 6 is the unit ID.
+	if (length < 9) {
+		reply->setResult(ModbusReply::ParseError);
+		return;
+	}
+	quint8 functionCode = mBuffer.peek(7);
+	if ((functionCode & 0x80) != 0) {
+		reply->setResult(static_cast<ModbusReply::ExceptionCode>(mBuffer.peek(8)));
+		return;
+	}
+	switch (functionCode) {
+	case ModbusTcpFrame::ReadHoldingRegisters:
+	case ModbusTcpFrame::ReadInputRegisters:
+	case ModbusTcpFrame::ReadWriteMultipleRegisters:
+	{
+		int payloadSize = mBuffer.peek(8);
+		if (9 + payloadSize != length || (payloadSize & 1) != 0)
+			break;
+		QVector<quint16> &values = reply->registerBuffer();
+		values.resize(payloadSize / 2);
+		mBuffer.peekRegisters(9, values.data(), values.size());
+		reply->setResult(ModbusReply::NoException);
+		return;
+	}
+	case ModbusTcpFrame::WriteSingleRegister:
+	{
+		if (length < 12)
+			break;
+		// quint16 startReg = mBuffer.peekUInt16(8);
+		QVector<quint16> &values = reply->registerBuffer();
+		values.resize(1);
+		values[0] = mBuffer.peekUInt16(10);
+		reply->setResult(ModbusReply::NoException);
+		return;
+	}
+	case ModbusTcpFrame::WriteMultipleRegisters:
+		if (length != 12)
+			break;
+		// quint16 startReg = mBuffer.peekUInt16(8);
+		// quint16 regCount = mBuffer.peekUInt16(10);
+		reply->setResult(ModbusReply::NoException);
+		return;
+	}
+	reply->setResult(ModbusReply::ParseError);
+}
+
+QString ModbusTcpConnection::key(const QString &hostName, quint16 tcpPort)
+{
+	return QString("%1:%2").arg(hostName).arg(tcpPort);
+}
+
+
+int ModbusTcpConnection::connectTimeout() const
+{
+	int timeout = 0;
+	foreach (ModbusTcpClient *client, mClients)
+		timeout = qMax(timeout, client->connectTimeout());
+	return timeout;
+}
+
+void ModbusTcpConnection::scheduleReconnect()
+{
+	if (!mAutoReconnect || mReconnectTimerId != 0 || mConnectTimerId != 0 || mLookupId != -1)
+		return;
+	int delay = qMin(MaxReconnectDelay, MinReconnectDelay << qMin(mReconnectAttempts, 16));
+	// Pick a delay between half and the full value.
+	delay = delay / 2 + randomInt(delay / 2 + 1);
+	++mReconnectAttempts;
+	mReconnectTimerId = startTimer(delay);
+}
+
+void ModbusTcpConnection::setKeepAliveOptions()
+{
+	mSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+	mSocket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+	// Qt has no API for the keepalive timing. The defaults of the OS (2 hours before the first
+	// probe) are too long for our purpose.
+#ifdef TCP_KEEPIDLE
+	int fd = static_cast<int>(mSocket->socketDescriptor());
+	if (fd < 0)
+		return;
+	int idle = KeepAliveIdle;
+	int interval = KeepAliveInterval;
+	int count = KeepAliveCount;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#endif
+}
+
+ModbusTcpConnection::Reply::Reply(ModbusTcpConnection *connection):
+	ModbusReply(connection),
+	connection(connection),
+	client(0),
+	sent(false),
+	queuedAt(0),
+	sentAt(0),
+	pooled(false),
+	mTransactionId(0),
+	mFinished(false)
+{
+}
+
+ModbusTcpConnection::Reply::~Reply()
+{
+	if (connection == 0)
+		return;
+	if (pooled)
+		connection->mReplyPool.removeOne(this);
+	else
+		connection->removeReply(this); // Deleted by the user before the request was finished.
+}
+
+void ModbusTcpConnection::Reply::start(ModbusTcpClient *client, quint16 transactionId,
+									   const QByteArray &frame)
+{
+	Q_ASSERT(connection != 0);
+	this->client = client;
+	this->frame = frame;
+	sent = false;
+	pooled = false;
+	mTransactionId = transactionId;
+	mFinished = false;
+}
+
+bool ModbusTcpConnection::Reply::isFinished() const
+{
+	return mFinished;
+}
+
+void ModbusTcpConnection::Reply::onFinished()
+{
+	Q_ASSERT(!mFinished);
+	mFinished = true;
+	TimerWheel::cancel(this);
+	if (client == 0)
+		return;
+	// We are always a child of the connection that created us, even if `connection` has been
+	// reset.
+	qint64 now = static_cast<ModbusTcpConnection *>(parent())->mClock.elapsed();
+	qint64 queueTime = (sent ? sentAt : now) - queuedAt;
+	client->mStatistics.addReply(queueTime, sent ? now - sentAt : -1, error());
+}
+
+void ModbusTcpConnection::Reply::onHandled()
+{
+	// We are always a child of the connection that created us.
+	static_cast<ModbusTcpConnection *>(parent())->recycleReply(this);
+}
+
+void ModbusTcpConnection::Reply::onTimeout()
+{
+	// Requests which have not been sent yet (because we are not connected) say nothing about the
+	// round trip time.
+	if (sent)
+		static_cast<ModbusTcpConnection *>(parent())->mRttEstimator->backOff();
+	// Assume the request (or its reply) got lost, so it no longer occupies a slot in the window.
+	if (connection != 0)
+		connection->removeReply(this);
+	setResult(Timeout);
+}
@@ -0,0 +1,285 @@
+#ifndef MODBUS_TCP_CONNECTION_H
+#define MODBUS_TCP_CONNECTION_H
+
+#include <QAbstractSocket>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QObject>
+#include "modbus_frame_buffer.h"
+#include "modbus_reply.h"
+#include "modbus_request_queue.h"
+#include "rtt_estimator.h"
+#include "timer_wheel.h"
+
+class ModbusTcpClient;
+class QHostInfo;
+
+/*!
+ * A Modbus TCP connection, shared by all `ModbusTcpClient` objects talking to the same server.
+ *
+ * A data manager or a SolarEdge inverter may act as gateway for several inverters (with different
+ * unit IDs). Some of them allow only a few simultaneous TCP connections. Therefore, all clients
+ * for the same host and port use a single connection, which is created when the first client
+ * connects, and destroyed when the last one is gone. The unit ID is part of each request, and
+ * replies are routed using the transaction ID, so the clients do not interfere with each other.
+ *
+ * Requests are not written to the socket immediately. Instead they are queued and sent in a single
+ * write at the end of the current event loop iteration. The number of requests that may be
+ * outstanding on the connection (the in-flight window) is limited by `maxInFlight`. Requests that
+ * do not fit in the window remain queued until a reply is received, or a request times out. The
+ * queue is ordered by priority (see `ModbusRequestQueue`), so writes of one client are not held
+ * up by the polls of the others.
+ *
+ * The timeouts of all requests are handled by a single timer wheel. Replies to requests sent using
+ * the handler API (see `ModbusClient`) are reused for new requests, so polling at a steady rate
+ * does not cause any QObject allocations.
+ *
+ * The connection records the latency, result and size of each request in the statistics of the
+ * client that sent it (see `ModbusStatistics`). Round trip times and timeouts are also fed to the
+ * `RttEstimator` of the host, which clients may use to set their timeouts.
+ *
+ * If one of the clients asks for it, a lost connection is re-established automatically, with an
+ * exponential back off between the attempts. The back off is randomized, so inverters that lost
+ * their connection at the same time (eg. because the Wi-Fi dropped) do not reconnect in lockstep.
+ * TCP keepalive is enabled on the socket, so a server that disappears without closing the
+ * connection (a half-open connection) is noticed even when no requests are pending.
+ */
+class ModbusTcpConnection : public QObject
+{
+	Q_OBJECT
+public:
+	/*!
+	 * Returns the connection to the given server, and registers `client` as one of its users.
+	 * Creates the connection if it does not exist yet.
+	 */
+	static ModbusTcpConnection *acquire(const QString &hostName, quint16 tcpPort,
+										ModbusTcpClient *client);
+
+	/*!
+	 * Unregisters `client`. Its pending requests are cancelled (the replies are deleted). The
+	 * connection is closed when the last client has been released.
+	 */
+	void release(ModbusTcpClient *client);
+
+	QString hostName() const
+	{
+		return mHostName;
+	}
+
+	quint16 tcpPort() const
+	{
+		return mTcpPort;
+	}
+
+	bool isConnected() const;
+
+	const RttEstimator *rttEstimator() const
+	{
+		return mRttEstimator;
+	}
+
+	/*!
+	 * Starts connecting to the server, unless the connection has been established already, or is
+	 * being established.
+	 * The host name is resolved only once. The address is cached and used for all connections to
+	 * the host, until connecting to it fails.
+	 * @param timeout Time (in ms) allowed for resolving the host name and setting up the
+	 * connection.
+	 */
+	void connectToServer(int timeout);
+
+	/// Enables automatic reconnects if at least one of the clients asks for it.
+	void updateAutoReconnect();
+
+	int maxInFlight() const
+	{
+		return mMaxInFlight;
+	}
+
+	/*!
+	 * Recomputes the size of the in-flight window from the settings of the clients. We use the
+	 * largest value: a client asking for a larger window knows the server can handle pipelined
+	 * requests, while the others just use the (safe) default.
+	 */
+	void updateMaxInFlight();
+
+	ModbusReply *readHoldingRegisters(ModbusTcpClient *client, int timeout, quint8 unitId,
+									  quint16 startReg, quint16 count);
+
+	ModbusReply *readInputRegisters(ModbusTcpClient *client, int timeout, quint8 unitId,
+									quint16 startReg, quint16 count);
+
+	ModbusReply *writeSingleHoldingRegister(ModbusTcpClient *client, int timeout, quint8 unitId,
+											quint16 reg, quint16 value);
+
+	ModbusReply *writeMultipleHoldingRegisters(ModbusTcpClient *client, int timeout,
+											   quint8 unitId, quint16 startReg,
+											   const QVector<quint16> &values);
+
+	ModbusReply *readWriteMultipleRegisters(ModbusTcpClient *client, int timeout, quint8 unitId,
+											quint16 readStartReg, quint16 readCount,
+											quint16 writeStartReg,
+											const QVector<quint16> &values);
+
+	/*!
+	 * Sends a request frame created by `ModbusTcpFrame`. The frame is not modified, so it may be
+	 * sent repeatedly.
+	 * @param registerCount Number of registers expected in the reply
+	 */
+	ModbusReply *send(ModbusTcpClient *client, int timeout, const QByteArray &frame,
+					  int registerCount);
+
+signals:
+	void connected();
+
+	void disconnected();
+
+protected:
+	void timerEvent(QTimerEvent *event) override;
+
+private slots:
+	void onConnected();
+
+	void onDisconnected();
+
+	void onHostLookedUp(const QHostInfo &info);
+
+	void onReadyRead();
+
+	void onSocketErrorReceived(QAbstractSocket::SocketError error);
+
+	void flush();
+
+private:
+	// Maximum number of finished replies kept for reuse
+	static const int MaxPoolSize = 16;
+	// Maximum value of the length field in the MBAP header (unit ID + PDU)
+	static const int MaxFrameLength = 254;
+	// Range of the delay (ms) between reconnect attempts
+	static const int MinReconnectDelay = 500;
+	static const int MaxReconnectDelay = 30000;
+	// TCP keepalive: the first probe is sent after KeepAliveIdle seconds without traffic, and then
+	// every KeepAliveInterval seconds. The connection is closed after KeepAliveCount unanswered
+	// probes.
+	static const int KeepAliveIdle = 10;
+	static const int KeepAliveInterval = 5;
+	static const int KeepAliveCount = 3;
+
+	class Reply : public ModbusReply, public TimerWheel::Entry {
+	public:
+		explicit Reply(ModbusTcpConnection *connection);
+
+		~Reply();
+
+		/// Prepares the reply for a new request.
+		void start(ModbusTcpClient *client, quint16 transactionId, const QByteArray &frame);
+
+		quint16 transactionId() const
+		{
+			return mTransactionId;
+		}
+
+		using ModbusReply::setResult;
+
+		using ModbusReply::registerBuffer;
+
+		using ModbusReply::reset;
+
+		bool isFinished() const override;
+
+		/*!
+		 * The connection this reply belongs to. Set while the request is pending, or the reply is
+		 * in the pool. Reset when the connection is destroyed first.
+		 */
+		ModbusTcpConnection *connection;
+		/// The client that sent the request.
+		ModbusTcpClient *client;
+		/*!
+		 * The request frame, with a zero transaction ID. Cleared when the frame has been written
+		 * to the socket.
+		 */
+		QByteArray frame;
+		/// True if the frame has been written to the socket.
+		bool sent;
+		/// Time (see `ModbusTcpConnection::mClock`) the request was created.
+		qint64 queuedAt;
+		/// Time the frame was written to the socket, only valid if `sent` is true.
+		qint64 sentAt;
+		/// True if the reply is in the pool of the connection.
+		bool pooled;
+
+	private:
+		void onFinished() override;
+
+		void onHandled() override;
+
+		void onTimeout() override;
+
+		quint16 mTransactionId;
+		bool mFinished;
+	};
+
+	ModbusTcpConnection(const QString &hostName, quint16 tcpPort);
+
+	~ModbusTcpConnection();
+
+	static QString key(const QString &hostName, quint16 tcpPort);
+
+	/// Returns the largest connect timeout of the clients.
+	int connectTimeout() const;
+
+	void scheduleReconnect();
+
+	void setKeepAliveOptions();
+
+	void scheduleFlush();
+
+	/// Adds `reply` to mQueue, using the priority of its request.
+	void enqueue(Reply *reply);
+
+	Reply *popReply(quint16 transactionId);
+
+	void removeReply(Reply *reply);
+
+	void recycleReply(Reply *reply);
+
+	void decodeReply(Reply *reply, int length);
+
+	// All connections, by host:port.
+	static QHash<QString, ModbusTcpConnection *> mConnections;
+	// Resolved addresses, by host name.
+	static QHash<QString, QHostAddress> mResolvedAddresses;
+
+	QList<ModbusTcpClient *> mClients;
+	// All unfinished requests: both the queued ones and those sent to the server.
+	QHash<quint16, Reply *> mPendingReplies;
+	// Requests waiting for room in the in-flight window.
+	ModbusRequestQueue<Reply *> mQueue;
+	// Finished replies which may be reused
+	QList<Reply *> mReplyPool;
+	TimerWheel *mTimerWheel;
+	RttEstimator *mRttEstimator;
+	// Time base for the request statistics
+	QElapsedTimer mClock;
+	QAbstractSocket *mSocket;
+	int mMaxInFlight;
+	int mInFlight;
+	bool mFlushScheduled;
+	int mConnectTimerId;
+	int mReconnectTimerId;
+	// Number of reconnect attempts since the connection was lost. Determines the back off.
+	int mReconnectAttempts;
+	bool mAutoReconnect;
+	// ID of the pending host name lookup, or -1.
+	int mLookupId;
+	// True if the connection has been established before, so the next one is a reconnect.
+	bool mWasConnected;
+	ModbusFrameBuffer mBuffer;
+	QString mHostName;
+	quint16 mTcpPort;
+	quint16 mTransactionId;
+};
+
+#endif // MODBUS_TCP_CONNECTION_H
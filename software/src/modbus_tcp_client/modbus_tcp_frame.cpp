@@ -0,0 +1,98 @@
+#include "modbus_tcp_frame.h"
+
+QByteArray ModbusTcpFrame::readRegisters(FunctionCode function, quint8 unitId, quint16 startReg,
+										 quint16 count)
+{
+	QByteArray frame = create(function, unitId, 4);
+	char *p = frame.data() + HeaderSize;
+	putUInt16(p, startReg);
+	putUInt16(p + 2, count);
+	return frame;
+}
+
+QByteArray ModbusTcpFrame::writeSingleRegister(quint8 unitId, quint16 reg, quint16 value)
+{
+	QByteArray frame = create(WriteSingleRegister, unitId, 4);
+	char *p = frame.data() + HeaderSize;
+	putUInt16(p, reg);
+	putUInt16(p + 2, value);
+	return frame;
+}
+
+QByteArray ModbusTcpFrame::writeMultipleRegisters(quint8 unitId, quint16 startReg,
+												  const QVector<quint16> &values)
+{
+	QByteArray frame = create(WriteMultipleRegisters, unitId, 5 + 2 * values.size());
+	char *p = frame.data() + HeaderSize;
+	putUInt16(p, startReg);
+	putUInt16(p + 2, static_cast<quint16>(values.size()));
+	p[4] = static_cast<char>(values.size() * 2);
+	p += 5;
+	foreach (quint16 value, values) {
+		putUInt16(p, value);
+		p += 2;
+	}
+	return frame;
+}
+
+QByteArray ModbusTcpFrame::readWriteMultipleRegisters(quint8 unitId, quint16 readStartReg,
+													  quint16 readCount, quint16 writeStartReg,
+													  const QVector<quint16> &values)
+{
+	QByteArray frame = create(ReadWriteMultipleRegisters, unitId, 9 + 2 * values.size());
+	char *p = frame.data() + HeaderSize;
+	putUInt16(p, readStartReg);
+	putUInt16(p + 2, readCount);
+	putUInt16(p + 4, writeStartReg);
+	putUInt16(p + 6, static_cast<quint16>(values.size()));
+	p[8] = static_cast<char>(values.size() * 2);
+	p += 9;
+	foreach (quint16 value, values) {
+		putUInt16(p, value);
+		p += 2;
+	}
+	return frame;
+}
+
+QByteArray ModbusTcpFrame::readRegistersResponse(FunctionCode function, quint8 unitId,
+												 const quint16 *values, int count)
+{
+	Q_ASSERT(count >= 0 && count <= 125);
+	QByteArray frame = create(function, unitId, 1 + 2 * count);
+	char *p = frame.data() + HeaderSize;
+	p[0] = static_cast<char>(2 * count);
+	p += 1;
+	for (int i = 0; i < count; ++i, p += 2)
+		putUInt16(p, values[i]);
+	return frame;
+}
+
+QByteArray ModbusTcpFrame::writeRegistersResponse(FunctionCode function, quint8 unitId,
+												  quint16 reg, quint16 valueOrCount)
+{
+	QByteArray frame = create(function, unitId, 4);
+	char *p = frame.data() + HeaderSize;
+	putUInt16(p, reg);
+	putUInt16(p + 2, valueOrCount);
+	return frame;
+}
+
+QByteArray ModbusTcpFrame::exceptionResponse(quint8 function, quint8 unitId,
+											 ModbusReply::ExceptionCode error)
+{
+	QByteArray frame = create(static_cast<quint8>(function | 0x80), unitId, 1);
+	frame[HeaderSize] = static_cast<char>(error);
+	return frame;
+}
+
+QByteArray ModbusTcpFrame::create(quint8 function, quint8 unitId, int dataSize)
+{
+	QByteArray frame(HeaderSize + dataSize, 0);
+	char *p = frame.data();
+	// Transaction ID (bytes 0-1) and protocol ID (2-3) are left zero.
+	// The length includes unit ID and function code.
+	putUInt16(p + 4, static_cast<quint16>(dataSize + 2));
+	p[6] = static_cast<char>(unitId);
+	p[7] = static_cast<char>(function);
+	return frame;
+}
@@ -0,0 +1,86 @@
+#ifndef MODBUS_TCP_FRAME_H
+#define MODBUS_TCP_FRAME_H
+
+#include <QByteArray>
+#include <QVector>
+#include "modbus_reply.h"
+
+/*!
+ * Encoding of Modbus TCP frames: requests for the client, and responses for the server.
+ *
+ * The frames are created with a zero transaction ID. The transaction ID is filled in (using
+ * `setTransactionId`) when the frame is written to the socket. This way a frame may be encoded
+ * once and sent many times.
+ */
+class ModbusTcpFrame
+{
+public:
+	enum FunctionCode
+	{
+		ReadCoils						= 1,
+		ReadDiscreteInputs				= 2,
+		ReadHoldingRegisters			= 3,
+		ReadInputRegisters				= 4,
+		WriteSingleCoil					= 5,
+		WriteSingleRegister				= 6,
+		WriteMultipleCoils				= 15,
+		WriteMultipleRegisters			= 16,
+		ReadFileRecord					= 20,
+		WriteFileRecord					= 21,
+		MaskWriteRegister				= 22,
+		ReadWriteMultipleRegisters		= 23,
+		ReadFIFOQueue					= 24,
+		EncapsulatedInterfaceTransport	= 43,
+	};
+
+	/// Size of the MBAP header and the function code.
+	static const int HeaderSize = 8;
+
+	static QByteArray readRegisters(FunctionCode function, quint8 unitId, quint16 startReg,
+									quint16 count);
+
+	static QByteArray writeSingleRegister(quint8 unitId, quint16 reg, quint16 value);
+
+	static QByteArray writeMultipleRegisters(quint8 unitId, quint16 startReg,
+											 const QVector<quint16> &values);
+
+	static QByteArray readWriteMultipleRegisters(quint8 unitId, quint16 readStartReg,
+												 quint16 readCount, quint16 writeStartReg,
+												 const QVector<quint16> &values);
+
+	/*!
+	 * Creates the response to a read request (function 3, 4 or 23).
+	 * @param values The register values, `count` elements.
+	 */
+	static QByteArray readRegistersResponse(FunctionCode function, quint8 unitId,
+											const quint16 *values, int count);
+
+	/*!
+	 * Creates the response to a write request (function 6 or 16), which echoes the first 4 bytes
+	 * of the request: the register address and the value (function 6) or count (function 16).
+	 */
+	static QByteArray writeRegistersResponse(FunctionCode function, quint8 unitId, quint16 reg,
+											 quint16 valueOrCount);
+
+	/// Creates an exception response to a request with the given function code.
+	static QByteArray exceptionResponse(quint8 function, quint8 unitId,
+										ModbusReply::ExceptionCode error);
+
+	static void setTransactionId(char *frame, quint16 transactionId)
+	{
+		frame[0] = static_cast<char>(transactionId >> 8);
+		frame[1] = static_cast<char>(transactionId & 0xFF);
+	}
+
+private:
+	/// Creates a frame with room for `dataSize` bytes after the function code.
+	static QByteArray create(quint8 function, quint8 unitId, int dataSize);
+
+	static void putUInt16(char *p, quint16 value)
+	{
+		p[0] = static_cast<char>(value >> 8);
+		p[1] = static_cast<char>(value & 0xFF);
+	}
+};
+
+#endif // MODBUS_TCP_FRAME_H
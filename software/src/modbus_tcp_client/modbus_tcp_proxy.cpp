@@ -0,0 +1,301 @@
+#include <QTcpSocket>
+#include "modbus_tcp_client.h"
+#include "modbus_tcp_frame.h"
+#include "modbus_tcp_proxy.h"
+
+ModbusTcpProxy::ModbusTcpProxy(const TargetResolver &resolver, QObject *parent):
+	ModbusTcpServer(0, parent),
+	mResolver(resolver),
+	mLastWriteId(0),
+	mCacheTime(DefaultCacheTime)
+{
+	mClock.start();
+}
+
+void ModbusTcpProxy::setCacheTime(int t)
+{
+	mCacheTime = qMax(0, t);
+	if (mCacheTime == 0)
+		mCache.clear();
+}
+
+void ModbusTcpProxy::handleRequest(QTcpSocket *socket, const ModbusFrameBuffer &buffer,
+								   int length)
+{
+	Requester requester;
+	requester.socket = socket;
+	requester.transactionId = buffer.peekUInt16(0);
+	quint8 unitId = buffer.peek(6);
+	quint8 function = buffer.peek(7);
+	Target target;
+	if (!mResolver || !mResolver(unitId, &target)) {
+		respond(requester, ModbusTcpFrame::exceptionResponse(function, unitId,
+															 ModbusReply::GatewayPathUnavailable));
+		return;
+	}
+	switch (function) {
+	case ModbusTcpFrame::ReadHoldingRegisters:
+	case ModbusTcpFrame::ReadInputRegisters:
+		handleRead(requester, target, buffer, length);
+		break;
+	case ModbusTcpFrame::WriteSingleRegister:
+	case ModbusTcpFrame::WriteMultipleRegisters:
+	case ModbusTcpFrame::ReadWriteMultipleRegisters:
+		handleWrite(requester, target, buffer, length);
+		break;
+	default:
+		respond(requester, ModbusTcpFrame::exceptionResponse(function, unitId,
+															 ModbusReply::IllegalFunction));
+		break;
+	}
+}
+
+void ModbusTcpProxy::onClientDisconnected()
+{
+	ModbusTcpClient *client = static_cast<ModbusTcpClient *>(sender());
+	mClients.remove(QString("%1:%2").arg(client->hostName()).arg(client->portName()));
+	// When the connection fails, the handlers of the pending requests are called with TcpError, so
+	// the proxy clients get a Gateway Path Unavailable exception. Requests which are still pending
+	// (because the connection was closed without an error) are answered the same way, as their
+	// handlers will not be called once the client is gone.
+	QList<quint64> keys;
+	for (QHash<quint64, PendingRead>::const_iterator it = mPendingReads.constBegin();
+		 it != mPendingReads.constEnd(); ++it) {
+		if (it->client == client)
+			keys.append(it.key());
+	}
+	foreach (quint64 key, keys) {
+		QByteArray response = ModbusTcpFrame::exceptionResponse(
+					static_cast<quint8>(key >> 32), unitIdOfKey(key),
+					ModbusReply::GatewayPathUnavailable);
+		foreach (const Requester &requester, mPendingReads.take(key).requesters)
+			respond(requester, response);
+	}
+	for (QHash<quint32, PendingWrite>::iterator it = mPendingWrites.begin();
+		 it != mPendingWrites.end();) {
+		if (it->client == client) {
+			respond(it->requester, ModbusTcpFrame::exceptionResponse(
+						it->function, it->unitId, ModbusReply::GatewayPathUnavailable));
+			it = mPendingWrites.erase(it);
+		} else {
+			++it;
+		}
+	}
+	client->deleteLater();
+}
+
+ModbusReply::ExceptionCode ModbusTcpProxy::toException(ModbusReply::ExceptionCode error)
+{
+	switch (error) {
+	case ModbusReply::UnsupportedFunction:
+		return ModbusReply::IllegalFunction;
+	case ModbusReply::TcpError:
+		return ModbusReply::GatewayPathUnavailable;
+	case ModbusReply::CrcError:
+	case ModbusReply::ParseError:
+	case ModbusReply::Timeout:
+		return ModbusReply::GatewayTargetDeviceFailedToRespond;
+	default:
+		// Exceptions sent by the device are passed on.
+		return error;
+	}
+}
+
+ModbusTcpClient *ModbusTcpProxy::client(const Target &target)
+{
+	ModbusTcpClient *&client = mClients[QString("%1:%2").arg(target.hostName).arg(target.tcpPort)];
+	if (client == 0) {
+		client = new ModbusTcpClient(this);
+		client->setPriority(ModbusClient::BackgroundPriority);
+		client->setAdaptiveTimeout(MinTimeout, MaxTimeout);
+		connect(client, SIGNAL(disconnected()), this, SLOT(onClientDisconnected()));
+		client->connectToServer(target.hostName, target.tcpPort);
+	}
+	return client;
+}
+
+void ModbusTcpProxy::handleRead(const Requester &requester, const Target &target,
+								const ModbusFrameBuffer &buffer, int length)
+{
+	quint8 unitId = buffer.peek(6);
+	quint8 function = buffer.peek(7);
+	quint16 startReg = buffer.peekUInt16(8);
+	quint16 count = buffer.peekUInt16(10);
+	if (length != ModbusTcpFrame::HeaderSize + 4 || count < 1 ||
+		count > ModbusClient::MaxReadCount) {
+		respond(requester, ModbusTcpFrame::exceptionResponse(function, unitId,
+															 ModbusReply::IllegalDataValue));
+		return;
+	}
+	quint64 key = readKey(unitId, function, startReg, count);
+	QHash<quint64, CacheEntry>::const_iterator c = mCache.find(key);
+	if (c != mCache.end() && mClock.elapsed() - c->time <= mCacheTime) {
+		respond(requester, ModbusTcpFrame::readRegistersResponse(
+					static_cast<ModbusTcpFrame::FunctionCode>(function), unitId,
+					c->registers.constData(), c->registers.size()));
+		return;
+	}
+	QHash<quint64, PendingRead>::iterator p = mPendingReads.find(key);
+	if (p != mPendingReads.end()) {
+		p->requesters.append(requester);
+		return;
+	}
+	PendingRead &pending = mPendingReads[key];
+	pending.client = client(target);
+	pending.requesters.append(requester);
+	ModbusReply::Handler handler = [this, key](ModbusReply *reply) {
+		onReadCompleted(key, reply);
+	};
+	if (function == ModbusTcpFrame::ReadHoldingRegisters)
+		pending.client->readHoldingRegisters(target.unitId, startReg, count, handler);
+	else
+		pending.client->readInputRegisters(target.unitId, startReg, count, handler);
+}
+
+void ModbusTcpProxy::handleWrite(const Requester &requester, const Target &target,
+								 const ModbusFrameBuffer &buffer, int length)
+{
+	quint8 unitId = buffer.peek(6);
+	quint8 function = buffer.peek(7);
+	int dataSize = length - ModbusTcpFrame::HeaderSize;
+	if (dataSize < 4) {
+		respond(requester, ModbusTcpFrame::exceptionResponse(function, unitId,
+															 ModbusReply::IllegalDataValue));
+		return;
+	}
+	quint16 reg = buffer.peekUInt16(8);
+	quint16 valueOrCount = buffer.peekUInt16(10);
+	bool valid = false;
+	QVector<quint16> values;
+	switch (function) {
+	case ModbusTcpFrame::WriteSingleRegister:
+		valid = dataSize == 4;
+		break;
+	case ModbusTcpFrame::WriteMultipleRegisters:
+		valid = dataSize >= 5 && valueOrCount >= 1 && valueOrCount <= 123 &&
+			buffer.peek(12) == 2 * valueOrCount && dataSize == 5 + 2 * valueOrCount;
+		if (valid) {
+			values.resize(valueOrCount);
+			buffer.peekRegisters(13, values.data(), valueOrCount);
+		}
+		break;
+	case ModbusTcpFrame::ReadWriteMultipleRegisters:
+	{
+		quint16 writeCount = dataSize >= 9 ? buffer.peekUInt16(14) : 0;
+		valid = valueOrCount >= 1 && valueOrCount <= ModbusClient::MaxReadCount &&
+			writeCount >= 1 && writeCount <= 121 && buffer.peek(16) == 2 * writeCount &&
+			dataSize == 9 + 2 * writeCount;
+		if (valid) {
+			values.resize(writeCount);
+			buffer.peekRegisters(17, values.data(), writeCount);
+		}
+		break;
+	}
+	}
+	if (!valid) {
+		respond(requester, ModbusTcpFrame::exceptionResponse(function, unitId,
+															 ModbusReply::IllegalDataValue));
+		return;
+	}
+	invalidateCache(unitId);
+	quint32 writeId = ++mLastWriteId;
+	PendingWrite &pending = mPendingWrites[writeId];
+	pending.client = client(target);
+	pending.requester = requester;
+	pending.unitId = unitId;
+	pending.function = function;
+	pending.reg = reg;
+	pending.valueOrCount = valueOrCount;
+	ModbusReply::Handler handler = [this, writeId](ModbusReply *reply) {
+		onWriteCompleted(writeId, reply);
+	};
+	ModbusTcpClient *c = pending.client;
+	switch (function) {
+	case ModbusTcpFrame::WriteSingleRegister:
+		c->writeSingleHoldingRegister(target.unitId, reg, valueOrCount, handler);
+		break;
+	case ModbusTcpFrame::WriteMultipleRegisters:
+		c->writeMultipleHoldingRegisters(target.unitId, reg, values, handler);
+		break;
+	default:
+		c->readWriteMultipleRegisters(target.unitId, reg, valueOrCount, buffer.peekUInt16(12),
+									  values, handler);
+		break;
+	}
+}
+
+void ModbusTcpProxy::onReadCompleted(quint64 key, ModbusReply *reply)
+{
+	QList<Requester> requesters = mPendingReads.take(key).requesters;
+	quint8 unitId = unitIdOfKey(key);
+	quint8 function = static_cast<quint8>(key >> 32);
+	QByteArray response;
+	if (reply->error() == ModbusReply::NoException) {
+		QVector<quint16> registers = reply->registers();
+		response = ModbusTcpFrame::readRegistersResponse(
+					static_cast<ModbusTcpFrame::FunctionCode>(function), unitId,
+					registers.constData(), registers.size());
+		if (mCacheTime > 0) {
+			CacheEntry &entry = mCache[key];
+			entry.time = mClock.elapsed();
+			entry.registers = registers;
+			pruneCache();
+		}
+	} else {
+		response = ModbusTcpFrame::exceptionResponse(function, unitId, toException(reply->error()));
+	}
+	foreach (const Requester &requester, requesters)
+		respond(requester, response);
+}
+
+void ModbusTcpProxy::onWriteCompleted(quint32 writeId, ModbusReply *reply)
+{
+	PendingWrite pending = mPendingWrites.take(writeId);
+	// Reads completed while the write was in progress may have returned the old values.
+	invalidateCache(pending.unitId);
+	if (reply->error() != ModbusReply::NoException) {
+		respond(pending.requester, ModbusTcpFrame::exceptionResponse(
+					pending.function, pending.unitId, toException(reply->error())));
+		return;
+	}
+	if (pending.function == ModbusTcpFrame::ReadWriteMultipleRegisters) {
+		QVector<quint16> registers = reply->registers();
+		respond(pending.requester, ModbusTcpFrame::readRegistersResponse(
+					ModbusTcpFrame::ReadWriteMultipleRegisters, pending.unitId,
+					registers.constData(), registers.size()));
+		return;
+	}
+	respond(pending.requester, ModbusTcpFrame::writeRegistersResponse(
+				static_cast<ModbusTcpFrame::FunctionCode>(pending.function), pending.unitId,
+				pending.reg, pending.valueOrCount));
+}
+
+void ModbusTcpProxy::respond(const Requester &requester, const QByteArray &response)
+{
+	if (requester.socket.isNull())
+		return;
+	sendResponse(requester.socket.data(), requester.transactionId, response);
+}
+
+void ModbusTcpProxy::invalidateCache(quint8 unitId)
+{
+	for (QHash<quint64, CacheEntry>::iterator it = mCache.begin(); it != mCache.end();) {
+		if (unitIdOfKey(it.key()) == unitId)
+			it = mCache.erase(it);
+		else
+			++it;
+	}
+}
+
+void ModbusTcpProxy::pruneCache()
+{
+	if (mCache.size() <= MaxCacheEntries)
+		return;
+	qint64 now = mClock.elapsed();
+	for (QHash<quint64, CacheEntry>::iterator it = mCache.begin(); it != mCache.end();) {
+		if (now - it->time > mCacheTime)
+			it = mCache.erase(it);
+		else
+			++it;
+	}
+}
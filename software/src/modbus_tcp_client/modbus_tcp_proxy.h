@@ -0,0 +1,162 @@
+#ifndef MODBUS_TCP_PROXY_H
+#define MODBUS_TCP_PROXY_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QVector>
+#include <functional>
+#include "modbus_reply.h"
+#include "modbus_tcp_server.h"
+
+class ModbusTcpClient;
+
+/*!
+ * Modbus TCP server, which forwards the requests of its clients to the actual devices.
+ *
+ * Devices that handle only one Modbus TCP connection cannot be used by other tools while we are
+ * connected. The proxy forwards requests over the connection we have already (requests of all
+ * proxy clients share it, see `ModbusTcpConnection`), so the transaction IDs of the proxy clients
+ * are replaced by our own, and restored in the response.
+ *
+ * Each unit ID seen by the proxy clients is mapped to a device (host, port and unit ID) by a
+ * resolver function. Requests for units which cannot be resolved are answered with a Gateway Path
+ * Unavailable exception.
+ *
+ * The requests are sent with `ModbusClient::BackgroundPriority`, so our own requests, like power
+ * limit updates, never have to wait for them.
+ *
+ * To limit the additional load on the device, the results of reads (functions 3 and 4) are cached
+ * for a while (see `setCacheTime`). Identical reads which arrive while a read is in progress
+ * share its result. Writes invalidate the cache of the unit.
+ */
+class ModbusTcpProxy : public ModbusTcpServer
+{
+	Q_OBJECT
+public:
+	struct Target
+	{
+		QString hostName;
+		quint16 tcpPort;
+		quint8 unitId;
+	};
+
+	/*!
+	 * Looks up the device for a unit ID used by the proxy clients.
+	 * @return False if there is no device with this unit ID.
+	 */
+	typedef std::function<bool (quint8 unitId, Target *target)> TargetResolver;
+
+	/// Cache time used by default (ms).
+	static const int DefaultCacheTime = 1000;
+
+	explicit ModbusTcpProxy(const TargetResolver &resolver, QObject *parent = 0);
+
+	int cacheTime() const
+	{
+		return mCacheTime;
+	}
+
+	/*!
+	 * Sets the time (in ms) during which the result of a read is used to answer identical reads.
+	 * Zero disables the cache, so each read (except those sharing the result of a read which is
+	 * in progress) is forwarded.
+	 */
+	void setCacheTime(int t);
+
+protected:
+	void handleRequest(QTcpSocket *socket, const ModbusFrameBuffer &buffer, int length) override;
+
+private slots:
+	void onClientDisconnected();
+
+private:
+	// Timeout limits of the forwarding clients (ms)
+	static const int MinTimeout = 250;
+	static const int MaxTimeout = 5000;
+	// Number of cache entries above which stale entries are removed
+	static const int MaxCacheEntries = 256;
+
+	// A proxy client waiting for a response
+	struct Requester
+	{
+		QPointer<QTcpSocket> socket;
+		quint16 transactionId;
+	};
+
+	// A read which has been forwarded, and the proxy clients waiting for it
+	struct PendingRead
+	{
+		ModbusTcpClient *client;
+		QList<Requester> requesters;
+	};
+
+	// A write which has been forwarded. The register and value or count are needed to build the
+	// response of functions 6 and 16.
+	struct PendingWrite
+	{
+		ModbusTcpClient *client;
+		Requester requester;
+		quint8 unitId;
+		quint8 function;
+		quint16 reg;
+		quint16 valueOrCount;
+	};
+
+	struct CacheEntry
+	{
+		qint64 time;
+		QVector<quint16> registers;
+	};
+
+	/// Identifies a read: proxy unit ID, function code, start register, and count.
+	static quint64 readKey(quint8 unitId, quint8 function, quint16 startReg, quint16 count)
+	{
+		return (static_cast<quint64>(unitId) << 40) | (static_cast<quint64>(function) << 32) |
+			(static_cast<quint64>(startReg) << 16) | count;
+	}
+
+	static quint8 unitIdOfKey(quint64 key)
+	{
+		return static_cast<quint8>(key >> 40);
+	}
+
+	/// Converts the error of a forwarded request to the exception sent to the proxy client.
+	static ModbusReply::ExceptionCode toException(ModbusReply::ExceptionCode error);
+
+	/*!
+	 * Returns the client used to forward requests to the host of `target`. The client is removed
+	 * when the connection is lost, so we do not keep a connection open to a device that is no
+	 * longer in use.
+	 */
+	ModbusTcpClient *client(const Target &target);
+
+	void handleRead(const Requester &requester, const Target &target,
+					const ModbusFrameBuffer &buffer, int length);
+
+	void handleWrite(const Requester &requester, const Target &target,
+					 const ModbusFrameBuffer &buffer, int length);
+
+	void onReadCompleted(quint64 key, ModbusReply *reply);
+
+	void onWriteCompleted(quint32 writeId, ModbusReply *reply);
+
+	void respond(const Requester &requester, const QByteArray &response);
+
+	void invalidateCache(quint8 unitId);
+
+	void pruneCache();
+
+	TargetResolver mResolver;
+	// Clients by host:port
+	QHash<QString, ModbusTcpClient *> mClients;
+	QHash<quint64, PendingRead> mPendingReads;
+	QHash<quint32, PendingWrite> mPendingWrites;
+	quint32 mLastWriteId;
+	QHash<quint64, CacheEntry> mCache;
+	QElapsedTimer mClock;
+	int mCacheTime;
+};
+
+#endif // MODBUS_TCP_PROXY_H
@@ -0,0 +1,154 @@
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "modbus_register_image.h"
+#include "modbus_reply.h"
+#include "modbus_tcp_frame.h"
+#include "modbus_tcp_server.h"
+
+ModbusTcpServer::ModbusTcpServer(const ModbusRegisterImage *image, QObject *parent):
+	QObject(parent),
+	mServer(new QTcpServer(this)),
+	mImage(image),
+	mBatchSocket(0)
+{
+	mServer->setMaxPendingConnections(MaxConnections);
+	connect(mServer, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+ModbusTcpServer::~ModbusTcpServer()
+{
+	qDeleteAll(mBuffers);
+}
+
+bool ModbusTcpServer::listen(quint16 tcpPort, const QHostAddress &address)
+{
+	close();
+	return mServer->listen(address, tcpPort);
+}
+
+void ModbusTcpServer::close()
+{
+	mServer->close();
+	foreach (QTcpSocket *socket, mBuffers.keys()) {
+		removeSocket(socket);
+		socket->abort();
+	}
+}
+
+bool ModbusTcpServer::isListening() const
+{
+	return mServer->isListening();
+}
+
+quint16 ModbusTcpServer::serverPort() const
+{
+	return mServer->serverPort();
+}
+
+void ModbusTcpServer::onNewConnection()
+{
+	while (mServer->hasPendingConnections()) {
+		QTcpSocket *socket = mServer->nextPendingConnection();
+		if (mBuffers.size() >= MaxConnections) {
+			socket->abort();
+			socket->deleteLater();
+			continue;
+		}
+		mBuffers.insert(socket, new ModbusFrameBuffer());
+		connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+		connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+	}
+}
+
+void ModbusTcpServer::onReadyRead()
+{
+	QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+	ModbusFrameBuffer *buffer = mBuffers.value(socket);
+	if (buffer == 0)
+		return;
+	buffer->readFrom(socket);
+	// Handle all complete requests, and send the responses in a single write.
+	mBatchSocket = socket;
+	for (;;) {
+		// MBAP header: transaction ID, protocol ID, length (including unit ID).
+		if (buffer->size() < 6)
+			break;
+		int length = buffer->peekUInt16(4);
+		if (buffer->peekUInt16(2) != 0 || length < 2 || length > MaxFrameLength) {
+			// Not Modbus TCP, or we lost track of the frame boundaries.
+			mBatchSocket = 0;
+			mBatch.clear();
+			removeSocket(socket);
+			socket->abort();
+			return;
+		}
+		length += 6;
+		if (buffer->size() < length)
+			break;
+		handleRequest(socket, *buffer, length);
+		buffer->skip(length);
+	}
+	mBatchSocket = 0;
+	if (!mBatch.isEmpty()) {
+		socket->write(mBatch);
+		mBatch.clear();
+	}
+}
+
+void ModbusTcpServer::onDisconnected()
+{
+	QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+	removeSocket(socket);
+}
+
+void ModbusTcpServer::handleRequest(QTcpSocket *socket, const ModbusFrameBuffer &buffer,
+									int length)
+{
+	sendResponse(socket, buffer.peekUInt16(0), readFromImage(buffer, length));
+}
+
+void ModbusTcpServer::sendResponse(QTcpSocket *socket, quint16 transactionId,
+								   const QByteArray &response)
+{
+	if (socket == mBatchSocket) {
+		int offset = mBatch.size();
+		mBatch.append(response);
+		ModbusTcpFrame::setTransactionId(mBatch.data() + offset, transactionId);
+		return;
+	}
+	if (!mBuffers.contains(socket))
+		return;
+	QByteArray frame = response;
+	ModbusTcpFrame::setTransactionId(frame.data(), transactionId);
+	socket->write(frame);
+}
+
+QByteArray ModbusTcpServer::readFromImage(const ModbusFrameBuffer &buffer, int length) const
+{
+	quint8 unitId = buffer.peek(6);
+	quint8 function = buffer.peek(7);
+	if (function != ModbusTcpFrame::ReadHoldingRegisters)
+		return ModbusTcpFrame::exceptionResponse(function, unitId, ModbusReply::IllegalFunction);
+	if (length != ModbusTcpFrame::HeaderSize + 4)
+		return ModbusTcpFrame::exceptionResponse(function, unitId, ModbusReply::IllegalDataValue);
+	quint16 startReg = buffer.peekUInt16(8);
+	quint16 count = buffer.peekUInt16(10);
+	if (count < 1 || count > 125)
+		return ModbusTcpFrame::exceptionResponse(function, unitId, ModbusReply::IllegalDataValue);
+	if (mImage == 0 || !mImage->hasUnit(unitId)) {
+		return ModbusTcpFrame::exceptionResponse(function, unitId,
+												 ModbusReply::GatewayTargetDeviceFailedToRespond);
+	}
+	quint16 values[125];
+	if (!mImage->read(unitId, startReg, count, values))
+		return ModbusTcpFrame::exceptionResponse(function, unitId, ModbusReply::IllegalDataAddress);
+	return ModbusTcpFrame::readRegistersResponse(ModbusTcpFrame::ReadHoldingRegisters, unitId,
+												 values, count);
+}
+
+void ModbusTcpServer::removeSocket(QTcpSocket *socket)
+{
+	delete mBuffers.take(socket);
+	socket->disconnect(this);
+	socket->deleteLater();
+}
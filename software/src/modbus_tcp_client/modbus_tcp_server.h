@@ -0,0 +1,93 @@
+#ifndef MODBUS_TCP_SERVER_H
+#define MODBUS_TCP_SERVER_H
+
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include "modbus_frame_buffer.h"
+
+class ModbusRegisterImage;
+class QTcpServer;
+class QTcpSocket;
+
+/*!
+ * Modbus TCP server, which serves holding registers from a `ModbusRegisterImage`.
+ *
+ * Some devices (like SolarEdge inverters and Fronius datamanagers) cannot handle more than one
+ * Modbus TCP client. The server allows other tools to read the data we have retrieved from such a
+ * device already, without causing any additional traffic to the device itself.
+ *
+ * Only Read Holding Registers (function 3) is supported. Reading registers which are not in the
+ * image results in an Illegal Data Address exception. Requests for an unknown unit ID are answered
+ * with Gateway Target Device Failed To Respond, like a gateway would do.
+ *
+ * Subclasses may handle requests differently by overriding `handleRequest`.
+ */
+class ModbusTcpServer : public QObject
+{
+	Q_OBJECT
+public:
+	/*!
+	 * @param image The registers served. Must remain valid for the lifetime of the server. May be
+	 * 0 if a subclass handles all requests.
+	 */
+	explicit ModbusTcpServer(const ModbusRegisterImage *image, QObject *parent = 0);
+
+	~ModbusTcpServer();
+
+	/*!
+	 * Starts listening on `address`, which is the loopback interface unless the server should be
+	 * reachable from the network. Closes existing client connections first.
+	 */
+	bool listen(quint16 tcpPort, const QHostAddress &address = QHostAddress::LocalHost);
+
+	void close();
+
+	bool isListening() const;
+
+	/// The port the server is listening on, useful if `listen` was called with port 0.
+	quint16 serverPort() const;
+
+protected:
+	/*!
+	 * Handles the request frame of `length` bytes (including the MBAP header) at the read cursor
+	 * of `buffer`. The buffer is only valid during the call. The response must be sent using
+	 * `sendResponse`, which may be done later on (asynchronously).
+	 * The default implementation answers Read Holding Registers requests from the image.
+	 */
+	virtual void handleRequest(QTcpSocket *socket, const ModbusFrameBuffer &buffer, int length);
+
+	/*!
+	 * Sends `response` (created by `ModbusTcpFrame`) to a client, using the given transaction ID.
+	 * Does nothing if the client has disconnected.
+	 */
+	void sendResponse(QTcpSocket *socket, quint16 transactionId, const QByteArray &response);
+
+private slots:
+	void onNewConnection();
+
+	void onReadyRead();
+
+	void onDisconnected();
+
+private:
+	// Maximum number of simultaneous client connections
+	static const int MaxConnections = 16;
+	// Maximum value of the length field in the MBAP header (unit ID + PDU)
+	static const int MaxFrameLength = 254;
+
+	QByteArray readFromImage(const ModbusFrameBuffer &buffer, int length) const;
+
+	void removeSocket(QTcpSocket *socket);
+
+	QTcpServer *mServer;
+	const ModbusRegisterImage *mImage;
+	// Receive buffer per client connection
+	QHash<QTcpSocket *, ModbusFrameBuffer *> mBuffers;
+	// While handling the data received from a client, the responses sent to it are collected
+	// here, and written in one go.
+	QTcpSocket *mBatchSocket;
+	QByteArray mBatch;
+};
+
+#endif // MODBUS_TCP_SERVER_H
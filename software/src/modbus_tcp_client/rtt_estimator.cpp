@@ -0,0 +1,58 @@
+#include "rtt_estimator.h"
+#include "timer_wheel.h"
+
+QHash<QString, RttEstimator *> RttEstimator::mEstimators;
+
+RttEstimator::RttEstimator():
+	mSrtt(0),
+	mRttVar(0),
+	mBackOff(0),
+	mHasSamples(false)
+{
+}
+
+RttEstimator *RttEstimator::forHost(const QString &hostName)
+{
+	RttEstimator *estimator = mEstimators.value(hostName);
+	if (estimator == 0) {
+		estimator = new RttEstimator();
+		mEstimators.insert(hostName, estimator);
+	}
+	return estimator;
+}
+
+void RttEstimator::addSample(qint64 rtt)
+{
+	rtt = qMax(rtt, Q_INT64_C(0));
+	mBackOff = 0;
+	if (!mHasSamples) {
+		// SRTT = R, RTTVAR = R / 2
+		mSrtt = rtt << SrttShift;
+		mRttVar = (rtt << RttVarShift) / 2;
+		mHasSamples = true;
+		return;
+	}
+	// RTTVAR = 3/4 * RTTVAR + 1/4 * |SRTT - R|
+	qint64 delta = qAbs(rtt - (mSrtt >> SrttShift));
+	mRttVar += delta - (mRttVar >> RttVarShift);
+	// SRTT = 7/8 * SRTT + 1/8 * R
+	mSrtt += rtt - (mSrtt >> SrttShift);
+}
+
+void RttEstimator::backOff()
+{
+	if (mBackOff < MaxBackOff)
+		++mBackOff;
+}
+
+int RttEstimator::timeout(int minTimeout, int maxTimeout) const
+{
+	if (!mHasSamples)
+		return maxTimeout;
+	// The variation term should be at least the resolution of the timer (RFC 6298, 2.3).
+	qint64 t = smoothedRtt() + qMax(Q_INT64_C(4) * rttVariation(),
+									static_cast<qint64>(TimerWheel::TickInterval));
+	t <<= mBackOff;
+	return static_cast<int>(qBound(static_cast<qint64>(minTimeout), t,
+								   static_cast<qint64>(maxTimeout)));
+}
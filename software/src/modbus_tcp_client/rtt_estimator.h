@@ -0,0 +1,72 @@
+#ifndef RTT_ESTIMATOR_H
+#define RTT_ESTIMATOR_H
+
+#include <QHash>
+#include <QString>
+
+/*!
+ * Estimates the round trip time of requests to a host, and derives a timeout from it.
+ *
+ * This uses the algorithm TCP uses for its retransmission timeout (RFC 6298): the smoothed round
+ * trip time (SRTT) and its variation (RTTVAR) are updated with each reply, and the timeout is
+ * SRTT + 4 * RTTVAR. After a timeout the value is doubled (backed off) until a new reply comes in,
+ * so a host which is just slow will not time out over and over again.
+ *
+ * There is one estimator per host, shared by all connections to it, which survives the
+ * connections. So the timings measured while scanning can be used by the updater later on.
+ */
+class RttEstimator
+{
+public:
+	/// Returns the estimator for `hostName`, creating it if necessary.
+	static RttEstimator *forHost(const QString &hostName);
+
+	/// Adds a round trip time (in ms) of a request which did not time out.
+	void addSample(qint64 rtt);
+
+	/// Doubles the timeout, to be called when a request has timed out.
+	void backOff();
+
+	bool hasSamples() const
+	{
+		return mHasSamples;
+	}
+
+	/// Returns the smoothed round trip time in ms.
+	int smoothedRtt() const
+	{
+		return static_cast<int>(mSrtt >> SrttShift);
+	}
+
+	/// Returns the variation of the round trip time in ms.
+	int rttVariation() const
+	{
+		return static_cast<int>(mRttVar >> RttVarShift);
+	}
+
+	/*!
+	 * Returns the timeout for the next request in ms, limited to [minTimeout, maxTimeout]. If
+	 * there are no samples yet, the maximum is returned, so hosts we know nothing about get all
+	 * the time they need.
+	 */
+	int timeout(int minTimeout, int maxTimeout) const;
+
+private:
+	// SRTT and RTTVAR are stored with fixed point scaling (like the Linux TCP stack), so the
+	// gains (1/8 and 1/4) do not lose precision.
+	static const int SrttShift = 3;
+	static const int RttVarShift = 2;
+	// Limits the timeout to 2^MaxBackOff times the estimated value.
+	static const int MaxBackOff = 6;
+
+	RttEstimator();
+
+	static QHash<QString, RttEstimator *> mEstimators;
+
+	qint64 mSrtt;
+	qint64 mRttVar;
+	int mBackOff;
+	bool mHasSamples;
+};
+
+#endif // RTT_ESTIMATOR_H
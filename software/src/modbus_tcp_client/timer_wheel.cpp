@@ -0,0 +1,186 @@
+#include <QTimer>
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(QObject *parent):
+	QObject(parent),
+	mCurrentTick(0),
+	mCount(0),
+	mTimer(new QTimer(this)),
+	mTimerTick(0)
+{
+	for (int l = 0; l < Levels; ++l) {
+		for (int s = 0; s < Slots; ++s) {
+			Node &slot = mSlots[l][s];
+			slot.prev = &slot;
+			slot.next = &slot;
+		}
+	}
+	mClock.start();
+	mTimer->setSingleShot(true);
+	connect(mTimer, SIGNAL(timeout()), this, SLOT(onTimer()));
+}
+
+TimerWheel::~TimerWheel()
+{
+	// Detach the remaining entries, so they will not access the wheel when they are destroyed.
+	for (int l = 0; l < Levels; ++l) {
+		for (int s = 0; s < Slots; ++s) {
+			Node *slot = &mSlots[l][s];
+			while (slot->next != slot) {
+				Entry *entry = static_cast<Entry *>(slot->next);
+				unlink(entry);
+				entry->mWheel = 0;
+			}
+		}
+	}
+}
+
+void TimerWheel::schedule(Entry *entry, int interval)
+{
+	cancel(entry);
+	if (mCount == 0) {
+		// All slots are empty, so we can move to the current time without cascading. The timer may
+		// still be set from before, which is harmless: it fires once without work.
+		mCurrentTick = now();
+	}
+	// Round up, so the entry will never expire early. Make sure it does not end up in the slot
+	// being expired.
+	quint64 expiry = static_cast<quint64>(mClock.elapsed() + qMax(0, interval) + TickInterval - 1) /
+		TickInterval;
+	entry->mExpiry = qMax(expiry, mCurrentTick + 1);
+	entry->mWheel = this;
+	++mCount;
+	insert(entry);
+	// Entries beyond level 0 need the timer at the next cascade of level 1.
+	quint64 tick = entry->mExpiry - mCurrentTick < Slots ?
+		entry->mExpiry : (mCurrentTick | SlotMask) + 1;
+	if (!mTimer->isActive() || tick < mTimerTick)
+		setTimer(tick);
+}
+
+void TimerWheel::cancel(Entry *entry)
+{
+	TimerWheel *wheel = entry->mWheel;
+	if (wheel == 0)
+		return;
+	unlink(entry);
+	entry->mWheel = 0;
+	--wheel->mCount;
+}
+
+void TimerWheel::onTimer()
+{
+	quint64 target = now();
+	// Skip the ticks without work. The loop also ends if the last entry has been removed, in
+	// which case mCurrentTick will be reset when a new entry is scheduled.
+	while (mCurrentTick < target && mCount > 0) {
+		mCurrentTick = qMin(nextTick(), target);
+		if ((mCurrentTick & SlotMask) == 0) {
+			if (((mCurrentTick >> SlotBits) & SlotMask) == 0)
+				cascade(2);
+			cascade(1);
+		}
+		expire(&mSlots[0][mCurrentTick & SlotMask]);
+	}
+	if (mCount == 0)
+		return;
+	quint64 tick = nextTick();
+	if (!mTimer->isActive() || tick < mTimerTick)
+		setTimer(tick);
+}
+
+quint64 TimerWheel::now() const
+{
+	return static_cast<quint64>(mClock.elapsed()) / TickInterval;
+}
+
+quint64 TimerWheel::nextTick() const
+{
+	// Level 0 holds the entries expiring within the next 64 ticks.
+	quint64 boundary = (mCurrentTick | SlotMask) + 1;
+	for (quint64 tick = mCurrentTick + 1; tick <= boundary; ++tick) {
+		if (!isEmpty(&mSlots[0][tick & SlotMask]))
+			return tick;
+	}
+	for (int l = 1; l < Levels; ++l) {
+		for (int s = 0; s < Slots; ++s) {
+			if (!isEmpty(&mSlots[l][s]))
+				return boundary;
+		}
+	}
+	for (quint64 tick = boundary + 1; tick <= mCurrentTick + Slots; ++tick) {
+		if (!isEmpty(&mSlots[0][tick & SlotMask]))
+			return tick;
+	}
+	return 0;
+}
+
+void TimerWheel::setTimer(quint64 tick)
+{
+	mTimerTick = tick;
+	qint64 delay = static_cast<qint64>(tick * TickInterval) - mClock.elapsed();
+	mTimer->start(static_cast<int>(qMax(Q_INT64_C(0), delay)));
+}
+
+void TimerWheel::insert(Entry *entry)
+{
+	quint64 expiry = qMax(entry->mExpiry, mCurrentTick);
+	Node *slot = 0;
+	if (expiry - mCurrentTick < Slots) {
+		slot = &mSlots[0][expiry & SlotMask];
+	} else if ((expiry >> SlotBits) - (mCurrentTick >> SlotBits) < Slots) {
+		slot = &mSlots[1][(expiry >> SlotBits) & SlotMask];
+	} else {
+		// Entries beyond the range of the wheel (about 45 minutes) are put in the last slot, and
+		// will be put back in level 2 when that slot is cascaded.
+		quint64 index = qMin(expiry >> (2 * SlotBits), (mCurrentTick >> (2 * SlotBits)) + Slots - 1);
+		slot = &mSlots[2][index & SlotMask];
+	}
+	entry->prev = slot->prev;
+	entry->next = slot;
+	slot->prev->next = entry;
+	slot->prev = entry;
+}
+
+void TimerWheel::cascade(int level)
+{
+	// The entries in this slot expire within the next 64^level ticks, so they belong to a lower
+	// level now.
+	Node *slot = &mSlots[level][(mCurrentTick >> (level * SlotBits)) & SlotMask];
+	while (!isEmpty(slot)) {
+		Entry *entry = static_cast<Entry *>(slot->next);
+		unlink(entry);
+		insert(entry);
+	}
+}
+
+void TimerWheel::expire(Node *slot)
+{
+	// Take the entries one at a time, because onTimeout may cancel or (re)schedule other entries.
+	while (!isEmpty(slot)) {
+		Entry *entry = static_cast<Entry *>(slot->next);
+		cancel(entry);
+		entry->onTimeout();
+	}
+}
+
+void TimerWheel::unlink(Node *node)
+{
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->prev = node;
+	node->next = node;
+}
+
+TimerWheel::Entry::Entry():
+	mWheel(0),
+	mExpiry(0)
+{
+	prev = this;
+	next = this;
+}
+
+TimerWheel::Entry::~Entry()
+{
+	TimerWheel::cancel(this);
+}
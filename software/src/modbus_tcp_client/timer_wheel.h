@@ -0,0 +1,121 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+class QTimer;
+
+/*!
+ * Hierarchical timer wheel for a large number of timeouts which are usually cancelled before
+ * they expire (like request timeouts).
+ *
+ * A single-shot Qt timer drives the wheel. It is set to the first tick with work to do (an
+ * entry to expire, or a slot to cascade), so the wheel does not wake up every tick while entries
+ * are pending. Cancelling an entry does not touch the timer: if nothing is left when it fires, it
+ * is simply not set again. Scheduling and cancelling an entry is O(1) and does not allocate: the
+ * entries are intrusive (the object with the timeout derives from `TimerWheel::Entry`).
+ *
+ * The wheel has 3 levels of 64 slots. Level 0 holds the entries expiring within 64 ticks, level 1
+ * and 2 hold entries further away, which are moved to the lower levels as time progresses. The
+ * resolution is `TickInterval` ms: an entry may expire up to one tick late.
+ */
+class TimerWheel : public QObject
+{
+	Q_OBJECT
+public:
+	static const int TickInterval = 10;
+
+	class Entry;
+
+	explicit TimerWheel(QObject *parent = 0);
+
+	~TimerWheel();
+
+	/*!
+	 * Schedules `entry` to expire after `interval` ms. If the entry was already scheduled (on any
+	 * wheel), it is rescheduled.
+	 */
+	void schedule(Entry *entry, int interval);
+
+	/// Removes `entry` from the wheel. Does nothing if the entry is not scheduled.
+	static void cancel(Entry *entry);
+
+	/// Returns the number of scheduled entries.
+	int count() const
+	{
+		return mCount;
+	}
+
+private slots:
+	void onTimer();
+
+private:
+	struct Node
+	{
+		Node *prev;
+		Node *next;
+	};
+
+	static const int Levels = 3;
+	static const int SlotBits = 6;
+	static const int Slots = 1 << SlotBits;
+	static const quint64 SlotMask = Slots - 1;
+
+	quint64 now() const;
+
+	/// Returns the first tick after the current one with work to do, or 0 if there is none.
+	quint64 nextTick() const;
+
+	/// Sets the timer to fire at `tick`.
+	void setTimer(quint64 tick);
+
+	void insert(Entry *entry);
+
+	void cascade(int level);
+
+	void expire(Node *slot);
+
+	static void unlink(Node *node);
+
+	static bool isEmpty(const Node *slot)
+	{
+		return slot->next == slot;
+	}
+
+	Node mSlots[Levels][Slots];
+	QElapsedTimer mClock;
+	quint64 mCurrentTick;
+	int mCount;
+	QTimer *mTimer;
+	// The tick at which the timer fires, valid while it is active.
+	quint64 mTimerTick;
+};
+
+class TimerWheel::Entry : private TimerWheel::Node
+{
+public:
+	Entry();
+
+	virtual ~Entry();
+
+	bool isScheduled() const
+	{
+		return mWheel != 0;
+	}
+
+protected:
+	/// Called when the entry expires. The entry has been removed from the wheel at this point.
+	virtual void onTimeout() = 0;
+
+private:
+	friend class TimerWheel;
+
+	Entry(const Entry &);
+	Entry &operator=(const Entry &);
+
+	TimerWheel *mWheel;
+	quint64 mExpiry;
+};
+
+#endif // TIMER_WHEEL_H
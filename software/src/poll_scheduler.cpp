@@ -0,0 +1,57 @@
+#include <qnumeric.h>
+#include <QtGlobal>
+#include "poll_scheduler.h"
+
+PollScheduler::PollScheduler():
+	mLastPower(qQNaN()),
+	mMaxPower(DefaultMaxPower),
+	mMinInterval(1000),
+	mMaxInterval(1000),
+	mInterval(1000),
+	mPowerLimitActive(false)
+{
+}
+
+void PollScheduler::setBounds(int minInterval, int maxInterval)
+{
+	mMinInterval = qMax(1, minInterval);
+	mMaxInterval = qMax(mMinInterval, maxInterval);
+	mInterval = qBound(mMinInterval, mInterval, mMaxInterval);
+}
+
+void PollScheduler::setMaxPower(double maxPower)
+{
+	mMaxPower = qIsFinite(maxPower) && maxPower > 0 ? maxPower : DefaultMaxPower;
+}
+
+void PollScheduler::update(double power, bool sleeping)
+{
+	double lastPower = mLastPower;
+	mLastPower = power;
+	if (sleeping) {
+		mInterval = mMaxInterval;
+		return;
+	}
+	if (!qIsFinite(power) || !qIsFinite(lastPower)) {
+		mInterval = mMinInterval;
+		return;
+	}
+	double change = qAbs(power - lastPower);
+	if (change >= mMaxPower * FastChange / 100)
+		mInterval = mMinInterval;
+	else if (change <= mMaxPower * FlatChange / 1000)
+		mInterval = qMin(mMaxInterval, 2 * mInterval);
+	else
+		mInterval = qMax(mMinInterval, mInterval / 2);
+}
+
+void PollScheduler::reset()
+{
+	mLastPower = qQNaN();
+	mInterval = mMinInterval;
+}
+
+int PollScheduler::interval() const
+{
+	return mPowerLimitActive ? mMinInterval : mInterval;
+}
@@ -0,0 +1,64 @@
+#ifndef POLL_SCHEDULER_H
+#define POLL_SCHEDULER_H
+
+/*!
+ * Computes the interval between two polls of an inverter.
+ *
+ * Polling at a fixed rate wastes network bandwidth and CPU time when nothing happens, most of all
+ * at night. The interval is therefore adapted to the state and the output of the inverter:
+ * - When the inverter is sleeping (or in standby, or off), the maximum interval is used.
+ * - When the power changes fast, the minimum interval is used.
+ * - When the power is flat, the interval is doubled after each poll, up to the maximum.
+ * - Otherwise the interval is halved after each poll, down to the minimum.
+ * - While a power limit is active, the minimum interval is used, because the control loop which
+ *   sets the limit needs the actual power.
+ *
+ * Changes are measured relative to the maximum power of the inverter.
+ */
+class PollScheduler
+{
+public:
+	/// Change in power (in % of the maximum power) between two polls considered fast.
+	static const int FastChange = 5;
+	/// Change in power (in 0.1% of the maximum power) between two polls considered flat.
+	static const int FlatChange = 5;
+
+	PollScheduler();
+
+	/// Sets the limits (in ms) of the interval.
+	void setBounds(int minInterval, int maxInterval);
+
+	/// Sets the maximum power of the inverter (W). Used when the power rating is unknown: 0.
+	void setMaxPower(double maxPower);
+
+	void setPowerLimitActive(bool active)
+	{
+		mPowerLimitActive = active;
+	}
+
+	/*!
+	 * Updates the interval after a successful poll.
+	 * @param power AC power (W) read in the poll, NaN if unknown.
+	 * @param sleeping True if the inverter reports it is sleeping, in standby, or off.
+	 */
+	void update(double power, bool sleeping);
+
+	/// Forgets the power read in the last poll, and uses the minimum interval until the next one.
+	void reset();
+
+	/// Returns the time (in ms) to wait before the next poll.
+	int interval() const;
+
+private:
+	// Used as maximum power if the rating of the inverter is unknown.
+	static const int DefaultMaxPower = 5000;
+
+	double mLastPower;
+	double mMaxPower;
+	int mMinInterval;
+	int mMaxInterval;
+	int mInterval;
+	bool mPowerLimitActive;
+};
+
+#endif // POLL_SCHEDULER_H
@@ -0,0 +1,93 @@
+#include <QtGlobal>
+#include "power_limit_coalescer.h"
+
+PowerLimitCoalescer::PowerLimitCoalescer():
+	mScale(100),
+	mDeadband(0),
+	mRefreshInterval(RequestTimeout),
+	mRequestTimeout(RequestTimeout),
+	mRequested(1.0),
+	mWritten(1.0),
+	mRequestedAt(0),
+	mWrittenAt(0),
+	mWritePending(false),
+	mEnabled(false),
+	mActive(false)
+{
+	mClock.start();
+}
+
+bool PowerLimitCoalescer::request(double pct)
+{
+	mRequested = pct;
+	mRequestedAt = mClock.elapsed();
+	if (mWritePending)
+		return true;
+	if (!mActive || !mEnabled) {
+		mWritePending = true;
+		return true;
+	}
+	if (toRegister(pct) == toRegister(mWritten))
+		return false;
+	bool atBound = pct <= 0 || pct >= 1;
+	if (!atBound && qAbs(pct - mWritten) <= mDeadband)
+		return false;
+	mWritePending = true;
+	return true;
+}
+
+void PowerLimitCoalescer::setWritten()
+{
+	mWritten = mRequested;
+	mWrittenAt = mClock.elapsed();
+	mWritePending = false;
+	mEnabled = true;
+	mActive = true;
+}
+
+void PowerLimitCoalescer::invalidate()
+{
+	mEnabled = false;
+	if (mActive)
+		mWritePending = true;
+}
+
+void PowerLimitCoalescer::reset()
+{
+	mWritePending = false;
+	mEnabled = false;
+	mActive = false;
+}
+
+PowerLimitCoalescer::Action PowerLimitCoalescer::check()
+{
+	if (!mActive)
+		return NoAction;
+	qint64 now = mClock.elapsed();
+	if (now - mRequestedAt >= mRequestTimeout)
+		return Expire;
+	if (!mWritePending && now - mWrittenAt >= mRefreshInterval) {
+		// Enabling the limit again restarts the timeout of the inverter.
+		mEnabled = false;
+		mWritePending = true;
+		return Refresh;
+	}
+	return NoAction;
+}
+
+int PowerLimitCoalescer::nextCheck() const
+{
+	if (!mActive)
+		return -1;
+	qint64 now = mClock.elapsed();
+	qint64 next = mRequestedAt + mRequestTimeout;
+	// A pending write will refresh the limit anyway.
+	if (!mWritePending)
+		next = qMin(next, mWrittenAt + mRefreshInterval);
+	return static_cast<int>(qMax(Q_INT64_C(0), next - now));
+}
+
+int PowerLimitCoalescer::toRegister(double pct) const
+{
+	return qRound(pct * mScale);
+}
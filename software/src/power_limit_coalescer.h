@@ -0,0 +1,136 @@
+#ifndef POWER_LIMIT_COALESCER_H
+#define POWER_LIMIT_COALESCER_H
+
+#include <QElapsedTimer>
+
+/*!
+ * Decides when a power limit requested by the control loop (hub4control) must be written to the
+ * inverter.
+ *
+ * The control loop writes a new limit to the D-Bus several times per second, mostly with (nearly)
+ * the same value. Only the latest requested value is kept, and it is written only if it differs
+ * from the value written last by more than the deadband, or if it would be written to the inverter
+ * as a different register value. Limits of 0% and 100% are always written, so the inverter can
+ * reach them exactly.
+ *
+ * The first write enables the power limit on the inverter, with a timeout after which the
+ * inverter reverts to full power (see `PowerLimitTimeout`). Once enabled, only the percentage
+ * needs to be written (see `isFullWriteNeeded`). As long as the control loop is active, the whole
+ * limit is written again before the inverter timeout expires, even if the value has not changed.
+ * When the control loop has been silent for `RequestTimeout`, the limit should be disabled.
+ */
+class PowerLimitCoalescer
+{
+public:
+	/// Time (ms) without requests after which the control loop is assumed to be gone.
+	static const int RequestTimeout = 60000;
+
+	enum Action {
+		/// Nothing to be done.
+		NoAction,
+		/// The limit must be written again, to keep the inverter from reverting to full power.
+		Refresh,
+		/// The control loop is gone, and the limit must be disabled.
+		Expire
+	};
+
+	PowerLimitCoalescer();
+
+	/// Sets the resolution of the limit: the register value for 100%.
+	void setScale(double scale)
+	{
+		mScale = scale;
+	}
+
+	/// Sets the deadband, as fraction of the maximum power.
+	void setDeadband(double deadband)
+	{
+		mDeadband = deadband;
+	}
+
+	/// Sets the time (ms) after a write at which the limit must be written again.
+	void setRefreshInterval(int interval)
+	{
+		mRefreshInterval = interval;
+	}
+
+	/// Sets the time (ms) without requests after which the limit expires (see `RequestTimeout`).
+	void setRequestTimeout(int timeout)
+	{
+		mRequestTimeout = timeout;
+	}
+
+	/*!
+	 * Records a request of the control loop.
+	 * @param pct The requested limit, as fraction of the maximum power.
+	 * @return True if the limit must be written.
+	 */
+	bool request(double pct);
+
+	/// Returns true if the limit must be written.
+	bool isWritePending() const
+	{
+		return mWritePending;
+	}
+
+	/// The value to be written: the latest requested limit.
+	double value() const
+	{
+		return mRequested;
+	}
+
+	/*!
+	 * Returns true if the limit has to be enabled on the inverter, which means all registers
+	 * (enable, timeout, and percentage) must be written, not just the percentage.
+	 */
+	bool isFullWriteNeeded() const
+	{
+		return !mEnabled;
+	}
+
+	/// Returns true if a limit has been written, and has not been disabled since.
+	bool isActive() const
+	{
+		return mActive;
+	}
+
+	/// To be called when `value` is written to the inverter.
+	void setWritten();
+
+	/*!
+	 * To be called when the inverter may have lost the limit (eg. after a failed write). The next
+	 * write will be a full write.
+	 */
+	void invalidate();
+
+	/// To be called when the limit has been disabled: forgets all requests and writes.
+	void reset();
+
+	/*!
+	 * Returns what should be done now. Should be called after `nextCheck` ms. If `Refresh` is
+	 * returned, a write is pending.
+	 */
+	Action check();
+
+	/// Returns the time (ms) until `check` must be called, or -1 if the limit is not active.
+	int nextCheck() const;
+
+private:
+	int toRegister(double pct) const;
+
+	QElapsedTimer mClock;
+	double mScale;
+	double mDeadband;
+	int mRefreshInterval;
+	int mRequestTimeout;
+	double mRequested;
+	double mWritten;
+	// Time (see mClock) of the last request and the last write.
+	qint64 mRequestedAt;
+	qint64 mWrittenAt;
+	bool mWritePending;
+	bool mEnabled;
+	bool mActive;
+};
+
+#endif // POWER_LIMIT_COALESCER_H
@@ -0,0 +1,34 @@
+#include <QtGlobal>
+#include "scan_window.h"
+
+ScanWindow::ScanWindow():
+	mSize(InitialSize),
+	mSlowStart(true),
+	mRoundRemaining(0),
+	mRoundTimeouts(0)
+{
+	startRound();
+}
+
+void ScanWindow::addResult(bool timedOut)
+{
+	if (timedOut)
+		++mRoundTimeouts;
+	if (--mRoundRemaining > 0)
+		return;
+	if (mRoundTimeouts > MaxTimeoutRatio * mSize) {
+		mSize = qMax(static_cast<int>(MinSize), mSize / 2);
+		mSlowStart = false;
+	} else if (mSlowStart) {
+		mSize = qMin(static_cast<int>(MaxSize), mSize * 2);
+	} else {
+		mSize = qMin(static_cast<int>(MaxSize), mSize + Increase);
+	}
+	startRound();
+}
+
+void ScanWindow::startRound()
+{
+	mRoundRemaining = mSize;
+	mRoundTimeouts = 0;
+}
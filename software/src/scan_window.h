@@ -0,0 +1,50 @@
+#ifndef SCAN_WINDOW_H
+#define SCAN_WINDOW_H
+
+/*!
+ * Decides how many hosts may be scanned at the same time during an IP scan (AIMD, like the TCP
+ * congestion window).
+ *
+ * The outcome of the scans is evaluated per round: as many results as the size of the window,
+ * which is about the number of scans finished in the time needed to scan a host. A scan is prompt
+ * if it finished before the detector timeout, which includes hosts that are not there at all: on
+ * a healthy LAN the connection is refused, or the address does not resolve, well before that.
+ * Timeouts mean that requests or replies get lost, so if more than `MaxTimeoutRatio` of the scans
+ * in a round time out, the window is halved. Otherwise it grows: doubling each round until the
+ * first cut (slow start), by `Increase` hosts per round after that.
+ */
+class ScanWindow
+{
+public:
+	static const int MinSize = 8;
+	static const int MaxSize = 256;
+	/// Size of the window before anything is known about the network.
+	static const int InitialSize = 32;
+	/// Growth of the window per round, after the first cut.
+	static const int Increase = 8;
+	/// Fraction of timed out scans in a round above which the window is cut.
+	static constexpr double MaxTimeoutRatio = 0.1;
+
+	ScanWindow();
+
+	/// The number of hosts which may be scanned at the same time.
+	int size() const
+	{
+		return mSize;
+	}
+
+	/// To be called when a scan has finished. `timedOut` is true if it ran into the timeout.
+	void addResult(bool timedOut);
+
+private:
+	void startRound();
+
+	int mSize;
+	// The window is doubled each round while in slow start.
+	bool mSlowStart;
+	// Results still to be collected in this round, and the timeouts among them so far.
+	int mRoundRemaining;
+	int mRoundTimeouts;
+};
+
+#endif // SCAN_WINDOW_H
@@ -1,6 +1,8 @@
 #include <Qt>
 #include <veutil/qt/ve_qitem.hpp>
 #include "defines.h"
+#include "logging.h"
+#include "modbus_tcp_proxy.h"
 #include "settings.h"
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
@@ -23,7 +25,15 @@ Settings::Settings(VeQItem *root, QObject *parent) :
 	mIpAddresses(connectItem("IPAddresses", "", SIGNAL(ipAddressesChanged()), false)),
 	mKnownIpAddresses(connectItem("KnownIPAddresses", "", 0, false)),
 	mAutoScan(connectItem("AutoScan", 1, 0)),
-	mIdBySerial(connectItem("IdentifyBySerialNumber", 0, 0))
+	mIdBySerial(connectItem("IdentifyBySerialNumber", 0, 0)),
+	mModbusServerPort(connectItem("ModbusServerPort", 0, SIGNAL(modbusServerPortChanged()))),
+	mModbusServerAddress(connectItem("ModbusServerAddress", "127.0.0.1",
+									 SIGNAL(modbusServerPortChanged()))),
+	mModbusServerProxy(connectItem("ModbusServerProxy", 0, SIGNAL(modbusServerProxyChanged()))),
+	mModbusProxyCacheTime(connectItem("ModbusProxyCacheTime", ModbusTcpProxy::DefaultCacheTime,
+									  SIGNAL(modbusProxyCacheTimeChanged()))),
+	mRtuPorts(connectItem("RtuPorts", "", SIGNAL(rtuPortsChanged()), false)),
+	mRtuUnitIds(connectItem("RtuUnitIds", "1-8", SIGNAL(rtuPortsChanged()), false))
 {
 }
 
@@ -63,6 +73,55 @@ bool Settings::idBySerial() const
 	return mIdBySerial->getValue().toBool();
 }
 
+int Settings::modbusServerPort() const
+{
+	return mModbusServerPort->getValue().toInt();
+}
+
+QHostAddress Settings::modbusServerAddress() const
+{
+	return QHostAddress(mModbusServerAddress->getValue().toString().trimmed());
+}
+
+bool Settings::modbusServerProxy() const
+{
+	return mModbusServerProxy->getValue().toBool();
+}
+
+int Settings::modbusProxyCacheTime() const
+{
+	return mModbusProxyCacheTime->getValue().toInt();
+}
+
+QStringList Settings::rtuPorts() const
+{
+	QStringList result;
+	foreach (QString port, mRtuPorts->getValue().toString().split(',', SkipEmptyParts))
+		result.append(port.trimmed());
+	return result;
+}
+
+QList<quint8> Settings::rtuUnitIds() const
+{
+	QList<quint8> result;
+	foreach (QString range, mRtuUnitIds->getValue().toString().split(',', SkipEmptyParts)) {
+		QStringList bounds = range.split('-');
+		bool ok = bounds.size() <= 2;
+		int first = ok ? bounds.first().toInt(&ok) : 0;
+		int last = ok && bounds.size() == 2 ? bounds.last().toInt(&ok) : first;
+		// Address 0 is the broadcast address, and 248-255 are reserved.
+		if (!ok || first < 1 || last > 247) {
+			qWarning() << "Invalid RTU unit ID range:" << range;
+			continue;
+		}
+		for (int id = first; id <= last; ++id) {
+			if (!result.contains(static_cast<quint8>(id)))
+				result.append(static_cast<quint8>(id));
+		}
+	}
+	return result;
+}
+
 int Settings::registerInverter(const QString &uniqueId)
 {
 	QString settingsId = createInverterId(uniqueId);
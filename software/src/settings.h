@@ -30,6 +30,41 @@ public:
 
 	bool idBySerial() const;
 
+	/*!
+	 * TCP port of the local Modbus TCP server, which serves the data read from the SunSpec
+	 * inverters to other applications. Zero (the default) disables the server.
+	 */
+	int modbusServerPort() const;
+
+	/*!
+	 * Address the Modbus TCP server listens on. The default (127.0.0.1) only allows local
+	 * applications to connect. Use 0.0.0.0 to listen on all interfaces. Changes are reported with
+	 * `modbusServerPortChanged`.
+	 */
+	QHostAddress modbusServerAddress() const;
+
+	/*!
+	 * If set, the Modbus TCP server forwards requests to the inverters (see `ModbusTcpProxy`),
+	 * instead of serving the registers read by dbus-fronius only.
+	 */
+	bool modbusServerProxy() const;
+
+	/// Time (in ms) during which the proxy answers identical reads from its cache.
+	int modbusProxyCacheTime() const;
+
+	/*!
+	 * Modbus RTU (RS485) buses with SunSpec inverters: serial ports and serial to ethernet
+	 * gateways (see `ModbusRtuClient::isRtuAddress`). For example: "/dev/ttyUSB0:19200" or
+	 * "rtu+tcp://192.168.1.20:4001".
+	 */
+	QStringList rtuPorts() const;
+
+	/*!
+	 * Slave addresses probed on the RTU buses. The setting is a comma separated list of
+	 * addresses and ranges, for example: "1-4,10".
+	 */
+	QList<quint8> rtuUnitIds() const;
+
 	/*!
 	 * Registers an inverter.
 	 * @param deviceType The device type as specified by Fronius.
@@ -49,6 +84,14 @@ signals:
 
 	void ipAddressesChanged();
 
+	void modbusServerPortChanged();
+
+	void modbusServerProxyChanged();
+
+	void modbusProxyCacheTimeChanged();
+
+	void rtuPortsChanged();
+
 private:
 	QList<QHostAddress> toAdressList(const QString &s) const;
 
@@ -59,6 +102,12 @@ private:
 	VeQItem *mKnownIpAddresses;
 	VeQItem *mAutoScan;
 	VeQItem *mIdBySerial;
+	VeQItem *mModbusServerPort;
+	VeQItem *mModbusServerAddress;
+	VeQItem *mModbusServerProxy;
+	VeQItem *mModbusProxyCacheTime;
+	VeQItem *mRtuPorts;
+	VeQItem *mRtuUnitIds;
 };
 
 #endif // SETTINGS_H
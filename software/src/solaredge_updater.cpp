@@ -59,25 +59,27 @@ void SolaredgeUpdater::setIncludeInitCommands()
 	mIncludeInitCommands = true;
 }
 
-void SolaredgeUpdater::writeCommands(bool firstCommand)
+void SolaredgeUpdater::writeCommands()
 {
-	if (!firstCommand) {
-		ModbusReply *previousReply = static_cast<ModbusReply *>(sender());
-		previousReply->deleteLater();
-	}
-
-	if (mCommands.isEmpty())
-		return;
-
-	auto cmd = mCommands.takeFirst();
+	// All commands are sent at once. They are pipelined by the modbus client, and the inverter
+	// handles them in order, so there is no need to wait for the reply to each command.
 	const DeviceInfo &deviceInfo = inverter()->deviceInfo();
-	ModbusReply *reply = modbusClient()->writeMultipleHoldingRegisters(deviceInfo.networkId, cmd.first, cmd.second);
+	while (!mCommands.isEmpty()) {
+		auto cmd = mCommands.takeFirst();
+		ModbusReply *reply = modbusClient()->writeMultipleHoldingRegisters(deviceInfo.networkId, cmd.first, cmd.second);
+
+		// Use original onWriteCompleted when all commands are done
+		if (mCommands.isEmpty())
+			connect(reply, SIGNAL(finished()), this, SLOT(onWriteCompleted()));
+		else
+			connect(reply, SIGNAL(finished()), this, SLOT(onCommandCompleted()));
+	}
+}
 
-	// Use original onWriteCompleted when all commands are done
-	if (mCommands.isEmpty())
-		connect(reply, SIGNAL(finished()), this, SLOT(onWriteCompleted()));
-	else
-		connect(reply, SIGNAL(finished()), this, SLOT(writeCommands()));
+void SolaredgeUpdater::onCommandCompleted()
+{
+	ModbusReply *reply = static_cast<ModbusReply *>(sender());
+	reply->deleteLater();
 }
 
 void SolaredgeUpdater::writePowerLimit(double powerLimitPct)
@@ -100,7 +102,21 @@ void SolaredgeUpdater::writePowerLimit(double powerLimitPct)
 		mCommands.append({EnableDynamicPowerControl, {1}});
 		qInfo() << "Writing EDPC settings to SolarEdge Inverter:" << inverter()->location();
 	}
-	writeCommands(true);
+	writeCommands();
+}
+
+void SolaredgeUpdater::planReads(SunspecReadPlan &plan)
+{
+	// The power limit is not written to the immediate controls model, so there is no need to read
+	// back its state.
+	planInverterModel(plan);
+}
+
+bool SolaredgeUpdater::writePowerLimitAndRead(double powerLimitPct)
+{
+	// The power limit is spread over several commands, which are written in separate requests.
+	Q_UNUSED(powerLimitPct);
+	return false;
 }
 
 void SolaredgeUpdater::disablePowerLimiting()
@@ -111,7 +127,7 @@ void SolaredgeUpdater::disablePowerLimiting()
 	mCommands = {
 		{DynamicActivePowerLimit, toWords(PowerLimitDisableValue)}
 	};
-	writeCommands(true);
+	writeCommands();
 	inverter()->setPowerLimit(deviceInfo.maxPower);
 }
 
@@ -10,7 +10,7 @@ public:
 	explicit SolaredgeUpdater(Inverter *inverter, InverterSettings *settings, QObject *parent = 0);
 
 private slots:
-	void writeCommands(bool firstCommand = false);
+	void onCommandCompleted();
 
 	void setIncludeInitCommands();
 
@@ -19,8 +19,14 @@ private slots:
 	void onReadMaxPowerCompleted();
 
 private:
+	void writeCommands();
+
+	void planReads(SunspecReadPlan &plan) override;
+
 	void writePowerLimit(double powerLimitPct) override;
 
+	bool writePowerLimitAndRead(double powerLimitPct) override;
+
 	void disablePowerLimiting() override;
 
 	QList<std::pair<uint16_t, QVector<uint16_t>>> mCommands;
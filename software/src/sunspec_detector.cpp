@@ -1,53 +1,101 @@
 #include <velib/vecan/products.h>
+#include "modbus_rtu_client.h"
 #include "modbus_tcp_client.h"
 #include "modbus_reply.h"
+#include "settings.h"
 #include "sunspec_updater.h"
 #include "sunspec_detector.h"
 #include "sunspec_tools.h"
 
+// Lower limit of the (adaptive) timeout. During detection each request is tried only once, so we
+// are more conservative than the updater.
+static const int MinTimeout = 1000;
+// Timeout on an RTU bus. Devices on a bus respond within a few 100 ms or not at all, and each
+// absent slave address blocks the bus for the whole timeout.
+static const int SerialTimeout = 1000;
+// Number of registers read at once while fetching the model map. This is the maximum for a single
+// Modbus request.
+static const int PageSize = 125;
+// The first model (the common model, model 1) starts right after the SunSpec ID at 40000.
+static const quint16 FirstModelRegister = 40002;
+// Number of registers of the common model we use (up to and including the serial number).
+static const int CommonModelSize = 66;
+
 SunspecDetector::SunspecDetector(QObject *parent):
 	AbstractDetector(parent),
+	mSettings(0),
 	mUnitId(0)
 {
 }
 
 SunspecDetector::SunspecDetector(quint8 unitId, QObject *parent):
 	AbstractDetector(parent),
+	mSettings(0),
 	mUnitId(unitId)
 {
 }
 
+SunspecDetector::SunspecDetector(Settings *settings, QObject *parent):
+	AbstractDetector(parent),
+	mSettings(settings),
+	mUnitId(0)
+{
+}
+
 DetectorReply *SunspecDetector::start(const QString &hostName, int timeout)
 {
+	if (mSettings != 0 && ModbusRtuClient::isRtuAddress(hostName))
+		return start(hostName, timeout, mSettings->rtuUnitIds());
 	return start(hostName, timeout, mUnitId);
 }
 
 DetectorReply *SunspecDetector::start(const QString &hostName, int timeout, quint8 unitId)
 {
 	Q_ASSERT(unitId != 0);
+	return start(hostName, timeout, QList<quint8>() << unitId);
+}
 
-	// If we already have a connection to this inverter, then there is
+DetectorReply *SunspecDetector::start(const QString &hostName, int timeout,
+									  const QList<quint8> &unitIds)
+{
+	// If we already have a connection to an inverter, then there is
 	// no need to scan it again.
-	if (SunspecUpdater::hasConnectionTo(hostName, unitId)) {
-		return 0;
+	QList<quint8> ids;
+	foreach (quint8 unitId, unitIds) {
+		if (!SunspecUpdater::hasConnectionTo(hostName, unitId))
+			ids.append(unitId);
 	}
+	if (ids.isEmpty())
+		return 0;
 
-	ModbusTcpClient *client = new ModbusTcpClient(this);
+	bool rtu = ModbusRtuClient::isRtuAddress(hostName);
+	ModbusClient *client = 0;
+	if (rtu) {
+		client = ModbusRtuClient::create(hostName, this);
+		client->setTimeout(qMin(SerialTimeout, timeout));
+	} else {
+		client = new ModbusTcpClient(this);
+		client->setAdaptiveTimeout(qMin(MinTimeout, timeout), timeout);
+	}
 	connect(client, SIGNAL(connected()), this, SLOT(onConnected()));
 	connect(client, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
-	client->setTimeout(timeout);
-	client->connectToServer(hostName);
+	// Probing other units of a gateway must not delay the inverters we are talking to already.
+	client->setPriority(ModbusClient::DetectionPriority);
 	Reply *reply = new Reply(this);
 	reply->client = client;
-	reply->di.networkId = unitId;
+	reply->di.networkId = ids.takeFirst();
 	reply->di.hostName = hostName;
+	reply->unitIds = ids;
 	mClientToReply[client] = reply;
+	// The RTU client reports the state of the bus from the event loop.
+	if (!rtu)
+		static_cast<ModbusTcpClient *>(client)->connectToServer(hostName);
 	return reply;
 }
 
 void SunspecDetector::onConnected()
 {
-	ModbusTcpClient *client = static_cast<ModbusTcpClient *>(sender());
+	ModbusClient *client = static_cast<ModbusClient *>(sender());
 	Reply *di = mClientToReply.value(client);
 	Q_ASSERT(di != 0);
 	di->state = Reply::SunSpecHeader;
@@ -57,10 +105,13 @@ void SunspecDetector::onConnected()
 
 void SunspecDetector::onDisconnected()
 {
-	ModbusTcpClient *client = static_cast<ModbusTcpClient *>(sender());
+	ModbusClient *client = static_cast<ModbusClient *>(sender());
 	Reply *di = mClientToReply.value(client);
-	if (di != 0)
+	if (di != 0) {
+		// Without a connection, there is no point in probing the other units.
+		di->unitIds.clear();
 		setDone(di);
+	}
 }
 
 void SunspecDetector::onFinished()
@@ -82,10 +133,26 @@ void SunspecDetector::onFinished()
 			return;
 		}
 		di->currentRegister += 2;
-		di->state = Reply::ModuleContent;
-		startNextRequest(di, 66);
+		// Fetch the model map in large pages, and parse the models locally.
+		di->state = Reply::ModelPage;
+		startNextRequest(di, PageSize);
 		break;
 	}
+	case Reply::ModelPage:
+		if (reply->error() == ModbusReply::Timeout || reply->error() == ModbusReply::TcpError) {
+			setDone(di);
+			return;
+		}
+		if (reply->error() != ModbusReply::NoException || values.size() < 2) {
+			// Some devices (notably SMA) reject a read which extends past the end of a model,
+			// or past the end of the map. Walk the model headers one by one instead.
+			startModelWalk(di);
+			return;
+		}
+		di->pageStart = di->currentRegister;
+		di->page = values;
+		parsePage(di);
+		break;
 	case Reply::ModuleHeader:
 	{
 		if (values.size() < 2) {
@@ -94,126 +161,190 @@ void SunspecDetector::onFinished()
 			// setResult anyway. This helps SMA inverters which errors
 			// when reading one register past the end, instead of returning
 			// 0xFFFF as most other implementations do.
-			if ( !di->di.productName.isEmpty() && // Model 1 is present
-					di->di.phaseCount > 0 && // Model 1xx present
-					di->di.networkId > 0)
-				di->setResult();
-			setDone(di);
+			setMapDone(di);
 			return;
 		}
 		quint16 modelId = values[0];
 		quint16 modelSize = values[1];
-		di->state = Reply::ModuleHeader;
-		switch (modelId) {
-		case 101:
-		case 102:
-		case 103:
-		case 111:
-		case 112:
-		case 113:
-			di->di.retrievalMode = modelId > 103 ? ProtocolSunSpecFloat : ProtocolSunSpecIntSf;
-			di->di.phaseCount = modelId % 10;
-			di->di.inverterModelOffset = di->currentRegister;
-			break;
-		case 701:
-			// If we already detected a 100-model, stick with that.
-			if (di->di.phaseCount > 0)
-				break;
-			di->di.retrievalMode = ProtocolSunSpec2018;
-			di->di.inverterModelOffset = di->currentRegister;
-			// Call startNextRequest directly and ask for only 3 registers.
-			// This avoids the issue that model 701 is 153 long, too long for
-			// a single request.
-			startNextRequest(di, 3); // We Only need ACType
-			di->state = Reply::ModuleContent;
-			return;
-		case 120: // Nameplate ratings
-		case 702: // IEEE 1547 DERCapacity page
-			// If we already know the max power, no need to fetch it again.
-			if (di->di.maxPower > 0)
-				break;
-			di->state = Reply::ModuleContent;
-			break;
-		case 123: // Immediate controls
-			// SMA is always breaking model 123. Let's completely ignore
-			// model 123 to prevent issues with unreadable registers.
-			// Since model 1 always comes first, the productId will
-			// already be populated.
-			if (di->di.productId != VE_PROD_ID_PV_INVERTER_SMA) {
-				di->di.immediateControlOffset = di->currentRegister;
-				di->state = Reply::ModuleContent;
-			}
-			break;
-		case 0xFFFF:
-			if ( !di->di.productName.isEmpty() && // Model 1 is present
-					di->di.phaseCount > 0 && // Model 1xx present
-					di->di.networkId > 0)
-				di->setResult();
-			setDone(di);
+		if (modelId == 0xFFFF) {
+			setMapDone(di);
 			return;
 		}
-		if (di->state == Reply::ModuleHeader) {
+		quint16 count = processModelHeader(di, modelId, modelSize);
+		if (count == 0) {
 			di->currentRegister += 2 + modelSize;
 			startNextRequest(di, 2);
 		} else {
-			startNextRequest(di, modelSize + 2);
+			di->state = Reply::ModuleContent;
+			startNextRequest(di, count);
 		}
 		break;
 	}
 	case Reply::ModuleContent:
-		if (values.size() < 1) {
+		if (values.size() < 2) {
 			setDone(di);
 			return;
 		}
+		processModelContent(di, values);
 		di->state = Reply::ModuleHeader;
-		quint16 modelId = values[0];
-		switch(modelId) {
-		case 1:
-			if (values.size() == 66) {
-				QString manufacturer = getString(values, 2, 16);
-				if (manufacturer == "Fronius")
-					di->di.productId = VE_PROD_ID_PV_INVERTER_FRONIUS;
-				else if (manufacturer == "SMA")
-					di->di.productId = VE_PROD_ID_PV_INVERTER_SMA;
-				else if ((manufacturer == "ABB") || (manufacturer == "FIMER"))
-					di->di.productId = VE_PROD_ID_PV_INVERTER_ABB;
-				else
-					di->di.productId = VE_PROD_ID_PV_INVERTER_SUNSPEC;
-				QString model = getString(values, 18, 16);
-				di->di.productName = QString("%1 %2").arg(manufacturer).arg(model);
-
-				// Fronius uses 'options' (offset 34) for the data manager version
-				if (di->di.productId == VE_PROD_ID_PV_INVERTER_FRONIUS) {
-					di->di.dataManagerVersion = getString(values, 34, 8);
-				}
-
-				di->di.firmwareVersion = getString(values, 42, 8);
-				di->di.uniqueId = di->di.serialNumber = getString(values, 50, 16);
-			}
-			break;
-		case 701: // DERMeasureAC
-			if (values.size() > 2)
-				di->di.phaseCount = values[2] + 1;
-			break;
-		case 120: // Nameplate ratings
-			if (values.size() > 4)
-				di->di.maxPower = getScaledValue(values, 3, 1, 4, false);
-			if (values.size() > 22)
-				di->di.storageCapacity = getScaledValue(values, 21, 1, 22, false);
+		di->currentRegister += 2 + values[1];
+		startNextRequest(di, 2);
+		break;
+	}
+}
+
+void SunspecDetector::parsePage(Reply *di)
+{
+	for (;;) {
+		QVector<quint16> header = pageValues(di, di->currentRegister, 2);
+		if (header.isEmpty())
 			break;
-		case 702: // DERCapacity, new IEEE 1547 alternative for 120
-			if (values.size() > 45)
-				di->di.maxPower = getScaledValue(values, 2, 1, 45, false);
+		quint16 modelId = header[0];
+		quint16 modelSize = header[1];
+		if (modelId == 0xFFFF) {
+			setMapDone(di);
+			return;
+		}
+		// A page must be able to hold the part of the model we need, or we would never get it.
+		quint16 count = qMin(processModelHeader(di, modelId, modelSize),
+							 static_cast<quint16>(PageSize));
+		if (count > 0) {
+			QVector<quint16> content = pageValues(di, di->currentRegister, count);
+			if (content.isEmpty())
+				break;
+			processModelContent(di, content);
+		}
+		di->currentRegister += 2 + modelSize;
+	}
+	if (di->currentRegister == di->pageStart) {
+		// The device returned less than a model: reading the same page again would not help.
+		startModelWalk(di);
+		return;
+	}
+	// The next page starts at the model which is not (completely) in this one.
+	startNextRequest(di, PageSize);
+}
+
+QVector<quint16> SunspecDetector::pageValues(Reply *di, quint16 startRegister, quint16 count)
+{
+	int offset = startRegister - di->pageStart;
+	if (startRegister < di->pageStart || offset + count > di->page.size())
+		return QVector<quint16>();
+	return di->page.mid(offset, count);
+}
+
+void SunspecDetector::startModelWalk(Reply *di)
+{
+	di->page.clear();
+	if (di->currentRegister == FirstModelRegister) {
+		// Model 1 always comes first, so we can read its contents right away.
+		di->state = Reply::ModuleContent;
+		startNextRequest(di, CommonModelSize);
+	} else {
+		di->state = Reply::ModuleHeader;
+		startNextRequest(di, 2);
+	}
+}
+
+quint16 SunspecDetector::processModelHeader(Reply *di, quint16 modelId, quint16 modelSize)
+{
+	switch (modelId) {
+	case 1:
+		return CommonModelSize;
+	case 101:
+	case 102:
+	case 103:
+	case 111:
+	case 112:
+	case 113:
+		di->di.retrievalMode = modelId > 103 ? ProtocolSunSpecFloat : ProtocolSunSpecIntSf;
+		di->di.phaseCount = modelId % 10;
+		di->di.inverterModelOffset = di->currentRegister;
+		break;
+	case 701:
+		// If we already detected a 100-model, stick with that.
+		if (di->di.phaseCount > 0)
 			break;
-		case 123: // Immediate controls
-			if (values.size() > 23)
-				di->di.powerLimitScale = 100.0 / getScale(values, 23);
+		di->di.retrievalMode = ProtocolSunSpec2018;
+		di->di.inverterModelOffset = di->currentRegister;
+		// Ask for only 3 registers. This avoids the issue that model 701 is 153 long, too long
+		// for a single request.
+		return 3; // We Only need ACType
+	case 120: // Nameplate ratings
+	case 702: // IEEE 1547 DERCapacity page
+		// If we already know the max power, no need to fetch it again.
+		if (di->di.maxPower > 0)
 			break;
+		return modelSize + 2;
+	case 123: // Immediate controls
+		// SMA is always breaking model 123. Let's completely ignore
+		// model 123 to prevent issues with unreadable registers.
+		// Since model 1 always comes first, the productId will
+		// already be populated.
+		if (di->di.productId != VE_PROD_ID_PV_INVERTER_SMA) {
+			di->di.immediateControlOffset = di->currentRegister;
+			return modelSize + 2;
 		}
-		di->currentRegister += 2 + values[1];
-		startNextRequest(di, 2);
 		break;
 	}
+	return 0;
+}
+
+void SunspecDetector::processModelContent(Reply *di, const QVector<quint16> &values)
+{
+	quint16 modelId = values[0];
+	switch(modelId) {
+	case 1:
+		if (values.size() == CommonModelSize) {
+			QString manufacturer = getString(values, 2, 16);
+			if (manufacturer == "Fronius")
+				di->di.productId = VE_PROD_ID_PV_INVERTER_FRONIUS;
+			else if (manufacturer == "SMA")
+				di->di.productId = VE_PROD_ID_PV_INVERTER_SMA;
+			else if ((manufacturer == "ABB") || (manufacturer == "FIMER"))
+				di->di.productId = VE_PROD_ID_PV_INVERTER_ABB;
+			else
+				di->di.productId = VE_PROD_ID_PV_INVERTER_SUNSPEC;
+			QString model = getString(values, 18, 16);
+			di->di.productName = QString("%1 %2").arg(manufacturer).arg(model);
+
+			// Fronius uses 'options' (offset 34) for the data manager version
+			if (di->di.productId == VE_PROD_ID_PV_INVERTER_FRONIUS) {
+				di->di.dataManagerVersion = getString(values, 34, 8);
+			}
+
+			di->di.firmwareVersion = getString(values, 42, 8);
+			di->di.uniqueId = di->di.serialNumber = getString(values, 50, 16);
+		}
+		break;
+	case 701: // DERMeasureAC
+		if (values.size() > 2)
+			di->di.phaseCount = values[2] + 1;
+		break;
+	case 120: // Nameplate ratings
+		if (values.size() > 4)
+			di->di.maxPower = getScaledValue(values, 3, 1, 4, false);
+		if (values.size() > 22)
+			di->di.storageCapacity = getScaledValue(values, 21, 1, 22, false);
+		break;
+	case 702: // DERCapacity, new IEEE 1547 alternative for 120
+		if (values.size() > 45)
+			di->di.maxPower = getScaledValue(values, 2, 1, 45, false);
+		break;
+	case 123: // Immediate controls
+		if (values.size() > 23)
+			di->di.powerLimitScale = 100.0 / getScale(values, 23);
+		break;
+	}
+}
+
+void SunspecDetector::setMapDone(Reply *di)
+{
+	if ( !di->di.productName.isEmpty() && // Model 1 is present
+			di->di.phaseCount > 0 && // Model 1xx present
+			di->di.networkId > 0)
+		di->setResult();
+	setDone(di);
 }
 
 void SunspecDetector::startNextRequest(Reply *di, quint16 regCount)
@@ -224,10 +355,32 @@ void SunspecDetector::startNextRequest(Reply *di, quint16 regCount)
 	connect(reply, SIGNAL(finished()), this, SLOT(onFinished()));
 }
 
+bool SunspecDetector::startNextUnit(Reply *di)
+{
+	while (!di->unitIds.isEmpty()) {
+		quint8 unitId = di->unitIds.takeFirst();
+		// The unit may have been found by another scan in the mean time.
+		if (SunspecUpdater::hasConnectionTo(di->di.hostName, unitId))
+			continue;
+		DeviceInfo info;
+		info.hostName = di->di.hostName;
+		info.networkId = unitId;
+		di->di = info;
+		di->page.clear();
+		di->state = Reply::SunSpecHeader;
+		di->currentRegister = 40000;
+		startNextRequest(di, 2);
+		return true;
+	}
+	return false;
+}
+
 void SunspecDetector::setDone(Reply *di)
 {
 	if (!mClientToReply.contains(di->client))
 		return;
+	if (startNextUnit(di))
+		return;
 	di->setFinished();
 	disconnect(di->client);
 	mClientToReply.remove(di->client);
@@ -238,7 +391,8 @@ SunspecDetector::Reply::Reply(QObject *parent):
 	DetectorReply(parent),
 	client(0),
 	state(SunSpecHeader),
-	currentRegister(0)
+	currentRegister(0),
+	pageStart(0)
 {
 }
 
@@ -2,12 +2,23 @@
 #define SUNSPEC_DETECTOR_H
 
 #include <QAbstractSocket>
+#include <QList>
+#include <QVector>
 #include "abstract_detector.h"
 #include "defines.h"
 
+class ModbusClient;
 class ModbusReply;
-class ModbusTcpClient;
-
+class Settings;
+
+/*!
+ * Detects SunSpec inverters using Modbus TCP, or Modbus RTU if the host name is a serial address
+ * or the address of a serial to ethernet gateway (see `ModbusRtuClient::isRtuAddress`).
+ *
+ * An RTU bus is usually an RS485 bus with several devices, so all slave addresses from the
+ * `rtuUnitIds` setting are probed, one after the other, and the `deviceFound` signal is emitted
+ * for each inverter found.
+ */
 class SunspecDetector : public AbstractDetector
 {
 	Q_OBJECT
@@ -16,8 +27,12 @@ public:
 
 	SunspecDetector(quint8 unitId, QObject *parent = 0);
 
+	/// Creates a detector for serial ports, which probes the slave addresses from `settings`.
+	SunspecDetector(Settings *settings, QObject *parent = 0);
+
 	DetectorReply *start(const QString &hostName, int timeout) override;
 	DetectorReply *start(const QString &hostName, int timeout, quint8 unitId);
+	DetectorReply *start(const QString &hostName, int timeout, const QList<quint8> &unitIds);
 
 	quint8 unitId() const
 	{
@@ -61,22 +76,60 @@ private:
 
 		enum State {
 			SunSpecHeader,
+			/// Reading a page of the model map.
+			ModelPage,
+			/// Walking the map one model header at a time.
 			ModuleHeader,
 			ModuleContent
 		};
 
 		DeviceInfo di;
-		ModbusTcpClient *client;
+		ModbusClient *client;
+		/// Units (slave addresses) still to be probed after the current one.
+		QList<quint8> unitIds;
 		State state;
 		quint16 currentRegister;
+		/// The last page of the model map read, and its start register.
+		QVector<quint16> page;
+		quint16 pageStart;
 	};
 
+	/// Starts probing the next unit. Returns false if there are no units left.
+	bool startNextUnit(Reply *di);
+
 	void startNextRequest(Reply *di, quint16 regCount);
 
+	/*!
+	 * Parses the models in the last page read, starting at `currentRegister`, and reads the next
+	 * page if the map does not end within this one. Falls back to reading the model headers one by
+	 * one if the page does not hold a single model.
+	 */
+	void parsePage(Reply *di);
+
+	/// Returns the values of the given registers from the last page, or nothing if not available.
+	QVector<quint16> pageValues(Reply *di, quint16 startRegister, quint16 count);
+
+	/// Continues with reading the model headers one by one, starting at `currentRegister`.
+	void startModelWalk(Reply *di);
+
+	/*!
+	 * Handles the header of the model at `currentRegister`. Returns the number of registers of the
+	 * model (including the header) needed by `processModelContent`, or 0 if we can skip it.
+	 */
+	quint16 processModelHeader(Reply *di, quint16 modelId, quint16 modelSize);
+
+	/// `values` contains the registers of a model, starting at its header.
+	void processModelContent(Reply *di, const QVector<quint16> &values);
+
+	/// Done with the model map of the current unit. Reports the device if all we need was found.
+	void setMapDone(Reply *di);
+
+	/// Done with the current unit. Finishes the reply if there are no units left.
 	void setDone(Reply *di);
 
-	QHash<ModbusTcpClient *, Reply *> mClientToReply;
+	QHash<ModbusClient *, Reply *> mClientToReply;
 	QHash<ModbusReply *, Reply *> mModbusReplyToReply;
+	Settings *mSettings;
 	quint8 mUnitId;
 };
 
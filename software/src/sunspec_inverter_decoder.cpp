@@ -0,0 +1,155 @@
+#include "froniussolar_api.h"
+#include "sunspec_inverter_decoder.h"
+
+template<typename T>
+struct FieldSpec
+{
+	const char *pointName;
+	double T::*target;
+};
+
+// Models 101-103 and 111-113
+static constexpr FieldSpec<CommonInverterData> InverterCommonFields[] = {
+	{ "A", &CommonInverterData::acCurrent },
+	{ "W", &CommonInverterData::acPower },
+	// sunspec does not provide a voltage for the system as a whole. This does not make a lot of
+	// sense. Since previous versions of dbus-fronius published this value (retrieved via the Solar
+	// API) we use the value from phase 1.
+	{ "PhVphA", &CommonInverterData::acVoltage },
+	{ "WH", &CommonInverterData::totalEnergy }
+};
+
+static constexpr FieldSpec<ThreePhasesInverterData> InverterPhaseFields[] = {
+	{ "AphA", &ThreePhasesInverterData::acCurrentPhase1 },
+	{ "AphB", &ThreePhasesInverterData::acCurrentPhase2 },
+	{ "AphC", &ThreePhasesInverterData::acCurrentPhase3 },
+	{ "PhVphA", &ThreePhasesInverterData::acVoltagePhase1 },
+	{ "PhVphB", &ThreePhasesInverterData::acVoltagePhase2 },
+	{ "PhVphC", &ThreePhasesInverterData::acVoltagePhase3 }
+};
+
+// Model 701
+static constexpr FieldSpec<CommonInverterData> MeasureAcCommonFields[] = {
+	{ "A", &CommonInverterData::acCurrent },
+	{ "W", &CommonInverterData::acPower },
+	{ "LNV", &CommonInverterData::acVoltage },
+	{ "TotWhInj", &CommonInverterData::totalEnergy }
+};
+
+static constexpr FieldSpec<ThreePhasesInverterData> MeasureAcPhaseFields[] = {
+	{ "AL1", &ThreePhasesInverterData::acCurrentPhase1 },
+	{ "AL2", &ThreePhasesInverterData::acCurrentPhase2 },
+	{ "AL3", &ThreePhasesInverterData::acCurrentPhase3 },
+	{ "VL1", &ThreePhasesInverterData::acVoltagePhase1 },
+	{ "VL2", &ThreePhasesInverterData::acVoltagePhase2 },
+	{ "VL3", &ThreePhasesInverterData::acVoltagePhase3 }
+};
+
+template<typename T, int N>
+static bool addFields(const SunspecModel *model, const FieldSpec<T> (&specs)[N],
+					  QVector<SunspecField<T>> &fields)
+{
+	fields.reserve(N);
+	for (const FieldSpec<T> &spec: specs) {
+		const SunspecPoint *point = findSunspecPoint(model, spec.pointName);
+		if (point == 0)
+			return false;
+		SunspecField<T> field;
+		field.point = *point;
+		field.target = spec.target;
+		fields.append(field);
+	}
+	return true;
+}
+
+SunspecInverterDecoder::SunspecInverterDecoder():
+	mModelId(0),
+	mReadCount(0),
+	mPower(),
+	mState(),
+	mStateBias(0)
+{
+}
+
+SunspecInverterDecoder::SunspecInverterDecoder(const DeviceInfo &deviceInfo):
+	mModelId(0),
+	mReadCount(0),
+	mPower(),
+	mState(),
+	mStateBias(0)
+{
+	quint16 modelId = inverterModelId(deviceInfo);
+	const SunspecModel *model = findSunspecModel(modelId);
+	if (model == 0)
+		return;
+	bool threePhase = deviceInfo.phaseCount > 1;
+	bool ok = false;
+	const char *statePoint = 0;
+	if (modelId == 701) {
+		ok = addFields(model, MeasureAcCommonFields, mCommonFields) &&
+			(!threePhase || addFields(model, MeasureAcPhaseFields, mPhaseFields));
+		statePoint = "InvSt";
+		// +1 because 2018 enum is literally off by one from the earlier spec
+		mStateBias = 1;
+		// The model is 153 long, too long for a single modbus request. The first 121 registers
+		// contain everything we care about.
+		mReadCount = 121;
+	} else {
+		ok = addFields(model, InverterCommonFields, mCommonFields) &&
+			(!threePhase || addFields(model, InverterPhaseFields, mPhaseFields));
+		statePoint = "St";
+		mReadCount = deviceInfo.retrievalMode == ProtocolSunSpecFloat ? 62 : 52;
+	}
+	const SunspecPoint *power = findSunspecPoint(model, "W");
+	const SunspecPoint *state = findSunspecPoint(model, statePoint);
+	// The tables are fixed, so this can only fail if they are wrong.
+	Q_ASSERT(ok && power != 0 && state != 0);
+	if (!ok || power == 0 || state == 0) {
+		mCommonFields.clear();
+		mPhaseFields.clear();
+		return;
+	}
+	mPower = *power;
+	mState = *state;
+	mModelId = modelId;
+}
+
+template<typename T>
+void SunspecInverterDecoder::decode(const QVector<quint16> &values,
+									const QVector<SunspecField<T>> &fields, T &data)
+{
+	for (const SunspecField<T> &field: fields)
+		data.*field.target = getPointValue(values, field.point);
+}
+
+void SunspecInverterDecoder::decode(const QVector<quint16> &values, CommonInverterData &data) const
+{
+	decode(values, mCommonFields, data);
+}
+
+void SunspecInverterDecoder::decode(const QVector<quint16> &values,
+									ThreePhasesInverterData &data) const
+{
+	decode(values, mPhaseFields, data);
+}
+
+int SunspecInverterDecoder::operatingState(const QVector<quint16> &values) const
+{
+	return values[mState.offset] + mStateBias;
+}
+
+quint16 SunspecInverterDecoder::inverterModelId(const DeviceInfo &deviceInfo)
+{
+	if (deviceInfo.retrievalMode == ProtocolSunSpec2018)
+		return 701;
+	if (deviceInfo.phaseCount < 1 || deviceInfo.phaseCount > 3)
+		return 0;
+	switch (deviceInfo.retrievalMode) {
+	case ProtocolSunSpecIntSf:
+		return 100 + deviceInfo.phaseCount;
+	case ProtocolSunSpecFloat:
+		return 110 + deviceInfo.phaseCount;
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef SUNSPEC_INVERTER_DECODER_H
+#define SUNSPEC_INVERTER_DECODER_H
+
+#include <QVector>
+#include "defines.h"
+#include "sunspec_models.h"
+
+struct CommonInverterData;
+struct ThreePhasesInverterData;
+
+/// A point in the inverter model, and the member of `T` it is decoded into.
+template<typename T>
+struct SunspecField
+{
+	SunspecPoint point;
+	double T::*target;
+};
+
+/*!
+ * Decodes the inverter model (101-103, 111-113 or 701) as read by `SunspecUpdater`.
+ *
+ * The decoder is created once for a detected device. It looks up the points it needs in the model
+ * tables (see `sunspec_models.h`), for the model and phase count of the device, so decoding a
+ * poll is just a walk over a short list of points.
+ */
+class SunspecInverterDecoder
+{
+public:
+	SunspecInverterDecoder();
+
+	explicit SunspecInverterDecoder(const DeviceInfo &deviceInfo);
+
+	/// Returns false if the inverter model of the device is not supported.
+	bool isValid() const
+	{
+		return mModelId != 0;
+	}
+
+	quint16 modelId() const
+	{
+		return mModelId;
+	}
+
+	/// Number of registers to read, starting at the inverter model, to get all points we need.
+	quint16 readCount() const
+	{
+		return mReadCount;
+	}
+
+	/// The AC power (W) point, used for the fast poll.
+	const SunspecPoint &powerPoint() const
+	{
+		return mPower;
+	}
+
+	/// True if the values of the individual phases are available.
+	bool hasPhases() const
+	{
+		return !mPhaseFields.isEmpty();
+	}
+
+	/// `values` must start at the beginning of the model, and contain `readCount` registers.
+	void decode(const QVector<quint16> &values, CommonInverterData &data) const;
+
+	void decode(const QVector<quint16> &values, ThreePhasesInverterData &data) const;
+
+	/// Returns the operating state, using the enumeration of models 101-113.
+	int operatingState(const QVector<quint16> &values) const;
+
+	/// Returns the SunSpec model ID for the inverter model of the device, or 0 if unknown.
+	static quint16 inverterModelId(const DeviceInfo &deviceInfo);
+
+private:
+	template<typename T>
+	static void decode(const QVector<quint16> &values, const QVector<SunspecField<T>> &fields,
+					   T &data);
+
+	quint16 mModelId;
+	quint16 mReadCount;
+	SunspecPoint mPower;
+	SunspecPoint mState;
+	// Difference between the state reported by the model and the state of models 101-113.
+	int mStateBias;
+	QVector<SunspecField<CommonInverterData>> mCommonFields;
+	QVector<SunspecField<ThreePhasesInverterData>> mPhaseFields;
+};
+
+#endif // SUNSPEC_INVERTER_DECODER_H
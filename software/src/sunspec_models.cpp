@@ -0,0 +1,400 @@
+#include <qnumeric.h>
+#include <string.h>
+#include "sunspec_models.h"
+#include "sunspec_tools.h"
+
+// Point tables of the SunSpec models we use. Taken from the SunSpec information model
+// specification. Points we never read (padding, vendor specific values) are left out.
+
+// Inverter models 101-103 (integer values with scale factors). The layout is the same for single,
+// split and three phase inverters.
+static constexpr SunspecPoint Inverter10xPoints[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "A",			2,	SunspecUint16,		1,	6 },
+	{ "AphA",		3,	SunspecUint16,		1,	6 },
+	{ "AphB",		4,	SunspecUint16,		1,	6 },
+	{ "AphC",		5,	SunspecUint16,		1,	6 },
+	{ "A_SF",		6,	SunspecSunssf,		1,	-1 },
+	{ "PPVphAB",	7,	SunspecUint16,		1,	13 },
+	{ "PPVphBC",	8,	SunspecUint16,		1,	13 },
+	{ "PPVphCA",	9,	SunspecUint16,		1,	13 },
+	{ "PhVphA",		10,	SunspecUint16,		1,	13 },
+	{ "PhVphB",		11,	SunspecUint16,		1,	13 },
+	{ "PhVphC",		12,	SunspecUint16,		1,	13 },
+	{ "V_SF",		13,	SunspecSunssf,		1,	-1 },
+	{ "W",			14,	SunspecInt16,		1,	15 },
+	{ "W_SF",		15,	SunspecSunssf,		1,	-1 },
+	{ "Hz",			16,	SunspecUint16,		1,	17 },
+	{ "Hz_SF",		17,	SunspecSunssf,		1,	-1 },
+	{ "VA",			18,	SunspecInt16,		1,	19 },
+	{ "VA_SF",		19,	SunspecSunssf,		1,	-1 },
+	{ "VAr",		20,	SunspecInt16,		1,	21 },
+	{ "VAr_SF",		21,	SunspecSunssf,		1,	-1 },
+	{ "PF",			22,	SunspecInt16,		1,	23 },
+	{ "PF_SF",		23,	SunspecSunssf,		1,	-1 },
+	{ "WH",			24,	SunspecAcc32,		2,	26 },
+	{ "WH_SF",		26,	SunspecSunssf,		1,	-1 },
+	{ "DCA",		27,	SunspecUint16,		1,	28 },
+	{ "DCA_SF",		28,	SunspecSunssf,		1,	-1 },
+	{ "DCV",		29,	SunspecUint16,		1,	30 },
+	{ "DCV_SF",		30,	SunspecSunssf,		1,	-1 },
+	{ "DCW",		31,	SunspecInt16,		1,	32 },
+	{ "DCW_SF",		32,	SunspecSunssf,		1,	-1 },
+	{ "TmpCab",		33,	SunspecInt16,		1,	37 },
+	{ "TmpSnk",		34,	SunspecInt16,		1,	37 },
+	{ "TmpTrns",	35,	SunspecInt16,		1,	37 },
+	{ "TmpOt",		36,	SunspecInt16,		1,	37 },
+	{ "Tmp_SF",		37,	SunspecSunssf,		1,	-1 },
+	{ "St",			38,	SunspecEnum16,		1,	-1 },
+	{ "StVnd",		39,	SunspecEnum16,		1,	-1 },
+	{ "Evt1",		40,	SunspecBitfield32,	2,	-1 }
+};
+
+// Inverter models 111-113 (float values).
+static constexpr SunspecPoint Inverter11xPoints[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "A",			2,	SunspecFloat32,		2,	-1 },
+	{ "AphA",		4,	SunspecFloat32,		2,	-1 },
+	{ "AphB",		6,	SunspecFloat32,		2,	-1 },
+	{ "AphC",		8,	SunspecFloat32,		2,	-1 },
+	{ "PPVphAB",	10,	SunspecFloat32,		2,	-1 },
+	{ "PPVphBC",	12,	SunspecFloat32,		2,	-1 },
+	{ "PPVphCA",	14,	SunspecFloat32,		2,	-1 },
+	{ "PhVphA",		16,	SunspecFloat32,		2,	-1 },
+	{ "PhVphB",		18,	SunspecFloat32,		2,	-1 },
+	{ "PhVphC",		20,	SunspecFloat32,		2,	-1 },
+	{ "W",			22,	SunspecFloat32,		2,	-1 },
+	{ "Hz",			24,	SunspecFloat32,		2,	-1 },
+	{ "VA",			26,	SunspecFloat32,		2,	-1 },
+	{ "VAr",		28,	SunspecFloat32,		2,	-1 },
+	{ "PF",			30,	SunspecFloat32,		2,	-1 },
+	{ "WH",			32,	SunspecFloat32,		2,	-1 },
+	{ "DCA",		34,	SunspecFloat32,		2,	-1 },
+	{ "DCV",		36,	SunspecFloat32,		2,	-1 },
+	{ "DCW",		38,	SunspecFloat32,		2,	-1 },
+	{ "TmpCab",		40,	SunspecFloat32,		2,	-1 },
+	{ "TmpSnk",		42,	SunspecFloat32,		2,	-1 },
+	{ "TmpTrns",	44,	SunspecFloat32,		2,	-1 },
+	{ "TmpOt",		46,	SunspecFloat32,		2,	-1 },
+	{ "St",			48,	SunspecEnum16,		1,	-1 },
+	{ "StVnd",		49,	SunspecEnum16,		1,	-1 },
+	{ "Evt1",		50,	SunspecBitfield32,	2,	-1 }
+};
+
+// Nameplate ratings
+static constexpr SunspecPoint Nameplate120Points[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "DERTyp",		2,	SunspecEnum16,		1,	-1 },
+	{ "WRtg",		3,	SunspecUint16,		1,	4 },
+	{ "WRtg_SF",	4,	SunspecSunssf,		1,	-1 },
+	{ "VARtg",		5,	SunspecUint16,		1,	6 },
+	{ "VARtg_SF",	6,	SunspecSunssf,		1,	-1 },
+	{ "VArRtgQ1",	7,	SunspecInt16,		1,	11 },
+	{ "VArRtgQ2",	8,	SunspecInt16,		1,	11 },
+	{ "VArRtgQ3",	9,	SunspecInt16,		1,	11 },
+	{ "VArRtgQ4",	10,	SunspecInt16,		1,	11 },
+	{ "VArRtg_SF",	11,	SunspecSunssf,		1,	-1 },
+	{ "ARtg",		12,	SunspecUint16,		1,	13 },
+	{ "ARtg_SF",	13,	SunspecSunssf,		1,	-1 },
+	{ "PFRtgQ1",	14,	SunspecInt16,		1,	18 },
+	{ "PFRtgQ2",	15,	SunspecInt16,		1,	18 },
+	{ "PFRtgQ3",	16,	SunspecInt16,		1,	18 },
+	{ "PFRtgQ4",	17,	SunspecInt16,		1,	18 },
+	{ "PFRtg_SF",	18,	SunspecSunssf,		1,	-1 },
+	{ "WHRtg",		19,	SunspecUint16,		1,	20 },
+	{ "WHRtg_SF",	20,	SunspecSunssf,		1,	-1 },
+	{ "AhrRtg",		21,	SunspecUint16,		1,	22 },
+	{ "AhrRtg_SF",	22,	SunspecSunssf,		1,	-1 },
+	{ "MaxChaRte",	23,	SunspecUint16,		1,	24 },
+	{ "MaxChaRte_SF", 24, SunspecSunssf,	1,	-1 },
+	{ "MaxDisChaRte", 25, SunspecUint16,	1,	26 },
+	{ "MaxDisChaRte_SF", 26, SunspecSunssf,	1,	-1 }
+};
+
+// Immediate controls
+static constexpr SunspecPoint Controls123Points[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "Conn_WinTms", 2,	SunspecUint16,		1,	-1 },
+	{ "Conn_RvrtTms", 3, SunspecUint16,		1,	-1 },
+	{ "Conn",		4,	SunspecEnum16,		1,	-1 },
+	{ "WMaxLimPct",	5,	SunspecUint16,		1,	23 },
+	{ "WMaxLimPct_WinTms", 6, SunspecUint16, 1,	-1 },
+	{ "WMaxLimPct_RvrtTms", 7, SunspecUint16, 1, -1 },
+	{ "WMaxLimPct_RmpTms", 8, SunspecUint16, 1,	-1 },
+	{ "WMaxLim_Ena", 9,	SunspecEnum16,		1,	-1 },
+	{ "OutPFSet",	10,	SunspecInt16,		1,	24 },
+	{ "OutPFSet_WinTms", 11, SunspecUint16,	1,	-1 },
+	{ "OutPFSet_RvrtTms", 12, SunspecUint16, 1,	-1 },
+	{ "OutPFSet_RmpTms", 13, SunspecUint16,	1,	-1 },
+	{ "OutPFSet_Ena", 14, SunspecEnum16,	1,	-1 },
+	{ "VArWMaxPct",	15,	SunspecInt16,		1,	25 },
+	{ "VArMaxPct",	16,	SunspecInt16,		1,	25 },
+	{ "VArAvalPct",	17,	SunspecInt16,		1,	25 },
+	{ "VArPct_WinTms", 18, SunspecUint16,	1,	-1 },
+	{ "VArPct_RvrtTms", 19, SunspecUint16,	1,	-1 },
+	{ "VArPct_RmpTms", 20, SunspecUint16,	1,	-1 },
+	{ "VArPct_Mod",	21,	SunspecEnum16,		1,	-1 },
+	{ "VArPct_Ena",	22,	SunspecEnum16,		1,	-1 },
+	{ "WMaxLimPct_SF", 23, SunspecSunssf,	1,	-1 },
+	{ "OutPFSet_SF", 24, SunspecSunssf,		1,	-1 },
+	{ "VArPct_SF",	25,	SunspecSunssf,		1,	-1 }
+};
+
+// Multiple MPPT inverter extension. The fixed part is followed by a block for each tracker.
+static constexpr SunspecPoint Mppt160Points[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "DCA_SF",		2,	SunspecSunssf,		1,	-1 },
+	{ "DCV_SF",		3,	SunspecSunssf,		1,	-1 },
+	{ "DCW_SF",		4,	SunspecSunssf,		1,	-1 },
+	{ "DCWH_SF",	5,	SunspecSunssf,		1,	-1 },
+	{ "Evt",		6,	SunspecBitfield32,	2,	-1 },
+	{ "N",			8,	SunspecUint16,		1,	-1 },
+	{ "TmsPer",		9,	SunspecUint16,		1,	-1 }
+};
+
+static constexpr SunspecPoint Mppt160ModulePoints[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "IDStr",		1,	SunspecString,		8,	-1 },
+	{ "DCA",		9,	SunspecUint16,		1,	2 },
+	{ "DCV",		10,	SunspecUint16,		1,	3 },
+	{ "DCW",		11,	SunspecUint16,		1,	4 },
+	{ "DCWH",		12,	SunspecAcc32,		2,	5 },
+	{ "Tms",		14,	SunspecUint32,		2,	-1 },
+	{ "Tmp",		16,	SunspecInt16,		1,	-1 },
+	{ "DCSt",		17,	SunspecEnum16,		1,	-1 },
+	{ "DCEvt",		18,	SunspecBitfield32,	2,	-1 }
+};
+
+// DER AC measurement (IEEE 1547-2018)
+static constexpr SunspecPoint MeasureAc701Points[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "ACType",		2,	SunspecEnum16,		1,	-1 },
+	{ "St",			3,	SunspecEnum16,		1,	-1 },
+	{ "InvSt",		4,	SunspecEnum16,		1,	-1 },
+	{ "ConnSt",		5,	SunspecEnum16,		1,	-1 },
+	{ "Alrm",		6,	SunspecBitfield32,	2,	-1 },
+	{ "DERMode",	8,	SunspecBitfield32,	2,	-1 },
+	{ "W",			10,	SunspecInt16,		1,	116 },
+	{ "VA",			11,	SunspecInt16,		1,	118 },
+	{ "Var",		12,	SunspecInt16,		1,	119 },
+	{ "PF",			13,	SunspecInt16,		1,	117 },
+	{ "A",			14,	SunspecInt16,		1,	113 },
+	{ "LLV",		15,	SunspecUint16,		1,	114 },
+	{ "LNV",		16,	SunspecUint16,		1,	114 },
+	{ "Hz",			17,	SunspecUint32,		2,	115 },
+	{ "TotWhInj",	19,	SunspecAcc64,		4,	120 },
+	{ "TotWhAbs",	23,	SunspecAcc64,		4,	120 },
+	{ "TotVarhInj",	27,	SunspecAcc64,		4,	121 },
+	{ "TotVarhAbs",	31,	SunspecAcc64,		4,	121 },
+	{ "TmpAmb",		35,	SunspecInt16,		1,	122 },
+	{ "TmpCab",		36,	SunspecInt16,		1,	122 },
+	{ "TmpSnk",		37,	SunspecInt16,		1,	122 },
+	{ "TmpTrns",	38,	SunspecInt16,		1,	122 },
+	{ "TmpSw",		39,	SunspecInt16,		1,	122 },
+	{ "TmpOt",		40,	SunspecInt16,		1,	122 },
+	{ "WL1",		41,	SunspecInt16,		1,	116 },
+	{ "VAL1",		42,	SunspecInt16,		1,	118 },
+	{ "VarL1",		43,	SunspecInt16,		1,	119 },
+	{ "PFL1",		44,	SunspecInt16,		1,	117 },
+	{ "AL1",		45,	SunspecInt16,		1,	113 },
+	{ "VL1L2",		46,	SunspecUint16,		1,	114 },
+	{ "VL1",		47,	SunspecUint16,		1,	114 },
+	{ "TotWhInjL1",	48,	SunspecAcc64,		4,	120 },
+	{ "TotWhAbsL1",	52,	SunspecAcc64,		4,	120 },
+	{ "WL2",		64,	SunspecInt16,		1,	116 },
+	{ "VAL2",		65,	SunspecInt16,		1,	118 },
+	{ "VarL2",		66,	SunspecInt16,		1,	119 },
+	{ "PFL2",		67,	SunspecInt16,		1,	117 },
+	{ "AL2",		68,	SunspecInt16,		1,	113 },
+	{ "VL2L3",		69,	SunspecUint16,		1,	114 },
+	{ "VL2",		70,	SunspecUint16,		1,	114 },
+	{ "TotWhInjL2",	71,	SunspecAcc64,		4,	120 },
+	{ "TotWhAbsL2",	75,	SunspecAcc64,		4,	120 },
+	{ "WL3",		87,	SunspecInt16,		1,	116 },
+	{ "VAL3",		88,	SunspecInt16,		1,	118 },
+	{ "VarL3",		89,	SunspecInt16,		1,	119 },
+	{ "PFL3",		90,	SunspecInt16,		1,	117 },
+	{ "AL3",		91,	SunspecInt16,		1,	113 },
+	{ "VL3L1",		92,	SunspecUint16,		1,	114 },
+	{ "VL3",		93,	SunspecUint16,		1,	114 },
+	{ "TotWhInjL3",	94,	SunspecAcc64,		4,	120 },
+	{ "TotWhAbsL3",	98,	SunspecAcc64,		4,	120 },
+	{ "ThrotPct",	110, SunspecUint16,		1,	-1 },
+	{ "ThrotSrc",	111, SunspecBitfield32,	2,	-1 },
+	{ "A_SF",		113, SunspecSunssf,		1,	-1 },
+	{ "V_SF",		114, SunspecSunssf,		1,	-1 },
+	{ "Hz_SF",		115, SunspecSunssf,		1,	-1 },
+	{ "W_SF",		116, SunspecSunssf,		1,	-1 },
+	{ "PF_SF",		117, SunspecSunssf,		1,	-1 },
+	{ "VA_SF",		118, SunspecSunssf,		1,	-1 },
+	{ "Var_SF",		119, SunspecSunssf,		1,	-1 },
+	{ "TotWh_SF",	120, SunspecSunssf,		1,	-1 },
+	{ "TotVarh_SF",	121, SunspecSunssf,		1,	-1 },
+	{ "Tmp_SF",		122, SunspecSunssf,		1,	-1 }
+};
+
+// DER capacity (IEEE 1547-2018), the alternative for model 120.
+static constexpr SunspecPoint Capacity702Points[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "WMaxRtg",	2,	SunspecUint16,		1,	45 },
+	{ "WOvrExtRtg",	3,	SunspecUint16,		1,	45 },
+	{ "WOvrExtRtgPF", 4, SunspecUint16,		1,	46 },
+	{ "WUndExtRtg",	5,	SunspecUint16,		1,	45 },
+	{ "WUndExtRtgPF", 6, SunspecUint16,		1,	46 },
+	{ "VAMaxRtg",	7,	SunspecUint16,		1,	47 },
+	{ "VarMaxInjRtg", 8, SunspecUint16,		1,	48 },
+	{ "VarMaxAbsRtg", 9, SunspecUint16,		1,	48 },
+	{ "VNomRtg",	14,	SunspecUint16,		1,	49 },
+	{ "VMaxRtg",	15,	SunspecUint16,		1,	49 },
+	{ "VMinRtg",	16,	SunspecUint16,		1,	49 },
+	{ "AMaxRtg",	17,	SunspecUint16,		1,	50 },
+	{ "WMax",		26,	SunspecUint16,		1,	45 },
+	{ "VAMax",		31,	SunspecUint16,		1,	47 },
+	{ "VNom",		38,	SunspecUint16,		1,	49 },
+	{ "AMax",		41,	SunspecUint16,		1,	50 },
+	{ "W_SF",		45,	SunspecSunssf,		1,	-1 },
+	{ "PF_SF",		46,	SunspecSunssf,		1,	-1 },
+	{ "VA_SF",		47,	SunspecSunssf,		1,	-1 },
+	{ "Var_SF",		48,	SunspecSunssf,		1,	-1 },
+	{ "V_SF",		49,	SunspecSunssf,		1,	-1 },
+	{ "A_SF",		50,	SunspecSunssf,		1,	-1 },
+	{ "S_SF",		51,	SunspecSunssf,		1,	-1 }
+};
+
+// Enter service (IEEE 1547-2018)
+static constexpr SunspecPoint EnterService703Points[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "ES",			2,	SunspecEnum16,		1,	-1 },
+	{ "ESVHi",		3,	SunspecUint16,		1,	17 },
+	{ "ESVLo",		4,	SunspecUint16,		1,	17 },
+	{ "ESHzHi",		5,	SunspecUint32,		2,	18 },
+	{ "ESHzLo",		7,	SunspecUint32,		2,	18 },
+	{ "ESDlyTms",	9,	SunspecUint32,		2,	-1 },
+	{ "ESRndTms",	11,	SunspecUint32,		2,	-1 },
+	{ "ESRmpTms",	13,	SunspecUint32,		2,	-1 },
+	{ "ESDlyRemTms", 15, SunspecUint32,		2,	-1 },
+	{ "V_SF",		17,	SunspecSunssf,		1,	-1 },
+	{ "Hz_SF",		18,	SunspecSunssf,		1,	-1 }
+};
+
+// DER AC controls (IEEE 1547-2018), the alternative for model 123.
+static constexpr SunspecPoint Controls704Points[] = {
+	{ "ID",			0,	SunspecUint16,		1,	-1 },
+	{ "L",			1,	SunspecUint16,		1,	-1 },
+	{ "PFWInjEna",	2,	SunspecEnum16,		1,	-1 },
+	{ "PFWAbsEna",	8,	SunspecEnum16,		1,	-1 },
+	{ "WMaxLimPctEna", 14, SunspecEnum16,	1,	-1 },
+	{ "WMaxLimPct",	15,	SunspecUint16,		1,	52 },
+	{ "WMaxLimPctRvrt", 16, SunspecUint16,	1,	52 },
+	{ "WMaxLimPctEnaRvrt", 17, SunspecEnum16, 1, -1 },
+	{ "WMaxLimPctRvrtTms", 18, SunspecUint32, 2, -1 },
+	{ "WMaxLimPctRvrtRem", 20, SunspecUint32, 2, -1 },
+	{ "WSetEna",	22,	SunspecEnum16,		1,	-1 },
+	{ "WSetMod",	23,	SunspecEnum16,		1,	-1 },
+	{ "WSet",		24,	SunspecInt32,		2,	53 },
+	{ "WSetRvrt",	26,	SunspecInt32,		2,	53 },
+	{ "WSetPct",	28,	SunspecUint16,		1,	54 },
+	{ "WSetPctRvrt", 29, SunspecUint16,		1,	54 },
+	{ "WSetEnaRvrt", 30, SunspecEnum16,		1,	-1 },
+	{ "WSetRvrtTms", 31, SunspecUint32,		2,	-1 },
+	{ "WSetRvrtRem", 33, SunspecUint32,		2,	-1 },
+	{ "VarSetEna",	35,	SunspecEnum16,		1,	-1 },
+	{ "PF_SF",		51,	SunspecSunssf,		1,	-1 },
+	{ "WMaxLimPct_SF", 52, SunspecSunssf,	1,	-1 },
+	{ "WSet_SF",	53,	SunspecSunssf,		1,	-1 },
+	{ "WSetPct_SF",	54,	SunspecSunssf,		1,	-1 },
+	{ "VarSet_SF",	55,	SunspecSunssf,		1,	-1 },
+	{ "VarSetPct_SF", 56, SunspecSunssf,	1,	-1 }
+};
+
+template<int N>
+static constexpr int pointCount(const SunspecPoint (&)[N])
+{
+	return N;
+}
+
+static constexpr SunspecModel Models[] = {
+	{ 101, Inverter10xPoints, pointCount(Inverter10xPoints), 0, 0, 0, 0 },
+	{ 102, Inverter10xPoints, pointCount(Inverter10xPoints), 0, 0, 0, 0 },
+	{ 103, Inverter10xPoints, pointCount(Inverter10xPoints), 0, 0, 0, 0 },
+	{ 111, Inverter11xPoints, pointCount(Inverter11xPoints), 0, 0, 0, 0 },
+	{ 112, Inverter11xPoints, pointCount(Inverter11xPoints), 0, 0, 0, 0 },
+	{ 113, Inverter11xPoints, pointCount(Inverter11xPoints), 0, 0, 0, 0 },
+	{ 120, Nameplate120Points, pointCount(Nameplate120Points), 0, 0, 0, 0 },
+	{ 123, Controls123Points, pointCount(Controls123Points), 0, 0, 0, 0 },
+	{ 160, Mppt160Points, pointCount(Mppt160Points),
+	  Mppt160ModulePoints, pointCount(Mppt160ModulePoints), 10, 20 },
+	{ 701, MeasureAc701Points, pointCount(MeasureAc701Points), 0, 0, 0, 0 },
+	{ 702, Capacity702Points, pointCount(Capacity702Points), 0, 0, 0, 0 },
+	{ 703, EnterService703Points, pointCount(EnterService703Points), 0, 0, 0, 0 },
+	{ 704, Controls704Points, pointCount(Controls704Points), 0, 0, 0, 0 }
+};
+
+const SunspecModel *findSunspecModel(quint16 modelId)
+{
+	for (const SunspecModel &model: Models) {
+		if (model.id == modelId)
+			return &model;
+	}
+	return 0;
+}
+
+static const SunspecPoint *findPoint(const SunspecPoint *points, int count, const char *name)
+{
+	for (int i=0; i<count; ++i) {
+		if (strcmp(points[i].name, name) == 0)
+			return &points[i];
+	}
+	return 0;
+}
+
+const SunspecPoint *findSunspecPoint(const SunspecModel *model, const char *name)
+{
+	return findPoint(model->points, model->pointCount, name);
+}
+
+const SunspecPoint *findSunspecRepeatingPoint(const SunspecModel *model, const char *name)
+{
+	return findPoint(model->repeatingPoints, model->repeatingPointCount, name);
+}
+
+double getPointValue(const QVector<quint16> &values, const SunspecPoint &point, int base,
+					 int blockOffset)
+{
+	int offset = base + blockOffset + point.offset;
+	double value = qQNaN();
+	switch (point.type) {
+	case SunspecInt16:
+	case SunspecInt32:
+		value = getValue(values, offset, point.size, true);
+		break;
+	case SunspecUint16:
+	case SunspecEnum16:
+	case SunspecBitfield16:
+	case SunspecUint32:
+	case SunspecAcc32:
+	case SunspecBitfield32:
+	case SunspecAcc64:
+		value = getValue(values, offset, point.size, false);
+		break;
+	case SunspecFloat32:
+		value = getFloat(values, offset);
+		break;
+	case SunspecSunssf:
+		value = getScale(values, offset);
+		break;
+	default:
+		break;
+	}
+	if (point.scaleOffset >= 0 && qIsFinite(value))
+		value *= getScale(values, base + point.scaleOffset);
+	return value;
+}
@@ -0,0 +1,81 @@
+#ifndef SUNSPEC_MODELS_H
+#define SUNSPEC_MODELS_H
+
+#include <QVector>
+
+/// Data types of SunSpec points, as far as we need them.
+enum SunspecPointType {
+	SunspecInt16,
+	SunspecUint16,
+	SunspecEnum16,
+	SunspecBitfield16,
+	SunspecInt32,
+	SunspecUint32,
+	SunspecAcc32,
+	SunspecBitfield32,
+	SunspecAcc64,
+	SunspecFloat32,
+	SunspecSunssf,
+	SunspecString
+};
+
+/*!
+ * A point (value) in a SunSpec model.
+ *
+ * Offsets are relative to the start of the model, so the model ID is at offset 0 and the model
+ * length at offset 1. For the points in the repeating block of a model (see `SunspecModel`), the
+ * offset is relative to the start of the block, while the scale factor is always in the fixed part
+ * of the model.
+ */
+struct SunspecPoint
+{
+	const char *name;
+	quint16 offset;
+	SunspecPointType type;
+	/// Size in registers.
+	quint16 size;
+	/// Offset of the scale factor, or -1 if the value is not scaled.
+	qint16 scaleOffset;
+};
+
+/*!
+ * Layout of a SunSpec model. The tables are constant and known at compile time; the length of
+ * the model is not part of it, because it is reported by the device itself.
+ */
+struct SunspecModel
+{
+	quint16 id;
+	const SunspecPoint *points;
+	int pointCount;
+	/// Points in the repeating block, if any (eg. one block per MPPT tracker in model 160).
+	const SunspecPoint *repeatingPoints;
+	int repeatingPointCount;
+	/// Offset of the first repeating block, and the size of each block.
+	quint16 repeatingOffset;
+	quint16 repeatingSize;
+};
+
+/*!
+ * Returns the layout of a model, or 0 if we do not know the model.
+ * Supported are the inverter models (101-103, 111-113), nameplate (120), immediate controls
+ * (123), MPPT (160) and the IEEE 1547 models 701-704.
+ */
+const SunspecModel *findSunspecModel(quint16 modelId);
+
+/// Returns the point with the given name in the fixed part of `model`, or 0 if there is none.
+const SunspecPoint *findSunspecPoint(const SunspecModel *model, const char *name);
+
+/// Returns the point with the given name in the repeating block of `model`, or 0 if there is none.
+const SunspecPoint *findSunspecRepeatingPoint(const SunspecModel *model, const char *name);
+
+/*!
+ * Decodes a numeric point, including its scale factor.
+ * @param base Index of the first register of the model in `values`. This may be negative if
+ * `values` does not start at the beginning of the model.
+ * @param blockOffset Offset of the repeating block within the model, for repeating points.
+ * @return The value, or NaN if it is not implemented or not numeric.
+ */
+double getPointValue(const QVector<quint16> &values, const SunspecPoint &point, int base = 0,
+					 int blockOffset = 0);
+
+#endif // SUNSPEC_MODELS_H
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include "sunspec_models.h"
+#include "sunspec_read_plan.h"
+
+SunspecReadPlan::SunspecReadPlan():
+	mGapCost(MaxReadCount)
+{
+}
+
+void SunspecReadPlan::addRange(quint16 startRegister, quint16 count)
+{
+	while (count > 0) {
+		Block range;
+		range.startRegister = startRegister;
+		range.count = qMin(count, static_cast<quint16>(MaxReadCount));
+		mRanges.append(range);
+		startRegister += range.count;
+		count -= range.count;
+	}
+}
+
+void SunspecReadPlan::addPoint(quint16 modelOffset, const SunspecPoint &point)
+{
+	int start = point.offset;
+	int end = point.offset + point.size;
+	if (point.scaleOffset >= 0) {
+		// The scale factor is usually right behind the point (or behind a group of points which
+		// share it). If it is not, it is a separate range, and the plan decides whether it is
+		// worth reading the registers in between.
+		if (point.scaleOffset >= start && point.scaleOffset - end < mGapCost)
+			end = qMax(end, point.scaleOffset + 1);
+		else
+			addRange(modelOffset + point.scaleOffset, 1);
+	}
+	addRange(modelOffset + start, end - start);
+}
+
+void SunspecReadPlan::compile()
+{
+	QVector<Block> ranges = mRanges;
+	std::sort(ranges.begin(), ranges.end(), [](const Block &a, const Block &b) {
+		return a.startRegister < b.startRegister;
+	});
+	// Greedy: extend the current read as long as the result fits in a single read, and the gap is
+	// cheap enough. Since the ranges are sorted, this gives the fewest reads when all gaps may be
+	// read along.
+	mBlocks.clear();
+	foreach (const Block &range, ranges) {
+		if (!mBlocks.isEmpty()) {
+			Block &last = mBlocks.last();
+			int end = last.startRegister + last.count;
+			int rangeEnd = range.startRegister + range.count;
+			int gap = range.startRegister - end;
+			int count = qMax(end, rangeEnd) - last.startRegister;
+			if (gap <= mGapCost && count <= MaxReadCount) {
+				last.count = static_cast<quint16>(count);
+				continue;
+			}
+		}
+		mBlocks.append(range);
+	}
+}
+
+QVector<quint16> SunspecReadPlan::values(const QVector<QVector<quint16>> &blockValues,
+										 quint16 startRegister, quint16 count) const
+{
+	for (int i=0; i<mBlocks.size() && i<blockValues.size(); ++i) {
+		const Block &block = mBlocks[i];
+		if (startRegister < block.startRegister ||
+			startRegister + count > block.startRegister + block.count)
+			continue;
+		int offset = startRegister - block.startRegister;
+		if (blockValues[i].size() < offset + count)
+			return QVector<quint16>();
+		return blockValues[i].mid(offset, count);
+	}
+	return QVector<quint16>();
+}
@@ -0,0 +1,76 @@
+#ifndef SUNSPEC_READ_PLAN_H
+#define SUNSPEC_READ_PLAN_H
+
+#include <QVector>
+
+struct SunspecPoint;
+
+/*!
+ * Computes the holding register reads needed to get a set of SunSpec points at each poll.
+ *
+ * The wanted registers are added as ranges: a (part of a) model, or a single point with its scale
+ * factor. `compile` then joins them into as few reads of at most `MaxReadCount` registers as
+ * possible. Registers between two ranges are read as well if that is cheaper than another request
+ * (see `setGapCost`). A range is never spread over two reads, so its values can be taken from a
+ * single reply (see `values`).
+ */
+class SunspecReadPlan
+{
+public:
+	/// Maximum number of registers in a single read (limited by the Modbus frame size).
+	static const int MaxReadCount = 125;
+
+	struct Block
+	{
+		quint16 startRegister;
+		quint16 count;
+	};
+
+	SunspecReadPlan();
+
+	/*!
+	 * Sets the number of registers which take as long to transfer as an extra request. Gaps up to
+	 * this size between two ranges are read along. The default (`MaxReadCount`) is suitable for
+	 * Modbus TCP, where the round trip time is much larger than the transfer time of a register.
+	 */
+	void setGapCost(int registers)
+	{
+		mGapCost = registers;
+	}
+
+	/// Adds `count` registers. Ranges longer than `MaxReadCount` are split.
+	void addRange(quint16 startRegister, quint16 count);
+
+	/// Adds a point of the model starting at `modelOffset`, and its scale factor.
+	void addPoint(quint16 modelOffset, const SunspecPoint &point);
+
+	/// Computes the reads from the ranges added so far.
+	void compile();
+
+	/// The reads, ordered by start register. Valid after `compile`.
+	const QVector<Block> &blocks() const
+	{
+		return mBlocks;
+	}
+
+	bool isEmpty() const
+	{
+		return mBlocks.isEmpty();
+	}
+
+	/*!
+	 * Returns the values of a range added to the plan.
+	 * @param blockValues The reply to each read in `blocks`.
+	 * @return The values, or an empty vector if the range is not part of a single read, or the
+	 * reply was too short.
+	 */
+	QVector<quint16> values(const QVector<QVector<quint16>> &blockValues, quint16 startRegister,
+							quint16 count) const;
+
+private:
+	QVector<Block> mRanges;
+	QVector<Block> mBlocks;
+	int mGapCost;
+};
+
+#endif // SUNSPEC_READ_PLAN_H
@@ -5,10 +5,15 @@
 double getScaledValue(const QVector<quint16> &values, int offset, int size, int scaleOffset,
 					  bool isSigned)
 {
-	Q_ASSERT(size > 0 && size < 5);
 	double scale = getScale(values, scaleOffset);
 	if (!qIsFinite(scale))
 		return qQNaN();
+	return getValue(values, offset, size, isSigned) * scale;
+}
+
+double getValue(const QVector<quint16> &values, int offset, int size, bool isSigned)
+{
+	Q_ASSERT(size > 0 && size < 5);
 
 	// Convert registers to a 64-bit integer
 	quint64 v = 0;
@@ -37,10 +42,9 @@ double getScaledValue(const QVector<quint16> &values, int offset, int size, int
 		break;
 
 	}
-	double value = isSigned ?
+	return isSigned ?
 		static_cast<double>(size==1?static_cast<qint16>(v):(size==2?static_cast<qint32>(v):static_cast<qint64>(v))) :
 		static_cast<double>(v);
-	return value * scale;
 }
 
 double getFloat(const QVector<quint16> &values, int offset)
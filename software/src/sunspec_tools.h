@@ -7,6 +7,9 @@
 double getScaledValue(const QVector<quint16> &values, int offset, int size,
 					  int scaleOffset, bool isSigned);
 
+/// Returns the (unscaled) integer value of `size` registers, or NaN if it is not implemented.
+double getValue(const QVector<quint16> &values, int offset, int size, bool isSigned);
+
 double getScale(const QVector<quint16> &values, int offset);
 
 double getFloat(const QVector<quint16> &values, int offset);
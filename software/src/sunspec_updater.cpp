@@ -6,49 +6,100 @@
 #include "inverter.h"
 #include "sunspec_updater.h"
 #include "inverter_settings.h"
+#include "modbus_rtu_client.h"
 #include "modbus_tcp_client.h"
 #include "modbus_reply.h"
+#include "modbus_statistics_info.h"
 #include "power_info.h"
-#include "sunspec_tools.h"
+#include "sunspec_models.h"
 #include "logging.h"
 
 // The PV inverter will reset the power limit to maximum after this interval. The reset will cause
 // the power of the inverter to increase (or stay at its current value), so a large value for the
 // timeout is pretty safe.
 const int PowerLimitTimeout = 120;
+// Time (in s) before PowerLimitTimeout expires at which the power limit is written again.
+static const int PowerLimitRefreshMargin = 30;
 // This value used to be bigger to prevent old Fronius firmware from running (the resolution of
 // the power limiter was 1%. New Versions support precision of 0.01%. However, since a change in
 // the algorithm in hub4control, 1% should only work.
 static const int PowerLimitScale = 100;
+// Maximum number of requests sent to the inverter before the reply to the first one comes in. We
+// use this to send the power limit and the read back of the inverter model in one go, saving a
+// round trip for each power limit update.
+static const int MaxInFlight = 4;
+// Time allowed for setting up the TCP connection. This is independent of the request timeout:
+// connecting does not involve the (possibly slow) inverter firmware, just the TCP stack.
+static const int ConnectTimeout = 3000;
+// Maximum number of registers read by the fast poll. The power and its scale factor must be close
+// together for the fast poll to be worthwhile.
+static const int MaxPowerReadCount = 4;
+// Number of registers which take as long to transfer as a request on an RTU bus. At 9600 baud a
+// register takes about 2 ms, while a request costs about 60 ms (frame overhead, inter-frame gaps
+// and the response time of the device).
+static const int RtuGapCost = 30;
 
 QList<SunspecUpdater*> SunspecUpdater::mUpdaters;
+ModbusRegisterImage SunspecUpdater::mRegisterImage;
+
+static ModbusClient *createModbusClient(const QString &hostName, QObject *parent)
+{
+	if (ModbusRtuClient::isRtuAddress(hostName))
+		return ModbusRtuClient::create(hostName, parent);
+	return new ModbusTcpClient(parent);
+}
 
 SunspecUpdater::SunspecUpdater(Inverter *inverter, InverterSettings *settings, QObject *parent):
 	QObject(parent),
 	mInverter(inverter),
 	mSettings(settings),
-	mModbusClient(new ModbusTcpClient(this)),
+	mModbusClient(createModbusClient(inverter->hostName(), this)),
+	mTcpClient(0),
 	mTimer(new QTimer(this)),
 	mPowerLimitTimer(new QTimer(this)),
+	mFastPollTimer(new QTimer(this)),
 	mDataProcessor(new DataProcessor(inverter, settings, this)),
+	mDecoder(inverter->deviceInfo()),
 	mCurrentState(Idle),
-	mPowerLimitPct(1.0),
+	mInverterSleeping(false),
 	mRetryCount(0),
-	mWritePowerLimitRequested(false)
+	mCombinedWriteSupported(true),
+	mPlanRound(0),
+	mPlanPending(0),
+	mPlanFailed(false),
+	mLimiterReadback(true),
+	mLimiterSeenEnabled(false),
+	mFastPollPending(false)
 {
 	Q_ASSERT(inverter != 0);
 	connectModbusClient();
-	mModbusClient->setTimeout(5000);
-	mModbusClient->connectToServer(inverter->hostName());
+	onModbusTimeoutChanged();
+	onPollIntervalChanged();
+	// Inverters on an RTU bus share it with the other devices on the bus (see ModbusRtuBus).
+	// The bus is opened once, so there is nothing to configure or connect here.
+	if (!ModbusRtuClient::isRtuAddress(inverter->hostName())) {
+		mTcpClient = static_cast<ModbusTcpClient *>(mModbusClient);
+		mTcpClient->setMaxInFlight(MaxInFlight);
+		mTcpClient->setConnectTimeout(ConnectTimeout);
+		// Let the client handle reconnects, so it can back off when the inverter is unreachable.
+		mTcpClient->setAutoReconnect(true);
+		mTcpClient->connectToServer(inverter->hostName());
+	}
+	new ModbusStatisticsInfo(inverter->root()->itemGetOrCreate("Debug/Modbus", false),
+							 &mModbusClient->statistics(), this);
 	connect(
 		mInverter, SIGNAL(powerLimitRequested(double)),
 		this, SLOT(onPowerLimitRequested(double)));
 	mTimer->setSingleShot(true);
 	connect(mTimer, SIGNAL(timeout()), this, SLOT(onTimer()));
 	mPowerLimitTimer->setSingleShot(true);
-	mPowerLimitTimer->setInterval(60000);
-	connect(mPowerLimitTimer, SIGNAL(timeout()), this, SLOT(onPowerLimitExpired()));
+	connect(mPowerLimitTimer, SIGNAL(timeout()), this, SLOT(onPowerLimitTimer()));
+	mPowerLimitCoalescer.setRefreshInterval((PowerLimitTimeout - PowerLimitRefreshMargin) * 1000);
+	mFastPollTimer->setSingleShot(true);
+	connect(mFastPollTimer, SIGNAL(timeout()), this, SLOT(onFastPollTimer()));
 	connect(mSettings, SIGNAL(phaseChanged()), this, SLOT(onPhaseChanged()));
+	connect(mSettings, SIGNAL(modbusTimeoutChanged()), this, SLOT(onModbusTimeoutChanged()));
+	connect(mSettings, SIGNAL(pollIntervalChanged()), this, SLOT(onPollIntervalChanged()));
 
 	mUpdaters.append(this);
 }
@@ -58,6 +109,9 @@ SunspecUpdater::~SunspecUpdater()
 	// If the updater is being deleted, the connection is lost. Remove the
 	// updater from static member mUpdaters.
 	mUpdaters.removeAll(this);
+	quint8 unitId = registerImageUnitId();
+	if (unitId != 0)
+		mRegisterImage.removeUnit(unitId);
 }
 
 void SunspecUpdater::startNextAction(ModbusState state)
@@ -70,9 +124,19 @@ void SunspecUpdater::startNextAction(ModbusState state)
 		break;
 	case WritePowerLimit:
 	{
-		writePowerLimit(mPowerLimitPct);
-		mInverter->setPowerLimit(mPowerLimitPct * deviceInfo.maxPower);
-		mPowerLimitTimer->start();
+		double powerLimitPct = mPowerLimitCoalescer.value();
+		mInverter->setPowerLimit(powerLimitPct * deviceInfo.maxPower);
+		// The reply of the read back of the inverter model will take us to the next state.
+		mCurrentState = ReadPowerAndVoltage;
+		if (!writePowerLimitAndRead(powerLimitPct)) {
+			writePowerLimit(powerLimitPct);
+			// Pipeline the read back of the inverter model, instead of waiting for the write to
+			// complete.
+			readPowerAndVoltage();
+		}
+		// A request coming in while the write is in progress will be handled in the next cycle.
+		mPowerLimitCoalescer.setWritten();
+		updatePowerLimitTimer();
 		break;
 	}
 	case Idle:
@@ -86,13 +150,22 @@ void SunspecUpdater::startNextAction(ModbusState state)
 
 void SunspecUpdater::startIdleTimer()
 {
-	mTimer->setInterval(mCurrentState == Idle ? 1000 : 5000);
+	if (mCurrentState == Idle) {
+		// Keep polling at the highest rate while a power limit is active: the control loop
+		// setting the limit needs to see its effect.
+		mPollScheduler.setPowerLimitActive(mPowerLimitCoalescer.isActive());
+		mTimer->setInterval(mPollScheduler.interval());
+	} else {
+		mTimer->setInterval(5000);
+	}
 	mTimer->start();
 }
 
 void SunspecUpdater::setInverterState(int sunSpecState)
 {
 	int froniusState = 0;
+	mInverterSleeping = sunSpecState == SunspecOff || sunSpecState == SunspecSleeping ||
+		sunSpecState == SunspecShutdown || sunSpecState == SunspecStandby;
 	switch (sunSpecState) {
 	case SunspecOff:
 		froniusState = 0;
@@ -121,11 +194,54 @@ void SunspecUpdater::setInverterState(int sunSpecState)
 	mInverter->setStatusCode(froniusState);
 }
 
-void SunspecUpdater::readHoldingRegisters(quint16 startRegister, quint16 count)
+void SunspecUpdater::prepareReadPlan()
 {
+	mReadPlan = SunspecReadPlan();
+	// Reading registers we do not need is cheap on a network, but not on a slow serial bus.
+	if (mTcpClient == 0)
+		mReadPlan.setGapCost(RtuGapCost);
+	planReads(mReadPlan);
+	mReadPlan.compile();
 	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
-	ModbusReply *reply = mModbusClient->readHoldingRegisters(deviceInfo.networkId, startRegister, count);
-	connect(reply, SIGNAL(finished()), this, SLOT(onReadCompleted()));
+	foreach (const SunspecReadPlan::Block &block, mReadPlan.blocks()) {
+		mPlanRequests.append(mModbusClient->prepareReadHoldingRegisters(
+			deviceInfo.networkId, block.startRegister, block.count));
+	}
+	mPlanValues.resize(mPlanRequests.size());
+}
+
+void SunspecUpdater::runReadPlan()
+{
+	if (mPlanRequests.isEmpty())
+		prepareReadPlan();
+	// Replies of an earlier round (eg. from before a reconnect) are ignored.
+	quint32 round = ++mPlanRound;
+	mPlanPending = mPlanRequests.size();
+	mPlanFailed = false;
+	// This is done at every poll, so we use prepared requests and the handler API (which allows
+	// the client to reuse the reply). The client is our child, so the handler will not be called
+	// after we are destroyed. The requests are pipelined by the client.
+	for (int i=0; i<mPlanRequests.size(); ++i) {
+		mModbusClient->send(mPlanRequests[i], [this, round, i](ModbusReply *reply) {
+			onPlanReadCompleted(round, i, reply);
+		});
+	}
+}
+
+void SunspecUpdater::planReads(SunspecReadPlan &plan)
+{
+	planInverterModel(plan);
+	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
+	if (deviceInfo.immediateControlOffset != 0 && mLimiterReadback) {
+		// Read back the state of the power limiter, so we notice when the inverter has dropped
+		// the limit.
+		plan.addPoint(deviceInfo.immediateControlOffset, limiterEnabledPoint());
+	}
+}
+
+void SunspecUpdater::planInverterModel(SunspecReadPlan &plan)
+{
+	plan.addRange(mInverter->deviceInfo().inverterModelOffset, mDecoder.readCount());
 }
 
 void SunspecUpdater::writeMultipleHoldingRegisters(quint16 startReg, const QVector<quint16> &values)
@@ -157,17 +273,107 @@ void SunspecUpdater::handleError()
 	startIdleTimer();
 }
 
-void SunspecUpdater::onReadCompleted()
+void SunspecUpdater::onReadCompleted(ModbusReply *reply)
 {
-	ModbusReply *reply = static_cast<ModbusReply *>(sender());
-	reply->deleteLater();
 	if (!handleModbusError(reply))
 		return;
 
 	QVector<quint16> values = reply->registers();
 
+	// The read combined with the power limit starts at the inverter model.
+	quint8 unitId = registerImageUnitId();
+	if (unitId != 0)
+		mRegisterImage.update(unitId, mInverter->deviceInfo().inverterModelOffset, values);
+
+	processInverterModel(values);
+}
+
+void SunspecUpdater::onPlanReadCompleted(quint32 round, int block, ModbusReply *reply)
+{
+	if (round != mPlanRound)
+		return;
+	ModbusReply::ExceptionCode error = reply->error();
+	if (error == ModbusReply::NoException)
+		mPlanValues[block] = reply->registers();
+	else
+		mPlanFailed = true;
+	if (error == ModbusReply::IllegalDataAddress && mLimiterReadback &&
+		mInverter->deviceInfo().immediateControlOffset != 0) {
+		// Some inverters do not allow reading (some of) the immediate controls. Fall back to
+		// reading the inverter model only.
+		qWarning() << "Could not read back the power limiter state" << mInverter->location();
+		mLimiterReadback = false;
+		// The plan will be computed again at the next poll.
+		mPlanRequests.clear();
+	}
+	if (--mPlanPending > 0)
+		return;
+	if (mPlanFailed) {
+		handleError();
+		return;
+	}
+
 	mRetryCount = 0;
 
+	const QVector<SunspecReadPlan::Block> &blocks = mReadPlan.blocks();
+	quint8 unitId = registerImageUnitId();
+	if (unitId != 0) {
+		for (int i=0; i<blocks.size(); ++i)
+			mRegisterImage.update(unitId, blocks[i].startRegister, mPlanValues[i]);
+	}
+
+	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
+	if (deviceInfo.immediateControlOffset != 0) {
+		QVector<quint16> enabled = mReadPlan.values(
+			mPlanValues, deviceInfo.immediateControlOffset + limiterEnabledPoint().offset, 1);
+		if (!enabled.isEmpty())
+			checkLimiterState(enabled[0]);
+	}
+
+	processInverterModel(mReadPlan.values(mPlanValues, deviceInfo.inverterModelOffset,
+										  mDecoder.readCount()));
+}
+
+void SunspecUpdater::checkLimiterState(quint16 enabled)
+{
+	// Not all inverters report the state of the limiter, so a disabled limiter is only taken
+	// seriously if we have seen it enabled before.
+	if (!mPowerLimitCoalescer.isActive() || mPowerLimitCoalescer.isFullWriteNeeded()) {
+		mLimiterSeenEnabled = false;
+		return;
+	}
+	if (enabled == 1) {
+		mLimiterSeenEnabled = true;
+	} else if (enabled == 0 && mLimiterSeenEnabled) {
+		// The inverter has dropped the limit, eg. because it has been restarted, or someone else
+		// has disabled it. Enable it again.
+		qWarning() << "Power limit disabled by inverter, enabling it again" << mInverter->location();
+		mLimiterSeenEnabled = false;
+		mPowerLimitCoalescer.invalidate();
+	}
+}
+
+const SunspecPoint &SunspecUpdater::limiterEnabledPoint()
+{
+	static const SunspecPoint *point = findLimiterEnabledPoint();
+	return *point;
+}
+
+const SunspecPoint *SunspecUpdater::findLimiterEnabledPoint()
+{
+	const SunspecModel *model = findSunspecModel(123);
+	const SunspecPoint *point = model == 0 ? 0 : findSunspecPoint(model, "WMaxLim_Ena");
+	// The tables are fixed, so this can only fail if they are wrong.
+	Q_ASSERT(point != 0);
+	if (point == 0) {
+		static const SunspecPoint fallback = { "WMaxLim_Ena", 9, SunspecEnum16, 1, -1 };
+		return &fallback;
+	}
+	return point;
+}
+
+void SunspecUpdater::processInverterModel(const QVector<quint16> &values)
+{
 	ModbusState nextState = mCurrentState;
 	switch (mCurrentState) {
 	case ReadPowerAndVoltage:
@@ -180,7 +386,8 @@ void SunspecUpdater::onReadCompleted()
 			break;
 		}
 
-		nextState = mWritePowerLimitRequested ? WritePowerLimit : Idle;
+		mPollScheduler.update(mInverter->meanPowerInfo()->power(), mInverterSleeping);
+		nextState = mPowerLimitCoalescer.isWritePending() ? WritePowerLimit : Idle;
 		break;
 	}
 	default:
@@ -195,7 +402,12 @@ void SunspecUpdater::onWriteCompleted()
 {
 	ModbusReply *reply = static_cast<ModbusReply *>(sender());
 	reply->deleteLater();
-	mWritePowerLimitRequested = false;
+	if (reply->error() != ModbusReply::NoException)
+		mPowerLimitCoalescer.invalidate();
+	// If a read is pending, it has been pipelined with the write. Its reply will arrive after
+	// this one.
+	if (mCurrentState == ReadPowerAndVoltage)
+		return;
 	startNextAction(ReadPowerAndVoltage);
 }
 
@@ -208,16 +420,66 @@ void SunspecUpdater::onPowerLimitRequested(double value)
 	// An invalid power limit means that power limiting is not supported. So we ignore the request.
 	if (!qIsFinite(mInverter->powerLimit()))
 		return;
-	mPowerLimitPct = qBound(0.0, value / deviceInfo.maxPower, 1.0);
-	if (mTimer->isActive()) {
-		mTimer->stop();
-		if (mCurrentState == Idle) {
-			startNextAction(WritePowerLimit);
-			return; // Skip setting of mWritePowerLimitRequested
+	mPowerLimitCoalescer.setScale(powerLimitScale);
+	mPowerLimitCoalescer.setDeadband(mSettings->powerLimitDeadband() / deviceInfo.maxPower);
+	// Most requests repeat the current limit, and need not be written.
+	if (mPowerLimitCoalescer.request(qBound(0.0, value / deviceInfo.maxPower, 1.0)))
+		startPowerLimitWrite();
+}
+
+void SunspecUpdater::startPowerLimitWrite()
+{
+	// If the timer is not active, a poll is in progress. The limit will be written when it is done.
+	if (!mTimer->isActive())
+		return;
+	mTimer->stop();
+	startNextAction(mCurrentState == Idle ? WritePowerLimit : mCurrentState);
+}
+
+void SunspecUpdater::updatePowerLimitTimer()
+{
+	int interval = mPowerLimitCoalescer.nextCheck();
+	if (interval < 0) {
+		mPowerLimitTimer->stop();
+		mFastPollTimer->stop();
+	} else {
+		mPowerLimitTimer->start(interval);
+		startFastPollTimer();
+	}
+}
+
+void SunspecUpdater::startFastPollTimer()
+{
+	int interval = mSettings->fastPollInterval();
+	if (interval <= 0 || !mPowerLimitCoalescer.isActive() || mFastPollPending ||
+		mFastPollTimer->isActive())
+		return;
+	mFastPollTimer->start(interval);
+}
+
+void SunspecUpdater::onFastPollTimer()
+{
+	// The regular polls continue during the fast poll: they keep the other values up to date,
+	// write the power limit, and detect connection problems.
+	if (!mPowerLimitCoalescer.isActive() || !mModbusClient->isConnected())
+		return;
+	mFastPollPending = readPower();
+}
+
+void SunspecUpdater::onPowerReadCompleted(ModbusReply *reply)
+{
+	mFastPollPending = false;
+	if (reply->error() == ModbusReply::NoException) {
+		QVector<quint16> values = reply->registers();
+		double power = qQNaN();
+		if (values.size() == powerReadCount()) {
+			const SunspecPoint &point = mDecoder.powerPoint();
+			power = getPointValue(values, point, -point.offset);
 		}
-		startNextAction(mCurrentState);
+		if (qIsFinite(power))
+			mDataProcessor->processPower(power);
 	}
-	mWritePowerLimitRequested = true;
+	startFastPollTimer();
 }
 
 void SunspecUpdater::onConnected()
@@ -227,6 +489,9 @@ void SunspecUpdater::onConnected()
 
 void SunspecUpdater::onDisconnected()
 {
+	mPollScheduler.reset();
+	// The inverter may have been restarted, in which case the limit must be enabled again.
+	mPowerLimitCoalescer.invalidate();
 	mCurrentState = ReadPowerAndVoltage;
 	handleError();
 }
@@ -234,15 +499,27 @@ void SunspecUpdater::onDisconnected()
 void SunspecUpdater::onTimer()
 {
 	Q_ASSERT(!mTimer->isActive());
+	// If we are not connected, the client is trying to reconnect, and will emit `connected` when
+	// it succeeds.
 	if (mModbusClient->isConnected())
 		startNextAction(mCurrentState == Idle ? ReadPowerAndVoltage : mCurrentState);
-	else
-		mModbusClient->connectToServer(mInverter->hostName());
 }
 
-void SunspecUpdater::onPowerLimitExpired()
+void SunspecUpdater::onPowerLimitTimer()
 {
-	disablePowerLimiting();
+	switch (mPowerLimitCoalescer.check()) {
+	case PowerLimitCoalescer::Expire:
+		// The control loop has stopped sending requests.
+		mPowerLimitCoalescer.reset();
+		disablePowerLimiting();
+		break;
+	case PowerLimitCoalescer::Refresh:
+		startPowerLimitWrite();
+		break;
+	default:
+		break;
+	}
+	updatePowerLimitTimer();
 }
 
 void SunspecUpdater::disablePowerLimiting()
@@ -251,7 +528,8 @@ void SunspecUpdater::disablePowerLimiting()
 	// PV-inverter and its configuration, this will either cause it to go to
 	// full power, or to go to zero.
 	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
-	writeMultipleHoldingRegisters(deviceInfo.immediateControlOffset + 9, QVector<quint16>() << 0);
+	writeMultipleHoldingRegisters(deviceInfo.immediateControlOffset + limiterEnabledPoint().offset,
+								  QVector<quint16>() << 0);
 	mInverter->setPowerLimit(deviceInfo.maxPower);
 }
 
@@ -264,6 +542,18 @@ void SunspecUpdater::onPhaseChanged()
 	mInverter->l3PowerInfo()->resetValues();
 }
 
+void SunspecUpdater::onModbusTimeoutChanged()
+{
+	mModbusClient->setAdaptiveTimeout(mSettings->modbusMinTimeout(),
+									  mSettings->modbusMaxTimeout());
+}
+
+void SunspecUpdater::onPollIntervalChanged()
+{
+	mPollScheduler.setBounds(mSettings->pollIntervalMin(), mSettings->pollIntervalMax());
+	mPollScheduler.setMaxPower(mInverter->deviceInfo().maxPower);
+}
+
 void SunspecUpdater::connectModbusClient()
 {
 	connect(mModbusClient, SIGNAL(connected()), this, SLOT(onConnected()));
@@ -293,107 +583,143 @@ bool SunspecUpdater::hasConnectionTo(QString host, int id)
 
 void SunspecUpdater::readPowerAndVoltage()
 {
-	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
-	if (deviceInfo.retrievalMode == ProtocolSunSpecFloat)
-		readHoldingRegisters(deviceInfo.inverterModelOffset, 62);
-	else
-		readHoldingRegisters(deviceInfo.inverterModelOffset, 52);
+	runReadPlan();
+}
+
+bool SunspecUpdater::readPower()
+{
+	if (!mPowerRequest.isValid()) {
+		// W and W_SF in the integer models, the float W in the float models.
+		quint16 count = powerReadCount();
+		if (count == 0)
+			return false;
+		const DeviceInfo &deviceInfo = mInverter->deviceInfo();
+		mPowerRequest = mModbusClient->prepareReadHoldingRegisters(
+			deviceInfo.networkId, deviceInfo.inverterModelOffset + mDecoder.powerPoint().offset,
+			count);
+	}
+	mModbusClient->send(mPowerRequest, [this](ModbusReply *reply) { onPowerReadCompleted(reply); });
+	return true;
 }
 
 void SunspecUpdater::writePowerLimit(double powerLimitPct)
 {
 	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
+	writeMultipleHoldingRegisters(deviceInfo.immediateControlOffset + 5,
+								  powerLimitValues(powerLimitPct));
+}
+
+bool SunspecUpdater::writePowerLimitAndRead(double powerLimitPct)
+{
+	if (!mCombinedWriteSupported || !mSettings->combinedPowerLimitWrite())
+		return false;
+	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
+	mModbusClient->readWriteMultipleRegisters(
+		deviceInfo.networkId, deviceInfo.inverterModelOffset, mDecoder.readCount(),
+		deviceInfo.immediateControlOffset + 5, powerLimitValues(powerLimitPct),
+		[this](ModbusReply *reply) { onWriteAndReadCompleted(reply); });
+	return true;
+}
 
+void SunspecUpdater::onWriteAndReadCompleted(ModbusReply *reply)
+{
+	if (reply->error() != ModbusReply::NoException)
+		mPowerLimitCoalescer.invalidate();
+	if (reply->error() == ModbusReply::IllegalFunction) {
+		qWarning() << "Inverter does not support Read/Write Multiple Registers,"
+				   << "using separate requests" << mInverter->location();
+		mCombinedWriteSupported = false;
+		startNextAction(WritePowerLimit);
+		return;
+	}
+	onReadCompleted(reply);
+}
+
+bool SunspecUpdater::findProxyTarget(quint8 unitId, ModbusTcpProxy::Target *target)
+{
+	if (unitId == 0)
+		return false;
+	foreach (SunspecUpdater *u, mUpdaters) {
+		// The proxy forwards requests using Modbus TCP only.
+		if (u->mTcpClient == 0)
+			continue;
+		if (u->registerImageUnitId() == unitId) {
+			target->hostName = u->mInverter->hostName();
+			target->tcpPort = u->mTcpClient->portName();
+			target->unitId = static_cast<quint8>(u->mInverter->networkId());
+			return true;
+		}
+	}
+	return false;
+}
+
+quint8 SunspecUpdater::registerImageUnitId() const
+{
+	// Unit IDs above 247 are reserved.
+	int deviceInstance = mInverter->deviceInstance();
+	return deviceInstance > 0 && deviceInstance <= 247 ? static_cast<quint8>(deviceInstance) : 0;
+}
+
+quint16 SunspecUpdater::powerReadCount() const
+{
+	if (!mDecoder.isValid())
+		return 0;
+	const SunspecPoint &point = mDecoder.powerPoint();
+	int end = point.offset + point.size;
+	if (point.scaleOffset >= 0) {
+		if (point.scaleOffset < point.offset)
+			return 0;
+		end = qMax(end, point.scaleOffset + 1);
+	}
+	int count = end - point.offset;
+	return count <= MaxPowerReadCount ? static_cast<quint16>(count) : 0;
+}
+
+QVector<quint16> SunspecUpdater::powerLimitValues(double powerLimitPct) const
+{
+	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
 	QVector<quint16> values;
 	quint16 pct = static_cast<quint16>(qRound(powerLimitPct * deviceInfo.powerLimitScale));
 	values.append(pct);
+	// Once the limit has been enabled, changing the percentage is enough.
+	if (!mPowerLimitCoalescer.isFullWriteNeeded())
+		return values;
 	values.append(0); // unused
 	values.append(PowerLimitTimeout);
 	values.append(0); // unused
 	values.append(1); // enabled power throttle mode
-	writeMultipleHoldingRegisters(deviceInfo.immediateControlOffset + 5, values);
+	return values;
 }
 
 bool SunspecUpdater::parsePowerAndVoltage(QVector<quint16> values)
 {
-	int modelId = values[0];
-	const DeviceInfo &deviceInfo = mInverter->deviceInfo();
-	ProtocolType retrievalMode = modelId > 103 ? ProtocolSunSpecFloat : ProtocolSunSpecIntSf;
-	int phaseCount = modelId % 10;
-	if (retrievalMode != deviceInfo.retrievalMode || phaseCount != deviceInfo.phaseCount) {
+	if (values[0] != mDecoder.modelId()) {
 		emit inverterModelChanged();
 		return false; // go to idle
 	}
-	if (deviceInfo.retrievalMode == ProtocolSunSpecFloat) {
-		if (values.size() != 62)
-			return false;
-		double power = getFloat(values, 22);
-		if (qIsFinite(power)) {
-			CommonInverterData cid;
-			cid.acCurrent = getFloat(values, 2);
-			cid.acPower = power;
-			// sunspec does not provide a voltage for the system as a whole. This does not
-			// make a lot of sense. Since previous versions of dbus-fronius published this
-			// value (retrieved via the Solar API) we use the value from phase 1.
-			cid.acVoltage = getFloat(values, 16);
-			cid.totalEnergy = getFloat(values, 32);
-			mDataProcessor->process(cid);
-
-			if (deviceInfo.phaseCount > 1) {
-				ThreePhasesInverterData tpid;
-				tpid.acCurrentPhase1 = getFloat(values, 4);
-				tpid.acCurrentPhase2 = getFloat(values, 6);
-				tpid.acCurrentPhase3 = getFloat(values, 8);
-				tpid.acVoltagePhase1 = getFloat(values, 16);
-				tpid.acVoltagePhase2 = getFloat(values, 18);
-				tpid.acVoltagePhase3 = getFloat(values, 20);
-				mDataProcessor->process(tpid);
-			} else if (mSettings->phase() == MultiPhase) {
-				// A single phase inverter used as a Multiphase
-				// generator. This only makes sense in a split-phase
-				// system. Typical in North America, and fully
-				// supported by Fronius.
-				updateSplitPhase(cid.acPower/2, cid.totalEnergy/2);
-			}
-		}
-		setInverterState(values[48]);
-	} else {
-		if (values.size() != 52)
-			return false;
-		// In older versions of the Fronius firmware, power value and its scaling were sometimes
-		// 0 even when it was obvious that the value should have been different. It seemed to
-		// be indicating some kind of error situation.
-		double power = getScaledValue(values, 14, 1, 15, true);
-		if (qIsFinite(power)) {
-			CommonInverterData cid;
-			cid.acCurrent = getScaledValue(values, 2, 1, 6, false);
-			cid.acPower = power;
-			// sunspec does not provide a voltage for the system as a whole. This does not
-			// make a lot of sense. Since previous versions of dbus-fronius published this
-			// value (retrieved via the Solar API) we use the value from phase 1.
-			cid.acVoltage = getScaledValue(values, 10, 1, 13, false);
-			cid.totalEnergy = getScaledValue(values, 24, 2, 26, false);
-			mDataProcessor->process(cid);
-
-			if (deviceInfo.phaseCount > 1) {
-				ThreePhasesInverterData tpid;
-				tpid.acCurrentPhase1 = getScaledValue(values, 3, 1, 6, false);
-				tpid.acCurrentPhase2 = getScaledValue(values, 4, 1, 6, false);
-				tpid.acCurrentPhase3 = getScaledValue(values, 5, 1, 6, false);
-				tpid.acVoltagePhase1 = getScaledValue(values, 10, 1, 13, false);
-				tpid.acVoltagePhase2 = getScaledValue(values, 11, 1, 13, false);
-				tpid.acVoltagePhase3 = getScaledValue(values, 12, 1, 13, false);
-				mDataProcessor->process(tpid);
-			} else if (mSettings->phase() == MultiPhase) {
-				// A single phase inverter used as a Multiphase
-				// generator. This only makes sense in a split-phase
-				// system. Typical in North America, and fully
-				// supported by Fronius.
-				updateSplitPhase(cid.acPower/2, cid.totalEnergy/2);
-			}
+	if (values.size() != mDecoder.readCount())
+		return false;
+	// In older versions of the Fronius firmware, power value and its scaling were sometimes
+	// 0 even when it was obvious that the value should have been different. It seemed to
+	// be indicating some kind of error situation.
+	CommonInverterData cid;
+	mDecoder.decode(values, cid);
+	if (qIsFinite(cid.acPower)) {
+		mDataProcessor->process(cid);
+
+		if (mDecoder.hasPhases()) {
+			ThreePhasesInverterData tpid;
+			mDecoder.decode(values, tpid);
+			mDataProcessor->process(tpid);
+		} else if (mSettings->phase() == MultiPhase) {
+			// A single phase inverter used as a Multiphase
+			// generator. This only makes sense in a split-phase
+			// system. Typical in North America, and fully
+			// supported by Fronius.
+			updateSplitPhase(cid.acPower/2, cid.totalEnergy/2);
 		}
-		setInverterState(values[38]);
 	}
+	setInverterState(mDecoder.operatingState(values));
 	return true;
 }
 
@@ -432,11 +758,16 @@ Sunspec2018Updater::Sunspec2018Updater(Inverter *inverter, InverterSettings *set
 {
 }
 
-void Sunspec2018Updater::readPowerAndVoltage()
+void Sunspec2018Updater::planReads(SunspecReadPlan &plan)
 {
-	// Read 121 values. The model is 153 long, too long for a single modbus
-	// request, This is enough to get everything we care about.
-	readHoldingRegisters(inverter()->deviceInfo().inverterModelOffset, 121);
+	// Power limiting is not supported yet, so there is no need to read back the limiter.
+	planInverterModel(plan);
+}
+
+bool Sunspec2018Updater::readPower()
+{
+	// W and its scale factor are far apart in model 701, and power limiting is not supported yet.
+	return false;
 }
 
 void Sunspec2018Updater::writePowerLimit(double powerLimitPct)
@@ -444,39 +775,12 @@ void Sunspec2018Updater::writePowerLimit(double powerLimitPct)
 	Q_UNUSED(powerLimitPct);
 }
 
-void Sunspec2018Updater::disablePowerLimiting()
+bool Sunspec2018Updater::writePowerLimitAndRead(double powerLimitPct)
 {
+	Q_UNUSED(powerLimitPct);
+	return false;
 }
 
-bool Sunspec2018Updater::parsePowerAndVoltage(QVector<quint16> values)
+void Sunspec2018Updater::disablePowerLimiting()
 {
-	if (values.size() != 121)
-		return false;
-
-	CommonInverterData cid;
-	cid.acPower = getScaledValue(values, 10, 1, 116, true);
-	cid.acCurrent = getScaledValue(values, 14, 1, 113, true);
-	cid.acVoltage = getScaledValue(values, 16, 1, 114, false);
-
-	cid.totalEnergy = getScaledValue(values, 19, 4, 120, false);
-	processor()->process(cid);
-
-	if (inverter()->deviceInfo().phaseCount > 1) {
-		ThreePhasesInverterData tpid;
-		tpid.acCurrentPhase1 = getScaledValue(values, 45, 1, 113, true);
-		tpid.acCurrentPhase2 = getScaledValue(values, 68, 1, 113, true);
-		tpid.acCurrentPhase3 = getScaledValue(values, 91, 1, 113, true);
-
-		tpid.acVoltagePhase1 = getScaledValue(values, 47, 1, 114, false);
-		tpid.acVoltagePhase2 = getScaledValue(values, 70, 1, 114, false);
-		tpid.acVoltagePhase3 = getScaledValue(values, 93, 1, 114, false);
-		processor()->process(tpid);
-	} else if (settings()->phase() == MultiPhase) {
-		// A single phase inverter across phases, in North America.
-		updateSplitPhase(cid.acPower/2, cid.totalEnergy/2);
-	}
-
-	// +1 because 2018 enum is literally off by one from the earlier spec
-	setInverterState(values[4] + 1);
-	return true;
 }
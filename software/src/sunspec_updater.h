@@ -5,6 +5,13 @@
 #include <QList>
 #include <QAbstractSocket>
 #include <QString>
+#include "modbus_register_image.h"
+#include "modbus_client.h"
+#include "modbus_tcp_proxy.h"
+#include "poll_scheduler.h"
+#include "power_limit_coalescer.h"
+#include "sunspec_inverter_decoder.h"
+#include "sunspec_read_plan.h"
 
 class DataProcessor;
 class Inverter;
@@ -25,14 +32,28 @@ public:
 
 	static bool hasConnectionTo(QString host, int id);
 
+	/*!
+	 * Contains the registers of the inverter model of all inverters, as last read by the updaters.
+	 * Each inverter is stored under its D-Bus device instance, which is used as unit ID. An
+	 * inverter is removed when its updater is destroyed.
+	 */
+	static const ModbusRegisterImage &registerImage()
+	{
+		return mRegisterImage;
+	}
+
+	/*!
+	 * Looks up the inverter with the given unit ID (as used in `registerImage`), for use as
+	 * `ModbusTcpProxy::TargetResolver`.
+	 */
+	static bool findProxyTarget(quint8 unitId, ModbusTcpProxy::Target *target);
+
 signals:
 	void connectionLost();
 
 	void inverterModelChanged();
 
 private slots:
-	void onReadCompleted();
-
 	void onWriteCompleted();
 
 	void onPowerLimitRequested(double value);
@@ -43,15 +64,34 @@ private slots:
 
 	void onTimer();
 
-	void onPowerLimitExpired();
+	void onPowerLimitTimer();
+
+	void onFastPollTimer();
 
 	void onPhaseChanged();
 
+	void onModbusTimeoutChanged();
+
+	void onPollIntervalChanged();
+
 protected:
 	virtual void readPowerAndVoltage();
 
+	/*!
+	 * Starts a read of the AC power only, for the fast poll used while a power limit is active.
+	 * Returns false if this is not supported.
+	 */
+	virtual bool readPower();
+
 	virtual void writePowerLimit(double powerLimitPct);
 
+	/*!
+	 * Writes the power limit and reads back the inverter model (like `readPowerAndVoltage`) in a
+	 * single transaction. Returns false if this is not supported, in which case the caller should
+	 * use `writePowerLimit` and `readPowerAndVoltage` instead.
+	 */
+	virtual bool writePowerLimitAndRead(double powerLimitPct);
+
 	virtual void disablePowerLimiting();
 
 	virtual bool parsePowerAndVoltage(QVector<quint16> values);
@@ -60,11 +100,18 @@ protected:
 
 	InverterSettings *settings() { return mSettings; }
 
-	ModbusTcpClient *modbusClient() { return mModbusClient; }
+	ModbusClient *modbusClient() { return mModbusClient; }
 
 	DataProcessor *processor() { return mDataProcessor; }
 
-	void readHoldingRegisters(quint16 startRegister, quint16 count);
+	/*!
+	 * Adds the registers to be read at each poll to `plan`: the inverter model, and the state of
+	 * the power limiter. Called once, before the first poll.
+	 */
+	virtual void planReads(SunspecReadPlan &plan);
+
+	/// Adds the part of the inverter model needed by `parsePowerAndVoltage` to `plan`.
+	void planInverterModel(SunspecReadPlan &plan);
 
 	void updateSplitPhase(double power, double energy);
 
@@ -94,23 +141,92 @@ private:
 
 	void startIdleTimer();
 
+	/// Writes the pending power limit now, or after the poll in progress.
+	void startPowerLimitWrite();
+
+	/// Schedules the next refresh or expiry check of the power limit.
+	void updatePowerLimitTimer();
+
+	/// Schedules the next fast poll, if a power limit is active.
+	void startFastPollTimer();
+
+	void onPowerReadCompleted(ModbusReply *reply);
+
 	void writeMultipleHoldingRegisters(quint16 startReg, const QVector<quint16> &values);
 
+	void onReadCompleted(ModbusReply *reply);
+
+	void prepareReadPlan();
+
+	/// Sends all reads of the read plan.
+	void runReadPlan();
+
+	void onPlanReadCompleted(quint32 round, int block, ModbusReply *reply);
+
+	void processInverterModel(const QVector<quint16> &values);
+
+	/// Handles the state of the power limiter (WMaxLim_Ena) as read back from the inverter.
+	void checkLimiterState(quint16 enabled);
+
+	/// The WMaxLim_Ena point of the immediate controls model (123).
+	static const SunspecPoint &limiterEnabledPoint();
+
+	static const SunspecPoint *findLimiterEnabledPoint();
+
+	void onWriteAndReadCompleted(ModbusReply *reply);
+
+	/// Returns the number of registers read by the fast poll, or 0 if it is not possible.
+	quint16 powerReadCount() const;
+
+	/// Returns the unit ID of the inverter in `mRegisterImage`, or 0 if it cannot be stored.
+	quint8 registerImageUnitId() const;
+
+	QVector<quint16> powerLimitValues(double powerLimitPct) const;
+
 	bool handleModbusError(ModbusReply *reply);
 
 	void handleError();
 
 	Inverter *mInverter;
 	InverterSettings *mSettings;
-	ModbusTcpClient *mModbusClient;
+	ModbusClient *mModbusClient;
+	// Same as mModbusClient if the inverter is connected through Modbus TCP, 0 otherwise.
+	ModbusTcpClient *mTcpClient;
 	QTimer *mTimer;
+	// Fires when the power limit must be refreshed or has expired (see PowerLimitCoalescer).
 	QTimer *mPowerLimitTimer;
+	QTimer *mFastPollTimer;
 	DataProcessor *mDataProcessor;
+	// Picked for the inverter model found by the detector.
+	SunspecInverterDecoder mDecoder;
 	ModbusState mCurrentState;
-	double mPowerLimitPct;
+	// Decides when to poll the inverter again, once we are idle.
+	PollScheduler mPollScheduler;
+	// True if the last poll reported the inverter is sleeping, in standby, or off.
+	bool mInverterSleeping;
+	PowerLimitCoalescer mPowerLimitCoalescer;
 	int mRetryCount;
-	bool mWritePowerLimitRequested;
+	// Cleared if the inverter does not support writePowerLimitAndRead.
+	bool mCombinedWriteSupported;
+	// The reads done at every poll, and a request for each read.
+	SunspecReadPlan mReadPlan;
+	QVector<ModbusClient::PreparedRequest> mPlanRequests;
+	QVector<QVector<quint16>> mPlanValues;
+	// Incremented each time the read plan is started.
+	quint32 mPlanRound;
+	// Number of reads of the current round still waiting for a reply.
+	int mPlanPending;
+	bool mPlanFailed;
+	// Cleared if the inverter does not allow reading back the state of the power limiter.
+	bool mLimiterReadback;
+	// True if the power limiter has been reported enabled since the limit was last written.
+	bool mLimiterSeenEnabled;
+	// The request used by readPower.
+	ModbusClient::PreparedRequest mPowerRequest;
+	// True while a fast poll is waiting for its reply.
+	bool mFastPollPending;
 	static QList<SunspecUpdater*> mUpdaters; // to keep track of inverters we have a connection with
+	static ModbusRegisterImage mRegisterImage;
 };
 
 class FroniusSunspecUpdater : public SunspecUpdater
@@ -128,13 +244,15 @@ class Sunspec2018Updater : public SunspecUpdater
 public:
 	explicit Sunspec2018Updater(Inverter *inverter, InverterSettings *settings, QObject *parent = 0);
 private:
-	void readPowerAndVoltage() override;
+	void planReads(SunspecReadPlan &plan) override;
+
+	bool readPower() override;
 
 	void writePowerLimit(double powerLimitPct) override;
 
-	void disablePowerLimiting() override;
+	bool writePowerLimitAndRead(double powerLimitPct) override;
 
-	bool parsePowerAndVoltage(QVector<quint16> values) override;
+	void disablePowerLimiting() override;
 };
 
 
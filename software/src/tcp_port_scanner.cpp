@@ -0,0 +1,197 @@
+#include <QSocketNotifier>
+#include <QTimer>
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "tcp_port_scanner.h"
+#include "logging.h"
+
+// Number of events handled per call of epoll_wait.
+static const int MaxEvents = 64;
+
+TcpPortScanner::TcpPortScanner(QObject *parent):
+	QObject(parent),
+	mQueueIndex(0),
+	mTimeout(0),
+	mTimer(new QTimer(this)),
+	mNotifier(0),
+	mEpoll(epoll_create1(EPOLL_CLOEXEC)),
+	mMaxSockets(MaxSockets)
+{
+	mClock.start();
+	mTimer->setSingleShot(true);
+	connect(mTimer, SIGNAL(timeout()), this, SLOT(onTimer()));
+	if (mEpoll < 0) {
+		qWarning() << "Could not create epoll instance:" << strerror(errno);
+	} else {
+		mNotifier = new QSocketNotifier(mEpoll, QSocketNotifier::Read, this);
+		connect(mNotifier, SIGNAL(activated(int)), this, SLOT(onEvents()));
+	}
+	// Leave room for the other connections of the process.
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+		mMaxSockets = qBound(1, static_cast<int>(limit.rlim_cur / 2),
+							 static_cast<int>(MaxSockets));
+	}
+}
+
+TcpPortScanner::~TcpPortScanner()
+{
+	abort();
+	delete mNotifier;
+	if (mEpoll >= 0)
+		::close(mEpoll);
+}
+
+void TcpPortScanner::start(const QList<QHostAddress> &addresses, const QList<quint16> &ports,
+						   int timeout)
+{
+	abort();
+	mAddresses = addresses;
+	mTimeout = timeout;
+	if (mEpoll >= 0) {
+		foreach (const QHostAddress &address, addresses) {
+			if (address.protocol() != QAbstractSocket::IPv4Protocol)
+				continue;
+			foreach (quint16 port, ports) {
+				Probe probe;
+				probe.address = address.toIPv4Address();
+				probe.port = port;
+				probe.deadline = 0;
+				mQueue.append(probe);
+			}
+		}
+	} else {
+		foreach (const QHostAddress &address, addresses)
+			mFound.insert(address.toIPv4Address());
+	}
+	// Start from the event loop, so `finished` is never emitted from here.
+	mTimer->start(0);
+}
+
+QList<QHostAddress> TcpPortScanner::hostsFound() const
+{
+	QList<QHostAddress> hosts;
+	foreach (const QHostAddress &address, mAddresses) {
+		if (address.protocol() != QAbstractSocket::IPv4Protocol ||
+			mFound.contains(address.toIPv4Address()))
+			hosts.append(address);
+	}
+	return hosts;
+}
+
+void TcpPortScanner::onEvents()
+{
+	epoll_event events[MaxEvents];
+	int count;
+	while ((count = epoll_wait(mEpoll, events, MaxEvents, 0)) > 0) {
+		for (int i=0; i<count; ++i) {
+			int fd = events[i].data.fd;
+			QHash<int, Probe>::const_iterator it = mProbes.constFind(fd);
+			if (it == mProbes.constEnd())
+				continue;
+			// The connect has completed. A refused connection means the port is closed.
+			int error = 0;
+			socklen_t size = sizeof(error);
+			if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) == 0 && error == 0)
+				mFound.insert(it.value().address);
+			closeProbe(fd);
+		}
+	}
+	update();
+}
+
+void TcpPortScanner::onTimer()
+{
+	// The sockets are started in order, and all connects have the same timeout.
+	qint64 now = mClock.elapsed();
+	while (!mOrder.isEmpty() && mProbes.value(mOrder.first()).deadline <= now)
+		closeProbe(mOrder.first());
+	update();
+}
+
+void TcpPortScanner::update()
+{
+	startProbes();
+	if (!isRunning()) {
+		mTimer->stop();
+		emit finished();
+		return;
+	}
+	if (!mOrder.isEmpty()) {
+		qint64 deadline = mProbes.value(mOrder.first()).deadline;
+		mTimer->start(static_cast<int>(qMax(Q_INT64_C(0), deadline - mClock.elapsed())));
+	}
+}
+
+void TcpPortScanner::startProbes()
+{
+	while (mProbes.size() < mMaxSockets && mQueueIndex < mQueue.size()) {
+		Probe probe = mQueue[mQueueIndex++];
+		// One open port is enough.
+		if (mFound.contains(probe.address))
+			continue;
+		probe.deadline = mClock.elapsed() + mTimeout;
+		startProbe(probe);
+	}
+}
+
+void TcpPortScanner::startProbe(const Probe &probe)
+{
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		qWarning() << "Could not create socket:" << strerror(errno);
+		mFound.insert(probe.address);
+		return;
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(probe.port);
+	addr.sin_addr.s_addr = htonl(probe.address);
+	if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0) {
+		mFound.insert(probe.address);
+		::close(fd);
+		return;
+	}
+	if (errno != EINPROGRESS) {
+		// Refused or unreachable right away.
+		::close(fd);
+		return;
+	}
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLOUT;
+	event.data.fd = fd;
+	if (epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+		qWarning() << "Could not watch socket:" << strerror(errno);
+		mFound.insert(probe.address);
+		::close(fd);
+		return;
+	}
+	mProbes.insert(fd, probe);
+	mOrder.append(fd);
+}
+
+void TcpPortScanner::closeProbe(int fd)
+{
+	epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, 0);
+	::close(fd);
+	mProbes.remove(fd);
+	mOrder.removeOne(fd);
+}
+
+void TcpPortScanner::abort()
+{
+	foreach (int fd, mProbes.keys())
+		closeProbe(fd);
+	mQueue.clear();
+	mQueueIndex = 0;
+	mFound.clear();
+	mAddresses.clear();
+	mTimer->stop();
+}
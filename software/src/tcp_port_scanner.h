@@ -0,0 +1,107 @@
+#ifndef TCP_PORT_SCANNER_H
+#define TCP_PORT_SCANNER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QSet>
+#include <QVector>
+
+class QSocketNotifier;
+class QTimer;
+
+/*!
+ * Finds the hosts which accept TCP connections on one of a set of ports.
+ *
+ * This is a quick sweep before the detectors are started, so they only have to deal with hosts
+ * that are actually there. Non-blocking `connect` calls are made to all ports of all addresses,
+ * and the results are collected with a single epoll instance, which is watched by the Qt event
+ * loop. A connect which has not completed within the timeout is abandoned. On a LAN, a host
+ * accepts or refuses the connection within milliseconds, so the timeout can be short.
+ *
+ * The number of sockets open at the same time is limited (see `MaxSockets`), so large ranges are
+ * swept in batches.
+ */
+class TcpPortScanner : public QObject
+{
+	Q_OBJECT
+public:
+	/// Maximum number of connects in progress.
+	static const int MaxSockets = 512;
+
+	TcpPortScanner(QObject *parent = 0);
+
+	~TcpPortScanner();
+
+	bool isRunning() const
+	{
+		return mQueueIndex < mQueue.size() || !mProbes.isEmpty();
+	}
+
+	/*!
+	 * Starts the sweep. `finished` is emitted from the event loop once all addresses have been
+	 * tried. Addresses which cannot be swept (not IPv4) are reported as found. A sweep in
+	 * progress is abandoned.
+	 * @param timeout Time (ms) allowed for each connect.
+	 */
+	void start(const QList<QHostAddress> &addresses, const QList<quint16> &ports, int timeout);
+
+	/// Abandons the sweep in progress, without emitting `finished`.
+	void abort();
+
+	/// The addresses passed to `start`.
+	const QList<QHostAddress> &addresses() const
+	{
+		return mAddresses;
+	}
+
+	/// The addresses with at least one open port, in the order they were passed to `start`.
+	QList<QHostAddress> hostsFound() const;
+
+signals:
+	void finished();
+
+private slots:
+	void onEvents();
+
+	void onTimer();
+
+private:
+	struct Probe
+	{
+		quint32 address;
+		quint16 port;
+		qint64 deadline;
+	};
+
+	/// Starts connects from the queue, as long as `mMaxSockets` allows.
+	void startProbes();
+
+	/*!
+	 * Starts a connect. If that is not possible because we are out of resources, the host is
+	 * reported as found, so it is not skipped by the detectors.
+	 */
+	void startProbe(const Probe &probe);
+
+	void closeProbe(int fd);
+
+	/// Starts new connects, and emits `finished` if there is nothing left to do.
+	void update();
+
+	QList<QHostAddress> mAddresses;
+	QVector<Probe> mQueue;
+	int mQueueIndex;
+	// Connects in progress, by socket, and the sockets in the order they were started.
+	QHash<int, Probe> mProbes;
+	QList<int> mOrder;
+	QSet<quint32> mFound;
+	QElapsedTimer mClock;
+	int mTimeout;
+	QTimer *mTimer;
+	QSocketNotifier *mNotifier;
+	int mEpoll;
+	int mMaxSockets;
+};
+
+#endif // TCP_PORT_SCANNER_H
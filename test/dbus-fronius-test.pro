@@ -37,7 +37,8 @@ INCLUDEPATH += \
     $$EXTDIR/googletest/include \
     $$EXTDIR/googletest \
     $$EXTDIR/qthttp/src/qhttp \
-    $$SRCDIR
+    $$SRCDIR \
+    $$SRCDIR/modbus_tcp_client
 
 HEADERS += \
     $$SRCDIR/froniussolar_api.h \
@@ -48,6 +49,28 @@ HEADERS += \
     $$SRCDIR/fronius_device_info.h \
     $$SRCDIR/ve_qitem_consumer.h \
     $$SRCDIR/ve_service.h \
+    $$SRCDIR/poll_scheduler.h \
+    $$SRCDIR/power_limit_coalescer.h \
+    $$SRCDIR/scan_window.h \
+    $$SRCDIR/sunspec_inverter_decoder.h \
+    $$SRCDIR/sunspec_models.h \
+    $$SRCDIR/sunspec_read_plan.h \
+    $$SRCDIR/sunspec_tools.h \
+    $$SRCDIR/modbus_tcp_client/crc16.h \
+    $$SRCDIR/modbus_tcp_client/modbus_client.h \
+    $$SRCDIR/modbus_tcp_client/modbus_frame_buffer.h \
+    $$SRCDIR/modbus_tcp_client/modbus_register_image.h \
+    $$SRCDIR/modbus_tcp_client/modbus_reply.h \
+    $$SRCDIR/modbus_tcp_client/modbus_request_queue.h \
+    $$SRCDIR/modbus_tcp_client/modbus_rtu_frame_parser.h \
+    $$SRCDIR/modbus_tcp_client/modbus_statistics.h \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_client.h \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_connection.h \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_frame.h \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_proxy.h \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_server.h \
+    $$SRCDIR/modbus_tcp_client/rtt_estimator.h \
+    $$SRCDIR/modbus_tcp_client/timer_wheel.h \
     src/fronius_solar_api_test.h \
     src/test_helper.h \
     src/dbus_inverter_bridge_test.h \
@@ -62,12 +85,47 @@ SOURCES += \
     $$SRCDIR/fronius_device_info.cpp \
     $$SRCDIR/ve_qitem_consumer.cpp \
     $$SRCDIR/ve_service.cpp \
+    $$SRCDIR/poll_scheduler.cpp \
+    $$SRCDIR/power_limit_coalescer.cpp \
+    $$SRCDIR/scan_window.cpp \
+    $$SRCDIR/sunspec_inverter_decoder.cpp \
+    $$SRCDIR/sunspec_models.cpp \
+    $$SRCDIR/sunspec_read_plan.cpp \
+    $$SRCDIR/sunspec_tools.cpp \
+    $$SRCDIR/modbus_tcp_client/crc16.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_client.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_frame_buffer.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_register_image.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_reply.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_rtu_frame_parser.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_statistics.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_client.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_connection.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_frame.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_proxy.cpp \
+    $$SRCDIR/modbus_tcp_client/modbus_tcp_server.cpp \
+    $$SRCDIR/modbus_tcp_client/rtt_estimator.cpp \
+    $$SRCDIR/modbus_tcp_client/timer_wheel.cpp \
     $$EXTDIR/googletest/src/gtest-all.cc \
     src/main.cpp \
     src/dbus_inverter_bridge_test.cpp \
     src/fronius_solar_api_test.cpp \
     src/test_helper.cpp \
-    src/data_processor_test.cpp
+    src/data_processor_test.cpp \
+    src/modbus_tcp_connection_test.cpp \
+    src/power_limit_coalescer_test.cpp \
+    src/sunspec_inverter_decoder_test.cpp \
+    src/sunspec_read_plan_test.cpp \
+    src/modbus_request_queue_test.cpp \
+    src/modbus_frame_buffer_test.cpp \
+    src/timer_wheel_test.cpp \
+    src/modbus_rtu_frame_parser_test.cpp \
+    src/poll_scheduler_test.cpp \
+    src/scan_window_test.cpp \
+    src/modbus_register_image_test.cpp \
+    src/modbus_tcp_server_test.cpp \
+    src/modbus_tcp_proxy_test.cpp \
+    src/rtt_estimator_test.cpp
 
 OTHER_FILES += \
     src/fronius_sim/app.py \
@@ -0,0 +1,47 @@
+# Application version and revision
+VERSION = 0.1.0
+
+# suppress the mangling of va_arg has changed for gcc 4.4
+QMAKE_CXXFLAGS += -Wno-psabi
+
+# gcc 4.8 and newer don't like the QOMPILE_ASSERT in qt
+QMAKE_CXXFLAGS += -Wno-unused-local-typedefs
+
+MOC_DIR=.moc
+OBJECTS_DIR=.obj
+
+QT += core
+QT -= gui
+
+TARGET = modbus_benchmark
+CONFIG += console release
+CONFIG -= app_bundle
+DEFINES += VERSION=\\\"$${VERSION}\\\"
+
+TEMPLATE = app
+
+SRCDIR = ../software/src
+CLIENTDIR = $$SRCDIR/modbus_tcp_client
+APPDIR = ./modbus_benchmark
+
+INCLUDEPATH += \
+    $$SRCDIR \
+    $$CLIENTDIR
+
+HEADERS += \
+    $$CLIENTDIR/crc16.h \
+    $$CLIENTDIR/modbus_frame_buffer.h \
+    $$CLIENTDIR/modbus_rtu_frame_parser.h \
+    $$CLIENTDIR/modbus_tcp_frame.h \
+    $$APPDIR/benchmark.h
+
+SOURCES += \
+    $$CLIENTDIR/crc16.cpp \
+    $$CLIENTDIR/modbus_frame_buffer.cpp \
+    $$CLIENTDIR/modbus_rtu_frame_parser.cpp \
+    $$CLIENTDIR/modbus_tcp_frame.cpp \
+    $$APPDIR/benchmark.cpp \
+    $$APPDIR/frame_decoder_benchmark.cpp \
+    $$APPDIR/frame_encoder_benchmark.cpp \
+    $$APPDIR/rtu_decoder_benchmark.cpp \
+    $$APPDIR/main.cpp
@@ -0,0 +1,73 @@
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <cstdlib>
+#include <new>
+#include "benchmark.h"
+
+static quint64 AllocationCount = 0;
+
+void *operator new(std::size_t size)
+{
+	++AllocationCount;
+	void *p = std::malloc(size == 0 ? 1 : size);
+	if (p == 0)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+quint64 allocationCount()
+{
+	return AllocationCount;
+}
+
+static QElapsedTimer &benchmarkClock()
+{
+	static QElapsedTimer timer;
+	if (!timer.isValid())
+		timer.start();
+	return timer;
+}
+
+BenchmarkRun::BenchmarkRun(const QString &name):
+	mName(name),
+	mStart(benchmarkClock().nsecsElapsed()),
+	mAllocations(allocationCount())
+{
+}
+
+void BenchmarkRun::finish(qint64 bytes, qint64 items)
+{
+	qint64 nsecs = qMax(Q_INT64_C(1), benchmarkClock().nsecsElapsed() - mStart);
+	quint64 allocations = allocationCount() - mAllocations;
+	QTextStream out(stdout);
+	out << QString("%1 %2 MB/s %3 ns/frame %4 allocs/frame").
+		   arg(mName, -48).
+		   arg(1e3 * bytes / nsecs, 9, 'f', 1).
+		   arg(static_cast<double>(nsecs) / items, 9, 'f', 1).
+		   arg(static_cast<double>(allocations) / items, 6, 'f', 2) << '\n';
+}
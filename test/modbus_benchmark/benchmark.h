@@ -0,0 +1,45 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QString>
+
+/*!
+ * Returns the number of heap allocations done since the start of the program. This is tracked by
+ * replacing the global `operator new`.
+ */
+quint64 allocationCount();
+
+/*!
+ * Measures throughput and allocations of a piece of code. Usage:
+ * @code
+ * BenchmarkRun run("Legacy decoder");
+ * for (int i=0; i<count; ++i)
+ *     decode(...);
+ * run.finish(bytes, frames);
+ * @endcode
+ */
+class BenchmarkRun
+{
+public:
+	explicit BenchmarkRun(const QString &name);
+
+	/*!
+	 * Stops the measurement and prints the results.
+	 * @param bytes Number of bytes processed
+	 * @param items Number of items (eg. frames) processed
+	 */
+	void finish(qint64 bytes, qint64 items);
+
+private:
+	QString mName;
+	qint64 mStart;
+	quint64 mAllocations;
+};
+
+void runFrameDecoderBenchmark();
+
+void runFrameEncoderBenchmark();
+
+void runRtuDecoderBenchmark();
+
+#endif // BENCHMARK_H
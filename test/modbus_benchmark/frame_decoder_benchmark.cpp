@@ -0,0 +1,131 @@
+#include <QByteArray>
+#include <QTextStream>
+#include <QVector>
+#include "benchmark.h"
+#include "modbus_frame_buffer.h"
+
+// Compares the receive path of ModbusTcpClient before and after the introduction of
+// ModbusFrameBuffer. The socket is simulated by a stream of read holding register responses,
+// delivered in chunks of several frames (as happens when requests are pipelined).
+
+static quint16 toUInt16(const QByteArray &buffer, int offset)
+{
+	return static_cast<quint16>(
+		(static_cast<quint8>(buffer[offset]) << 8) | static_cast<quint8>(buffer[offset + 1]));
+}
+
+static QByteArray createResponse(quint16 transactionId, int registerCount)
+{
+	QByteArray frame;
+	int payloadSize = 2 * registerCount;
+	int length = 3 + payloadSize;
+	frame.append(static_cast<char>(transactionId >> 8));
+	frame.append(static_cast<char>(transactionId & 0xFF));
+	frame.append(static_cast<char>(0));
+	frame.append(static_cast<char>(0));
+	frame.append(static_cast<char>(length >> 8));
+	frame.append(static_cast<char>(length & 0xFF));
+	frame.append(static_cast<char>(1)); // Unit ID
+	frame.append(static_cast<char>(3)); // Read holding registers
+	frame.append(static_cast<char>(payloadSize));
+	for (int i = 0; i < registerCount; ++i) {
+		frame.append(static_cast<char>(i >> 8));
+		frame.append(static_cast<char>(i & 0xFF));
+	}
+	return frame;
+}
+
+/// Copy of the decoder loop used by ModbusTcpClient before ModbusFrameBuffer was introduced.
+static int decodeLegacy(QByteArray &buffer, quint32 &checksum)
+{
+	int frames = 0;
+	for (;;) {
+		if (buffer.size() < 6)
+			return frames;
+		int length = toUInt16(buffer, 4) + 6;
+		if (buffer.size() < length)
+			return frames;
+		quint8 payloadSize = static_cast<quint8>(buffer[8]);
+		int i0 = 9;
+		int i1 = i0 + payloadSize;
+		if (i1 == length) {
+			QVector<quint16> values;
+			for (; i0 < i1; i0 += 2)
+				values.append(toUInt16(buffer, i0));
+			checksum += values.last();
+		}
+		buffer.remove(0, length);
+		++frames;
+	}
+}
+
+/// The decoder loop from ModbusTcpClient::onReadyRead and ModbusTcpClient::decodeReply.
+static int decodeFrameBuffer(ModbusFrameBuffer &buffer, int registerCount, quint32 &checksum)
+{
+	int frames = 0;
+	for (;;) {
+		if (buffer.size() < 6)
+			return frames;
+		int length = buffer.peekUInt16(4) + 6;
+		if (buffer.size() < length)
+			return frames;
+		int payloadSize = buffer.peek(8);
+		if (9 + payloadSize == length) {
+			// In ModbusTcpClient the vector is reserved when the request is created.
+			QVector<quint16> values;
+			values.reserve(registerCount);
+			values.resize(payloadSize / 2);
+			buffer.peekRegisters(9, values.data(), values.size());
+			checksum += values.last();
+		}
+		buffer.skip(length);
+		++frames;
+	}
+}
+
+static void runCase(int registerCount, int framesPerChunk, int totalFrames)
+{
+	QByteArray chunk;
+	for (int i = 0; i < framesPerChunk; ++i)
+		chunk.append(createResponse(static_cast<quint16>(i), registerCount));
+	int chunkCount = totalFrames / framesPerChunk;
+	qint64 bytes = static_cast<qint64>(chunkCount) * chunk.size();
+	qint64 frames = static_cast<qint64>(chunkCount) * framesPerChunk;
+
+	QTextStream(stdout) << QString("%1 registers/frame, %2 frames/chunk").
+						   arg(registerCount).arg(framesPerChunk) << '\n';
+	quint32 legacyChecksum = 0;
+	{
+		QByteArray buffer;
+		BenchmarkRun run("  QByteArray + remove");
+		for (int i = 0; i < chunkCount; ++i) {
+			// QTcpSocket::read(qint64) returns a new byte array.
+			buffer.append(QByteArray(chunk.constData(), chunk.size()));
+			decodeLegacy(buffer, legacyChecksum);
+		}
+		run.finish(bytes, frames);
+	}
+	quint32 checksum = 0;
+	{
+		ModbusFrameBuffer buffer;
+		BenchmarkRun run("  ModbusFrameBuffer");
+		for (int i = 0; i < chunkCount; ++i) {
+			buffer.append(chunk.constData(), chunk.size());
+			decodeFrameBuffer(buffer, registerCount, checksum);
+		}
+		run.finish(bytes, frames);
+	}
+	if (checksum != legacyChecksum)
+		QTextStream(stdout) << "  Checksum mismatch!\n";
+}
+
+void runFrameDecoderBenchmark()
+{
+	QTextStream(stdout) << "Modbus TCP frame decoder\n";
+	const int registerCounts[] = { 2, 40, 125 };
+	const int framesPerChunk[] = { 1, 4, 16 };
+	for (int r: registerCounts) {
+		for (int f: framesPerChunk)
+			runCase(r, f, 200000);
+	}
+}
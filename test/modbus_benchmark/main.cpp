@@ -0,0 +1,19 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include "benchmark.h"
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setApplicationVersion(VERSION);
+
+	QStringList args = app.arguments();
+	bool all = args.size() < 2;
+	if (all || args.contains("decoder"))
+		runFrameDecoderBenchmark();
+	if (all || args.contains("encoder"))
+		runFrameEncoderBenchmark();
+	if (all || args.contains("rtu"))
+		runRtuDecoderBenchmark();
+	return 0;
+}
@@ -0,0 +1,212 @@
+#include <QByteArray>
+#include <QTextStream>
+#include <QVector>
+#include <string.h>
+#include "benchmark.h"
+#include "crc16.h"
+#include "modbus_rtu_frame_parser.h"
+
+// Compares the receive path of ModbusRtuClient before and after the introduction of
+// ModbusRtuFrameParser. The serial port is simulated by a stream of read holding register
+// responses, delivered in chunks of a fixed size (which do not respect frame boundaries).
+
+static QByteArray createResponse(quint8 unitId, int registerCount)
+{
+	QByteArray frame;
+	frame.append(static_cast<char>(unitId));
+	frame.append(static_cast<char>(3)); // Read holding registers
+	frame.append(static_cast<char>(2 * registerCount));
+	for (int i = 0; i < registerCount; ++i) {
+		frame.append(static_cast<char>(i >> 8));
+		frame.append(static_cast<char>(i & 0xFF));
+	}
+	quint16 crc = Crc16::getValue(frame);
+	frame.append(static_cast<char>(msb(crc)));
+	frame.append(static_cast<char>(lsb(crc)));
+	return frame;
+}
+
+/// Copy of the state engine used by ModbusRtuClient before ModbusRtuFrameParser was introduced.
+class LegacyDecoder
+{
+public:
+	LegacyDecoder():
+		frames(0),
+		checksum(0)
+	{
+		reset();
+	}
+
+	void handleByteRead(quint8 b)
+	{
+		if (mAddToCrc)
+			mCrcBuilder.add(b);
+		switch (mState) {
+		case Address:
+			mState = Function;
+			break;
+		case Function:
+			mState = ByteCount;
+			break;
+		case ByteCount:
+			mCount = b;
+			mState = mCount == 0 ? CrcMsb : Data;
+			mAddToCrc = mCount != 0;
+			break;
+		case Data:
+			if (mCount > 0) {
+				mData.append(static_cast<char>(b));
+				--mCount;
+			}
+			if (mCount == 0) {
+				mState = CrcMsb;
+				mAddToCrc = false;
+			}
+			break;
+		case CrcMsb:
+			mCrc = static_cast<quint16>(b << 8);
+			mState = CrcLsb;
+			break;
+		case CrcLsb:
+			mCrc |= b;
+			if (mCrc == mCrcBuilder.getValue()) {
+				QVector<quint16> registers;
+				for (int i=0; i<mData.length(); i+=2)
+					registers.append(toUInt16(mData, i));
+				checksum += registers.last();
+				++frames;
+			}
+			reset();
+			break;
+		}
+	}
+
+	qint64 frames;
+	quint32 checksum;
+
+private:
+	enum ReadState {
+		Address,
+		Function,
+		ByteCount,
+		Data,
+		CrcMsb,
+		CrcLsb
+	};
+
+	void reset()
+	{
+		mState = Address;
+		mCrcBuilder.reset();
+		mAddToCrc = true;
+		mData.clear();
+	}
+
+	ReadState mState;
+	quint8 mCount;
+	quint16 mCrc;
+	Crc16 mCrcBuilder;
+	bool mAddToCrc;
+	QByteArray mData;
+};
+
+static void runCase(int registerCount, int chunkSize, int totalFrames)
+{
+	QByteArray frame = createResponse(1, registerCount);
+	QByteArray stream;
+	for (int i = 0; i < 64; ++i)
+		stream.append(frame);
+	int repeat = totalFrames / 64;
+	qint64 bytes = static_cast<qint64>(repeat) * stream.size();
+	qint64 frames = static_cast<qint64>(repeat) * 64;
+
+	QTextStream(stdout) << QString("%1 registers/frame, %2 bytes/read").
+						   arg(registerCount).arg(chunkSize) << '\n';
+	LegacyDecoder legacy;
+	{
+		BenchmarkRun run("  state engine per byte");
+		for (int r = 0; r < repeat; ++r) {
+			for (int offset = 0; offset < stream.size(); offset += chunkSize) {
+				int n = qMin(chunkSize, stream.size() - offset);
+				const quint8 *p = reinterpret_cast<const quint8 *>(stream.constData() + offset);
+				for (int i = 0; i < n; ++i)
+					legacy.handleByteRead(p[i]);
+			}
+		}
+		run.finish(bytes, frames);
+	}
+	quint32 checksum = 0;
+	qint64 decoded = 0;
+	{
+		ModbusRtuFrameParser parser;
+		// In ModbusRtuClient the vector is kept in the reply.
+		QVector<quint16> registers;
+		registers.reserve(registerCount);
+		BenchmarkRun run("  ModbusRtuFrameParser");
+		for (int r = 0; r < repeat; ++r) {
+			for (int offset = 0; offset < stream.size(); offset += chunkSize) {
+				int room = 0;
+				char *buffer = parser.writeBuffer(&room);
+				int n = qMin(qMin(chunkSize, room), stream.size() - offset);
+				// Simulates read(2) on the serial port.
+				memcpy(buffer, stream.constData() + offset, static_cast<size_t>(n));
+				parser.commit(n);
+				ModbusRtuFrameParser::Frame f;
+				while (parser.nextFrame(&f)) {
+					int count = (f.dataSize - 1) / 2;
+					registers.resize(count);
+					const quint8 *p = f.data + 1;
+					for (int i = 0; i < count; ++i, p += 2)
+						registers[i] = toUInt16(p[0], p[1]);
+					checksum += registers.last();
+					++decoded;
+				}
+			}
+		}
+		run.finish(bytes, frames);
+	}
+	if (checksum != legacy.checksum || decoded != legacy.frames || decoded != frames)
+		QTextStream(stdout) << "  Checksum mismatch!\n";
+}
+
+static void runCrcCase(int size, int totalFrames)
+{
+	QByteArray data(size, 0);
+	for (int i = 0; i < size; ++i)
+		data[i] = static_cast<char>(i * 7);
+	qint64 bytes = static_cast<qint64>(totalFrames) * size;
+	QTextStream(stdout) << QString("CRC16 over %1 bytes").arg(size) << '\n';
+	quint32 byteChecksum = 0;
+	{
+		BenchmarkRun run("  byte by byte");
+		for (int f = 0; f < totalFrames; ++f) {
+			Crc16 crc;
+			for (int i = 0; i < size; ++i)
+				crc.add(static_cast<uint8_t>(data.constData()[i]));
+			byteChecksum += crc.getValue();
+		}
+		run.finish(bytes, totalFrames);
+	}
+	quint32 checksum = 0;
+	{
+		BenchmarkRun run("  slicing-by-4");
+		for (int f = 0; f < totalFrames; ++f)
+			checksum += Crc16::getValue(data.constData(), size);
+		run.finish(bytes, totalFrames);
+	}
+	if (checksum != byteChecksum)
+		QTextStream(stdout) << "  Checksum mismatch!\n";
+}
+
+void runRtuDecoderBenchmark()
+{
+	QTextStream(stdout) << "Modbus RTU frame decoder\n";
+	const int registerCounts[] = { 2, 40, 125 };
+	const int chunkSizes[] = { 8, 64, 256 };
+	for (int r: registerCounts) {
+		for (int c: chunkSizes)
+			runCase(r, c, 200000);
+	}
+	runCrcCase(8, 1000000);
+	runCrcCase(255, 200000);
+}
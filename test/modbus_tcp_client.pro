@@ -40,9 +40,24 @@ INCLUDEPATH += \
 HEADERS += \
     $$CLIENTDIR/crc16.h \
     $$CLIENTDIR/modbus_client.h \
+    $$CLIENTDIR/modbus_frame_buffer.h \
     $$CLIENTDIR/modbus_tcp_client.h \
+    $$CLIENTDIR/modbus_tcp_connection.h \
+    $$CLIENTDIR/modbus_tcp_frame.h \
     $$CLIENTDIR/modbus_reply.h \
+    $$CLIENTDIR/modbus_statistics.h \
+    $$CLIENTDIR/modbus_rtu_bus.h \
+    $$CLIENTDIR/modbus_rtu_serial_bus.h \
+    $$CLIENTDIR/modbus_rtu_tcp_bus.h \
     $$CLIENTDIR/modbus_rtu_client.h \
+    $$CLIENTDIR/modbus_rtu_over_tcp_client.h \
+    $$CLIENTDIR/modbus_rtu_frame_parser.h \
+    $$CLIENTDIR/rtt_estimator.h \
+    $$CLIENTDIR/modbus_register_image.h \
+    $$CLIENTDIR/modbus_tcp_server.h \
+    $$CLIENTDIR/modbus_tcp_proxy.h \
+    $$CLIENTDIR/modbus_request_queue.h \
+    $$CLIENTDIR/timer_wheel.h \
     $$APPDIR/app.h \
     $$APPDIR/arguments.h
 
@@ -53,9 +68,23 @@ SOURCES += \
     $$EXTDIR/velib/src/types/ve_variant.c \
     $$CLIENTDIR/crc16.cpp \
     $$CLIENTDIR/modbus_client.cpp \
+    $$CLIENTDIR/modbus_frame_buffer.cpp \
     $$CLIENTDIR/modbus_tcp_client.cpp \
+    $$CLIENTDIR/modbus_tcp_connection.cpp \
+    $$CLIENTDIR/modbus_tcp_frame.cpp \
     $$CLIENTDIR/modbus_reply.cpp \
+    $$CLIENTDIR/modbus_statistics.cpp \
+    $$CLIENTDIR/modbus_rtu_bus.cpp \
+    $$CLIENTDIR/modbus_rtu_serial_bus.cpp \
+    $$CLIENTDIR/modbus_rtu_tcp_bus.cpp \
     $$CLIENTDIR/modbus_rtu_client.cpp \
+    $$CLIENTDIR/modbus_rtu_over_tcp_client.cpp \
+    $$CLIENTDIR/modbus_rtu_frame_parser.cpp \
+    $$CLIENTDIR/rtt_estimator.cpp \
+    $$CLIENTDIR/modbus_register_image.cpp \
+    $$CLIENTDIR/modbus_tcp_server.cpp \
+    $$CLIENTDIR/modbus_tcp_proxy.cpp \
+    $$CLIENTDIR/timer_wheel.cpp \
     $$APPDIR/app.cpp \
     $$APPDIR/arguments.cpp \
     $$APPDIR/main.cpp
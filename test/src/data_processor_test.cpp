@@ -1,4 +1,5 @@
 #include <cmath>
+#include <qnumeric.h>
 #include "data_processor.h"
 #include "data_processor_test.h"
 #include "froniussolar_api.h"
@@ -227,6 +228,122 @@ TEST_F(DataProcessorTest, ThreePhaseMultiple)
 	}
 }
 
+TEST_F(DataProcessorTest, L1PowerOnly)
+{
+	setUpProcessor(PhaseL1);
+
+	CommonInverterData data;
+	data.acPower = 512;
+	data.acVoltage = 225;
+	data.acCurrent = 2.3;
+	data.acFrequency = 60;
+	data.totalEnergy = 34596.9;
+	mProcessor->process(data);
+	mProcessor->processPower(618);
+
+	EXPECT_FLOAT_EQ(618, mInverter->meanPowerInfo()->power());
+	EXPECT_FLOAT_EQ(618, mInverter->l1PowerInfo()->power());
+	EXPECT_FLOAT_EQ(225, mInverter->l1PowerInfo()->voltage());
+	EXPECT_FLOAT_EQ(34.5969, mInverter->l1PowerInfo()->totalEnergy());
+}
+
+TEST_F(DataProcessorTest, ThreePhasePowerOnly)
+{
+	setUpProcessor(MultiPhase);
+
+	CommonInverterData data;
+	data.acPower = 445.7;
+	data.acVoltage = 232.8;
+	data.acCurrent = 1.93;
+	data.acFrequency = 59.5;
+	data.totalEnergy = 4321.9;
+	mProcessor->process(data);
+
+	ThreePhasesInverterData tpd;
+	tpd.acCurrentPhase1 = 0.61;
+	tpd.acVoltagePhase1 = 229.8;
+	tpd.acCurrentPhase2 = 0.57;
+	tpd.acVoltagePhase2 = 231.2;
+	tpd.acCurrentPhase3 = 0.63;
+	tpd.acVoltagePhase3 = 227.3;
+	mProcessor->process(tpd);
+	mProcessor->processPower(891.4);
+
+	double vi1 = 0.61 * 229.8;
+	double vi2 = 0.57 * 231.2;
+	double vi3 = 0.63 * 227.3;
+	double vit = vi1 + vi2 + vi3;
+
+	EXPECT_FLOAT_EQ(891.4, mInverter->meanPowerInfo()->power());
+	EXPECT_FLOAT_EQ(891.4 * vi1 / vit, mInverter->l1PowerInfo()->power());
+	EXPECT_FLOAT_EQ(891.4 * vi2 / vit, mInverter->l2PowerInfo()->power());
+	EXPECT_FLOAT_EQ(891.4 * vi3 / vit, mInverter->l3PowerInfo()->power());
+	EXPECT_FLOAT_EQ(0.61, mInverter->l1PowerInfo()->current());
+}
+
+TEST_F(DataProcessorTest, ThreePhasePowerOnlyAfterZero)
+{
+	setUpProcessor(MultiPhase);
+
+	CommonInverterData data;
+	data.acPower = 445.7;
+	data.acVoltage = 232.8;
+	data.acCurrent = 1.93;
+	data.acFrequency = 59.5;
+	data.totalEnergy = 4321.9;
+	mProcessor->process(data);
+
+	ThreePhasesInverterData tpd;
+	tpd.acCurrentPhase1 = 0.61;
+	tpd.acVoltagePhase1 = 229.8;
+	tpd.acCurrentPhase2 = 0.57;
+	tpd.acVoltagePhase2 = 231.2;
+	tpd.acCurrentPhase3 = 0.63;
+	tpd.acVoltagePhase3 = 227.3;
+	mProcessor->process(tpd);
+
+	// The inverter stops producing.
+	data.acPower = 0;
+	data.acCurrent = 0;
+	mProcessor->process(data);
+	tpd.acCurrentPhase1 = 0;
+	tpd.acCurrentPhase2 = 0;
+	tpd.acCurrentPhase3 = 0;
+	mProcessor->process(tpd);
+	EXPECT_FLOAT_EQ(0, mInverter->l1PowerInfo()->power());
+
+	// The power returns: distributed as in the last update with power.
+	mProcessor->processPower(891.4);
+
+	double vi1 = 0.61 * 229.8;
+	double vi2 = 0.57 * 231.2;
+	double vi3 = 0.63 * 227.3;
+	double vit = vi1 + vi2 + vi3;
+
+	EXPECT_FLOAT_EQ(891.4, mInverter->meanPowerInfo()->power());
+	EXPECT_FLOAT_EQ(891.4 * vi1 / vit, mInverter->l1PowerInfo()->power());
+	EXPECT_FLOAT_EQ(891.4 * vi2 / vit, mInverter->l2PowerInfo()->power());
+	EXPECT_FLOAT_EQ(891.4 * vi3 / vit, mInverter->l3PowerInfo()->power());
+
+	mProcessor->processPower(qQNaN());
+	EXPECT_NAN(mInverter->meanPowerInfo()->power());
+	EXPECT_NAN(mInverter->l1PowerInfo()->power());
+	EXPECT_NAN(mInverter->l2PowerInfo()->power());
+	EXPECT_NAN(mInverter->l3PowerInfo()->power());
+}
+
+TEST_F(DataProcessorTest, ThreePhasePowerOnlyInitial)
+{
+	setUpProcessor(MultiPhase);
+
+	// No full update yet: the power is distributed evenly.
+	mProcessor->processPower(600);
+	EXPECT_FLOAT_EQ(600, mInverter->meanPowerInfo()->power());
+	EXPECT_FLOAT_EQ(200, mInverter->l1PowerInfo()->power());
+	EXPECT_FLOAT_EQ(200, mInverter->l2PowerInfo()->power());
+	EXPECT_FLOAT_EQ(200, mInverter->l3PowerInfo()->power());
+}
+
 void DataProcessorTest::SetUp()
 {
 }
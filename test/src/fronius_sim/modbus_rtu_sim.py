@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+'''
+Simulates a Modbus RTU (RS485) bus with several SunSpec inverters, using a pseudo terminal pair.
+
+The simulator prints the name of the slave side of the pair, which can be used as serial port by
+dbus-fronius (the RtuPorts setting) or the modbus_tcp_client test tool. Only the slave addresses
+given on the command line respond, requests for other addresses time out, just like on a real bus.
+
+With --tcp, the simulator acts as a serial to ethernet gateway instead: RTU frames are exchanged
+over a TCP connection (use "rtu+tcp://localhost:<port>" as RTU port).
+'''
+import argparse
+import os
+import select
+import socket
+import struct
+import sys
+import time
+import tty
+
+from fronius_sim import FroniusSim
+from modbus_tcp_sim import FroniusDataBlock
+
+
+ILLEGAL_FUNCTION = 1
+ILLEGAL_DATA_ADDRESS = 2
+
+
+def crc16(data):
+	crc = 0xFFFF
+	for b in bytearray(data):
+		crc ^= b
+		for i in range(8):
+			if crc & 1:
+				crc = (crc >> 1) ^ 0xA001
+			else:
+				crc >>= 1
+	return crc
+
+
+def add_crc(frame):
+	return frame + struct.pack('<H', crc16(frame))
+
+
+def frame_length(buffer):
+	''' Returns the length of the request at the start of buffer, or 0 if unknown (yet). '''
+	if len(buffer) < 2:
+		return 0
+	function = buffer[1]
+	if function in (3, 4, 6):
+		return 8
+	if function == 16:
+		return 9 + buffer[6] if len(buffer) > 6 else 0
+	if function == 23:
+		return 13 + buffer[10] if len(buffer) > 10 else 0
+	# Unknown function: assume there is nothing after the CRC.
+	return 4
+
+
+class RtuBus(object):
+	def __init__(self, inverters, delay):
+		self._blocks = {int(i.id): FroniusDataBlock(i) for i in inverters}
+		self._delay = delay
+		self._buffer = bytearray()
+
+	def handle_data(self, data):
+		''' Handles data received on the bus, and returns the responses to complete requests. '''
+		self._buffer += data
+		responses = []
+		while True:
+			length = frame_length(self._buffer)
+			if length == 0 or len(self._buffer) < length:
+				break
+			frame = bytes(self._buffer[:length])
+			del self._buffer[:length]
+			if crc16(frame) != 0:
+				print('CRC error, discarding {} bytes'.format(len(self._buffer) + length))
+				self._buffer = bytearray()
+				break
+			response = self.handle_request(bytearray(frame[:-2]))
+			if response is not None:
+				responses.append(add_crc(response))
+		return responses
+
+	def handle_request(self, pdu):
+		unit_id = pdu[0]
+		function = pdu[1]
+		block = self._blocks.get(unit_id)
+		if block is None:
+			return None
+		if self._delay > 0:
+			time.sleep(self._delay / 1000.0)
+		if function in (3, 4):
+			start, count = struct.unpack('>HH', bytes(pdu[2:6]))
+			return self.read_response(pdu[:2], block, start, count)
+		if function == 6:
+			print('Unit {}: write {} to {}'.format(unit_id, pdu[4] << 8 | pdu[5], pdu[2] << 8 | pdu[3]))
+			return pdu[:6]
+		if function == 16:
+			start, count = struct.unpack('>HH', bytes(pdu[2:6]))
+			print('Unit {}: write {} registers at {}'.format(unit_id, count, start))
+			return pdu[:6]
+		if function == 23:
+			start, count, write_start, write_count = struct.unpack('>HHHH', bytes(pdu[2:10]))
+			print('Unit {}: write {} registers at {}'.format(unit_id, write_count, write_start))
+			return self.read_response(pdu[:2], block, start, count)
+		return bytearray([unit_id, function | 0x80, ILLEGAL_FUNCTION])
+
+	@staticmethod
+	def read_response(header, block, start, count):
+		if count < 1 or count > 125:
+			return bytearray([header[0], header[1] | 0x80, ILLEGAL_DATA_ADDRESS])
+		values = [block.get_value(start + i) & 0xFFFF for i in range(count)]
+		return header + bytearray([2 * count]) + struct.pack('>{}H'.format(count), *values)
+
+
+def serve_tcp(bus, port):
+	server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+	server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+	server.bind(('0.0.0.0', port))
+	# Like most gateways, we accept a single connection at a time.
+	server.listen(1)
+	print('Listening on TCP port {}'.format(port))
+	sys.stdout.flush()
+	while True:
+		connection, address = server.accept()
+		print('Connection from {}'.format(address[0]))
+		while True:
+			data = connection.recv(1024)
+			if not data:
+				break
+			for response in bus.handle_data(bytearray(data)):
+				connection.sendall(bytes(response))
+		connection.close()
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Modbus RTU SunSpec inverter simulator')
+	parser.add_argument('--units', default='1,2,3',
+		help='comma separated list of slave addresses with an inverter')
+	parser.add_argument('--delay', type=int, default=20,
+		help='time (in ms) needed by an inverter to respond')
+	parser.add_argument('--tcp', type=int, default=0,
+		help='listen on this TCP port instead of using a pseudo terminal')
+	args = parser.parse_args()
+
+	inverters = [FroniusSim(id=u, device_type=None, unique_id='RTU{:04}'.format(int(u)),
+		has_3phases=int(u) % 2 == 1, modbus_enabled=True) for u in args.units.split(',')]
+	bus = RtuBus(inverters, args.delay)
+	if args.tcp > 0:
+		serve_tcp(bus, args.tcp)
+		return
+
+	master, slave = os.openpty()
+	tty.setraw(master)
+	# Keep the slave side open, so the master side does not report errors (EIO) when the client
+	# closes the port.
+	tty.setraw(slave)
+	print('Serial port: {}'.format(os.ttyname(slave)))
+	print('Units: {}'.format(args.units))
+	sys.stdout.flush()
+
+	while True:
+		select.select([master], [], [])
+		data = os.read(master, 1024)
+		for response in bus.handle_data(bytearray(data)):
+			os.write(master, bytes(response))
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <QBuffer>
+#include "modbus_frame_buffer.h"
+
+// Appends `count` bytes, with values starting at `first`.
+static void appendSequence(ModbusFrameBuffer &buffer, int first, int count)
+{
+	QByteArray data;
+	for (int i=0; i<count; ++i)
+		data.append(static_cast<char>(first + i));
+	buffer.append(data.constData(), data.size());
+}
+
+TEST(ModbusFrameBufferTest, appendAndSkip)
+{
+	ModbusFrameBuffer buffer(16);
+	EXPECT_EQ(16, buffer.capacity());
+	EXPECT_EQ(0, buffer.size());
+	appendSequence(buffer, 1, 6);
+	EXPECT_EQ(6, buffer.size());
+	EXPECT_EQ(1, buffer.peek(0));
+	EXPECT_EQ(0x0304, buffer.peekUInt16(2));
+	buffer.skip(4);
+	EXPECT_EQ(2, buffer.size());
+	EXPECT_EQ(5, buffer.peek(0));
+	EXPECT_EQ(0x0506, buffer.peekUInt16(0));
+}
+
+TEST(ModbusFrameBufferTest, wrapAround)
+{
+	ModbusFrameBuffer buffer(16);
+	appendSequence(buffer, 0, 11);
+	buffer.skip(11);
+	// 5 bytes fit before the end of the buffer, the rest wraps around to the start.
+	appendSequence(buffer, 0x10, 12);
+	EXPECT_EQ(16, buffer.capacity());
+	EXPECT_EQ(12, buffer.size());
+	for (int i=0; i<12; ++i)
+		EXPECT_EQ(0x10 + i, buffer.peek(i));
+	// A value which is split by the end of the buffer.
+	EXPECT_EQ(0x1415, buffer.peekUInt16(4));
+
+	quint16 registers[6];
+	buffer.peekRegisters(0, registers, 6);
+	for (int i=0; i<6; ++i)
+		EXPECT_EQ(((0x10 + 2 * i) << 8) | (0x11 + 2 * i), registers[i]);
+
+	// Registers which do not wrap.
+	buffer.skip(6);
+	buffer.peekRegisters(0, registers, 3);
+	EXPECT_EQ(0x1617, registers[0]);
+	EXPECT_EQ(0x1a1b, registers[2]);
+}
+
+TEST(ModbusFrameBufferTest, growWhileWrapped)
+{
+	ModbusFrameBuffer buffer(16);
+	appendSequence(buffer, 0, 12);
+	buffer.skip(10);
+	appendSequence(buffer, 12, 10);
+	EXPECT_EQ(12, buffer.size());
+	// Does not fit: the data is moved to a bigger buffer.
+	appendSequence(buffer, 22, 20);
+	EXPECT_EQ(32, buffer.capacity());
+	EXPECT_EQ(32, buffer.size());
+	for (int i=0; i<32; ++i)
+		EXPECT_EQ(10 + i, buffer.peek(i));
+}
+
+TEST(ModbusFrameBufferTest, clear)
+{
+	ModbusFrameBuffer buffer(16);
+	appendSequence(buffer, 0, 13);
+	buffer.skip(2);
+	buffer.clear();
+	EXPECT_EQ(0, buffer.size());
+	EXPECT_EQ(16, buffer.capacity());
+	// New data is read from the start, even if it wraps around.
+	appendSequence(buffer, 0x20, 8);
+	EXPECT_EQ(8, buffer.size());
+	EXPECT_EQ(0x20, buffer.peek(0));
+	EXPECT_EQ(0x2324, buffer.peekUInt16(3));
+	EXPECT_EQ(0x27, buffer.peek(7));
+}
+
+TEST(ModbusFrameBufferTest, readFrom)
+{
+	ModbusFrameBuffer buffer(16);
+	appendSequence(buffer, 0, 12);
+	buffer.skip(12);
+
+	QByteArray data;
+	for (int i=0; i<10; ++i)
+		data.append(static_cast<char>(0x30 + i));
+	QBuffer device(&data);
+	ASSERT_TRUE(device.open(QIODevice::ReadOnly));
+	// Takes two reads: one up to the end of the buffer, and one at the start.
+	EXPECT_EQ(10, buffer.readFrom(&device));
+	EXPECT_EQ(10, buffer.size());
+	for (int i=0; i<10; ++i)
+		EXPECT_EQ(0x30 + i, buffer.peek(i));
+	EXPECT_EQ(0, buffer.readFrom(&device));
+}
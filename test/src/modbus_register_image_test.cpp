@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "modbus_register_image.h"
+
+// Returns `count` consecutive values, starting at `first`.
+static QVector<quint16> sequence(int first, int count)
+{
+	QVector<quint16> values;
+	for (int i=0; i<count; ++i)
+		values.append(static_cast<quint16>(first + i));
+	return values;
+}
+
+TEST(ModbusRegisterImageTest, updateAndRead)
+{
+	ModbusRegisterImage image;
+	EXPECT_FALSE(image.hasUnit(1));
+	image.update(1, 40000, sequence(100, 10));
+	EXPECT_TRUE(image.hasUnit(1));
+	EXPECT_FALSE(image.hasUnit(2));
+
+	quint16 values[10];
+	ASSERT_TRUE(image.read(1, 40000, 10, values));
+	for (int i=0; i<10; ++i)
+		EXPECT_EQ(100 + i, values[i]);
+	ASSERT_TRUE(image.read(1, 40003, 2, values));
+	EXPECT_EQ(103, values[0]);
+	EXPECT_EQ(104, values[1]);
+
+	// Registers next to the stored ones, and other units, are not available.
+	EXPECT_FALSE(image.read(1, 39999, 2, values));
+	EXPECT_FALSE(image.read(1, 40009, 2, values));
+	EXPECT_FALSE(image.read(2, 40000, 1, values));
+	EXPECT_FALSE(image.read(1, 40000, 0, values));
+}
+
+TEST(ModbusRegisterImageTest, crossPage)
+{
+	// 40000 is register 0 of page 625, so this update spans 3 pages.
+	ModbusRegisterImage image;
+	image.update(1, 39990, sequence(0, 100));
+	quint16 values[100];
+	ASSERT_TRUE(image.read(1, 39990, 100, values));
+	for (int i=0; i<100; ++i)
+		EXPECT_EQ(i, values[i]);
+	ASSERT_TRUE(image.read(1, 39998, 4, values));
+	EXPECT_EQ(8, values[0]);
+	EXPECT_EQ(11, values[3]);
+	EXPECT_FALSE(image.read(1, 40050, 50, values));
+}
+
+TEST(ModbusRegisterImageTest, partlyValidPage)
+{
+	ModbusRegisterImage image;
+	// Two blocks in the same page, with a gap in between.
+	image.update(1, 40000, sequence(0, 5));
+	image.update(1, 40010, sequence(10, 5));
+	quint16 values[15];
+	EXPECT_FALSE(image.read(1, 40000, 15, values));
+	EXPECT_FALSE(image.read(1, 40004, 2, values));
+	EXPECT_FALSE(image.read(1, 40009, 2, values));
+	ASSERT_TRUE(image.read(1, 40010, 5, values));
+	EXPECT_EQ(10, values[0]);
+
+	// Filling the gap makes the whole range available.
+	image.update(1, 40005, sequence(5, 5));
+	ASSERT_TRUE(image.read(1, 40000, 15, values));
+	for (int i=0; i<15; ++i)
+		EXPECT_EQ(i, values[i]);
+
+	// Overwriting keeps the registers valid.
+	image.update(1, 40002, sequence(200, 2));
+	ASSERT_TRUE(image.read(1, 40000, 5, values));
+	EXPECT_EQ(1, values[1]);
+	EXPECT_EQ(200, values[2]);
+	EXPECT_EQ(201, values[3]);
+	EXPECT_EQ(4, values[4]);
+}
+
+TEST(ModbusRegisterImageTest, fullPage)
+{
+	// A page which is completely valid, and its neighbour, which is not.
+	ModbusRegisterImage image;
+	image.update(1, 64, sequence(0, 64));
+	quint16 values[65];
+	ASSERT_TRUE(image.read(1, 64, 64, values));
+	EXPECT_EQ(0, values[0]);
+	EXPECT_EQ(63, values[63]);
+	EXPECT_FALSE(image.read(1, 63, 64, values));
+	EXPECT_FALSE(image.read(1, 64, 65, values));
+
+	// The last register of the next page only.
+	image.update(1, 191, sequence(1000, 1));
+	EXPECT_FALSE(image.read(1, 128, 64, values));
+	ASSERT_TRUE(image.read(1, 191, 1, values));
+	EXPECT_EQ(1000, values[0]);
+}
+
+TEST(ModbusRegisterImageTest, topOfAddressSpace)
+{
+	ModbusRegisterImage image;
+	// Values beyond register 65535 are dropped.
+	image.update(1, 65530, sequence(0, 10));
+	quint16 values[10];
+	ASSERT_TRUE(image.read(1, 65530, 6, values));
+	EXPECT_EQ(0, values[0]);
+	EXPECT_EQ(5, values[5]);
+	ASSERT_TRUE(image.read(1, 65535, 1, values));
+	EXPECT_EQ(5, values[0]);
+	EXPECT_FALSE(image.read(1, 65535, 2, values));
+	// Register 0 is not written by the wrap around.
+	EXPECT_FALSE(image.read(1, 0, 1, values));
+}
+
+TEST(ModbusRegisterImageTest, removeUnit)
+{
+	ModbusRegisterImage image;
+	image.update(1, 40000, sequence(0, 10));
+	image.update(2, 40000, sequence(0, 10));
+	image.removeUnit(1);
+	EXPECT_FALSE(image.hasUnit(1));
+	quint16 values[10];
+	EXPECT_FALSE(image.read(1, 40000, 10, values));
+	EXPECT_TRUE(image.read(2, 40000, 10, values));
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "modbus_request_queue.h"
+
+TEST(ModbusRequestQueueTest, priorityOrder)
+{
+	ModbusRequestQueue<int> queue;
+	queue.enqueue(1, ModbusClient::PollPriority);
+	queue.enqueue(2, ModbusClient::BackgroundPriority);
+	queue.enqueue(3, ModbusClient::ControlPriority);
+	queue.enqueue(4, ModbusClient::PollPriority);
+	EXPECT_EQ(4, queue.size());
+	EXPECT_EQ(2, queue.size(ModbusClient::PollPriority));
+
+	EXPECT_EQ(3, queue.dequeue());
+	EXPECT_EQ(1, queue.dequeue());
+	EXPECT_EQ(4, queue.dequeue());
+	EXPECT_EQ(2, queue.dequeue());
+	EXPECT_TRUE(queue.isEmpty());
+	EXPECT_EQ(4, queue.maxSize());
+	queue.resetMaxSize();
+	EXPECT_EQ(0, queue.maxSize());
+}
+
+TEST(ModbusRequestQueueTest, noStarvation)
+{
+	const int maxOvertaken = ModbusRequestQueue<int>::MaxOvertaken;
+	ModbusRequestQueue<int> queue;
+	queue.enqueue(-1, ModbusClient::BackgroundPriority);
+	queue.enqueue(-2, ModbusClient::BackgroundPriority);
+
+	// A constant load of control requests: there is always one waiting.
+	int next = 0;
+	queue.enqueue(next++, ModbusClient::ControlPriority);
+	QList<int> served;
+	for (int i = 0; i < 4 * maxOvertaken; ++i) {
+		queue.enqueue(next++, ModbusClient::ControlPriority);
+		served.append(queue.dequeue());
+	}
+
+	int first = served.indexOf(-1);
+	int second = served.indexOf(-2);
+	ASSERT_NE(-1, first);
+	ASSERT_NE(-1, second);
+	EXPECT_EQ(maxOvertaken, first);
+	EXPECT_EQ(first + maxOvertaken + 1, second);
+	// The control requests are still served in order.
+	int last = -1;
+	foreach (int item, served) {
+		if (item < 0)
+			continue;
+		EXPECT_GT(item, last);
+		last = item;
+	}
+}
+
+TEST(ModbusRequestQueueTest, removeOne)
+{
+	ModbusRequestQueue<int> queue;
+	queue.enqueue(1, ModbusClient::PollPriority);
+	queue.enqueue(2, ModbusClient::DetectionPriority);
+	EXPECT_TRUE(queue.removeOne(1));
+	EXPECT_FALSE(queue.removeOne(1));
+	EXPECT_EQ(1, queue.size());
+	EXPECT_EQ(2, queue.dequeue());
+	EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(ModbusRequestQueueTest, dequeuePreferred)
+{
+	ModbusRequestQueue<int> queue;
+	queue.enqueue(1, ModbusClient::PollPriority);
+	queue.enqueue(2, ModbusClient::PollPriority);
+	queue.enqueue(3, ModbusClient::BackgroundPriority);
+	EXPECT_EQ(2, queue.dequeue([](int item) { return item % 2 == 0; }));
+	// There is no preferred request left on the poll level.
+	EXPECT_EQ(1, queue.dequeue([](int item) { return item % 2 == 0; }));
+	EXPECT_EQ(3, queue.dequeue());
+}
@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <string.h>
+#include "crc16.h"
+#include "modbus_rtu_frame_parser.h"
+
+// The CRC as defined in the Modbus specification: bit by bit, without tables.
+static quint16 referenceCrc(const QByteArray &bytes)
+{
+	quint16 crc = 0xFFFF;
+	for (int i=0; i<bytes.size(); ++i) {
+		crc ^= static_cast<quint8>(bytes[i]);
+		for (int bit=0; bit<8; ++bit)
+			crc = (crc & 1) != 0 ? static_cast<quint16>((crc >> 1) ^ 0xA001) : crc >> 1;
+	}
+	return toUInt16(lsb(crc), msb(crc));
+}
+
+static QByteArray withCrc(QByteArray frame)
+{
+	quint16 crc = Crc16::getValue(frame);
+	frame.append(static_cast<char>(msb(crc)));
+	frame.append(static_cast<char>(lsb(crc)));
+	return frame;
+}
+
+// A reply to a read of 2 holding registers.
+static QByteArray readReply(quint8 unitId, quint16 value0, quint16 value1)
+{
+	QByteArray frame;
+	frame.append(static_cast<char>(unitId));
+	frame.append(3);
+	frame.append(4);
+	frame.append(static_cast<char>(msb(value0)));
+	frame.append(static_cast<char>(lsb(value0)));
+	frame.append(static_cast<char>(msb(value1)));
+	frame.append(static_cast<char>(lsb(value1)));
+	return withCrc(frame);
+}
+
+TEST(Crc16Test, knownValues)
+{
+	EXPECT_EQ(0x374B, Crc16::getValue(QByteArray("123456789")));
+	// Read holding register 0 of unit 1.
+	const char request[] = { 1, 3, 0, 0, 0, 1 };
+	EXPECT_EQ(0x840A, Crc16::getValue(request, sizeof(request)));
+	EXPECT_EQ(0xFFFF, Crc16::getValue(QByteArray()));
+}
+
+TEST(Crc16Test, slicingMatchesReference)
+{
+	std::mt19937 random(1234);
+	for (int size=0; size<300; ++size) {
+		QByteArray bytes;
+		for (int i=0; i<size; ++i)
+			bytes.append(static_cast<char>(random() & 0xFF));
+		quint16 expected = referenceCrc(bytes);
+		EXPECT_EQ(expected, Crc16::getValue(bytes)) << "size " << size;
+
+		// The same data in pieces, with the bytewise and the block functions mixed.
+		Crc16 crc;
+		int i = 0;
+		while (i < size) {
+			int n = qMin(static_cast<int>(random() % 11), size - i);
+			if (n == 0) {
+				crc.add(static_cast<uint8_t>(bytes[i]));
+				++i;
+			} else {
+				crc.add(bytes.constData() + i, n);
+				i += n;
+			}
+		}
+		EXPECT_EQ(expected, crc.getValue()) << "size " << size;
+	}
+}
+
+TEST(ModbusRtuFrameParserTest, readReply)
+{
+	ModbusRtuFrameParser parser;
+	QByteArray frame = readReply(7, 0x1234, 0xABCD);
+	parser.append(frame.constData(), frame.size());
+
+	ModbusRtuFrameParser::Frame result;
+	ASSERT_TRUE(parser.nextFrame(&result));
+	EXPECT_EQ(7, result.unitId);
+	EXPECT_EQ(3, result.function);
+	ASSERT_EQ(5, result.dataSize);
+	EXPECT_EQ(4, result.data[0]);
+	EXPECT_EQ(0x12, result.data[1]);
+	EXPECT_EQ(0xCD, result.data[4]);
+	EXPECT_EQ(0, parser.size());
+	EXPECT_FALSE(parser.nextFrame(&result));
+}
+
+TEST(ModbusRtuFrameParserTest, partialFrame)
+{
+	ModbusRtuFrameParser parser;
+	QByteArray frame = readReply(1, 1, 2);
+	ModbusRtuFrameParser::Frame result;
+	for (int i=0; i<frame.size() - 1; ++i) {
+		parser.append(frame.constData() + i, 1);
+		EXPECT_FALSE(parser.nextFrame(&result));
+	}
+	// Received directly into the parser.
+	int room = 0;
+	char *buffer = parser.writeBuffer(&room);
+	ASSERT_GE(room, static_cast<int>(ModbusRtuFrameParser::MaxFrameSize));
+	buffer[0] = frame[frame.size() - 1];
+	parser.commit(1);
+	ASSERT_TRUE(parser.nextFrame(&result));
+	EXPECT_EQ(1, result.unitId);
+}
+
+TEST(ModbusRtuFrameParserTest, exceptionAndWriteReplies)
+{
+	ModbusRtuFrameParser parser;
+	QByteArray exception;
+	exception.append(2);
+	exception.append(static_cast<char>(0x83));
+	exception.append(2);
+	QByteArray write;
+	write.append(2);
+	write.append(16);
+	write.append(QByteArray::fromHex("9c400002"));
+	QByteArray data = withCrc(exception) + withCrc(write);
+	parser.append(data.constData(), data.size());
+
+	ModbusRtuFrameParser::Frame result;
+	ASSERT_TRUE(parser.nextFrame(&result));
+	EXPECT_EQ(0x83, result.function);
+	ASSERT_EQ(1, result.dataSize);
+	EXPECT_EQ(2, result.data[0]);
+	ASSERT_TRUE(parser.nextFrame(&result));
+	EXPECT_EQ(16, result.function);
+	EXPECT_EQ(4, result.dataSize);
+	EXPECT_FALSE(parser.nextFrame(&result));
+}
+
+TEST(ModbusRtuFrameParserTest, resyncAfterCrcError)
+{
+	ModbusRtuFrameParser parser;
+	QByteArray corrupt = readReply(1, 1, 2);
+	corrupt[4] = static_cast<char>(corrupt[4] ^ 0x10);
+	QByteArray data = corrupt + readReply(1, 3, 4);
+	parser.append(data.constData(), data.size());
+
+	ModbusRtuFrameParser::Frame result;
+	ASSERT_TRUE(parser.nextFrame(&result));
+	EXPECT_EQ(3, toUInt16(result.data[1], result.data[2]));
+	EXPECT_EQ(4, toUInt16(result.data[3], result.data[4]));
+	EXPECT_GE(parser.crcErrorCount(), 1u);
+}
+
+TEST(ModbusRtuFrameParserTest, clear)
+{
+	ModbusRtuFrameParser parser;
+	QByteArray frame = readReply(1, 1, 2);
+	// An interrupted frame, followed by silence.
+	parser.append(frame.constData(), 5);
+	parser.clear();
+	EXPECT_EQ(0, parser.size());
+	parser.append(frame.constData(), frame.size());
+	ModbusRtuFrameParser::Frame result;
+	ASSERT_TRUE(parser.nextFrame(&result));
+	EXPECT_EQ(0u, parser.crcErrorCount());
+}
+
+TEST(ModbusRtuFrameParserTest, longStream)
+{
+	// More data than the buffer holds, received in chunks which do not match the frames, so the
+	// unparsed data has to be moved to the start of the buffer now and then.
+	QByteArray data;
+	for (int i=0; i<200; ++i)
+		data += readReply(1, static_cast<quint16>(i), 0);
+	ModbusRtuFrameParser parser;
+	ModbusRtuFrameParser::Frame result;
+	int count = 0;
+	for (int i=0; i<data.size(); i += 13) {
+		parser.append(data.constData() + i, qMin(13, data.size() - i));
+		while (parser.nextFrame(&result)) {
+			EXPECT_EQ(count, toUInt16(result.data[1], result.data[2]));
+			++count;
+		}
+	}
+	EXPECT_EQ(200, count);
+	EXPECT_EQ(0u, parser.crcErrorCount());
+}
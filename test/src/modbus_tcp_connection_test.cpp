@@ -0,0 +1,301 @@
+#include <gtest/gtest.h>
+#include <QElapsedTimer>
+#include <QList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "modbus_reply.h"
+#include "modbus_tcp_client.h"
+#include "test_helper.h"
+
+// Processes events until `socket` has received `count` bytes, or the timeout expires.
+static bool waitForBytes(QTcpSocket *socket, int count, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (socket->bytesAvailable() < count && timer.elapsed() < timeout)
+		qWait(10);
+	return socket->bytesAvailable() >= count;
+}
+
+static QTcpSocket *waitForConnection(QTcpServer &server, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (!server.hasPendingConnections() && timer.elapsed() < timeout)
+		qWait(10);
+	return server.nextPendingConnection();
+}
+
+static bool waitForConnected(ModbusClient &client, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (!client.isConnected() && timer.elapsed() < timeout)
+		qWait(10);
+	return client.isConnected();
+}
+
+static bool waitForReply(ModbusReply *reply, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (!reply->isFinished() && timer.elapsed() < timeout)
+		qWait(10);
+	return reply->isFinished();
+}
+
+// Reads a request for holding registers (12 bytes), and returns its transaction ID.
+static quint16 readRequest(QTcpSocket *socket, quint16 *startReg = 0)
+{
+	if (!waitForBytes(socket, 12))
+		return 0;
+	QByteArray request = socket->read(12);
+	if (startReg != 0) {
+		*startReg = static_cast<quint16>((static_cast<quint8>(request[8]) << 8) |
+										 static_cast<quint8>(request[9]));
+	}
+	return static_cast<quint16>((static_cast<quint8>(request[0]) << 8) |
+								static_cast<quint8>(request[1]));
+}
+
+// A reply to a read of 2 holding registers, from unit 1.
+static QByteArray readReply(quint16 transactionId, quint16 value0, quint16 value1)
+{
+	QByteArray frame;
+	frame.append(static_cast<char>(transactionId >> 8));
+	frame.append(static_cast<char>(transactionId & 0xFF));
+	frame.append(2, '\0'); // Protocol ID
+	frame.append('\0');
+	frame.append(7); // Length: unit ID, function code, byte count, 4 data bytes
+	frame.append(1); // Unit ID
+	frame.append(3); // Read holding registers
+	frame.append(4);
+	frame.append(static_cast<char>(value0 >> 8));
+	frame.append(static_cast<char>(value0 & 0xFF));
+	frame.append(static_cast<char>(value1 >> 8));
+	frame.append(static_cast<char>(value1 & 0xFF));
+	return frame;
+}
+
+TEST(ModbusTcpConnectionTest, truncatedFrameBeforeReconnect)
+{
+	QTcpServer server;
+	ASSERT_TRUE(server.listen(QHostAddress::LocalHost, 0));
+
+	ModbusTcpClient client;
+	client.setTimeout(2000);
+	client.setAutoReconnect(true);
+	client.connectToServer("127.0.0.1", server.serverPort());
+
+	QTcpSocket *first = waitForConnection(server);
+	ASSERT_TRUE(first != 0);
+	ModbusReply *reply = client.readHoldingRegisters(1, 40000, 2);
+	quint16 transactionId = readRequest(first);
+	ASSERT_NE(0, transactionId);
+
+	// The connection drops in the middle of the reply.
+	first->write(readReply(transactionId, 1, 2).left(8));
+	first->flush();
+	qWait(100);
+	first->abort();
+	ASSERT_TRUE(waitForReply(reply));
+	EXPECT_EQ(ModbusReply::TcpError, reply->error());
+	delete reply;
+
+	// After the reconnect, the first reply on the new connection must be decoded.
+	QTcpSocket *second = waitForConnection(server);
+	ASSERT_TRUE(second != 0);
+	reply = client.readHoldingRegisters(1, 40000, 2);
+	transactionId = readRequest(second);
+	ASSERT_NE(0, transactionId);
+	second->write(readReply(transactionId, 0x5375, 0x6e53));
+	second->flush();
+	ASSERT_TRUE(waitForReply(reply));
+	EXPECT_EQ(ModbusReply::NoException, reply->error());
+	ASSERT_EQ(2, reply->registers().size());
+	EXPECT_EQ(0x5375, reply->registers()[0]);
+	EXPECT_EQ(0x6e53, reply->registers()[1]);
+	delete reply;
+
+	delete first;
+	delete second;
+}
+
+TEST(ModbusTcpConnectionTest, invalidFrame)
+{
+	QTcpServer server;
+	ASSERT_TRUE(server.listen(QHostAddress::LocalHost, 0));
+
+	ModbusTcpClient client;
+	client.setTimeout(2000);
+	client.setAutoReconnect(true);
+	client.connectToServer("127.0.0.1", server.serverPort());
+
+	QTcpSocket *first = waitForConnection(server);
+	ASSERT_TRUE(first != 0);
+	ModbusReply *reply = client.readHoldingRegisters(1, 40000, 2);
+	quint16 transactionId = readRequest(first);
+	ASSERT_NE(0, transactionId);
+
+	// A wrong protocol ID: the request fails without waiting for the timeout, and the connection
+	// is closed.
+	QByteArray frame = readReply(transactionId, 1, 2);
+	frame[3] = 1;
+	first->write(frame);
+	first->flush();
+	ASSERT_TRUE(waitForReply(reply, 1000));
+	EXPECT_EQ(ModbusReply::TcpError, reply->error());
+	delete reply;
+
+	// A length field which does not fit in a Modbus TCP frame, on the new connection.
+	QTcpSocket *second = waitForConnection(server);
+	ASSERT_TRUE(second != 0);
+	reply = client.readHoldingRegisters(1, 40000, 2);
+	transactionId = readRequest(second);
+	ASSERT_NE(0, transactionId);
+	frame = readReply(transactionId, 1, 2);
+	frame[4] = 1;
+	second->write(frame);
+	second->flush();
+	ASSERT_TRUE(waitForReply(reply, 1000));
+	EXPECT_EQ(ModbusReply::TcpError, reply->error());
+	delete reply;
+
+	// The third connection works.
+	QTcpSocket *third = waitForConnection(server);
+	ASSERT_TRUE(third != 0);
+	reply = client.readHoldingRegisters(1, 40000, 2);
+	transactionId = readRequest(third);
+	ASSERT_NE(0, transactionId);
+	third->write(readReply(transactionId, 3, 4));
+	third->flush();
+	ASSERT_TRUE(waitForReply(reply));
+	EXPECT_EQ(ModbusReply::NoException, reply->error());
+	delete reply;
+
+	delete first;
+	delete second;
+	delete third;
+}
+
+TEST(ModbusTcpConnectionTest, batchedRequests)
+{
+	QTcpServer server;
+	ASSERT_TRUE(server.listen(QHostAddress::LocalHost, 0));
+	ModbusTcpClient client;
+	client.setMaxInFlight(4);
+	client.connectToServer("127.0.0.1", server.serverPort());
+	QTcpSocket *socket = waitForConnection(server);
+	ASSERT_TRUE(socket != 0);
+	ASSERT_TRUE(waitForConnected(client));
+
+	// Requests created in the same event loop iteration are sent in a single write.
+	QList<ModbusReply *> replies;
+	for (int i=0; i<3; ++i)
+		replies.append(client.readHoldingRegisters(1, static_cast<quint16>(40000 + 10 * i), 2));
+	ASSERT_TRUE(waitForBytes(socket, 1));
+	EXPECT_EQ(36, socket->bytesAvailable());
+
+	QList<quint16> transactionIds;
+	for (int i=0; i<3; ++i) {
+		quint16 startReg = 0;
+		transactionIds.append(readRequest(socket, &startReg));
+		EXPECT_EQ(40000 + 10 * i, startReg);
+	}
+	EXPECT_NE(transactionIds[0], transactionIds[1]);
+	EXPECT_NE(transactionIds[1], transactionIds[2]);
+	for (int i=0; i<3; ++i)
+		socket->write(readReply(transactionIds[i], static_cast<quint16>(i), 0));
+	socket->flush();
+	for (int i=0; i<3; ++i) {
+		ASSERT_TRUE(waitForReply(replies[i]));
+		EXPECT_EQ(ModbusReply::NoException, replies[i]->error());
+		EXPECT_EQ(i, replies[i]->registers()[0]);
+	}
+	qDeleteAll(replies);
+	delete socket;
+}
+
+TEST(ModbusTcpConnectionTest, inFlightWindow)
+{
+	QTcpServer server;
+	ASSERT_TRUE(server.listen(QHostAddress::LocalHost, 0));
+	ModbusTcpClient client;
+	client.setTimeout(5000);
+	client.setMaxInFlight(2);
+	client.connectToServer("127.0.0.1", server.serverPort());
+	QTcpSocket *socket = waitForConnection(server);
+	ASSERT_TRUE(socket != 0);
+	ASSERT_TRUE(waitForConnected(client));
+
+	QList<ModbusReply *> replies;
+	for (int i=0; i<3; ++i)
+		replies.append(client.readHoldingRegisters(1, static_cast<quint16>(40000 + 10 * i), 2));
+	quint16 first = readRequest(socket);
+	quint16 second = readRequest(socket);
+	ASSERT_NE(0, first);
+	ASSERT_NE(0, second);
+	// The third request waits for room in the window.
+	qWait(200);
+	EXPECT_EQ(0, socket->bytesAvailable());
+	EXPECT_FALSE(replies[2]->isFinished());
+
+	socket->write(readReply(second, 2, 0));
+	socket->flush();
+	ASSERT_TRUE(waitForReply(replies[1]));
+	quint16 startReg = 0;
+	quint16 third = readRequest(socket, &startReg);
+	ASSERT_NE(0, third);
+	EXPECT_EQ(40020, startReg);
+	EXPECT_FALSE(replies[0]->isFinished());
+
+	socket->write(readReply(first, 1, 0) + readReply(third, 3, 0));
+	socket->flush();
+	for (int i=0; i<3; ++i) {
+		ASSERT_TRUE(waitForReply(replies[i]));
+		EXPECT_EQ(ModbusReply::NoException, replies[i]->error());
+		EXPECT_EQ(i + 1, replies[i]->registers()[0]);
+	}
+	qDeleteAll(replies);
+	delete socket;
+}
+
+TEST(ModbusTcpConnectionTest, outOfOrderReplies)
+{
+	QTcpServer server;
+	ASSERT_TRUE(server.listen(QHostAddress::LocalHost, 0));
+	ModbusTcpClient client;
+	client.setMaxInFlight(4);
+	client.connectToServer("127.0.0.1", server.serverPort());
+	QTcpSocket *socket = waitForConnection(server);
+	ASSERT_TRUE(socket != 0);
+	ASSERT_TRUE(waitForConnected(client));
+
+	QList<ModbusReply *> replies;
+	QList<quint16> transactionIds;
+	for (int i=0; i<4; ++i)
+		replies.append(client.readHoldingRegisters(1, static_cast<quint16>(40000 + 10 * i), 2));
+	for (int i=0; i<4; ++i) {
+		transactionIds.append(readRequest(socket));
+		ASSERT_NE(0, transactionIds.last());
+	}
+
+	// The replies are matched by transaction ID, not by the order of the requests.
+	static const int order[] = { 2, 0, 3, 1 };
+	for (int i=0; i<4; ++i) {
+		int r = order[i];
+		socket->write(readReply(transactionIds[r], static_cast<quint16>(r), 0x100));
+		socket->flush();
+		ASSERT_TRUE(waitForReply(replies[r]));
+		for (int j=i+1; j<4; ++j)
+			EXPECT_FALSE(replies[order[j]]->isFinished());
+	}
+	for (int i=0; i<4; ++i) {
+		EXPECT_EQ(ModbusReply::NoException, replies[i]->error());
+		ASSERT_EQ(2, replies[i]->registers().size());
+		EXPECT_EQ(i, replies[i]->registers()[0]);
+		EXPECT_EQ(0x100, replies[i]->registers()[1]);
+	}
+	qDeleteAll(replies);
+	delete socket;
+}
@@ -0,0 +1,309 @@
+#include <gtest/gtest.h>
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "modbus_reply.h"
+#include "modbus_tcp_frame.h"
+#include "modbus_tcp_proxy.h"
+#include "test_helper.h"
+
+// Processes events until `socket` has received `count` bytes, or the timeout expires.
+static bool waitForBytes(QTcpSocket *socket, int count, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (socket->bytesAvailable() < count && timer.elapsed() < timeout)
+		qWait(10);
+	return socket->bytesAvailable() >= count;
+}
+
+static QTcpSocket *waitForConnection(QTcpServer &server, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (!server.hasPendingConnections() && timer.elapsed() < timeout)
+		qWait(10);
+	return server.nextPendingConnection();
+}
+
+// Reads a complete frame (MBAP header and PDU). Returns an empty array on timeout.
+static QByteArray readFrame(QTcpSocket *socket, int timeout = 5000)
+{
+	if (!waitForBytes(socket, 6, timeout))
+		return QByteArray();
+	QByteArray header = socket->peek(6);
+	int length = (static_cast<quint8>(header[4]) << 8) | static_cast<quint8>(header[5]);
+	if (!waitForBytes(socket, 6 + length, timeout))
+		return QByteArray();
+	return socket->read(6 + length);
+}
+
+static quint16 transactionIdOf(const QByteArray &frame)
+{
+	return static_cast<quint16>((static_cast<quint8>(frame[0]) << 8) |
+								static_cast<quint8>(frame[1]));
+}
+
+static QByteArray withTransactionId(QByteArray frame, quint16 transactionId)
+{
+	ModbusTcpFrame::setTransactionId(frame.data(), transactionId);
+	return frame;
+}
+
+static QByteArray readRequest(quint16 transactionId, quint8 unitId, quint16 startReg,
+							  quint16 count)
+{
+	return withTransactionId(
+		ModbusTcpFrame::readRegisters(ModbusTcpFrame::ReadHoldingRegisters, unitId, startReg,
+									  count),
+		transactionId);
+}
+
+static QByteArray readResponse(quint16 transactionId, quint8 unitId, quint16 value0,
+							   quint16 value1)
+{
+	quint16 values[] = { value0, value1 };
+	return withTransactionId(
+		ModbusTcpFrame::readRegistersResponse(ModbusTcpFrame::ReadHoldingRegisters, unitId,
+											  values, 2),
+		transactionId);
+}
+
+static QByteArray exceptionResponse(quint16 transactionId, quint8 function, quint8 unitId,
+									ModbusReply::ExceptionCode error)
+{
+	return withTransactionId(ModbusTcpFrame::exceptionResponse(function, unitId, error),
+							 transactionId);
+}
+
+/*
+ * The proxy forwards requests for unit 1 to unit 7 of a fake device, which is a plain TCP server
+ * controlled by the test. Unit 2 cannot be resolved.
+ */
+class ModbusTcpProxyTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		mDeviceSocket = 0;
+		ASSERT_TRUE(mDevice.listen(QHostAddress::LocalHost, 0));
+		quint16 devicePort = mDevice.serverPort();
+		mProxy = new ModbusTcpProxy([devicePort](quint8 unitId, ModbusTcpProxy::Target *target) {
+			if (unitId != 1)
+				return false;
+			target->hostName = "127.0.0.1";
+			target->tcpPort = devicePort;
+			target->unitId = 7;
+			return true;
+		});
+		ASSERT_TRUE(mProxy->listen(0));
+		mClient = connectClient();
+		ASSERT_TRUE(mClient != 0);
+	}
+
+	void TearDown() override
+	{
+		delete mClient;
+		delete mProxy;
+		delete mDeviceSocket;
+	}
+
+	QTcpSocket *connectClient()
+	{
+		QTcpSocket *socket = new QTcpSocket();
+		socket->connectToHost(QHostAddress::LocalHost, mProxy->serverPort());
+		if (!socket->waitForConnected(5000)) {
+			delete socket;
+			return 0;
+		}
+		return socket;
+	}
+
+	static void send(QTcpSocket *socket, const QByteArray &data)
+	{
+		socket->write(data);
+		socket->flush();
+	}
+
+	/// Returns the next request forwarded to the device, or an empty array on timeout.
+	QByteArray deviceRequest()
+	{
+		if (mDeviceSocket == 0)
+			mDeviceSocket = waitForConnection(mDevice);
+		if (mDeviceSocket == 0)
+			return QByteArray();
+		return readFrame(mDeviceSocket);
+	}
+
+	/// Sends `response` from the device, with the transaction ID of `request`.
+	void deviceRespond(const QByteArray &request, const QByteArray &response)
+	{
+		send(mDeviceSocket, withTransactionId(response, transactionIdOf(request)));
+	}
+
+	/// Forwards a read of 2 registers at 40000, answered by the device with `value0, value1`.
+	void forwardRead(quint16 transactionId, quint16 value0, quint16 value1)
+	{
+		send(mClient, readRequest(transactionId, 1, 40000, 2));
+		QByteArray request = deviceRequest();
+		ASSERT_EQ(readRequest(transactionIdOf(request), 7, 40000, 2), request);
+		deviceRespond(request, readResponse(0, 7, value0, value1));
+		EXPECT_EQ(readResponse(transactionId, 1, value0, value1), readFrame(mClient));
+	}
+
+	/// Returns true if the device does not receive anything for a while.
+	bool deviceIdle()
+	{
+		qWait(100);
+		return mDeviceSocket == 0 || mDeviceSocket->bytesAvailable() == 0;
+	}
+
+	QTcpServer mDevice;
+	QTcpSocket *mDeviceSocket;
+	ModbusTcpProxy *mProxy;
+	QTcpSocket *mClient;
+};
+
+TEST_F(ModbusTcpProxyTest, transactionIds)
+{
+	// Two proxy clients using the same transaction ID.
+	QTcpSocket *other = connectClient();
+	ASSERT_TRUE(other != 0);
+	send(mClient, readRequest(0x1234, 1, 40000, 2));
+	send(other, readRequest(0x1234, 1, 40010, 2));
+
+	// The device sees our own transaction IDs, and its own unit ID.
+	QByteArray first = deviceRequest();
+	ASSERT_EQ(12, first.size());
+	EXPECT_EQ(7, first[6]);
+	deviceRespond(first, readResponse(0, 7, 1, 2));
+	QByteArray second = deviceRequest();
+	ASSERT_EQ(12, second.size());
+	EXPECT_EQ(7, second[6]);
+	EXPECT_NE(transactionIdOf(first), transactionIdOf(second));
+	deviceRespond(second, readResponse(0, 7, 3, 4));
+
+	// The first request forwarded is not necessarily that of the first client.
+	bool firstIsClient = first == readRequest(transactionIdOf(first), 7, 40000, 2);
+	EXPECT_EQ(readRequest(transactionIdOf(second), 7, firstIsClient ? 40010 : 40000, 2), second);
+	EXPECT_EQ(readResponse(0x1234, 1, firstIsClient ? 1 : 3, firstIsClient ? 2 : 4),
+			  readFrame(mClient));
+	EXPECT_EQ(readResponse(0x1234, 1, firstIsClient ? 3 : 1, firstIsClient ? 4 : 2),
+			  readFrame(other));
+	delete other;
+}
+
+TEST_F(ModbusTcpProxyTest, cache)
+{
+	forwardRead(1, 0x10, 0x11);
+
+	// Within the cache time, the read is answered by the proxy.
+	send(mClient, readRequest(2, 1, 40000, 2));
+	EXPECT_EQ(readResponse(2, 1, 0x10, 0x11), readFrame(mClient));
+	EXPECT_TRUE(deviceIdle());
+
+	// Other registers are not in the cache.
+	send(mClient, readRequest(3, 1, 40001, 2));
+	QByteArray request = deviceRequest();
+	ASSERT_EQ(readRequest(transactionIdOf(request), 7, 40001, 2), request);
+	deviceRespond(request, readResponse(0, 7, 0x11, 0x12));
+	EXPECT_EQ(readResponse(3, 1, 0x11, 0x12), readFrame(mClient));
+
+	// After the cache time, the read is forwarded again.
+	mProxy->setCacheTime(50);
+	qWait(100);
+	forwardRead(4, 0x20, 0x21);
+}
+
+TEST_F(ModbusTcpProxyTest, shareReadInProgress)
+{
+	QTcpSocket *other = connectClient();
+	ASSERT_TRUE(other != 0);
+	send(mClient, readRequest(1, 1, 40000, 2));
+	send(other, readRequest(2, 1, 40000, 2));
+
+	QByteArray request = deviceRequest();
+	ASSERT_EQ(readRequest(transactionIdOf(request), 7, 40000, 2), request);
+	// Only one read is forwarded.
+	EXPECT_TRUE(deviceIdle());
+	deviceRespond(request, readResponse(0, 7, 5, 6));
+	EXPECT_EQ(readResponse(1, 1, 5, 6), readFrame(mClient));
+	EXPECT_EQ(readResponse(2, 1, 5, 6), readFrame(other));
+	EXPECT_TRUE(deviceIdle());
+	delete other;
+}
+
+TEST_F(ModbusTcpProxyTest, writeInvalidatesCache)
+{
+	forwardRead(1, 0x10, 0x11);
+
+	send(mClient, withTransactionId(ModbusTcpFrame::writeSingleRegister(1, 40000, 0x55), 2));
+	QByteArray request = deviceRequest();
+	ASSERT_EQ(withTransactionId(ModbusTcpFrame::writeSingleRegister(7, 40000, 0x55),
+								transactionIdOf(request)),
+			  request);
+	deviceRespond(request, ModbusTcpFrame::writeRegistersResponse(
+					  ModbusTcpFrame::WriteSingleRegister, 7, 40000, 0x55));
+	EXPECT_EQ(withTransactionId(ModbusTcpFrame::writeRegistersResponse(
+									ModbusTcpFrame::WriteSingleRegister, 1, 40000, 0x55),
+								2),
+			  readFrame(mClient));
+
+	// The cached value is gone, so the read goes to the device.
+	forwardRead(3, 0x55, 0x11);
+}
+
+TEST_F(ModbusTcpProxyTest, exceptions)
+{
+	// No device for this unit.
+	send(mClient, readRequest(1, 2, 40000, 2));
+	EXPECT_EQ(exceptionResponse(1, 3, 2, ModbusReply::GatewayPathUnavailable),
+			  readFrame(mClient));
+
+	// Not supported by the proxy.
+	send(mClient, withTransactionId(ModbusTcpFrame::readRegisters(ModbusTcpFrame::ReadCoils, 1,
+																  0, 8),
+									2));
+	EXPECT_EQ(exceptionResponse(2, 1, 1, ModbusReply::IllegalFunction), readFrame(mClient));
+	send(mClient, readRequest(3, 1, 40000, 126));
+	EXPECT_EQ(exceptionResponse(3, 3, 1, ModbusReply::IllegalDataValue), readFrame(mClient));
+	EXPECT_TRUE(deviceIdle());
+
+	// Exceptions from the device are passed on.
+	send(mClient, readRequest(4, 1, 40000, 2));
+	QByteArray request = deviceRequest();
+	ASSERT_EQ(12, request.size());
+	deviceRespond(request, ModbusTcpFrame::exceptionResponse(3, 7,
+															 ModbusReply::IllegalDataAddress));
+	EXPECT_EQ(exceptionResponse(4, 3, 1, ModbusReply::IllegalDataAddress), readFrame(mClient));
+
+	// The device does not respond. The previous reply gave the proxy an estimate of the round
+	// trip time, so it does not take the maximum timeout.
+	send(mClient, readRequest(5, 1, 40000, 2));
+	ASSERT_EQ(12, deviceRequest().size());
+	EXPECT_EQ(exceptionResponse(5, 3, 1, ModbusReply::GatewayTargetDeviceFailedToRespond),
+			  readFrame(mClient, 10000));
+}
+
+TEST_F(ModbusTcpProxyTest, deviceDisconnects)
+{
+	// A read which has been forwarded, and a write waiting for it to complete.
+	send(mClient, readRequest(1, 1, 40000, 2) +
+		 withTransactionId(ModbusTcpFrame::writeSingleRegister(1, 40000, 0x55), 2));
+	ASSERT_EQ(12, deviceRequest().size());
+	qWait(20);
+	mDeviceSocket->abort();
+	delete mDeviceSocket;
+	mDeviceSocket = 0;
+
+	// Both are answered, in any order.
+	QByteArray first = readFrame(mClient);
+	QByteArray second = readFrame(mClient);
+	if (transactionIdOf(first) == 2)
+		qSwap(first, second);
+	EXPECT_EQ(exceptionResponse(1, 3, 1, ModbusReply::GatewayPathUnavailable), first);
+	EXPECT_EQ(exceptionResponse(2, 6, 1, ModbusReply::GatewayPathUnavailable), second);
+
+	// The next request uses a new connection.
+	forwardRead(3, 1, 2);
+}
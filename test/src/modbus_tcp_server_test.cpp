@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include <QElapsedTimer>
+#include <QTcpSocket>
+#include "modbus_register_image.h"
+#include "modbus_tcp_frame.h"
+#include "modbus_tcp_server.h"
+#include "test_helper.h"
+
+// Processes events until `socket` has received `count` bytes, or the timeout expires.
+static bool waitForBytes(QTcpSocket *socket, int count, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (socket->bytesAvailable() < count && timer.elapsed() < timeout)
+		qWait(10);
+	return socket->bytesAvailable() >= count;
+}
+
+static bool waitForDisconnect(QTcpSocket *socket, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (socket->state() != QAbstractSocket::UnconnectedState && timer.elapsed() < timeout)
+		qWait(10);
+	return socket->state() == QAbstractSocket::UnconnectedState;
+}
+
+// Reads a complete frame (MBAP header and PDU). Returns an empty array on timeout.
+static QByteArray readFrame(QTcpSocket *socket)
+{
+	if (!waitForBytes(socket, 6))
+		return QByteArray();
+	QByteArray header = socket->peek(6);
+	int length = (static_cast<quint8>(header[4]) << 8) | static_cast<quint8>(header[5]);
+	if (!waitForBytes(socket, 6 + length))
+		return QByteArray();
+	return socket->read(6 + length);
+}
+
+static QByteArray withTransactionId(QByteArray frame, quint16 transactionId)
+{
+	ModbusTcpFrame::setTransactionId(frame.data(), transactionId);
+	return frame;
+}
+
+static QByteArray readRequest(quint16 transactionId, quint8 unitId, quint16 startReg,
+							  quint16 count)
+{
+	return withTransactionId(
+		ModbusTcpFrame::readRegisters(ModbusTcpFrame::ReadHoldingRegisters, unitId, startReg,
+									  count),
+		transactionId);
+}
+
+class ModbusTcpServerTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		QVector<quint16> values;
+		for (int i=0; i<10; ++i)
+			values.append(static_cast<quint16>(0x100 + i));
+		mImage.update(1, 40000, values);
+		mServer = new ModbusTcpServer(&mImage);
+		ASSERT_TRUE(mServer->listen(0));
+		mSocket = new QTcpSocket();
+		mSocket->connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+		ASSERT_TRUE(mSocket->waitForConnected(5000));
+	}
+
+	void TearDown() override
+	{
+		delete mSocket;
+		delete mServer;
+	}
+
+	void send(const QByteArray &data)
+	{
+		mSocket->write(data);
+		mSocket->flush();
+	}
+
+	ModbusRegisterImage mImage;
+	ModbusTcpServer *mServer;
+	QTcpSocket *mSocket;
+};
+
+TEST_F(ModbusTcpServerTest, readHoldingRegisters)
+{
+	send(readRequest(0x1234, 1, 40002, 2));
+	QByteArray response = readFrame(mSocket);
+	quint16 values[] = { 0x102, 0x103 };
+	EXPECT_EQ(withTransactionId(ModbusTcpFrame::readRegistersResponse(
+									ModbusTcpFrame::ReadHoldingRegisters, 1, values, 2),
+								0x1234),
+			  response);
+}
+
+TEST_F(ModbusTcpServerTest, batchedRequests)
+{
+	// Several requests in a single segment. The responses are sent in order, in a single write.
+	send(readRequest(1, 1, 40000, 1) + readRequest(2, 1, 40001, 1) + readRequest(3, 1, 40009, 1));
+	// Each response is 11 bytes.
+	ASSERT_TRUE(waitForBytes(mSocket, 33));
+	for (int i=0; i<3; ++i) {
+		QByteArray response = mSocket->read(11);
+		EXPECT_EQ(i + 1, static_cast<quint8>(response[1]));
+		EXPECT_EQ(3, response[7]);
+	}
+	EXPECT_EQ(0, mSocket->bytesAvailable());
+
+	// A request split over two segments.
+	QByteArray request = readRequest(4, 1, 40000, 2);
+	send(request.left(5));
+	qWait(50);
+	send(request.mid(5));
+	QByteArray response = readFrame(mSocket);
+	ASSERT_EQ(13, response.size());
+	EXPECT_EQ(4, response[1]);
+}
+
+TEST_F(ModbusTcpServerTest, exceptionResponses)
+{
+	// Registers which are not in the image.
+	send(readRequest(1, 1, 40008, 4));
+	EXPECT_EQ(withTransactionId(ModbusTcpFrame::exceptionResponse(
+									3, 1, ModbusReply::IllegalDataAddress), 1),
+			  readFrame(mSocket));
+
+	// A unit which is not in the image.
+	send(readRequest(2, 5, 40000, 1));
+	EXPECT_EQ(withTransactionId(ModbusTcpFrame::exceptionResponse(
+									3, 5, ModbusReply::GatewayTargetDeviceFailedToRespond), 2),
+			  readFrame(mSocket));
+
+	// Unsupported function.
+	send(withTransactionId(ModbusTcpFrame::readRegisters(ModbusTcpFrame::ReadInputRegisters, 1,
+														 40000, 1),
+						   3));
+	EXPECT_EQ(withTransactionId(ModbusTcpFrame::exceptionResponse(
+									4, 1, ModbusReply::IllegalFunction), 3),
+			  readFrame(mSocket));
+
+	// Too many registers.
+	send(readRequest(4, 1, 40000, 126));
+	EXPECT_EQ(withTransactionId(ModbusTcpFrame::exceptionResponse(
+									3, 1, ModbusReply::IllegalDataValue), 4),
+			  readFrame(mSocket));
+}
+
+TEST_F(ModbusTcpServerTest, badProtocolId)
+{
+	QByteArray request = readRequest(1, 1, 40000, 1);
+	request[3] = 1;
+	send(request);
+	EXPECT_TRUE(waitForDisconnect(mSocket));
+	EXPECT_EQ(0, mSocket->bytesAvailable());
+}
+
+TEST_F(ModbusTcpServerTest, badLength)
+{
+	// The frame may not be longer than 260 bytes (a length field of 254).
+	QByteArray request = readRequest(1, 1, 40000, 1);
+	request[4] = 1;
+	request[5] = 0;
+	send(request);
+	EXPECT_TRUE(waitForDisconnect(mSocket));
+
+	// The length field must include the unit ID and the function code.
+	QTcpSocket socket;
+	socket.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+	ASSERT_TRUE(socket.waitForConnected(5000));
+	request[4] = 0;
+	request[5] = 1;
+	socket.write(request.left(7));
+	socket.flush();
+	EXPECT_TRUE(waitForDisconnect(&socket));
+}
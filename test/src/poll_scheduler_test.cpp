@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <qnumeric.h>
+#include "poll_scheduler.h"
+
+// The bounds used by default (see InverterSettings).
+static void setUpScheduler(PollScheduler &scheduler)
+{
+	scheduler.setBounds(1000, 30000);
+	scheduler.setMaxPower(10000);
+	scheduler.update(5000, false);
+}
+
+TEST(PollSchedulerTest, flatPowerUpToMaximum)
+{
+	PollScheduler scheduler;
+	setUpScheduler(scheduler);
+	// Nothing is known about the previous poll.
+	EXPECT_EQ(1000, scheduler.interval());
+
+	// 50 W is 0.5% of the maximum power: flat.
+	static const int expected[] = { 2000, 4000, 8000, 16000, 30000, 30000 };
+	for (int i=0; i<6; ++i) {
+		scheduler.update(5000 + (i % 2) * 50, false);
+		EXPECT_EQ(expected[i], scheduler.interval());
+	}
+}
+
+TEST(PollSchedulerTest, fastChange)
+{
+	PollScheduler scheduler;
+	setUpScheduler(scheduler);
+	for (int i=0; i<5; ++i)
+		scheduler.update(5000, false);
+	EXPECT_EQ(30000, scheduler.interval());
+	// 5% of the maximum power.
+	scheduler.update(5500, false);
+	EXPECT_EQ(1000, scheduler.interval());
+}
+
+TEST(PollSchedulerTest, moderateChangeDownToMinimum)
+{
+	PollScheduler scheduler;
+	setUpScheduler(scheduler);
+	for (int i=0; i<5; ++i)
+		scheduler.update(5000, false);
+	EXPECT_EQ(30000, scheduler.interval());
+
+	// Between flat and fast: the interval is halved, down to the minimum.
+	static const int expected[] = { 15000, 7500, 3750, 1875, 1000, 1000 };
+	double power = 5000;
+	for (int i=0; i<6; ++i) {
+		power += 200;
+		scheduler.update(power, false);
+		EXPECT_EQ(expected[i], scheduler.interval());
+	}
+}
+
+TEST(PollSchedulerTest, sleeping)
+{
+	PollScheduler scheduler;
+	setUpScheduler(scheduler);
+	scheduler.update(0, true);
+	EXPECT_EQ(30000, scheduler.interval());
+	// Waking up: the power is back.
+	scheduler.update(3000, false);
+	EXPECT_EQ(1000, scheduler.interval());
+}
+
+TEST(PollSchedulerTest, powerLimitActive)
+{
+	PollScheduler scheduler;
+	setUpScheduler(scheduler);
+	for (int i=0; i<5; ++i)
+		scheduler.update(5000, false);
+	EXPECT_EQ(30000, scheduler.interval());
+	scheduler.setPowerLimitActive(true);
+	EXPECT_EQ(1000, scheduler.interval());
+	scheduler.update(0, true);
+	EXPECT_EQ(1000, scheduler.interval());
+	scheduler.setPowerLimitActive(false);
+	EXPECT_EQ(30000, scheduler.interval());
+}
+
+TEST(PollSchedulerTest, unknownPower)
+{
+	PollScheduler scheduler;
+	setUpScheduler(scheduler);
+	for (int i=0; i<5; ++i)
+		scheduler.update(5000, false);
+	scheduler.update(qQNaN(), false);
+	EXPECT_EQ(1000, scheduler.interval());
+
+	for (int i=0; i<5; ++i)
+		scheduler.update(5000, false);
+	scheduler.reset();
+	EXPECT_EQ(1000, scheduler.interval());
+}
+
+TEST(PollSchedulerTest, unknownMaxPower)
+{
+	// The default maximum power (5000 W) is used: 250 W is a fast change.
+	PollScheduler scheduler;
+	scheduler.setBounds(1000, 30000);
+	scheduler.setMaxPower(0);
+	scheduler.update(1000, false);
+	for (int i=0; i<5; ++i)
+		scheduler.update(1000, false);
+	EXPECT_EQ(30000, scheduler.interval());
+	scheduler.update(1250, false);
+	EXPECT_EQ(1000, scheduler.interval());
+}
+
+TEST(PollSchedulerTest, bounds)
+{
+	PollScheduler scheduler;
+	// The maximum is never below the minimum.
+	scheduler.setBounds(5000, 2000);
+	EXPECT_EQ(5000, scheduler.interval());
+	scheduler.update(0, true);
+	EXPECT_EQ(5000, scheduler.interval());
+
+	// A new maximum applies to the current interval.
+	scheduler.setBounds(1000, 30000);
+	scheduler.update(0, true);
+	EXPECT_EQ(30000, scheduler.interval());
+	scheduler.setBounds(1000, 10000);
+	EXPECT_EQ(10000, scheduler.interval());
+}
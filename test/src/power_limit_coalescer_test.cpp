@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "power_limit_coalescer.h"
+#include "test_helper.h"
+
+TEST(PowerLimitCoalescerTest, fullWriteOnFirstEnable)
+{
+	PowerLimitCoalescer coalescer;
+	EXPECT_FALSE(coalescer.isActive());
+	EXPECT_EQ(-1, coalescer.nextCheck());
+
+	EXPECT_TRUE(coalescer.request(0.5));
+	EXPECT_TRUE(coalescer.isWritePending());
+	EXPECT_TRUE(coalescer.isFullWriteNeeded());
+	EXPECT_DOUBLE_EQ(0.5, coalescer.value());
+
+	coalescer.setWritten();
+	EXPECT_TRUE(coalescer.isActive());
+	EXPECT_FALSE(coalescer.isWritePending());
+	EXPECT_FALSE(coalescer.isFullWriteNeeded());
+}
+
+TEST(PowerLimitCoalescerTest, changedRegisterOnly)
+{
+	PowerLimitCoalescer coalescer;
+	coalescer.setScale(100);
+	coalescer.request(0.5);
+	coalescer.setWritten();
+
+	// Same register value: nothing to write.
+	EXPECT_FALSE(coalescer.request(0.501));
+	EXPECT_FALSE(coalescer.isWritePending());
+
+	// Once enabled, only the percentage is written.
+	EXPECT_TRUE(coalescer.request(0.6));
+	EXPECT_TRUE(coalescer.isWritePending());
+	EXPECT_FALSE(coalescer.isFullWriteNeeded());
+	EXPECT_DOUBLE_EQ(0.6, coalescer.value());
+	coalescer.setWritten();
+
+	// A failed write means the inverter may have lost the limit.
+	coalescer.invalidate();
+	EXPECT_TRUE(coalescer.isWritePending());
+	EXPECT_TRUE(coalescer.isFullWriteNeeded());
+}
+
+TEST(PowerLimitCoalescerTest, deadband)
+{
+	PowerLimitCoalescer coalescer;
+	coalescer.setScale(10000);
+	coalescer.setDeadband(0.05);
+	coalescer.request(0.5);
+	coalescer.setWritten();
+
+	EXPECT_FALSE(coalescer.request(0.54));
+	EXPECT_TRUE(coalescer.request(0.56));
+	coalescer.setWritten();
+
+	// The bounds are always written, so the inverter can reach them exactly.
+	coalescer.request(0.98);
+	coalescer.setWritten();
+	EXPECT_TRUE(coalescer.request(1.0));
+}
+
+TEST(PowerLimitCoalescerTest, refreshBeforeTimeout)
+{
+	PowerLimitCoalescer coalescer;
+	coalescer.setRefreshInterval(50);
+	coalescer.request(0.5);
+	coalescer.setWritten();
+	EXPECT_EQ(PowerLimitCoalescer::NoAction, coalescer.check());
+	EXPECT_GT(coalescer.nextCheck(), 0);
+	EXPECT_LE(coalescer.nextCheck(), 50);
+
+	qWait(80);
+	EXPECT_EQ(0, coalescer.nextCheck());
+	EXPECT_EQ(PowerLimitCoalescer::Refresh, coalescer.check());
+	// The refresh enables the limit again, which restarts the timeout of the inverter.
+	EXPECT_TRUE(coalescer.isWritePending());
+	EXPECT_TRUE(coalescer.isFullWriteNeeded());
+	EXPECT_DOUBLE_EQ(0.5, coalescer.value());
+
+	coalescer.setWritten();
+	EXPECT_EQ(PowerLimitCoalescer::NoAction, coalescer.check());
+}
+
+TEST(PowerLimitCoalescerTest, expire)
+{
+	PowerLimitCoalescer coalescer;
+	coalescer.setRequestTimeout(50);
+	coalescer.setRefreshInterval(1000);
+	coalescer.request(0.5);
+	coalescer.setWritten();
+	EXPECT_EQ(PowerLimitCoalescer::NoAction, coalescer.check());
+
+	qWait(80);
+	EXPECT_EQ(PowerLimitCoalescer::Expire, coalescer.check());
+
+	coalescer.reset();
+	EXPECT_FALSE(coalescer.isActive());
+	EXPECT_FALSE(coalescer.isWritePending());
+	EXPECT_EQ(PowerLimitCoalescer::NoAction, coalescer.check());
+	EXPECT_EQ(-1, coalescer.nextCheck());
+
+	// The next request enables the limit again.
+	EXPECT_TRUE(coalescer.request(0.5));
+	EXPECT_TRUE(coalescer.isFullWriteNeeded());
+}
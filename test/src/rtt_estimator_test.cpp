@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include "rtt_estimator.h"
+
+// The estimators are kept for the lifetime of the process, so each test uses its own host name.
+
+TEST(RttEstimatorTest, forHost)
+{
+	RttEstimator *estimator = RttEstimator::forHost("rtt-test-for-host");
+	EXPECT_EQ(estimator, RttEstimator::forHost("rtt-test-for-host"));
+	EXPECT_NE(estimator, RttEstimator::forHost("rtt-test-other-host"));
+}
+
+TEST(RttEstimatorTest, noSamples)
+{
+	RttEstimator *estimator = RttEstimator::forHost("rtt-test-no-samples");
+	EXPECT_FALSE(estimator->hasSamples());
+	EXPECT_EQ(5000, estimator->timeout(250, 5000));
+	// Backing off does not change the maximum.
+	estimator->backOff();
+	EXPECT_EQ(5000, estimator->timeout(250, 5000));
+}
+
+TEST(RttEstimatorTest, firstSample)
+{
+	RttEstimator *estimator = RttEstimator::forHost("rtt-test-first-sample");
+	estimator->addSample(100);
+	EXPECT_TRUE(estimator->hasSamples());
+	// SRTT = R, RTTVAR = R / 2
+	EXPECT_EQ(100, estimator->smoothedRtt());
+	EXPECT_EQ(50, estimator->rttVariation());
+	EXPECT_EQ(300, estimator->timeout(1, 10000));
+}
+
+TEST(RttEstimatorTest, convergence)
+{
+	RttEstimator *estimator = RttEstimator::forHost("rtt-test-convergence");
+	estimator->addSample(100);
+	// SRTT = 7/8 * 100 + 1/8 * 20, RTTVAR = 3/4 * 50 + 1/4 * 80
+	estimator->addSample(20);
+	EXPECT_EQ(90, estimator->smoothedRtt());
+	EXPECT_EQ(57, estimator->rttVariation());
+	EXPECT_EQ(318, estimator->timeout(1, 10000));
+
+	// The variation grows for one more sample, after which the timeout comes down.
+	for (int i=0; i<10; ++i)
+		estimator->addSample(20);
+	EXPECT_LT(estimator->timeout(1, 10000), 200);
+	for (int i=0; i<40; ++i)
+		estimator->addSample(20);
+	EXPECT_EQ(20, estimator->smoothedRtt());
+	EXPECT_EQ(0, estimator->rttVariation());
+	// The variation term is at least one tick of the timer wheel.
+	EXPECT_EQ(30, estimator->timeout(1, 10000));
+}
+
+TEST(RttEstimatorTest, backOff)
+{
+	RttEstimator *estimator = RttEstimator::forHost("rtt-test-back-off");
+	estimator->addSample(100);
+	estimator->backOff();
+	EXPECT_EQ(600, estimator->timeout(1, 100000));
+	estimator->backOff();
+	EXPECT_EQ(1200, estimator->timeout(1, 100000));
+
+	// Limited to 2^6 times the estimate.
+	for (int i=0; i<10; ++i)
+		estimator->backOff();
+	EXPECT_EQ(300 << 6, estimator->timeout(1, 100000));
+
+	// A new sample resets the back off.
+	estimator->addSample(100);
+	EXPECT_EQ(100, estimator->smoothedRtt());
+	EXPECT_EQ(37, estimator->rttVariation());
+	EXPECT_EQ(248, estimator->timeout(1, 100000));
+}
+
+TEST(RttEstimatorTest, limits)
+{
+	RttEstimator *estimator = RttEstimator::forHost("rtt-test-limits");
+	estimator->addSample(100);
+	EXPECT_EQ(500, estimator->timeout(500, 1000));
+	EXPECT_EQ(200, estimator->timeout(100, 200));
+	EXPECT_EQ(300, estimator->timeout(300, 300));
+
+	// The maximum also applies after backing off.
+	estimator->backOff();
+	estimator->backOff();
+	EXPECT_EQ(1000, estimator->timeout(500, 1000));
+
+	// Negative round trip times (eg. after a clock step) count as 0.
+	RttEstimator *fast = RttEstimator::forHost("rtt-test-limits-fast");
+	fast->addSample(-5);
+	EXPECT_EQ(0, fast->smoothedRtt());
+	EXPECT_EQ(10, fast->timeout(1, 1000));
+	EXPECT_EQ(250, fast->timeout(250, 1000));
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "scan_window.h"
+
+// Adds a round of results (as many as the current size), with `timeouts` of them timed out.
+static void addRound(ScanWindow &window, int timeouts)
+{
+	int size = window.size();
+	for (int i=0; i<size; ++i)
+		window.addResult(i < timeouts);
+}
+
+TEST(ScanWindowTest, slowStart)
+{
+	ScanWindow window;
+	EXPECT_EQ(32, window.size());
+	addRound(window, 0);
+	EXPECT_EQ(64, window.size());
+	addRound(window, 0);
+	EXPECT_EQ(128, window.size());
+	addRound(window, 0);
+	EXPECT_EQ(256, window.size());
+	// Clamped at the maximum.
+	addRound(window, 0);
+	EXPECT_EQ(256, window.size());
+}
+
+TEST(ScanWindowTest, roundNotComplete)
+{
+	ScanWindow window;
+	for (int i=0; i<31; ++i)
+		window.addResult(false);
+	EXPECT_EQ(32, window.size());
+	window.addResult(false);
+	EXPECT_EQ(64, window.size());
+}
+
+TEST(ScanWindowTest, shrinkAndGrowAdditively)
+{
+	ScanWindow window;
+	addRound(window, 0);
+	EXPECT_EQ(64, window.size());
+	// More than 10% timeouts: the window is halved, and slow start ends.
+	addRound(window, 7);
+	EXPECT_EQ(32, window.size());
+	addRound(window, 0);
+	EXPECT_EQ(40, window.size());
+	addRound(window, 0);
+	EXPECT_EQ(48, window.size());
+}
+
+TEST(ScanWindowTest, timeoutRatio)
+{
+	ScanWindow window;
+	// 3 of 32 is less than 10%.
+	addRound(window, 3);
+	EXPECT_EQ(64, window.size());
+	// 7 of 64 is more.
+	addRound(window, 7);
+	EXPECT_EQ(32, window.size());
+}
+
+TEST(ScanWindowTest, clampAtMinimum)
+{
+	ScanWindow window;
+	addRound(window, 32);
+	EXPECT_EQ(16, window.size());
+	addRound(window, 16);
+	EXPECT_EQ(8, window.size());
+	addRound(window, 8);
+	EXPECT_EQ(8, window.size());
+	// Growing additively from the minimum.
+	addRound(window, 0);
+	EXPECT_EQ(16, window.size());
+}
+
+TEST(ScanWindowTest, clampAtMaximum)
+{
+	ScanWindow window;
+	addRound(window, 0);
+	addRound(window, 0);
+	addRound(window, 13);
+	EXPECT_EQ(64, window.size());
+	for (int i=0; i<30; ++i)
+		addRound(window, 0);
+	EXPECT_EQ(256, window.size());
+}
@@ -0,0 +1,276 @@
+#include <cmath>
+#include <gtest/gtest.h>
+#include "defines.h"
+#include "froniussolar_api.h"
+#include "sunspec_inverter_decoder.h"
+#include "sunspec_tools.h"
+
+// Register dumps of the inverter models of a three phase inverter, as read by SunspecUpdater:
+// starting at the model ID, `readCount` registers long.
+
+// Model 103: 12.34 A, 8512 W, 230.1 V, 2390570 Wh, state 4 (MPPT).
+static const quint16 Model103[] = {
+	103, 50,
+	1234, 411, 412, 411, 0xFFFE,		// A, AphA, AphB, AphC, A_SF
+	4001, 3998, 4003,					// PPVphAB, PPVphBC, PPVphCA
+	2301, 2305, 2299, 0xFFFF,			// PhVphA, PhVphB, PhVphC, V_SF
+	8512, 0,							// W, W_SF
+	5001, 0xFFFE,						// Hz, Hz_SF
+	8530, 0,							// VA, VA_SF
+	0xFF9C, 0,							// VAr, VAr_SF
+	998, 0xFFFD,						// PF, PF_SF
+	0x0003, 0xA5D1, 1,					// WH, WH_SF
+	0xFFFF, 0x8000, 0xFFFF, 0x8000,		// DCA, DCA_SF, DCV, DCV_SF
+	8780, 0,							// DCW, DCW_SF
+	0x8000, 0x8000, 0x8000, 0x8000, 0x8000,	// TmpCab, TmpSnk, TmpTrns, TmpOt, Tmp_SF
+	4, 4,								// St, StVnd
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0	// Evt1, Evt2, EvtVnd1-4
+};
+
+// Model 113: the same values as float32.
+static const quint16 Model113[] = {
+	113, 60,
+	0x4145, 0x70A4,						// A
+	0x4083, 0x851F,						// AphA
+	0x4083, 0xD70A,						// AphB
+	0x4083, 0x851F,						// AphC
+	0x43C8, 0x0CCD, 0x43C7, 0xE666, 0x43C8, 0x2666,	// PPVphAB, PPVphBC, PPVphCA
+	0x4366, 0x199A,						// PhVphA
+	0x4366, 0x8000,						// PhVphB
+	0x4365, 0xE666,						// PhVphC
+	0x4605, 0x0000,						// W
+	0x4248, 0x0A3D,						// Hz
+	0x4605, 0x4800,						// VA
+	0xC2C8, 0x0000,						// VAr
+	0x4479, 0x8000,						// PF
+	0x4A11, 0xE4E8,						// WH
+	0x7FC0, 0x0000, 0x7FC0, 0x0000,		// DCA, DCV
+	0x4609, 0x3000,						// DCW
+	0x7FC0, 0x0000, 0x7FC0, 0x0000, 0x7FC0, 0x0000, 0x7FC0, 0x0000,	// TmpCab-TmpOt
+	4, 4,								// St, StVnd
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0	// Evt1, Evt2, EvtVnd1-4
+};
+
+template<int N>
+static QVector<quint16> toVector(const quint16 (&registers)[N])
+{
+	QVector<quint16> values;
+	for (int i=0; i<N; ++i)
+		values.append(registers[i]);
+	return values;
+}
+
+// Turns a dump of a three phase model into the single phase model: the phase B and C registers are
+// not implemented.
+static QVector<quint16> toSinglePhase(QVector<quint16> values, bool isFloat)
+{
+	values[0] -= 2;
+	static const int IntOffsets[] = { 4, 5, 7, 8, 9, 11, 12 };
+	static const int FloatOffsets[] = { 6, 8, 10, 12, 14, 18, 20 };
+	for (int i=0; i<7; ++i) {
+		if (isFloat) {
+			values[FloatOffsets[i]] = 0x7FC0;
+			values[FloatOffsets[i] + 1] = 0;
+		} else {
+			values[IntOffsets[i]] = 0xFFFF;
+		}
+	}
+	return values;
+}
+
+static DeviceInfo deviceInfo(ProtocolType retrievalMode, int phaseCount)
+{
+	DeviceInfo info;
+	info.retrievalMode = retrievalMode;
+	info.phaseCount = phaseCount;
+	return info;
+}
+
+static void expectSame(double expected, double actual)
+{
+	if (std::isnan(expected))
+		EXPECT_TRUE(std::isnan(actual));
+	else
+		EXPECT_DOUBLE_EQ(expected, actual);
+}
+
+// The parsing of models 101-103 before the model tables were introduced.
+static void decodeIntSf(const QVector<quint16> &values, bool threePhase, CommonInverterData &cid,
+						ThreePhasesInverterData &tpid)
+{
+	cid.acPower = getScaledValue(values, 14, 1, 15, true);
+	cid.acCurrent = getScaledValue(values, 2, 1, 6, false);
+	cid.acVoltage = getScaledValue(values, 10, 1, 13, false);
+	cid.totalEnergy = getScaledValue(values, 24, 2, 26, false);
+	if (threePhase) {
+		tpid.acCurrentPhase1 = getScaledValue(values, 3, 1, 6, false);
+		tpid.acCurrentPhase2 = getScaledValue(values, 4, 1, 6, false);
+		tpid.acCurrentPhase3 = getScaledValue(values, 5, 1, 6, false);
+		tpid.acVoltagePhase1 = getScaledValue(values, 10, 1, 13, false);
+		tpid.acVoltagePhase2 = getScaledValue(values, 11, 1, 13, false);
+		tpid.acVoltagePhase3 = getScaledValue(values, 12, 1, 13, false);
+	}
+}
+
+// The parsing of models 111-113 before the model tables were introduced.
+static void decodeFloat(const QVector<quint16> &values, bool threePhase, CommonInverterData &cid,
+						ThreePhasesInverterData &tpid)
+{
+	cid.acPower = getFloat(values, 22);
+	cid.acCurrent = getFloat(values, 2);
+	cid.acVoltage = getFloat(values, 16);
+	cid.totalEnergy = getFloat(values, 32);
+	if (threePhase) {
+		tpid.acCurrentPhase1 = getFloat(values, 4);
+		tpid.acCurrentPhase2 = getFloat(values, 6);
+		tpid.acCurrentPhase3 = getFloat(values, 8);
+		tpid.acVoltagePhase1 = getFloat(values, 16);
+		tpid.acVoltagePhase2 = getFloat(values, 18);
+		tpid.acVoltagePhase3 = getFloat(values, 20);
+	}
+}
+
+static void checkDecoder(const QVector<quint16> &values, ProtocolType retrievalMode,
+						 int phaseCount)
+{
+	bool isFloat = retrievalMode == ProtocolSunSpecFloat;
+	SunspecInverterDecoder decoder(deviceInfo(retrievalMode, phaseCount));
+	ASSERT_TRUE(decoder.isValid());
+	EXPECT_EQ(values[0], decoder.modelId());
+	EXPECT_EQ(isFloat ? 62 : 52, decoder.readCount());
+	ASSERT_EQ(values.size(), decoder.readCount());
+	EXPECT_EQ(phaseCount > 1, decoder.hasPhases());
+
+	const SunspecPoint &power = decoder.powerPoint();
+	EXPECT_EQ(isFloat ? 22 : 14, power.offset);
+	EXPECT_EQ(isFloat ? -1 : 15, power.scaleOffset);
+	EXPECT_EQ(4, decoder.operatingState(values));
+
+	CommonInverterData expected;
+	ThreePhasesInverterData expectedPhases;
+	if (isFloat)
+		decodeFloat(values, phaseCount > 1, expected, expectedPhases);
+	else
+		decodeIntSf(values, phaseCount > 1, expected, expectedPhases);
+
+	CommonInverterData cid;
+	decoder.decode(values, cid);
+	expectSame(expected.acPower, cid.acPower);
+	expectSame(expected.acCurrent, cid.acCurrent);
+	expectSame(expected.acVoltage, cid.acVoltage);
+	expectSame(expected.totalEnergy, cid.totalEnergy);
+
+	if (phaseCount > 1) {
+		ThreePhasesInverterData tpid;
+		decoder.decode(values, tpid);
+		expectSame(expectedPhases.acCurrentPhase1, tpid.acCurrentPhase1);
+		expectSame(expectedPhases.acCurrentPhase2, tpid.acCurrentPhase2);
+		expectSame(expectedPhases.acCurrentPhase3, tpid.acCurrentPhase3);
+		expectSame(expectedPhases.acVoltagePhase1, tpid.acVoltagePhase1);
+		expectSame(expectedPhases.acVoltagePhase2, tpid.acVoltagePhase2);
+		expectSame(expectedPhases.acVoltagePhase3, tpid.acVoltagePhase3);
+	}
+}
+
+TEST(SunspecInverterDecoderTest, model101)
+{
+	QVector<quint16> values = toSinglePhase(toVector(Model103), false);
+	checkDecoder(values, ProtocolSunSpecIntSf, 1);
+
+	SunspecInverterDecoder decoder(deviceInfo(ProtocolSunSpecIntSf, 1));
+	CommonInverterData cid;
+	decoder.decode(values, cid);
+	EXPECT_DOUBLE_EQ(8512, cid.acPower);
+	EXPECT_DOUBLE_EQ(12.34, cid.acCurrent);
+	EXPECT_DOUBLE_EQ(230.1, cid.acVoltage);
+	EXPECT_DOUBLE_EQ(2390570, cid.totalEnergy);
+}
+
+TEST(SunspecInverterDecoderTest, model103)
+{
+	QVector<quint16> values = toVector(Model103);
+	checkDecoder(values, ProtocolSunSpecIntSf, 3);
+
+	SunspecInverterDecoder decoder(deviceInfo(ProtocolSunSpecIntSf, 3));
+	ThreePhasesInverterData tpid;
+	decoder.decode(values, tpid);
+	EXPECT_DOUBLE_EQ(4.11, tpid.acCurrentPhase1);
+	EXPECT_DOUBLE_EQ(4.12, tpid.acCurrentPhase2);
+	EXPECT_DOUBLE_EQ(4.11, tpid.acCurrentPhase3);
+	EXPECT_DOUBLE_EQ(230.1, tpid.acVoltagePhase1);
+	EXPECT_DOUBLE_EQ(230.5, tpid.acVoltagePhase2);
+	EXPECT_DOUBLE_EQ(229.9, tpid.acVoltagePhase3);
+}
+
+TEST(SunspecInverterDecoderTest, model111)
+{
+	QVector<quint16> values = toSinglePhase(toVector(Model113), true);
+	checkDecoder(values, ProtocolSunSpecFloat, 1);
+
+	SunspecInverterDecoder decoder(deviceInfo(ProtocolSunSpecFloat, 1));
+	CommonInverterData cid;
+	decoder.decode(values, cid);
+	EXPECT_FLOAT_EQ(8512, cid.acPower);
+	EXPECT_FLOAT_EQ(12.34, cid.acCurrent);
+	EXPECT_FLOAT_EQ(230.1, cid.acVoltage);
+	EXPECT_FLOAT_EQ(2390330, cid.totalEnergy);
+}
+
+TEST(SunspecInverterDecoderTest, model113)
+{
+	QVector<quint16> values = toVector(Model113);
+	checkDecoder(values, ProtocolSunSpecFloat, 3);
+
+	SunspecInverterDecoder decoder(deviceInfo(ProtocolSunSpecFloat, 3));
+	ThreePhasesInverterData tpid;
+	decoder.decode(values, tpid);
+	EXPECT_FLOAT_EQ(4.11, tpid.acCurrentPhase1);
+	EXPECT_FLOAT_EQ(4.12, tpid.acCurrentPhase2);
+	EXPECT_FLOAT_EQ(4.11, tpid.acCurrentPhase3);
+	EXPECT_FLOAT_EQ(230.1, tpid.acVoltagePhase1);
+	EXPECT_FLOAT_EQ(230.5, tpid.acVoltagePhase2);
+	EXPECT_FLOAT_EQ(229.9, tpid.acVoltagePhase3);
+}
+
+TEST(SunspecInverterDecoderTest, pointOffsets)
+{
+	// The offsets and scale factors of the old parsing code.
+	struct Expected {
+		quint16 modelId;
+		const char *name;
+		quint16 offset;
+		qint16 scaleOffset;
+	};
+	static const Expected points[] = {
+		{ 103, "A", 2, 6 },
+		{ 103, "AphA", 3, 6 },
+		{ 103, "AphB", 4, 6 },
+		{ 103, "AphC", 5, 6 },
+		{ 103, "PhVphA", 10, 13 },
+		{ 103, "PhVphB", 11, 13 },
+		{ 103, "PhVphC", 12, 13 },
+		{ 103, "W", 14, 15 },
+		{ 103, "WH", 24, 26 },
+		{ 103, "St", 38, -1 },
+		{ 113, "A", 2, -1 },
+		{ 113, "AphA", 4, -1 },
+		{ 113, "AphB", 6, -1 },
+		{ 113, "AphC", 8, -1 },
+		{ 113, "PhVphA", 16, -1 },
+		{ 113, "PhVphB", 18, -1 },
+		{ 113, "PhVphC", 20, -1 },
+		{ 113, "W", 22, -1 },
+		{ 113, "WH", 32, -1 },
+		{ 113, "St", 48, -1 }
+	};
+	for (const Expected &e: points) {
+		for (quint16 modelId = e.modelId - 2; modelId <= e.modelId; ++modelId) {
+			const SunspecModel *model = findSunspecModel(modelId);
+			ASSERT_TRUE(model != 0) << modelId;
+			const SunspecPoint *point = findSunspecPoint(model, e.name);
+			ASSERT_TRUE(point != 0) << modelId << ' ' << e.name;
+			EXPECT_EQ(e.offset, point->offset) << modelId << ' ' << e.name;
+			EXPECT_EQ(e.scaleOffset, point->scaleOffset) << modelId << ' ' << e.name;
+		}
+	}
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include "sunspec_models.h"
+#include "sunspec_read_plan.h"
+
+static void expectBlock(const SunspecReadPlan &plan, int index, quint16 startRegister,
+						quint16 count)
+{
+	ASSERT_LT(index, plan.blocks().size());
+	EXPECT_EQ(startRegister, plan.blocks()[index].startRegister);
+	EXPECT_EQ(count, plan.blocks()[index].count);
+}
+
+// Values of a block: the register number relative to 40000.
+static QVector<quint16> blockValues(const SunspecReadPlan::Block &block)
+{
+	QVector<quint16> values;
+	for (int i=0; i<block.count; ++i)
+		values.append(block.startRegister - 40000 + i);
+	return values;
+}
+
+TEST(SunspecReadPlanTest, mergeAdjacentRanges)
+{
+	SunspecReadPlan plan;
+	plan.addRange(40010, 5);
+	plan.addRange(40000, 10);
+	plan.addRange(40012, 8);
+	EXPECT_TRUE(plan.isEmpty());
+	plan.compile();
+	ASSERT_EQ(1, plan.blocks().size());
+	expectBlock(plan, 0, 40000, 20);
+}
+
+TEST(SunspecReadPlanTest, gapCost)
+{
+	SunspecReadPlan plan;
+	plan.addRange(40000, 10);
+	plan.addRange(40020, 5);
+	plan.compile();
+	ASSERT_EQ(1, plan.blocks().size());
+	expectBlock(plan, 0, 40000, 25);
+
+	plan.setGapCost(4);
+	plan.compile();
+	ASSERT_EQ(2, plan.blocks().size());
+	expectBlock(plan, 0, 40000, 10);
+	expectBlock(plan, 1, 40020, 5);
+}
+
+TEST(SunspecReadPlanTest, splitAtMaxReadCount)
+{
+	SunspecReadPlan plan;
+	plan.addRange(40000, 300);
+	plan.compile();
+	ASSERT_EQ(3, plan.blocks().size());
+	expectBlock(plan, 0, 40000, SunspecReadPlan::MaxReadCount);
+	expectBlock(plan, 1, 40125, SunspecReadPlan::MaxReadCount);
+	expectBlock(plan, 2, 40250, 50);
+}
+
+TEST(SunspecReadPlanTest, rangeNotSpreadOverReads)
+{
+	SunspecReadPlan plan;
+	plan.addRange(40000, 100);
+	plan.addRange(40110, 30);
+	plan.addRange(40140, 5);
+	plan.compile();
+	// The second range would not fit in the first read, so it starts a new one.
+	ASSERT_EQ(2, plan.blocks().size());
+	expectBlock(plan, 0, 40000, 100);
+	expectBlock(plan, 1, 40110, 35);
+}
+
+TEST(SunspecReadPlanTest, addPoint)
+{
+	const SunspecModel *model = findSunspecModel(103);
+	ASSERT_TRUE(model != 0);
+	const SunspecPoint *power = findSunspecPoint(model, "W");
+	ASSERT_TRUE(power != 0);
+
+	// The scale factor is right behind the point.
+	SunspecReadPlan plan;
+	plan.addPoint(40070, *power);
+	plan.compile();
+	ASSERT_EQ(1, plan.blocks().size());
+	expectBlock(plan, 0, 40070 + power->offset, 2);
+
+	// The scale factor of model 701 W is far behind the point.
+	model = findSunspecModel(701);
+	ASSERT_TRUE(model != 0);
+	power = findSunspecPoint(model, "W");
+	ASSERT_TRUE(power != 0);
+	SunspecReadPlan sparse;
+	sparse.setGapCost(10);
+	sparse.addPoint(40070, *power);
+	sparse.compile();
+	ASSERT_EQ(2, sparse.blocks().size());
+	expectBlock(sparse, 0, 40070 + power->offset, power->size);
+	expectBlock(sparse, 1, 40070 + power->scaleOffset, 1);
+}
+
+TEST(SunspecReadPlanTest, values)
+{
+	SunspecReadPlan plan;
+	plan.setGapCost(4);
+	plan.addRange(40000, 10);
+	plan.addRange(40020, 5);
+	plan.compile();
+	ASSERT_EQ(2, plan.blocks().size());
+
+	QVector<QVector<quint16>> replies;
+	foreach (const SunspecReadPlan::Block &block, plan.blocks())
+		replies.append(blockValues(block));
+
+	QVector<quint16> values = plan.values(replies, 40002, 3);
+	ASSERT_EQ(3, values.size());
+	EXPECT_EQ(2, values[0]);
+	EXPECT_EQ(4, values[2]);
+
+	values = plan.values(replies, 40020, 5);
+	ASSERT_EQ(5, values.size());
+	EXPECT_EQ(20, values[0]);
+	EXPECT_EQ(24, values[4]);
+
+	// Not part of a single read.
+	EXPECT_TRUE(plan.values(replies, 40008, 4).isEmpty());
+	EXPECT_TRUE(plan.values(replies, 40012, 2).isEmpty());
+
+	// A reply which is too short.
+	replies[1].resize(3);
+	EXPECT_TRUE(plan.values(replies, 40020, 5).isEmpty());
+	EXPECT_EQ(3, plan.values(replies, 40020, 3).size());
+
+	// A missing reply.
+	replies.resize(1);
+	EXPECT_TRUE(plan.values(replies, 40020, 3).isEmpty());
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <QElapsedTimer>
+#include <QList>
+#include "test_helper.h"
+#include "timer_wheel.h"
+
+class TestEntry : public TimerWheel::Entry
+{
+public:
+	TestEntry(QElapsedTimer *clock, QList<TestEntry *> *expired = 0):
+		timeouts(0),
+		expiredAt(-1),
+		mClock(clock),
+		mExpired(expired)
+	{
+	}
+
+	int timeouts;
+	qint64 expiredAt;
+
+protected:
+	void onTimeout() override
+	{
+		++timeouts;
+		expiredAt = mClock->elapsed();
+		if (mExpired != 0)
+			mExpired->append(this);
+	}
+
+private:
+	QElapsedTimer *mClock;
+	QList<TestEntry *> *mExpired;
+};
+
+// Processes events until `entry` has expired, or the timeout expires.
+static bool waitForTimeout(const TestEntry &entry, int timeout = 5000)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (entry.timeouts == 0 && timer.elapsed() < timeout)
+		qWait(5);
+	return entry.timeouts > 0;
+}
+
+TEST(TimerWheelTest, expireNotEarly)
+{
+	QElapsedTimer clock;
+	clock.start();
+	TimerWheel wheel;
+	TestEntry entry(&clock);
+	wheel.schedule(&entry, 100);
+	EXPECT_TRUE(entry.isScheduled());
+	EXPECT_EQ(1, wheel.count());
+
+	qWait(50);
+	EXPECT_EQ(0, entry.timeouts);
+	ASSERT_TRUE(waitForTimeout(entry));
+	EXPECT_EQ(1, entry.timeouts);
+	EXPECT_GE(entry.expiredAt, 100);
+	EXPECT_FALSE(entry.isScheduled());
+	EXPECT_EQ(0, wheel.count());
+}
+
+TEST(TimerWheelTest, cancel)
+{
+	QElapsedTimer clock;
+	clock.start();
+	TimerWheel wheel;
+	TestEntry entry(&clock);
+	wheel.schedule(&entry, 30);
+	TimerWheel::cancel(&entry);
+	EXPECT_FALSE(entry.isScheduled());
+	EXPECT_EQ(0, wheel.count());
+	// Cancelling twice is harmless.
+	TimerWheel::cancel(&entry);
+	qWait(100);
+	EXPECT_EQ(0, entry.timeouts);
+}
+
+TEST(TimerWheelTest, reschedule)
+{
+	QElapsedTimer clock;
+	clock.start();
+	TimerWheel wheel;
+	TestEntry entry(&clock);
+	wheel.schedule(&entry, 30);
+	wheel.schedule(&entry, 200);
+	EXPECT_EQ(1, wheel.count());
+	qWait(100);
+	EXPECT_EQ(0, entry.timeouts);
+	ASSERT_TRUE(waitForTimeout(entry));
+	EXPECT_EQ(1, entry.timeouts);
+	EXPECT_GE(entry.expiredAt, 200);
+}
+
+TEST(TimerWheelTest, order)
+{
+	QElapsedTimer clock;
+	clock.start();
+	TimerWheel wheel;
+	QList<TestEntry *> expired;
+	TestEntry first(&clock, &expired);
+	TestEntry second(&clock, &expired);
+	TestEntry third(&clock, &expired);
+	wheel.schedule(&third, 150);
+	wheel.schedule(&first, 20);
+	wheel.schedule(&second, 80);
+	EXPECT_EQ(3, wheel.count());
+	ASSERT_TRUE(waitForTimeout(third));
+	ASSERT_EQ(3, expired.size());
+	EXPECT_EQ(&first, expired[0]);
+	EXPECT_EQ(&second, expired[1]);
+	EXPECT_EQ(&third, expired[2]);
+}
+
+TEST(TimerWheelTest, cascade)
+{
+	QElapsedTimer clock;
+	clock.start();
+	TimerWheel wheel;
+	// Beyond the 64 ticks of level 0, so the entry has to be moved down before it expires.
+	TestEntry entry(&clock);
+	wheel.schedule(&entry, 1000);
+	qWait(800);
+	EXPECT_EQ(0, entry.timeouts);
+	ASSERT_TRUE(waitForTimeout(entry));
+	EXPECT_GE(entry.expiredAt, 1000);
+}
+
+TEST(TimerWheelTest, destroyScheduledEntry)
+{
+	QElapsedTimer clock;
+	clock.start();
+	TimerWheel wheel;
+	TestEntry entry(&clock);
+	{
+		TestEntry other(&clock);
+		wheel.schedule(&other, 20);
+		wheel.schedule(&entry, 50);
+		EXPECT_EQ(2, wheel.count());
+	}
+	EXPECT_EQ(1, wheel.count());
+	ASSERT_TRUE(waitForTimeout(entry));
+	EXPECT_EQ(0, wheel.count());
+}
+
+TEST(TimerWheelTest, destroyWheel)
+{
+	QElapsedTimer clock;
+	clock.start();
+	TestEntry entry(&clock);
+	{
+		TimerWheel wheel;
+		wheel.schedule(&entry, 20);
+	}
+	// The entry is detached from the wheel, so it can be destroyed safely.
+	EXPECT_FALSE(entry.isScheduled());
+}